@@ -0,0 +1,333 @@
+#ifndef CSLIBS_NDT_COMMON_ADAPTIVE_TREE_HPP
+#define CSLIBS_NDT_COMMON_ADAPTIVE_TREE_HPP
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/common/mod.hpp>
+
+#include <cslibs_ndt/common/distribution.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Sparse forest of 2^Dim-trees, quadtrees in 2D and octrees in 3D,
+ *        holding one distribution per cell. The roots are hashed, a root
+ *        spans 2^max_depth cells of the finest resolution per axis.
+ *
+ *        A leaf splits once its distribution is not flat anymore, i.e. the
+ *        smallest eigenvalue of its covariance exceeds a fraction of the
+ *        largest, which is the case for corners, edges, curved or scattered
+ *        structure. An inner node, whose children are all leaves, is merged
+ *        again if the sum of their moments is flat, as a single distribution
+ *        then describes them well. Leaves keep the moments per child, so a
+ *        split and a merge both are exact.
+ *
+ *        Points are not kept, so a child created by a split only knows how
+ *        the points inserted from then on fall into its own children. It
+ *        therefore only splits while all of its points are known this way,
+ *        i.e. if they were all inserted within the batch which split its
+ *        parent, and stays a leaf otherwise. No point is ever lost, points
+ *        inserted within one batch are resolved exactly.
+ */
+template<std::size_t Dim, typename T = double>
+class EIGEN_ALIGN16 AdaptiveTree
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    static constexpr std::size_t Size = 1ul << Dim;
+
+    using Ptr            = std::shared_ptr<AdaptiveTree>;
+    using ConstPtr       = std::shared_ptr<const AdaptiveTree>;
+    using index_t        = std::array<int, Dim>;
+    using sample_t       = Eigen::Matrix<double, Dim, 1>;
+    using samples_t      = std::vector<sample_t, Eigen::aligned_allocator<sample_t>>;
+    using distribution_t = cslibs_ndt::Distribution<Dim, T>;
+    using moments_t      = typename distribution_t::distribution_t;
+
+    /**
+     * @brief Constructor.
+     * @param max_depth         number of subdivisions of a root cell
+     * @param flatness          a leaf splits, once the ratio of the smallest
+     *                          to the largest covariance eigenvalue exceeds it,
+     *                          children merge below half of it
+     * @param min_points        leaves with less points never split
+     */
+    inline AdaptiveTree(const std::size_t max_depth,
+                        const double      flatness   = 0.05,
+                        const std::size_t min_points = 4 * Dim) :
+        max_depth_(max_depth),
+        flatness_split_(flatness),
+        flatness_merge_(0.5 * flatness),
+        min_points_(min_points)
+    {
+    }
+
+    inline AdaptiveTree(const AdaptiveTree &other) :
+        max_depth_(other.max_depth_),
+        flatness_split_(other.flatness_split_),
+        flatness_merge_(other.flatness_merge_),
+        min_points_(other.min_points_)
+    {
+        for (const auto &r : other.roots_)
+            roots_[r.first].reset(new Node(*r.second));
+    }
+
+    inline AdaptiveTree(AdaptiveTree &&other) = default;
+
+    inline std::size_t getMaxDepth() const
+    {
+        return max_depth_;
+    }
+
+    inline bool empty() const
+    {
+        return roots_.empty();
+    }
+
+    /**
+     * @brief Insert a batch of samples.
+     * @param samples   the samples stored in the distributions
+     * @param cells     index of every sample at the finest resolution
+     */
+    inline void insert(const samples_t            &samples,
+                       const std::vector<index_t> &cells)
+    {
+        std::unordered_map<index_t, ids_t, parallel::IndexHash<index_t>> roots;
+        for (std::size_t i = 0 ; i < samples.size() ; ++i)
+            roots[toRoot(cells[i])].emplace_back(i);
+
+        for (const auto &r : roots) {
+            std::unique_ptr<Node> &root = roots_[r.first];
+            if (!root)
+                root.reset(new Node(max_depth_ > 0));
+            for (const std::size_t i : r.second)
+                root->distribution.data().add(samples[i]);
+            insert(*root, 0, samples, cells, r.second);
+        }
+    }
+
+    /**
+     * @brief Leaf containing a cell of the finest resolution, nullptr for
+     *        unknown space.
+     */
+    inline const distribution_t* getDistribution(const index_t &cell) const
+    {
+        const auto r = roots_.find(toRoot(cell));
+        if (r == roots_.end())
+            return nullptr;
+
+        const Node *node = r->second.get();
+        for (std::size_t depth = 0 ; node && node->children ; ++depth)
+            node = node->children->at(toChild(cell, depth)).get();
+        return node ? &node->distribution : nullptr;
+    }
+
+    /**
+     * @brief Visit all leaves.
+     * @param function  (const index_t &root, const std::size_t depth, const distribution_t &d)
+     */
+    template<typename Fn>
+    inline void traverse(const Fn &function) const
+    {
+        for (const auto &r : roots_)
+            traverse(*r.second, r.first, 0, function);
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        std::size_t size = sizeof(*this) +
+                roots_.bucket_count() * sizeof(void*) +
+                roots_.size() * (sizeof(index_t) + sizeof(std::unique_ptr<Node>) + sizeof(void*));
+        for (const auto &r : roots_)
+            size += r.second->getByteSize();
+        return size;
+    }
+
+private:
+    using ids_t = std::vector<std::size_t>;
+
+    struct EIGEN_ALIGN16 Candidates
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        std::array<moments_t, Size> data;
+    };
+
+    struct EIGEN_ALIGN16 Node
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        using children_t = std::array<std::unique_ptr<Node>, Size>;
+
+        /// moments of all points in the cell
+        distribution_t              distribution;
+        /// inner nodes only
+        std::unique_ptr<children_t> children;
+        /// leaves above the maximum depth only, moments per child
+        std::unique_ptr<Candidates> candidates;
+
+        inline explicit Node(const bool refinable) :
+            candidates(refinable ? new Candidates : nullptr)
+        {
+        }
+
+        inline Node(const Node &other) :
+            distribution(other.distribution),
+            candidates(other.candidates ? new Candidates(*other.candidates) : nullptr)
+        {
+            if (other.children) {
+                children.reset(new children_t);
+                for (std::size_t c = 0 ; c < Size ; ++c)
+                    if (other.children->at(c))
+                        children->at(c).reset(new Node(*other.children->at(c)));
+            }
+        }
+
+        inline std::size_t getByteSize() const
+        {
+            std::size_t size = sizeof(Node);
+            if (candidates)
+                size += sizeof(Candidates);
+            if (children) {
+                size += sizeof(children_t);
+                for (const std::unique_ptr<Node> &c : *children)
+                    if (c)
+                        size += c->getByteSize();
+            }
+            return size;
+        }
+    };
+
+    std::size_t max_depth_;
+    double      flatness_split_;
+    double      flatness_merge_;
+    std::size_t min_points_;
+    std::unordered_map<index_t, std::unique_ptr<Node>, parallel::IndexHash<index_t>> roots_;
+
+    inline index_t toRoot(const index_t &cell) const
+    {
+        index_t r;
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            r[d] = cslibs_math::common::div<int>(cell[d], 1 << max_depth_);
+        return r;
+    }
+
+    inline std::size_t toChild(const index_t &cell,
+                               const std::size_t depth) const
+    {
+        std::size_t c = 0;
+        for (std::size_t d = 0 ; d < Dim ; ++d) {
+            const int local = cslibs_math::common::mod<int>(cell[d], 1 << max_depth_);
+            c |= static_cast<std::size_t>((local >> (max_depth_ - depth - 1)) & 1) << d;
+        }
+        return c;
+    }
+
+    /// ratio of the smallest to the largest covariance eigenvalue
+    static inline double flatness(const moments_t &moments)
+    {
+        using covariance_t = Eigen::Matrix<double, Dim, Dim>;
+        const covariance_t cov = moments.getCovariance().template cast<double>();
+        const sample_t     ev  = Eigen::SelfAdjointEigenSolver<covariance_t>(cov, Eigen::EigenvaluesOnly).eigenvalues();
+        return ev(Dim - 1) > 0.0 ? std::max(0.0, ev(0)) / ev(Dim - 1) : 0.0;
+    }
+
+    inline bool split(const Node &node) const
+    {
+        /// the candidates of a child created by a split lack the points inserted before
+        std::size_t known = 0;
+        for (const moments_t &m : node.candidates->data)
+            known += m.getN();
+        return known == node.distribution.data().getN() &&
+               node.distribution.data().getN() >= min_points_ &&
+               flatness(node.distribution.data()) > flatness_split_;
+    }
+
+    inline bool merge(const Node &node) const
+    {
+        for (const std::unique_ptr<Node> &c : *node.children)
+            if (c && c->children)
+                return false;
+        return node.distribution.data().getN() < min_points_ ||
+               flatness(node.distribution.data()) <= flatness_merge_;
+    }
+
+    /// the samples are already contained in the distribution of the node
+    inline void insert(Node                       &node,
+                       const std::size_t           depth,
+                       const samples_t            &samples,
+                       const std::vector<index_t> &cells,
+                       const ids_t                &ids)
+    {
+        if (depth == max_depth_)
+            return;
+
+        std::array<ids_t, Size> partition;
+        for (const std::size_t i : ids)
+            partition[toChild(cells[i], depth)].emplace_back(i);
+
+        if (!node.children) {
+            for (std::size_t c = 0 ; c < Size ; ++c)
+                for (const std::size_t i : partition[c])
+                    node.candidates->data[c].add(samples[i]);
+            if (!split(node))
+                return;
+
+            node.children.reset(new typename Node::children_t);
+            for (std::size_t c = 0 ; c < Size ; ++c) {
+                const moments_t &moments = node.candidates->data[c];
+                if (moments.getN() == 0)
+                    continue;
+                std::unique_ptr<Node> &child = node.children->at(c);
+                child.reset(new Node(depth + 1 < max_depth_));
+                child->distribution.data() = moments;
+                insert(*child, depth + 1, samples, cells, partition[c]);
+            }
+            node.candidates.reset();
+            return;
+        }
+
+        for (std::size_t c = 0 ; c < Size ; ++c) {
+            if (partition[c].empty())
+                continue;
+            std::unique_ptr<Node> &child = node.children->at(c);
+            if (!child)
+                child.reset(new Node(depth + 1 < max_depth_));
+            for (const std::size_t i : partition[c])
+                child->distribution.data().add(samples[i]);
+            insert(*child, depth + 1, samples, cells, partition[c]);
+        }
+
+        if (merge(node)) {
+            node.candidates.reset(new Candidates);
+            for (std::size_t c = 0 ; c < Size ; ++c)
+                if (node.children->at(c))
+                    node.candidates->data[c] = node.children->at(c)->distribution.data();
+            node.children.reset();
+        }
+    }
+
+    template<typename Fn>
+    inline void traverse(const Node        &node,
+                         const index_t     &root,
+                         const std::size_t  depth,
+                         const Fn          &function) const
+    {
+        if (!node.children) {
+            function(root, depth, node.distribution);
+            return;
+        }
+        for (const std::unique_ptr<Node> &c : *node.children)
+            if (c)
+                traverse(*c, root, depth + 1, function);
+    }
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_ADAPTIVE_TREE_HPP
@@ -0,0 +1,33 @@
+#ifndef CSLIBS_NDT_COMMON_BACKEND_HPP
+#define CSLIBS_NDT_COMMON_BACKEND_HPP
+
+#include <cslibs_indexed_storage/storage.hpp>
+#include <cslibs_indexed_storage/backend/kdtree/kdtree.hpp>
+
+#include <cslibs_ndt/common/morton_storage.hpp>
+
+namespace cslibs_ndt {
+namespace backend {
+/**
+ * @brief Storages of the distributions and bundles of a dynamic map.
+ */
+struct KDTree
+{
+    template<typename data_t, typename index_t>
+    using storage_t = cslibs_indexed_storage::Storage<data_t, index_t, cslibs_indexed_storage::backend::kdtree::KDTree>;
+};
+
+/**
+ * @brief Blocks in Z-order, see MortonStorage, so that spatially adjacent
+ *        bundles and distributions are adjacent in memory and traversals
+ *        stream through them.
+ */
+struct Morton
+{
+    template<typename data_t, typename index_t>
+    using storage_t = MortonStorage<data_t, index_t>;
+};
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_BACKEND_HPP
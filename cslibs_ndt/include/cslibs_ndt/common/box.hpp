@@ -0,0 +1,55 @@
+#ifndef CSLIBS_NDT_COMMON_BOX_HPP
+#define CSLIBS_NDT_COMMON_BOX_HPP
+
+#include <algorithm>
+#include <tuple>
+
+namespace cslibs_ndt {
+namespace box {
+/**
+ * @brief Component-wise minimum of two indices. std::min compares index
+ *        arrays lexicographically, which does not bound a box.
+ */
+template<typename index_t>
+inline index_t minimum(const index_t &a,
+                       const index_t &b)
+{
+    index_t m;
+    for (std::size_t d = 0 ; d < std::tuple_size<index_t>::value ; ++d)
+        m[d] = std::min(a[d], b[d]);
+    return m;
+}
+
+/**
+ * @brief Component-wise maximum of two indices.
+ */
+template<typename index_t>
+inline index_t maximum(const index_t &a,
+                       const index_t &b)
+{
+    index_t m;
+    for (std::size_t d = 0 ; d < std::tuple_size<index_t>::value ; ++d)
+        m[d] = std::max(a[d], b[d]);
+    return m;
+}
+
+/**
+ * @brief Test if an index lies inside a box.
+ * @param bi        the index
+ * @param min_bi    minimum index of the box, inclusive
+ * @param max_bi    maximum index of the box, inclusive
+ */
+template<typename index_t>
+inline bool contains(const index_t &bi,
+                     const index_t &min_bi,
+                     const index_t &max_bi)
+{
+    for (std::size_t d = 0 ; d < std::tuple_size<index_t>::value ; ++d)
+        if (bi[d] < min_bi[d] || bi[d] > max_bi[d])
+            return false;
+    return true;
+}
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_BOX_HPP
@@ -72,6 +72,10 @@ public:
         return data_;
     }
 
+    /**
+     * @brief Bundles only refer to the distributions of the storages, which
+     *        are merged on their own, so the references are kept.
+     */
     inline void merge(const Bundle &)
     {
     }
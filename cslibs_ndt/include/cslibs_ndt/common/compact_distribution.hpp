@@ -0,0 +1,289 @@
+#ifndef CSLIBS_NDT_COMMON_COMPACT_DISTRIBUTION_HPP
+#define CSLIBS_NDT_COMMON_COMPACT_DISTRIBUTION_HPP
+
+#include <memory>
+#include <cmath>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math/statistics/distribution.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Normal distribution storing its moments with scalar type T.
+ *        The interface mirrors cslibs_math::statistics::Distribution and
+ *        exchanges double precision samples and matrices, so it can be
+ *        used as a drop-in replacement inside the maps. Instead of the
+ *        correlated moment the central second moment is kept, which does
+ *        not suffer from cancellation when covariances are recovered in
+ *        single precision. Updates are computed with accumulator_t and
+ *        rounded to T afterwards.
+ */
+template<typename T, std::size_t Dim, std::size_t lambda_ratio_exponent = 3, typename accumulator_t = double>
+class EIGEN_ALIGN16 CompactDistribution
+{
+public:
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr             = std::shared_ptr<CompactDistribution>;
+    using allocator_t     = Eigen::aligned_allocator<CompactDistribution>;
+
+    using sample_t        = Eigen::Matrix<double, Dim, 1>;
+    using covariance_t    = Eigen::Matrix<double, Dim, Dim>;
+    using eigen_values_t  = Eigen::Matrix<double, Dim, 1>;
+    using eigen_vectors_t = Eigen::Matrix<double, Dim, Dim>;
+
+    using mean_t          = Eigen::Matrix<T, Dim, 1>;
+    using scatter_t       = Eigen::Matrix<T, Dim, Dim>;
+
+    inline CompactDistribution() :
+        n_(0),
+        mean_(mean_t::Zero()),
+        scatter_(scatter_t::Zero()),
+        inverse_covariance_(scatter_t::Zero()),
+        determinant_(T()),
+        dirty_(true)
+    {
+    }
+
+    inline CompactDistribution(const std::size_t n,
+                               const mean_t     &mean,
+                               const scatter_t  &scatter) :
+        n_(n),
+        mean_(mean),
+        scatter_(scatter),
+        inverse_covariance_(scatter_t::Zero()),
+        determinant_(T()),
+        dirty_(true)
+    {
+    }
+
+    inline void reset()
+    {
+        n_       = 0;
+        mean_    = mean_t::Zero();
+        scatter_ = scatter_t::Zero();
+        dirty_   = true;
+    }
+
+    inline void add(const sample_t &p)
+    {
+        using acc_sample_t = Eigen::Matrix<accumulator_t, Dim, 1>;
+        using acc_matrix_t = Eigen::Matrix<accumulator_t, Dim, Dim>;
+
+        const accumulator_t n     = static_cast<accumulator_t>(n_);
+        const accumulator_t n_1   = n + accumulator_t(1);
+        const acc_sample_t  x     = p.template cast<accumulator_t>();
+        const acc_sample_t  mean  = mean_.template cast<accumulator_t>();
+        const acc_sample_t  delta = x - mean;
+        const acc_sample_t  mean_next = mean + delta / n_1;
+        const acc_matrix_t  scatter   = (scatter_.template cast<accumulator_t>() * n +
+                                         delta * (x - mean_next).transpose()) / n_1;
+
+        mean_    = mean_next.template cast<T>();
+        scatter_ = scatter.template cast<T>();
+        ++ n_;
+        dirty_   = true;
+    }
+
+    inline CompactDistribution& operator += (const CompactDistribution &other)
+    {
+        if (other.n_ == 0)
+            return *this;
+        if (n_ == 0)
+            return (*this = other);
+
+        using acc_sample_t = Eigen::Matrix<accumulator_t, Dim, 1>;
+        using acc_matrix_t = Eigen::Matrix<accumulator_t, Dim, Dim>;
+
+        const accumulator_t na    = static_cast<accumulator_t>(n_);
+        const accumulator_t nb    = static_cast<accumulator_t>(other.n_);
+        const accumulator_t n     = na + nb;
+        const acc_sample_t  mean  = mean_.template cast<accumulator_t>();
+        const acc_sample_t  delta = other.mean_.template cast<accumulator_t>() - mean;
+        const acc_matrix_t  scatter = (scatter_.template cast<accumulator_t>() * na +
+                                       other.scatter_.template cast<accumulator_t>() * nb) / n +
+                                      delta * delta.transpose() * (na * nb / (n * n));
+
+        mean_    = (mean + delta * (nb / n)).template cast<T>();
+        scatter_ = scatter.template cast<T>();
+        n_      += other.n_;
+        dirty_   = true;
+        return *this;
+    }
+
+    inline std::size_t getN() const
+    {
+        return n_;
+    }
+
+    inline bool valid() const
+    {
+        return n_ >= 3;
+    }
+
+    inline sample_t getMean() const
+    {
+        return mean_.template cast<double>();
+    }
+
+    inline covariance_t getCorrelated() const
+    {
+        const sample_t mean = getMean();
+        return scatter_.template cast<double>() + mean * mean.transpose();
+    }
+
+    inline covariance_t getCovariance() const
+    {
+        update();
+        return covariance_.template cast<double>();
+    }
+
+    inline covariance_t getInformationMatrix() const
+    {
+        update();
+        return inverse_covariance_.template cast<double>();
+    }
+
+    inline eigen_values_t getEigenValues(const bool abs = false) const
+    {
+        update();
+        return abs ? eigen_values_.cwiseAbs().template cast<double>() : eigen_values_.template cast<double>();
+    }
+
+    inline eigen_vectors_t getEigenVectors() const
+    {
+        update();
+        return eigen_vectors_.template cast<double>();
+    }
+
+    inline double sample(const sample_t &p) const
+    {
+        update();
+        if (!valid())
+            return 0.0;
+
+        const mean_t q = p.template cast<T>() - mean_;
+        const T exponent = T(-0.5) * q.dot(inverse_covariance_ * q);
+        const T denominator = std::sqrt(std::pow(T(2 * M_PI), T(Dim)) * determinant_);
+        return static_cast<double>(std::exp(exponent) / denominator);
+    }
+
+    inline double sampleNonNormalized(const sample_t &p) const
+    {
+        update();
+        if (!valid())
+            return 0.0;
+
+        const mean_t q = p.template cast<T>() - mean_;
+        const T exponent = T(-0.5) * q.dot(inverse_covariance_ * q);
+        return static_cast<double>(std::exp(exponent));
+    }
+
+    /**
+     * @brief Get the stored mean, as used for serialization.
+     * @return the mean in storage precision
+     */
+    inline const mean_t& getStoredMean() const
+    {
+        return mean_;
+    }
+
+    /**
+     * @brief Get the stored, biased central second moment.
+     * @return the scatter in storage precision
+     */
+    inline const scatter_t& getStoredScatter() const
+    {
+        return scatter_;
+    }
+
+    inline std::size_t byte_size() const
+    {
+        return sizeof(*this);
+    }
+
+private:
+    std::size_t         n_;
+    mean_t              mean_;
+    scatter_t           scatter_;
+
+    mutable scatter_t   covariance_;
+    mutable scatter_t   inverse_covariance_;
+    mutable mean_t      eigen_values_;
+    mutable scatter_t   eigen_vectors_;
+    mutable T           determinant_;
+    mutable bool        dirty_;
+
+    inline void update() const
+    {
+        if (!dirty_)
+            return;
+
+        if (valid()) {
+            /// the decomposition is done in double precision, only its result is stored
+            const double   n = static_cast<double>(n_);
+            covariance_t   c = scatter_.template cast<double>() * (n / (n - 1.0));
+
+            Eigen::SelfAdjointEigenSolver<covariance_t> solver(c);
+            eigen_values_t  values  = solver.eigenvalues();
+            eigen_vectors_t vectors = solver.eigenvectors();
+
+            const double min_lambda = values.maxCoeff() * std::pow(10.0, -static_cast<double>(lambda_ratio_exponent));
+            for (std::size_t i = 0 ; i < Dim ; ++i)
+                if (values(i) < min_lambda)
+                    values(i) = min_lambda;
+            c = vectors * values.asDiagonal() * vectors.transpose();
+
+            covariance_         = c.template cast<T>();
+            inverse_covariance_ = c.inverse().template cast<T>();
+            eigen_values_       = values.template cast<T>();
+            eigen_vectors_      = vectors.template cast<T>();
+            determinant_        = static_cast<T>(c.determinant());
+        } else {
+            covariance_         = scatter_t::Zero();
+            inverse_covariance_ = scatter_t::Zero();
+            eigen_values_       = mean_t::Zero();
+            eigen_vectors_      = scatter_t::Zero();
+            determinant_        = T();
+        }
+        dirty_ = false;
+    }
+};
+
+/**
+ * @brief Selects the moment storage for a given scalar type, double keeps
+ *        the cslibs_math implementation.
+ */
+template<std::size_t Dim, typename T>
+struct DistributionType
+{
+    using type = CompactDistribution<T, Dim, 3>;
+};
+
+template<std::size_t Dim>
+struct DistributionType<Dim, double>
+{
+    using type = cslibs_math::statistics::Distribution<Dim, 3>;
+};
+
+/**
+ * @brief Same mean and covariance, weighted as if estimated from n samples.
+ */
+template<std::size_t Dim, std::size_t L>
+inline cslibs_math::statistics::Distribution<Dim, L> reweighted(const cslibs_math::statistics::Distribution<Dim, L> &d,
+                                                                const std::size_t                                    n)
+{
+    return cslibs_math::statistics::Distribution<Dim, L>(n, d.getMean(), d.getCorrelated());
+}
+
+template<typename T, std::size_t Dim, std::size_t L, typename A>
+inline CompactDistribution<T, Dim, L, A> reweighted(const CompactDistribution<T, Dim, L, A> &d,
+                                                    const std::size_t                        n)
+{
+    return CompactDistribution<T, Dim, L, A>(n, d.getStoredMean(), d.getStoredScatter());
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_COMPACT_DISTRIBUTION_HPP
@@ -0,0 +1,109 @@
+#ifndef CSLIBS_NDT_COMMON_DIRTY_BLOCKS_HPP
+#define CSLIBS_NDT_COMMON_DIRTY_BLOCKS_HPP
+
+#include <array>
+#include <vector>
+#include <tuple>
+#include <unordered_set>
+
+#include <cslibs_math/common/div.hpp>
+
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Set of blocks of bundles which changed since it was cleared the last
+ *        time, so consumers of a map only need to reprocess these. Blocks span
+ *        2^block_exponent bundles per axis, which keeps marking cheap, as the
+ *        bundles touched by a ray or a cloud are mostly adjacent and a repeated
+ *        block is detected without hashing.
+ */
+template<typename index_t>
+class DirtyBlocks
+{
+public:
+    static constexpr std::size_t Dim = std::tuple_size<index_t>::value;
+
+    using blocks_t = std::unordered_set<index_t, parallel::IndexHash<index_t>>;
+
+    inline explicit DirtyBlocks(const int block_exponent = 3) :
+        block_size_(1 << block_exponent)
+    {
+    }
+
+    inline void mark(const index_t &bi)
+    {
+        index_t block;
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            block[d] = cslibs_math::common::div<int>(bi[d], block_size_);
+        if (!blocks_.empty() && block == last_)
+            return;
+
+        last_ = block;
+        blocks_.insert(block);
+    }
+
+    inline void clear()
+    {
+        blocks_.clear();
+    }
+
+    inline bool empty() const
+    {
+        return blocks_.empty();
+    }
+
+    inline std::size_t size() const
+    {
+        return blocks_.size();
+    }
+
+    inline int getBlockSize() const
+    {
+        return block_size_;
+    }
+
+    inline const blocks_t& getBlocks() const
+    {
+        return blocks_;
+    }
+
+    /**
+     * @brief Bundles which might have changed with a block. Neighbouring
+     *        bundles share distributions, so the block is grown by one.
+     * @param block     the block
+     * @param min_bi    minimum bundle index, inclusive
+     * @param max_bi    maximum bundle index, inclusive
+     */
+    inline void getBounds(const index_t &block,
+                          index_t       &min_bi,
+                          index_t       &max_bi) const
+    {
+        for (std::size_t d = 0 ; d < Dim ; ++d) {
+            min_bi[d] = block[d] * block_size_ - 1;
+            max_bi[d] = (block[d] + 1) * block_size_;
+        }
+    }
+
+    /**
+     * @brief Visit the bounds of all blocks.
+     * @param function  (const index_t &min_bi, const index_t &max_bi)
+     */
+    template<typename Fn>
+    inline void traverse(const Fn &function) const
+    {
+        index_t min_bi, max_bi;
+        for (const index_t &block : blocks_) {
+            getBounds(block, min_bi, max_bi);
+            function(min_bi, max_bi);
+        }
+    }
+
+private:
+    int      block_size_;
+    index_t  last_;
+    blocks_t blocks_;
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_DIRTY_BLOCKS_HPP
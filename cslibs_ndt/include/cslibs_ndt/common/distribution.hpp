@@ -4,12 +4,13 @@
 #include <mutex>
 
 #include <cslibs_math/statistics/distribution.hpp>
+#include <cslibs_ndt/common/compact_distribution.hpp>
 
 #include <cslibs_indexed_storage/storage.hpp>
 #include <cslibs_indexed_storage/backend/kdtree/kdtree.hpp>
 
 namespace cslibs_ndt {
-template<std::size_t Dim>
+template<std::size_t Dim, typename T = double>
 class EIGEN_ALIGN16 Distribution
 {
 public:
@@ -17,8 +18,9 @@ public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
     using allocator_t              = Eigen::aligned_allocator<Distribution>;
-    using distribution_container_t = Distribution<Dim>;
-    using distribution_t           = cslibs_math::statistics::Distribution<Dim, 3>;
+    using distribution_container_t = Distribution<Dim, T>;
+    using distribution_t           = typename DistributionType<Dim, T>::type;
+    using scalar_t                 = T;
 
     inline Distribution()
     {
@@ -78,8 +80,9 @@ public:
         return data_;
     }
 
-    inline void merge(const Distribution &)
+    inline void merge(const Distribution &other)
     {
+        data_ += other.data_;
     }
 
     inline std::size_t byte_size() const
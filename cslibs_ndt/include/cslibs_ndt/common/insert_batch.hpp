@@ -0,0 +1,68 @@
+#ifndef CSLIBS_NDT_COMMON_INSERT_BATCH_HPP
+#define CSLIBS_NDT_COMMON_INSERT_BATCH_HPP
+
+#include <vector>
+#include <utility>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math/linear/pointcloud.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Point clouds of several sensors together with their origins, which
+ *        are inserted into a map in one call, so that the moments are
+ *        aggregated once for all sensors.
+ */
+template<typename point_t, typename pose_t>
+class InsertBatch
+{
+public:
+    using cloud_t   = cslibs_math::linear::Pointcloud<point_t>;
+    using entry_t   = std::pair<typename cloud_t::ConstPtr, pose_t>;
+    using entries_t = std::vector<entry_t, Eigen::aligned_allocator<entry_t>>;
+
+    inline InsertBatch() = default;
+
+    /**
+     * @brief Add a cloud to the batch.
+     * @param points        the points, given in the sensor frame
+     * @param points_origin sensor pose in the world frame
+     */
+    inline void add(const typename cloud_t::ConstPtr &points,
+                    const pose_t &points_origin = pose_t())
+    {
+        entries_.emplace_back(points, points_origin);
+    }
+
+    inline std::size_t size() const
+    {
+        return entries_.size();
+    }
+
+    inline bool empty() const
+    {
+        return entries_.empty();
+    }
+
+    inline void clear()
+    {
+        entries_.clear();
+    }
+
+    inline typename entries_t::const_iterator begin() const
+    {
+        return entries_.begin();
+    }
+
+    inline typename entries_t::const_iterator end() const
+    {
+        return entries_.end();
+    }
+
+private:
+    entries_t entries_;
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_INSERT_BATCH_HPP
@@ -0,0 +1,97 @@
+#ifndef CSLIBS_NDT_COMMON_MERGE_HPP
+#define CSLIBS_NDT_COMMON_MERGE_HPP
+
+#include <array>
+#include <cmath>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math/statistics/distribution.hpp>
+#include <cslibs_ndt/common/compact_distribution.hpp>
+#include <cslibs_ndt/common/occupancy_distribution.hpp>
+
+namespace cslibs_ndt {
+namespace merge {
+template<std::size_t Dim>
+using rotation_t    = Eigen::Matrix<double, int(Dim), int(Dim)>;
+template<std::size_t Dim>
+using translation_t = Eigen::Matrix<double, int(Dim), 1>;
+
+/**
+ * @brief Moments of the samples of a distribution after applying p' = R p + t.
+ */
+template<std::size_t Dim>
+inline cslibs_math::statistics::Distribution<Dim, 3> transform(const cslibs_math::statistics::Distribution<Dim, 3> &d,
+                                                               const rotation_t<Dim>                               &R,
+                                                               const translation_t<Dim>                            &t)
+{
+    using sample_t     = translation_t<Dim>;
+    using covariance_t = rotation_t<Dim>;
+
+    const sample_t     mean       = d.getMean();
+    const sample_t     r_mean     = R * mean;
+    const covariance_t correlated = R * d.getCorrelated() * R.transpose() +
+                                    r_mean * t.transpose() + t * r_mean.transpose() +
+                                    t * t.transpose();
+    return cslibs_math::statistics::Distribution<Dim, 3>(d.getN(), r_mean + t, correlated);
+}
+
+template<typename T, std::size_t Dim, std::size_t L, typename A>
+inline CompactDistribution<T, Dim, L, A> transform(const CompactDistribution<T, Dim, L, A> &d,
+                                                   const rotation_t<Dim>                   &R,
+                                                   const translation_t<Dim>                &t)
+{
+    using distribution_t = CompactDistribution<T, Dim, L, A>;
+    const translation_t<Dim> mean    = R * d.getStoredMean().template cast<double>() + t;
+    const rotation_t<Dim>    scatter = R * d.getStoredScatter().template cast<double>() * R.transpose();
+    return distribution_t(d.getN(),
+                          mean.template cast<T>(),
+                          scatter.template cast<T>());
+}
+
+/**
+ * @brief Cell with transformed moments, which keeps the decay state of the original.
+ */
+template<std::size_t Dim, typename T>
+inline OccupancyDistribution<Dim, T> transform(const OccupancyDistribution<Dim, T> &d,
+                                               const rotation_t<Dim>               &R,
+                                               const translation_t<Dim>            &t)
+{
+    using distribution_t = typename OccupancyDistribution<Dim, T>::distribution_t;
+
+    OccupancyDistribution<Dim, T> c(d.numFree(), d.getStamp(), d.getFreeScale(), d.getOccupiedScale());
+    if (d.getDistribution())
+        c.getDistribution().reset(new distribution_t(transform(*d.getDistribution(), R, t)));
+    return c;
+}
+
+/**
+ * @brief Check whether two grids with the same resolution are aligned, i.e.
+ *        the transformation between them is a translation by whole cells.
+ * @param R             rotation between the grids
+ * @param t             translation between the grids
+ * @param resolution    cell size
+ * @param offset        translation in cells, if aligned
+ */
+template<std::size_t Dim>
+inline bool aligned(const rotation_t<Dim>    &R,
+                    const translation_t<Dim> &t,
+                    const double              resolution,
+                    std::array<int, Dim>     &offset)
+{
+    static constexpr double eps = 1e-6;
+    if (!R.isIdentity(eps))
+        return false;
+
+    for (std::size_t d = 0 ; d < Dim ; ++d) {
+        const double cells = t(d) / resolution;
+        offset[d] = static_cast<int>(std::round(cells));
+        if (std::abs(cells - offset[d]) > eps)
+            return false;
+    }
+    return true;
+}
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_MERGE_HPP
@@ -0,0 +1,109 @@
+#ifndef CSLIBS_NDT_COMMON_MORTON_HPP
+#define CSLIBS_NDT_COMMON_MORTON_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace cslibs_ndt {
+namespace morton {
+/**
+ * @brief Interleave the lower 32 bits of x with zeros, bit i moves to 2i.
+ */
+inline uint64_t spread2(const uint64_t x)
+{
+    uint64_t v = x & 0x00000000ffffffffULL;
+    v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+    v = (v | (v <<  8)) & 0x00ff00ff00ff00ffULL;
+    v = (v | (v <<  4)) & 0x0f0f0f0f0f0f0f0fULL;
+    v = (v | (v <<  2)) & 0x3333333333333333ULL;
+    v = (v | (v <<  1)) & 0x5555555555555555ULL;
+    return v;
+}
+
+/**
+ * @brief Interleave the lower 21 bits of x with zeros, bit i moves to 3i.
+ */
+inline uint64_t spread3(const uint64_t x)
+{
+    uint64_t v = x & 0x00000000001fffffULL;
+    v = (v | (v << 32)) & 0x001f00000000ffffULL;
+    v = (v | (v << 16)) & 0x001f0000ff0000ffULL;
+    v = (v | (v <<  8)) & 0x100f00f00f00f00fULL;
+    v = (v | (v <<  4)) & 0x10c30c30c30c30c3ULL;
+    v = (v | (v <<  2)) & 0x1249249249249249ULL;
+    return v;
+}
+
+/**
+ * @brief Z-order code of an index relative to an offset, which has to be
+ *        less or equal to the index in every dimension.
+ * @param i         the index
+ * @param offset    the offset, e.g. the minimum index of a map
+ * @return the code
+ */
+inline uint64_t encode(const std::array<int, 2> &i,
+                       const std::array<int, 2> &offset)
+{
+    return spread2(static_cast<uint64_t>(i[0] - offset[0])) |
+          (spread2(static_cast<uint64_t>(i[1] - offset[1])) << 1);
+}
+
+inline uint64_t encode(const std::array<int, 3> &i,
+                       const std::array<int, 3> &offset)
+{
+    return spread3(static_cast<uint64_t>(i[0] - offset[0])) |
+          (spread3(static_cast<uint64_t>(i[1] - offset[1])) << 1) |
+          (spread3(static_cast<uint64_t>(i[2] - offset[2])) << 2);
+}
+
+/**
+ * @brief Collects bundles and visits them sorted by their Z-order code,
+ *        so that spatially adjacent bundles are visited consecutively.
+ */
+template<typename index_t, typename bundle_t>
+class Order
+{
+public:
+    inline explicit Order(const index_t &offset,
+                          const std::size_t reserve = 0) :
+        offset_(offset)
+    {
+        entries_.reserve(reserve);
+    }
+
+    inline void add(const index_t &i,
+                    bundle_t *bundle)
+    {
+        entries_.emplace_back(entry_t{encode(i, offset_), i, bundle});
+    }
+
+    inline std::size_t size() const
+    {
+        return entries_.size();
+    }
+
+    template <typename Fn>
+    inline void traverse(const Fn &function)
+    {
+        std::sort(entries_.begin(), entries_.end(),
+                  [](const entry_t &a, const entry_t &b) { return a.code < b.code; });
+        for (const entry_t &e : entries_)
+            function(e.index, *e.bundle);
+    }
+
+private:
+    struct entry_t {
+        uint64_t  code;
+        index_t   index;
+        bundle_t *bundle;
+    };
+
+    const index_t        offset_;
+    std::vector<entry_t> entries_;
+};
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_MORTON_HPP
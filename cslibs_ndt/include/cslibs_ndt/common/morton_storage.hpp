@@ -0,0 +1,261 @@
+#ifndef CSLIBS_NDT_COMMON_MORTON_STORAGE_HPP
+#define CSLIBS_NDT_COMMON_MORTON_STORAGE_HPP
+
+#include <map>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <type_traits>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/common/mod.hpp>
+
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/box.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Sparse storage which keeps its elements in Z-order (Morton order).
+ *        The index space is divided into blocks of 2^block_exponent indices
+ *        per axis. A block holds its elements densely, laid out by the
+ *        Z-order code of their offset within the block, and the blocks are
+ *        kept sorted by the Z-order code of the block index. Spatially
+ *        adjacent elements therefore mostly share a block, and a traversal
+ *        visits the elements in global Z-order while reading the blocks
+ *        front to back.
+ *
+ *        Elements never move once they are inserted, so pointers to them
+ *        stay valid. Empty slots of a block are default constructed, which
+ *        is the memory traded for the locality.
+ *
+ *        The members mirror the subset of cslibs_indexed_storage::Storage
+ *        which the maps use, so both can be exchanged.
+ */
+template<typename data_t, typename index_t, std::size_t BlockExponent = 2>
+class MortonStorage
+{
+public:
+    static constexpr std::size_t Dim       = std::tuple_size<index_t>::value;
+    static constexpr int         BlockSize = 1 << BlockExponent;
+    static constexpr std::size_t Slots     = 1ul << (BlockExponent * Dim);
+
+    static_assert(Slots <= 64, "the slots of a block are marked in 64 bits");
+
+    inline MortonStorage() :
+        size_(0)
+    {
+    }
+
+    inline MortonStorage(const MortonStorage &other) :
+        size_(other.size_)
+    {
+        for (const auto &b : other.blocks_)
+            blocks_.emplace_hint(blocks_.end(), b.first, block_ptr_t(new Block(*b.second)));
+    }
+
+    inline MortonStorage(MortonStorage &&other) = default;
+
+    inline data_t* get(const index_t &i)
+    {
+        const auto b = blocks_.find(code(toBlock(i)));
+        if (b == blocks_.end())
+            return nullptr;
+        const std::size_t s = toSlot(i);
+        return b->second->used(s) ? &b->second->data[s] : nullptr;
+    }
+
+    inline const data_t* get(const index_t &i) const
+    {
+        const auto b = blocks_.find(code(toBlock(i)));
+        if (b == blocks_.end())
+            return nullptr;
+        const std::size_t s = toSlot(i);
+        return b->second->used(s) ? &b->second->data[s] : nullptr;
+    }
+
+    /**
+     * @brief Insert or overwrite an element.
+     * @return the stored element
+     */
+    inline data_t& insert(const index_t &i,
+                          const data_t  &d)
+    {
+        const index_t bi = toBlock(i);
+        block_ptr_t  &b  = blocks_[code(bi)];
+        if (!b)
+            b.reset(new Block(bi));
+
+        const std::size_t s = toSlot(i);
+        if (!b->used(s)) {
+            b->mask |= 1ull << s;
+            ++ size_;
+        }
+        b->data[s] = d;
+        return b->data[s];
+    }
+
+    /**
+     * @brief Visit all elements in Z-order.
+     * @param function  (const index_t &i, data_t &d)
+     */
+    template<typename Fn>
+    inline void traverse(const Fn &function)
+    {
+        for (auto &b : blocks_)
+            visit(*b.second, function);
+    }
+
+    template<typename Fn>
+    inline void traverse(const Fn &function) const
+    {
+        for (const auto &b : blocks_)
+            visit(static_cast<const Block&>(*b.second), function);
+    }
+
+    /**
+     * @brief Visit the elements inside an axis-aligned box in Z-order, only
+     *        the blocks intersecting the box are read.
+     * @param min_i     minimum index of the box, inclusive
+     * @param max_i     maximum index of the box, inclusive
+     * @param function  (const index_t &i, const data_t &d)
+     */
+    template<typename Fn>
+    inline void traverse(const index_t &min_i,
+                         const index_t &max_i,
+                         const Fn      &function) const
+    {
+        const index_t min_bi = toBlock(min_i);
+        const index_t max_bi = toBlock(max_i);
+        for (const auto &b : blocks_) {
+            if (!box::contains(b.second->index, min_bi, max_bi))
+                continue;
+            visit(static_cast<const Block&>(*b.second), [&min_i, &max_i, &function](const index_t &i, const data_t &d) {
+                if (box::contains(i, min_i, max_i))
+                    function(i, d);
+            });
+        }
+    }
+
+    inline std::size_t size() const
+    {
+        return size_;
+    }
+
+    inline std::size_t blocks() const
+    {
+        return blocks_.size();
+    }
+
+    inline void clear()
+    {
+        blocks_.clear();
+        size_ = 0;
+    }
+
+    inline std::size_t byte_size() const
+    {
+        /// a tree node holds the key, the block pointer, three links and the color
+        return sizeof(*this) +
+               blocks_.size() * (sizeof(uint64_t) + sizeof(block_ptr_t) + 4 * sizeof(void*) +
+                                 sizeof(Block) + Slots * sizeof(data_t));
+    }
+
+private:
+    struct Block
+    {
+        using data_vector_t = std::vector<data_t, Eigen::aligned_allocator<data_t>>;
+
+        inline explicit Block(const index_t &i) :
+            index(i),
+            mask(0),
+            data(Slots)
+        {
+        }
+
+        inline bool used(const std::size_t s) const
+        {
+            return (mask >> s) & 1ull;
+        }
+
+        index_t       index;
+        uint64_t      mask;
+        data_vector_t data;
+    };
+
+    using block_ptr_t = std::unique_ptr<Block>;
+
+    std::map<uint64_t, block_ptr_t> blocks_;
+    std::size_t                     size_;
+
+    /// blocks are shifted into the positive range the codes are defined on
+    static constexpr int Bias = 1 << (64 / Dim - 2);
+
+    static inline uint64_t code(const index_t &bi)
+    {
+        index_t offset;
+        offset.fill(-Bias);
+        return morton::encode(bi, offset);
+    }
+
+    static inline index_t toBlock(const index_t &i)
+    {
+        index_t bi;
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            bi[d] = cslibs_math::common::div<int>(i[d], BlockSize);
+        return bi;
+    }
+
+    static inline std::size_t toSlot(const index_t &i)
+    {
+        index_t local, zero;
+        zero.fill(0);
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            local[d] = cslibs_math::common::mod<int>(i[d], BlockSize);
+        return static_cast<std::size_t>(morton::encode(local, zero));
+    }
+
+    /// inverse of toSlot
+    static inline index_t toIndex(const Block &b,
+                                  const std::size_t s)
+    {
+        index_t i;
+        for (std::size_t d = 0 ; d < Dim ; ++d) {
+            int local = 0;
+            for (std::size_t l = 0 ; l < BlockExponent ; ++l)
+                local |= static_cast<int>((s >> (l * Dim + d)) & 1ul) << l;
+            i[d] = b.index[d] * BlockSize + local;
+        }
+        return i;
+    }
+
+    template<typename block_t, typename Fn>
+    static inline void visit(block_t &b,
+                             const Fn &function)
+    {
+        for (std::size_t s = 0 ; s < Slots ; ++s)
+            if (b.used(s))
+                function(toIndex(b, s), b.data[s]);
+    }
+};
+
+template<typename data_t, typename index_t, std::size_t BlockExponent>
+constexpr std::size_t MortonStorage<data_t, index_t, BlockExponent>::Dim;
+template<typename data_t, typename index_t, std::size_t BlockExponent>
+constexpr int MortonStorage<data_t, index_t, BlockExponent>::BlockSize;
+template<typename data_t, typename index_t, std::size_t BlockExponent>
+constexpr std::size_t MortonStorage<data_t, index_t, BlockExponent>::Slots;
+template<typename data_t, typename index_t, std::size_t BlockExponent>
+constexpr int MortonStorage<data_t, index_t, BlockExponent>::Bias;
+
+template<typename storage_t>
+struct IsMortonStorage : std::false_type {};
+
+template<typename data_t, typename index_t, std::size_t BlockExponent>
+struct IsMortonStorage<MortonStorage<data_t, index_t, BlockExponent>> : std::true_type {};
+}
+
+#endif // CSLIBS_NDT_COMMON_MORTON_STORAGE_HPP
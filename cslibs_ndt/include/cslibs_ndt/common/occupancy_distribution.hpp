@@ -2,14 +2,17 @@
 #define CSLIBS_NDT_COMMON_OCCUPANCY_DISTRIBUTION_HPP
 
 #include <mutex>
+#include <cmath>
+#include <algorithm>
 
 #include <cslibs_math/statistics/distribution.hpp>
+#include <cslibs_ndt/common/compact_distribution.hpp>
 #include <cslibs_gridmaps/utility/inverse_model.hpp>
 
 #include <cslibs_indexed_storage/storage.hpp>
 
 namespace cslibs_ndt {
-template<std::size_t Dim>
+template<std::size_t Dim, typename T = double>
 class EIGEN_ALIGN16 OccupancyDistribution
 {
 public:
@@ -17,9 +20,10 @@ public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
     using allocator_t               = Eigen::aligned_allocator<OccupancyDistribution>;
-    using Ptr                       = std::shared_ptr<OccupancyDistribution<Dim>>;
-    using distribution_container_t  = OccupancyDistribution<Dim>;
-    using distribution_t            = cslibs_math::statistics::Distribution<Dim, 3>;
+    using Ptr                       = std::shared_ptr<OccupancyDistribution<Dim, T>>;
+    using distribution_container_t  = OccupancyDistribution<Dim, T>;
+    using distribution_t            = typename DistributionType<Dim, T>::type;
+    using scalar_t                  = T;
     using distribution_ptr_t        = typename distribution_t::Ptr;
     using point_t                   = typename distribution_t::sample_t;
 
@@ -27,49 +31,85 @@ public:
     using lock_t                    = std::unique_lock<mutex_t>;
 
     inline OccupancyDistribution() :
-        num_free_(0)
+        num_free_(0),
+        stamp_(0.0),
+        free_scale_(1.0),
+        occupied_scale_(1.0)
     {
     }
 
     inline OccupancyDistribution(const std::size_t num_free) :
-        num_free_(num_free)
+        num_free_(num_free),
+        stamp_(0.0),
+        free_scale_(1.0),
+        occupied_scale_(1.0)
     {
     }
 
     inline OccupancyDistribution(const std::size_t    num_free,
                                  const distribution_t data) :
         num_free_(num_free),
-        distribution_(new distribution_t(data))
+        distribution_(new distribution_t(data)),
+        stamp_(0.0),
+        free_scale_(1.0),
+        occupied_scale_(1.0)
+    {
+    }
+
+    /**
+     * @brief Cell with the decay state of another one, e.g. a saved one.
+     */
+    inline OccupancyDistribution(const std::size_t num_free,
+                                 const double      stamp,
+                                 const double      free_scale,
+                                 const double      occupied_scale) :
+        num_free_(num_free),
+        stamp_(stamp),
+        free_scale_(free_scale),
+        occupied_scale_(occupied_scale)
     {
     }
 
     inline OccupancyDistribution(const OccupancyDistribution &other) :
         num_free_(other.num_free_),
         distribution_(other.distribution_),
-        occupancy_(other.occupancy_),
-        inverse_model_(other.inverse_model_)
+        stamp_(other.stamp_),
+        free_scale_(other.free_scale_),
+        occupied_scale_(other.occupied_scale_)
     {
     }
 
     inline OccupancyDistribution& operator = (const OccupancyDistribution &other)
     {
-        num_free_      = other.num_free_;
-        distribution_  = other.distribution_;
-        occupancy_     = other.occupancy_;
-        inverse_model_ = other.inverse_model_;
+        num_free_       = other.num_free_;
+        distribution_   = other.distribution_;
+        stamp_          = other.stamp_;
+        free_scale_     = other.free_scale_;
+        occupied_scale_ = other.occupied_scale_;
         return *this;
     }
 
+    /**
+     * @brief Deep copy, copies share the moments otherwise.
+     */
+    inline OccupancyDistribution clone() const
+    {
+        OccupancyDistribution c(*this);
+        if (distribution_)
+            c.distribution_.reset(new distribution_t(*distribution_));
+        return c;
+    }
+
     inline void updateFree()
     {
+        free_scale_ = blend(free_scale_, num_free_, 1ul);
         ++ num_free_;
-        inverse_model_ = nullptr;
     }
 
     inline void updateFree(const std::size_t &num_free)
     {
+        free_scale_ = blend(free_scale_, num_free_, num_free);
         num_free_ += num_free;
-        inverse_model_ = nullptr;
     }
 
     inline void updateOccupied(const point_t & p)
@@ -77,8 +117,8 @@ public:
         if (!distribution_)
             distribution_.reset(new distribution_t());
 
+        occupied_scale_ = blend(occupied_scale_, distribution_->getN(), 1ul);
         distribution_->add(p);
-        inverse_model_ = nullptr;
     }
 
     inline void updateOccupied(const distribution_ptr_t &d)
@@ -89,8 +129,66 @@ public:
         if (!distribution_)
             distribution_.reset(new distribution_t());
 
+        occupied_scale_ = blend(occupied_scale_, distribution_->getN(), d->getN());
         *distribution_ += *d;
-        inverse_model_ = nullptr;
+    }
+
+    /**
+     * @brief Exponentially forget the observations made before a point in time.
+     *        The free count and the weight of the moments are multiplied with
+     *        exp(-(time - stamp) / time_constant), where stamp is the time of
+     *        the last decay. The counts stay integral, the fractional remainder
+     *        is kept as a scale, so that frequent small steps do not get lost.
+     *        Moments whose weight drops below half a sample are removed.
+     * @param time          current time, earlier times are ignored
+     * @param time_constant time after which the weights dropped to 1/e, values
+     *                      less or equal to zero only set the stamp
+     */
+    inline void decay(const double time,
+                      const double time_constant)
+    {
+        if (time <= stamp_)
+            return;
+
+        if (time_constant > 0.0) {
+            const double w = std::exp((stamp_ - time) / time_constant);
+            rescale(num_free_, free_scale_, w);
+
+            if (distribution_) {
+                const std::size_t n = distribution_->getN();
+                std::size_t n_decayed = n;
+                rescale(n_decayed, occupied_scale_, w);
+                if (n_decayed == 0)
+                    distribution_.reset();
+                else if (n_decayed != n)
+                    *distribution_ = reweighted(*distribution_, n_decayed);
+            }
+        }
+        stamp_ = time;
+    }
+
+    /**
+     * @brief Time of the last decay.
+     */
+    inline double getStamp() const
+    {
+        return stamp_;
+    }
+
+    /**
+     * @brief Weight of a free observation, relative to a fresh one.
+     */
+    inline double getFreeScale() const
+    {
+        return free_scale_;
+    }
+
+    /**
+     * @brief Weight of a sample of the moments, relative to a fresh one.
+     */
+    inline double getOccupiedScale() const
+    {
+        return occupied_scale_;
     }
 
     inline std::size_t numFree() const
@@ -108,19 +206,34 @@ public:
         if (!inverse_model)
             throw std::runtime_error("inverse model not set!");
 
-        if (inverse_model == inverse_model_)
-            return occupancy_;
+        return occupancy(inverse_model, 1.0);
+    }
+
+    /**
+     * @brief Occupancy as if the cell was decayed up to a point in time,
+     *        without modifying it.
+     */
+    inline double getOccupancy(const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+                               const double time,
+                               const double time_constant) const
+    {
+        if (time_constant <= 0.0 || time <= stamp_)
+            return getOccupancy(inverse_model);
+        if (!inverse_model)
+            throw std::runtime_error("inverse model not set!");
 
-        inverse_model_ = inverse_model;
-        occupancy_ = distribution_ ?
-                    cslibs_math::common::LogOdds::from(
-                        num_free_ * inverse_model_->getLogOddsFree() +
-                        distribution_->getN() * inverse_model_->getLogOddsOccupied() -
-                        (num_free_ + distribution_->getN()) * inverse_model_->getLogOddsPrior()) :
-                    cslibs_math::common::LogOdds::from(
-                        num_free_ * inverse_model_->getLogOddsFree() -
-                        num_free_ * inverse_model_->getLogOddsPrior());
-        return occupancy_;
+        return occupancy(inverse_model, std::exp((stamp_ - time) / time_constant));
+    }
+
+    /**
+     * @brief Evaluate the lazily computed members of the moments, so that
+     *        concurrent readers of the same cell only read them afterwards.
+     */
+    inline void prepare() const
+    {
+        lock_t l(data_mutex_);
+        if (distribution_)
+            distribution_->getCovariance();
     }
 
     inline const distribution_ptr_t &getDistribution() const
@@ -133,8 +246,33 @@ public:
         return distribution_;
     }
 
-    inline void merge(const OccupancyDistribution&)
+    /**
+     * @brief Add the observations of another cell. Both cells are decayed to
+     *        the later one of their stamps first, so that the observations of
+     *        the older one are not counted as fresh ones.
+     * @param other         cell to add
+     * @param time_constant time constant of the decay, values less or equal
+     *                      to zero only take over the later stamp
+     */
+    inline void merge(const OccupancyDistribution &other,
+                      const double time_constant = 0.0)
     {
+        const double time = std::max(stamp_, other.stamp_);
+        decay(time, time_constant);
+
+        OccupancyDistribution o = (time_constant > 0.0 && other.stamp_ < time) ? other.clone() : other;
+        o.decay(time, time_constant);
+
+        free_scale_ = blend(free_scale_, num_free_, o.num_free_, o.free_scale_);
+        num_free_ += o.num_free_;
+
+        if (o.distribution_) {
+            if (!distribution_)
+                distribution_.reset(new distribution_t());
+
+            occupied_scale_ = blend(occupied_scale_, distribution_->getN(), o.distribution_->getN(), o.occupied_scale_);
+            *distribution_ += *o.distribution_;
+        }
     }
 
     inline std::size_t byte_size() const
@@ -148,8 +286,39 @@ private:
     std::size_t        num_free_;
     distribution_ptr_t distribution_;
 
-    mutable double                                      occupancy_;
-    mutable cslibs_gridmaps::utility::InverseModel::Ptr inverse_model_;
+    /// decay, counts are weighted with their scale
+    double             stamp_;
+    double             free_scale_;
+    double             occupied_scale_;
+
+    inline double occupancy(const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+                            const double w) const
+    {
+        const double num_free     = w * num_free_ * free_scale_;
+        const double num_occupied = distribution_ ? w * distribution_->getN() * occupied_scale_ : 0.0;
+        return cslibs_math::common::LogOdds::from(
+                    num_free     * inverse_model->getLogOddsFree() +
+                    num_occupied * inverse_model->getLogOddsOccupied() -
+                    (num_free + num_occupied) * inverse_model->getLogOddsPrior());
+    }
+
+    /// scale of the weight n * scale + k * k_scale of n + k samples
+    static inline double blend(const double      scale,
+                               const std::size_t n,
+                               const std::size_t k,
+                               const double      k_scale = 1.0)
+    {
+        return (scale == k_scale || n + k == 0) ? scale : (n * scale + k * k_scale) / static_cast<double>(n + k);
+    }
+
+    static inline void rescale(std::size_t &n,
+                               double      &scale,
+                               const double w)
+    {
+        const double weight = n * scale * w;
+        n     = static_cast<std::size_t>(std::round(weight));
+        scale = n > 0 ? weight / n : 1.0;
+    }
 };
 }
 
@@ -0,0 +1,167 @@
+#ifndef CSLIBS_NDT_COMMON_PARALLEL_INSERT_HPP
+#define CSLIBS_NDT_COMMON_PARALLEL_INSERT_HPP
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <iterator>
+#include <functional>
+#include <unordered_map>
+#include <type_traits>
+#include <algorithm>
+
+#include <eigen3/Eigen/Eigen>
+
+namespace cslibs_ndt {
+namespace parallel {
+/**
+ * @brief Hash for grid indices.
+ */
+template<typename index_t>
+struct IndexHash
+{
+    inline std::size_t operator()(const index_t &i) const
+    {
+        std::size_t h = 0;
+        for (const int v : i)
+            h ^= std::hash<int>()(v) + 0x9e3779b9ul + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+template<typename index_t, typename moments_t>
+using MomentsMap = std::unordered_map<index_t, moments_t, IndexHash<index_t>, std::equal_to<index_t>,
+                                      Eigen::aligned_allocator<std::pair<const index_t, moments_t>>>;
+
+/**
+ * @brief Aggregate a range in parallel. The range is partitioned into
+ *        contiguous chunks, one per thread, each of which is accumulated
+ *        into a thread-local hash map.
+ * @param begin         begin of the range
+ * @param end           end of the range
+ * @param num_threads   number of threads
+ * @param accumulate    (const value &v, partial_t &partial), called concurrently
+ *                      for different partial maps
+ * @return the partial maps, one per thread
+ */
+template<typename partial_t, typename iterator_t, typename Accumulate>
+inline std::vector<partial_t> aggregate(const iterator_t  &begin,
+                                        const iterator_t  &end,
+                                        const std::size_t  num_threads,
+                                        const Accumulate  &accumulate)
+{
+    const std::size_t n = static_cast<std::size_t>(std::distance(begin, end));
+    if (n == 0)
+        return std::vector<partial_t>();
+
+    const std::size_t threads = std::max<std::size_t>(1, std::min(num_threads, n));
+    const std::size_t chunk   = (n + threads - 1) / threads;
+    std::vector<partial_t> partial(threads);
+
+    auto run = [&begin, &partial, &accumulate, chunk, n](const std::size_t t) {
+        iterator_t        itr = std::next(begin, static_cast<typename std::iterator_traits<iterator_t>::difference_type>(t * chunk));
+        const std::size_t m   = std::min(chunk, n - t * chunk);
+        partial_t &values     = partial[t];
+        for (std::size_t i = 0 ; i < m ; ++i, ++itr)
+            accumulate(*itr, values);
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1 ; t < threads ; ++t)
+        if (t * chunk < n)
+            workers.emplace_back(run, t);
+    run(0);
+    for (std::thread &w : workers)
+        w.join();
+    return partial;
+}
+
+/**
+ * @brief Merge values aggregated per bundle into the bundles of a map. The
+ *        bundles are allocated sequentially, afterwards one thread per
+ *        distribution storage applies the values, so that no storage is
+ *        written concurrently.
+ * @param partial       values per bundle index, possibly split across maps
+ * @param allocate      (const index_t &bi) -> bundle_t*, called sequentially
+ * @param update        (distribution_t &d, const value_t &v)
+ */
+template<typename bundle_t, typename index_t, typename partial_t,
+         typename Allocate, typename Update>
+inline void merge(const std::vector<partial_t> &partial,
+                  const Allocate               &allocate,
+                  const Update                 &update)
+{
+    using value_t = typename partial_t::mapped_type;
+    static constexpr std::size_t size = std::tuple_size<typename bundle_t::data_t>::value;
+
+    /// allocate the bundles sequentially, in index order for locality
+    std::vector<std::pair<index_t, const value_t*>> sorted;
+    for (const partial_t &values : partial)
+        for (const auto &v : values)
+            sorted.emplace_back(v.first, &v.second);
+    if (sorted.empty())
+        return;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<index_t, const value_t*> &a, const std::pair<index_t, const value_t*> &b) {
+        return a.first < b.first;
+    });
+
+    std::vector<std::pair<bundle_t*, const value_t*>> targets;
+    targets.reserve(sorted.size());
+    for (const auto &v : sorted)
+        if (bundle_t *bundle = allocate(v.first))
+            targets.emplace_back(bundle, v.second);
+
+    /// one thread per distribution storage
+    std::array<std::thread, size> workers;
+    for (std::size_t i = 0 ; i < size ; ++i)
+        workers[i] = std::thread([&targets, &update, i]() {
+            for (const auto &t : targets)
+                update(*(t.first->at(i)), *(t.second));
+        });
+    for (std::size_t i = 0 ; i < size ; ++i)
+        workers[i].join();
+}
+
+/**
+ * @brief Insert a batch of points into the bundles of a map. The points are
+ *        partitioned across threads, which aggregate their moments per bundle
+ *        in thread-local hash maps. After the bundles have been allocated,
+ *        the partial moments are merged with one thread per distribution
+ *        storage, so that no storage is written concurrently.
+ * @param points_begin  begin of the points
+ * @param points_end    end of the points
+ * @param num_threads   number of threads to aggregate the points with
+ * @param locate        (const point &p, point_t &p_m, index_t &bi) -> bool,
+ *                      transforms a point and computes its bundle index,
+ *                      false discards the point
+ * @param allocate      (const index_t &bi) -> bundle_t*, called sequentially
+ */
+template<typename bundle_t, typename point_t, typename index_t,
+         typename iterator_t, typename Locate, typename Allocate>
+inline void insert(const iterator_t  &points_begin,
+                   const iterator_t  &points_end,
+                   const std::size_t  num_threads,
+                   const Locate      &locate,
+                   const Allocate    &allocate)
+{
+    using distribution_t = typename std::remove_pointer<typename bundle_t::data_t::value_type>::type;
+    using moments_t      = typename distribution_t::distribution_t;
+    using partial_t      = MomentsMap<index_t, moments_t>;
+    using value_t        = typename std::iterator_traits<iterator_t>::value_type;
+
+    const std::vector<partial_t> partial = aggregate<partial_t>(points_begin, points_end, num_threads,
+                                                                [&locate](const value_t &p, partial_t &moments) {
+        point_t p_m;
+        index_t bi;
+        if (locate(p, p_m, bi))
+            moments[bi].add(p_m);
+    });
+    merge<bundle_t, index_t>(partial, allocate, [](distribution_t &d, const moments_t &m) {
+        d.data() += m;
+    });
+}
+}
+}
+
+#endif // CSLIBS_NDT_COMMON_PARALLEL_INSERT_HPP
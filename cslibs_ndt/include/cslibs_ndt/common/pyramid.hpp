@@ -0,0 +1,202 @@
+#ifndef CSLIBS_NDT_COMMON_PYRAMID_HPP
+#define CSLIBS_NDT_COMMON_PYRAMID_HPP
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/linear/pointcloud.hpp>
+
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Resolution pyramid of dynamic gridmaps. Points are only inserted
+ *        into level 0, level k has twice the resolution of level k - 1.
+ *
+ *        Distribution j of storage 0 at level k - 1 covers [j, j + 1) cells,
+ *        storage i at level k is shifted by half a coarse cell along the axes
+ *        set in i, which is exactly one fine cell. A fine storage 0 cell j is
+ *        hence a coarse bundle, and its moments belong to exactly the 2^Dim
+ *        distributions this bundle refers to. Insertion records the moments
+ *        added per fine cell, coarse levels merge them lazily, once queried.
+ *        The levels must only be modified through the pyramid.
+ */
+template <typename gridmap_t>
+class Pyramid
+{
+public:
+    using Ptr                   = std::shared_ptr<Pyramid>;
+    using ConstPtr              = std::shared_ptr<const Pyramid>;
+    using gridmap_ptr_t         = typename gridmap_t::Ptr;
+    using gridmap_const_ptr_t   = typename gridmap_t::ConstPtr;
+    using pose_t                = typename gridmap_t::pose_t;
+    using point_t               = typename gridmap_t::point_t;
+    using index_t               = typename gridmap_t::index_t;
+    using distribution_t        = typename gridmap_t::distribution_t;
+    using distribution_bundle_t = typename gridmap_t::distribution_bundle_t;
+    using moments_t             = typename distribution_t::distribution_t;
+    using pending_t             = parallel::MomentsMap<index_t, moments_t>;
+
+    static constexpr std::size_t Dim  = std::tuple_size<index_t>::value;
+    static constexpr std::size_t Size = 1ul << Dim;
+
+    /**
+     * @brief Constructor.
+     * @param origin        origin shared by all levels
+     * @param resolution    resolution of level 0
+     * @param levels        number of levels, at least one
+     */
+    inline Pyramid(const pose_t      &origin,
+                   const double       resolution,
+                   const std::size_t  levels) :
+        levels_(std::max<std::size_t>(1ul, levels)),
+        pending_(levels_.size())
+    {
+        double r = resolution;
+        for (gridmap_ptr_t &l : levels_) {
+            l.reset(new gridmap_t(origin, r));
+            r *= 2.0;
+        }
+    }
+
+    inline std::size_t getLevels() const
+    {
+        return levels_.size();
+    }
+
+    inline void insert(const point_t &p)
+    {
+        levels_[0]->insert(p);
+        if (levels_.size() > 1)
+            pending_[1][toCell(levels_[0]->getBundleIndex(p))].add(p);
+    }
+
+    inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
+                       const pose_t &points_origin = pose_t())
+    {
+        insert(points->begin(), points->end(), points_origin);
+    }
+
+    template<typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
+    {
+        levels_[0]->insert(points_begin, points_end, points_origin);
+        if (levels_.size() == 1)
+            return;
+
+        /// consecutive points mostly share a cell, skip the hash in that case
+        pending_t &pending = pending_[1];
+        moments_t *last    = nullptr;
+        index_t    last_j;
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
+            if (!pm.isNormal())
+                continue;
+            const index_t j = toCell(levels_[0]->getBundleIndex(pm));
+            if (!last || j != last_j) {
+                last   = &pending[j];
+                last_j = j;
+            }
+            last->add(pm);
+        }
+    }
+
+    /**
+     * @brief Get a level, which is brought up to date first. All queries,
+     *        sample, getDistributionBundle, traverse etc., go through the
+     *        returned map.
+     * @param level     the level, 0 being the finest
+     */
+    inline const gridmap_t& getLevel(const std::size_t level) const
+    {
+        update(level);
+        return *levels_.at(level);
+    }
+
+    inline gridmap_const_ptr_t getLevelPtr(const std::size_t level) const
+    {
+        update(level);
+        return levels_.at(level);
+    }
+
+    inline double sample(const point_t &p,
+                         const std::size_t level) const
+    {
+        return getLevel(level).sample(p);
+    }
+
+    inline double sampleNonNormalized(const point_t &p,
+                                      const std::size_t level) const
+    {
+        return getLevel(level).sampleNonNormalized(p);
+    }
+
+    inline const distribution_bundle_t* getDistributionBundle(const index_t &bi,
+                                                              const std::size_t level) const
+    {
+        return getLevel(level).getDistributionBundle(bi);
+    }
+
+    /**
+     * @brief Check whether a level has pending updates.
+     */
+    inline bool isDirty(const std::size_t level) const
+    {
+        for (std::size_t l = 1 ; l <= level && l < levels_.size() ; ++l)
+            if (!pending_[l].empty())
+                return true;
+        return false;
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        std::size_t size = sizeof(*this);
+        for (const gridmap_ptr_t &l : levels_)
+            size += l->getByteSize();
+        return size;
+    }
+
+private:
+    std::vector<gridmap_ptr_t> levels_;
+    /// pending_[k] holds the moments per storage 0 cell of level k - 1 not yet merged into level k
+    mutable std::vector<pending_t> pending_;
+
+    /// storage 0 index of a bundle
+    static inline index_t toCell(const index_t &bi)
+    {
+        index_t j;
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            j[d] = cslibs_math::common::div<int>(bi[d], 2);
+        return j;
+    }
+
+    inline void update(const std::size_t level) const
+    {
+        for (std::size_t l = 1 ; l <= level && l < levels_.size() ; ++l)
+            merge(l);
+    }
+
+    inline void merge(const std::size_t l) const
+    {
+        pending_t &pending = pending_[l];
+        if (pending.empty())
+            return;
+
+        gridmap_t &coarse = *levels_[l];
+        for (const auto &p : pending) {
+            distribution_bundle_t *bundle = coarse.getDistributionBundle(p.first);
+            for (std::size_t i = 0 ; i < Size ; ++i)
+                bundle->at(i)->data() += p.second;
+            if (l + 1 < levels_.size())
+                pending_[l + 1][toCell(p.first)] += p.second;
+        }
+        pending.clear();
+    }
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_PYRAMID_HPP
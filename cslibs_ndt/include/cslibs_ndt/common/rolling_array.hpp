@@ -0,0 +1,140 @@
+#ifndef CSLIBS_NDT_COMMON_ROLLING_ARRAY_HPP
+#define CSLIBS_NDT_COMMON_ROLLING_ARRAY_HPP
+
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math/common/mod.hpp>
+
+namespace cslibs_ndt {
+/**
+ * @brief Dense array of fixed size which is addressed with unbounded
+ *        indices wrapping around in every dimension. A window of the size
+ *        of the array can thus be moved over the index space without
+ *        moving or reallocating any element, only the elements entering
+ *        the window have to be reset.
+ */
+template<typename T, std::size_t Dim>
+class RollingArray
+{
+public:
+    using index_t = std::array<int, Dim>;
+    using size_t  = std::array<std::size_t, Dim>;
+    using data_t  = std::vector<T, Eigen::aligned_allocator<T>>;
+
+    inline explicit RollingArray(const size_t &size) :
+        size_(size)
+    {
+        std::size_t n = 1;
+        for (std::size_t d = 0 ; d < Dim ; ++d) {
+            stride_[d] = n;
+            n *= size_[d];
+        }
+        data_.resize(n);
+    }
+
+    inline T& at(const index_t &i)
+    {
+        return data_[slot(i)];
+    }
+
+    inline const T& at(const index_t &i) const
+    {
+        return data_[slot(i)];
+    }
+
+    inline const size_t& size() const
+    {
+        return size_;
+    }
+
+    inline std::size_t byte_size() const
+    {
+        return sizeof(*this) + data_.capacity() * sizeof(T);
+    }
+
+    /**
+     * @brief Visit all indices of an axis-aligned box.
+     * @param lo        minimum index of the box, inclusive
+     * @param hi        maximum index of the box, inclusive
+     * @param function  called with every index
+     */
+    template <typename Fn>
+    static inline void forEach(const index_t &lo,
+                               const index_t &hi,
+                               const Fn      &function)
+    {
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            if (lo[d] > hi[d])
+                return;
+
+        index_t i = lo;
+        for (;;) {
+            function(i);
+            std::size_t d = 0;
+            for (; d < Dim ; ++d) {
+                if (++i[d] <= hi[d])
+                    break;
+                i[d] = lo[d];
+            }
+            if (d == Dim)
+                return;
+        }
+    }
+
+    /**
+     * @brief Visit all indices of a box which are not part of a previous
+     *        box, exactly once, the cost is linear in the number of visited
+     *        indices.
+     * @param prev_lo   minimum index of the previous box, inclusive
+     * @param prev_hi   maximum index of the previous box, inclusive
+     * @param lo        minimum index of the box, inclusive
+     * @param hi        maximum index of the box, inclusive
+     * @param function  called with every entering index
+     */
+    template <typename Fn>
+    static inline void forEachEntering(const index_t &prev_lo,
+                                       const index_t &prev_hi,
+                                       const index_t &lo,
+                                       const index_t &hi,
+                                       const Fn      &function)
+    {
+        /// slabs along each axis, preceding axes are restricted to the overlap
+        index_t overlap_lo = lo;
+        index_t overlap_hi = hi;
+        for (std::size_t d = 0 ; d < Dim ; ++d) {
+            index_t slab_lo = overlap_lo;
+            index_t slab_hi = overlap_hi;
+            slab_hi[d] = std::min(hi[d], prev_lo[d] - 1);
+            forEach(slab_lo, slab_hi, function);
+
+            slab_hi    = overlap_hi;
+            slab_lo[d] = std::max(lo[d], prev_hi[d] + 1);
+            forEach(slab_lo, slab_hi, function);
+
+            overlap_lo[d] = std::max(lo[d], prev_lo[d]);
+            overlap_hi[d] = std::min(hi[d], prev_hi[d]);
+            if (overlap_lo[d] > overlap_hi[d])
+                return;
+        }
+    }
+
+private:
+    size_t  size_;
+    size_t  stride_;
+    data_t  data_;
+
+    inline std::size_t slot(const index_t &i) const
+    {
+        std::size_t s = 0;
+        for (std::size_t d = 0 ; d < Dim ; ++d)
+            s += static_cast<std::size_t>(cslibs_math::common::mod<int>(i[d], static_cast<int>(size_[d]))) * stride_[d];
+        return s;
+    }
+};
+}
+
+#endif // CSLIBS_NDT_COMMON_ROLLING_ARRAY_HPP
@@ -0,0 +1,50 @@
+#ifndef CSLIBS_NDT_CONVERSION_CONVERSION_TRAITS_HPP
+#define CSLIBS_NDT_CONVERSION_CONVERSION_TRAITS_HPP
+
+#include <type_traits>
+
+namespace cslibs_ndt {
+namespace conversion {
+
+template<typename MapT, typename Enable = void>
+struct ConversionTraits;
+/*
+Required Interface:
+- "void"-usings have to be adjusted
+- OCCUPANCY and BOUNDED have to be adjusted
+
+{
+    static constexpr bool OCCUPANCY = false;    /// sampled with an inverse model
+    static constexpr bool BOUNDED   = false;    /// array backed, converted over its whole size
+
+    using index_t  = void;                      /// index of a bundle
+    using bundle_t = void;                      /// const distributions of a bundle
+
+    /// look up the distributions of a bundle, which does not need to exist,
+    /// without modifying the map, false if none of them is allocated
+    static bool lookup(const MapT &map,
+                       const index_t &bi,
+                       bundle_t &bundle);
+};
+
+The packages add what their conversions need beyond that, e.g. a traversal.
+*/
+
+/**
+ * @brief Result type R of a conversion of maps with conversion traits of the
+ *        given kind, const maps included. Other types do not take part in
+ *        overload resolution.
+ */
+template<typename MapT, bool Occupancy, typename R = void>
+using enable_conversion_t =
+    typename std::enable_if<ConversionTraits<typename std::remove_const<MapT>::type>::OCCUPANCY == Occupancy, R>::type;
+
+/**
+ * @brief Conversion traits of a map, const maps included.
+ */
+template<typename MapT>
+using conversion_traits_t = ConversionTraits<typename std::remove_const<MapT>::type>;
+}
+}
+
+#endif // CSLIBS_NDT_CONVERSION_CONVERSION_TRAITS_HPP
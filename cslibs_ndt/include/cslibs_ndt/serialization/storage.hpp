@@ -18,45 +18,115 @@
 namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt {
-template <template <std::size_t> class T, std::size_t Size>
-void write(const T<Size> &d, std::ofstream &out)
+/**
+ * @brief Version of the binary format of occupancy cells. Version 1 holds the
+ *        free count and the moments, version 2 adds the stamp and the scales
+ *        of the decay. Maps store it with their meta data.
+ */
+static constexpr std::size_t occupancy_format_version = 2;
+
+template <std::size_t Size>
+void write(const cslibs_math::statistics::Distribution<Size, 3> &d, std::ofstream &out)
 {
-    cslibs_math::serialization::distribution::binary<Size, 3>::write(d.data(), out);
+    cslibs_math::serialization::distribution::binary<Size, 3>::write(d, out);
 }
 
-template <template <std::size_t> class T, std::size_t Size>
-std::size_t read(std::ifstream &in, T<Size> &d)
+template <std::size_t Size>
+std::size_t read(std::ifstream &in, cslibs_math::statistics::Distribution<Size, 3> &d)
 {
-    return cslibs_math::serialization::distribution::binary<Size, 3>::read(in, d.data());
+    return cslibs_math::serialization::distribution::binary<Size, 3>::read(in, d);
 }
 
-template<std::size_t Size>
-void write(const OccupancyDistribution<Size> &d, std::ofstream &out)
+template <typename S, std::size_t Size, std::size_t L, typename A>
+void write(const CompactDistribution<S, Size, L, A> &d, std::ofstream &out)
+{
+    cslibs_math::serialization::io<std::size_t>::write(d.getN(), out);
+    for (std::size_t i = 0 ; i < Size ; ++i)
+        cslibs_math::serialization::io<S>::write(d.getStoredMean()(i), out);
+    for (std::size_t i = 0 ; i < Size ; ++i)
+        for (std::size_t j = i ; j < Size ; ++j)
+            cslibs_math::serialization::io<S>::write(d.getStoredScatter()(i, j), out);
+}
+
+template <typename S, std::size_t Size, std::size_t L, typename A>
+std::size_t read(std::ifstream &in, CompactDistribution<S, Size, L, A> &d)
+{
+    using distribution_t = CompactDistribution<S, Size, L, A>;
+    const std::size_t n = cslibs_math::serialization::io<std::size_t>::read(in);
+    typename distribution_t::mean_t    mean;
+    typename distribution_t::scatter_t scatter;
+    for (std::size_t i = 0 ; i < Size ; ++i)
+        mean(i) = cslibs_math::serialization::io<S>::read(in);
+    for (std::size_t i = 0 ; i < Size ; ++i)
+        for (std::size_t j = i ; j < Size ; ++j)
+            scatter(i, j) = scatter(j, i) = cslibs_math::serialization::io<S>::read(in);
+    d = distribution_t(n, mean, scatter);
+    return sizeof(std::size_t) + (Size + Size * (Size + 1) / 2) * sizeof(S);
+}
+
+template <std::size_t Size, typename S>
+void write(const Distribution<Size, S> &d, std::ofstream &out)
+{
+    cslibs_ndt::write(d.data(), out);
+}
+
+template <std::size_t Size, typename S>
+std::size_t read(std::ifstream &in, Distribution<Size, S> &d)
+{
+    return cslibs_ndt::read(in, d.data());
+}
+
+/**
+ * @brief Cells whose format is not versioned are read as they are.
+ */
+template <typename data_t>
+std::size_t read(std::ifstream &in, data_t &d, const std::size_t)
+{
+    return cslibs_ndt::read(in, d);
+}
+
+template <std::size_t Size, typename S>
+void write(const OccupancyDistribution<Size, S> &d, std::ofstream &out)
 {
     cslibs_math::serialization::io<std::size_t>::write(d.numFree(), out);
+    cslibs_math::serialization::io<double>::write(d.getStamp(), out);
+    cslibs_math::serialization::io<double>::write(d.getFreeScale(), out);
+    cslibs_math::serialization::io<double>::write(d.getOccupiedScale(), out);
     if (!d.getDistribution())
-        cslibs_math::serialization::distribution::binary<Size, 3>::write(out);
+        cslibs_ndt::write(typename OccupancyDistribution<Size, S>::distribution_t(), out);
     else
-        cslibs_math::serialization::distribution::binary<Size, 3>::write(*(d.getDistribution()), out);
+        cslibs_ndt::write(*(d.getDistribution()), out);
 }
 
-template<std::size_t Size>
-std::size_t read(std::ifstream &in, OccupancyDistribution<Size> &d)
+/**
+ * @param version   format of the cell, see occupancy_format_version
+ */
+template <std::size_t Size, typename S>
+std::size_t read(std::ifstream &in, OccupancyDistribution<Size, S> &d,
+                 const std::size_t version = occupancy_format_version)
 {
     std::size_t f = cslibs_math::serialization::io<std::size_t>::read(in);
-    d = OccupancyDistribution<Size>(f);
-    typename OccupancyDistribution<Size>::distribution_t tmp;
-    std::size_t r = cslibs_math::serialization::distribution::binary<Size, 3>::read(in,tmp);
+    std::size_t r = sizeof(std::size_t);
+    double stamp = 0.0, free_scale = 1.0, occupied_scale = 1.0;
+    if (version >= 2) {
+        stamp          = cslibs_math::serialization::io<double>::read(in);
+        free_scale     = cslibs_math::serialization::io<double>::read(in);
+        occupied_scale = cslibs_math::serialization::io<double>::read(in);
+        r += 3 * sizeof(double);
+    }
+    d = OccupancyDistribution<Size, S>(f, stamp, free_scale, occupied_scale);
+    typename OccupancyDistribution<Size, S>::distribution_t tmp;
+    r += cslibs_ndt::read(in, tmp);
     if (tmp.getN() != 0)
-        d.getDistribution().reset(new typename OccupancyDistribution<Size>::distribution_t(tmp));
-    return sizeof(std::size_t) + r;
+        d.getDistribution().reset(new typename OccupancyDistribution<Size, S>::distribution_t(tmp));
+    return r;
 }
 
-template <template <std::size_t> class T, std::size_t Size, std::size_t Dim>
+template <template <std::size_t, typename> class T, std::size_t Size, std::size_t Dim, typename S = double>
 struct binary {
     using index_t      = std::array<int, Dim>;
     using size_t       = std::array<std::size_t, Dim>;
-    using data_t       = T<Size>;
+    using data_t       = T<Size, S>;
     template <template <typename, typename, typename...> class be>
     using storage_t    = cis::Storage<data_t, index_t, be>;
     using kd_storage_t = storage_t<cis::backend::kdtree::KDTree>;
@@ -81,28 +151,34 @@ struct binary {
         return true;
     }
 
+    /**
+     * @param version   format of the cells, as saved with the map
+     */
     inline static bool load(const boost::filesystem::path &path,
-                            std::shared_ptr<kd_storage_t> &storage)
+                            std::shared_ptr<kd_storage_t> &storage,
+                            const std::size_t version = occupancy_format_version)
     {
         storage.reset(new kd_storage_t);
-        return loadStorage(path, storage);
+        return loadStorage(path, storage, version);
     }
 
     inline static bool load(const boost::filesystem::path &path,
                             std::shared_ptr<ar_storage_t> &storage,
                             const size_t &size,
-                            const index_t &offset)
+                            const index_t &offset,
+                            const std::size_t version = occupancy_format_version)
     {
         storage.reset(new ar_storage_t);
         storage->template set<cis::option::tags::array_size>(size);
         storage->template set<cis::option::tags::array_offset>(offset);
-        return loadStorage(path, storage);
+        return loadStorage(path, storage, version);
     }
 
 private:
     template <template <typename, typename, typename...> class be>
     inline static bool loadStorage(const boost::filesystem::path  &path,
-                                   std::shared_ptr<storage_t<be>> &storage)
+                                   std::shared_ptr<storage_t<be>> &storage,
+                                   const std::size_t               version)
     {
         std::ifstream in(path.string(), std::ios::binary);
         if (!in.is_open()) {
@@ -119,7 +195,7 @@ private:
                 index_t index;
                 data_t  data;
                 read += cslibs_math::serialization::array::binary<int, Dim>::read(in, index);
-                read += cslibs_ndt::read(in, data);
+                read += cslibs_ndt::read(in, data, version);
                 storage->insert(index, data);
             }
         } catch (const std::exception &e) {
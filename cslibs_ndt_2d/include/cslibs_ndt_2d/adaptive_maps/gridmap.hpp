@@ -0,0 +1,177 @@
+#ifndef CSLIBS_NDT_2D_ADAPTIVE_MAPS_GRIDMAP_HPP
+#define CSLIBS_NDT_2D_ADAPTIVE_MAPS_GRIDMAP_HPP
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <memory>
+
+#include <cslibs_math_2d/linear/pose.hpp>
+#include <cslibs_math_2d/linear/point.hpp>
+
+#include <cslibs_ndt/common/adaptive_tree.hpp>
+
+#include <cslibs_math/linear/pointcloud.hpp>
+
+namespace cslibs_ndt_2d {
+namespace adaptive_maps {
+/**
+ * @brief Quadtree NDT map, cells are refined where the points are not
+ *        described by a flat distribution, see cslibs_ndt::AdaptiveTree.
+ *        Every point falls into exactly one leaf, distributions do not
+ *        overlap as in the bundles of the grid maps.
+ */
+template <typename T = double>
+class EIGEN_ALIGN16 GridmapT
+{
+public:
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using allocator_t = Eigen::aligned_allocator<GridmapT>;
+
+    using Ptr            = std::shared_ptr<GridmapT>;
+    using ConstPtr       = std::shared_ptr<const GridmapT>;
+    using pose_t         = cslibs_math_2d::Pose2d;
+    using transform_t    = cslibs_math_2d::Transform2d;
+    using point_t        = cslibs_math_2d::Point2d;
+    using tree_t         = cslibs_ndt::AdaptiveTree<2, T>;
+    using index_t        = typename tree_t::index_t;
+    using distribution_t = typename tree_t::distribution_t;
+
+    /**
+     * @brief Constructor.
+     * @param origin        origin of the map
+     * @param resolution    size of the finest cells
+     * @param max_depth     number of subdivisions, the root cells have a size
+     *                      of resolution * 2^max_depth
+     * @param flatness      see cslibs_ndt::AdaptiveTree
+     */
+    inline GridmapT(const pose_t      &origin,
+                    const double       resolution,
+                    const std::size_t  max_depth,
+                    const double       flatness = 0.05) :
+        resolution_(resolution),
+        resolution_inv_(1.0 / resolution_),
+        w_T_m_(origin),
+        m_T_w_(w_T_m_.inverse()),
+        tree_(max_depth, flatness)
+    {
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline double getRootResolution() const
+    {
+        return resolution_ * static_cast<double>(1 << tree_.getMaxDepth());
+    }
+
+    inline std::size_t getMaxDepth() const
+    {
+        return tree_.getMaxDepth();
+    }
+
+    inline pose_t getOrigin() const
+    {
+        return w_T_m_;
+    }
+
+    inline bool empty() const
+    {
+        return tree_.empty();
+    }
+
+    inline void insert(const point_t &p)
+    {
+        const point_t *begin = &p;
+        insert(begin, begin + 1);
+    }
+
+    inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
+                       const pose_t &points_origin = pose_t())
+    {
+        insert(points->begin(), points->end(), points_origin);
+    }
+
+    /**
+     * @brief Insert points as one batch, the tree is refined along with it.
+     */
+    template<typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
+    {
+        typename tree_t::samples_t samples;
+        std::vector<index_t>       cells;
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
+            if (!pm.isNormal())
+                continue;
+            samples.emplace_back(pm.data());
+            cells.emplace_back(toIndex(pm));
+        }
+        tree_.insert(samples, cells);
+    }
+
+    inline double sample(const point_t &p) const
+    {
+        const distribution_t *d = tree_.getDistribution(toIndex(p));
+        return d ? d->data().sample(p) : 0.0;
+    }
+
+    inline double sampleNonNormalized(const point_t &p) const
+    {
+        const distribution_t *d = tree_.getDistribution(toIndex(p));
+        return d ? d->data().sampleNonNormalized(p) : 0.0;
+    }
+
+    /**
+     * @brief Leaf containing a point, nullptr for unknown space.
+     */
+    inline const distribution_t* getDistribution(const point_t &p) const
+    {
+        return tree_.getDistribution(toIndex(p));
+    }
+
+    /**
+     * @brief Visit all leaves.
+     * @param function  (const index_t &root, const std::size_t depth, const distribution_t &d)
+     */
+    template <typename Fn>
+    inline void traverse(const Fn& function) const
+    {
+        tree_.traverse(function);
+    }
+
+    inline const tree_t& getTree() const
+    {
+        return tree_;
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) - sizeof(tree_t) + tree_.getByteSize();
+    }
+
+private:
+    const double resolution_;
+    const double resolution_inv_;
+    const transform_t w_T_m_;
+    const transform_t m_T_w_;
+    tree_t tree_;
+
+    inline index_t toIndex(const point_t &p_w) const
+    {
+        const point_t p_m = m_T_w_ * p_w;
+        return {{static_cast<int>(std::floor(p_m(0) * resolution_inv_)),
+                 static_cast<int>(std::floor(p_m(1) * resolution_inv_))}};
+    }
+};
+
+using Gridmap = GridmapT<double>;
+}
+}
+
+#endif // CSLIBS_NDT_2D_ADAPTIVE_MAPS_GRIDMAP_HPP
@@ -0,0 +1,167 @@
+#ifndef CSLIBS_NDT_2D_COMMON_LASER_SCAN_HPP
+#define CSLIBS_NDT_2D_COMMON_LASER_SCAN_HPP
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <cslibs_math_2d/linear/point.hpp>
+
+namespace cslibs_ndt_2d {
+/**
+ * @brief Planar range scan in polar form. The beam directions are computed
+ *        once on construction or reconfiguration, so a scan kept per sensor
+ *        only has its ranges refilled for every measurement.
+ */
+class EIGEN_ALIGN16 LaserScan
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr          = std::shared_ptr<LaserScan>;
+    using ConstPtr     = std::shared_ptr<const LaserScan>;
+    using point_t      = cslibs_math_2d::Point2d;
+    using directions_t = std::vector<point_t, Eigen::aligned_allocator<point_t>>;
+    using ranges_t     = std::vector<float>;
+
+    inline LaserScan() :
+        angle_min_(0.0),
+        angle_increment_(0.0),
+        range_min_(0.0),
+        range_max_(std::numeric_limits<double>::max())
+    {
+    }
+
+    /**
+     * @brief Constructor.
+     * @param angle_min         angle of the first beam
+     * @param angle_increment   angle between two consecutive beams
+     * @param size              number of beams
+     * @param range_min         readings below are discarded
+     * @param range_max         readings at or beyond only clear free space
+     */
+    inline LaserScan(const double       angle_min,
+                     const double       angle_increment,
+                     const std::size_t  size,
+                     const double       range_min,
+                     const double       range_max) :
+        angle_min_(angle_min),
+        angle_increment_(angle_increment),
+        range_min_(range_min),
+        range_max_(range_max)
+    {
+        configure(angle_min, angle_increment, size);
+    }
+
+    /**
+     * @brief Set the beam geometry, the direction table is only recomputed
+     *        if it changed.
+     * @param angle_min         angle of the first beam
+     * @param angle_increment   angle between two consecutive beams
+     * @param size              number of beams
+     */
+    inline void configure(const double      angle_min,
+                          const double      angle_increment,
+                          const std::size_t size)
+    {
+        if (angle_min == angle_min_ && angle_increment == angle_increment_ &&
+                size == directions_.size())
+            return;
+
+        angle_min_       = angle_min;
+        angle_increment_ = angle_increment;
+        directions_.resize(size);
+        for (std::size_t i = 0 ; i < size ; ++i) {
+            const double angle = angle_min_ + static_cast<double>(i) * angle_increment_;
+            directions_[i] = point_t(std::cos(angle), std::sin(angle));
+        }
+        ranges_.resize(size, std::numeric_limits<float>::quiet_NaN());
+    }
+
+    inline void setRangeLimits(const double range_min,
+                               const double range_max)
+    {
+        range_min_ = range_min;
+        range_max_ = range_max;
+    }
+
+    inline std::size_t size() const
+    {
+        return directions_.size();
+    }
+
+    inline double getAngleMin() const
+    {
+        return angle_min_;
+    }
+
+    inline double getAngleIncrement() const
+    {
+        return angle_increment_;
+    }
+
+    inline double getRangeMin() const
+    {
+        return range_min_;
+    }
+
+    inline double getRangeMax() const
+    {
+        return range_max_;
+    }
+
+    /**
+     * @brief Unit direction of a beam in the sensor frame.
+     */
+    inline const point_t& getDirection(const std::size_t i) const
+    {
+        return directions_[i];
+    }
+
+    inline const directions_t& getDirections() const
+    {
+        return directions_;
+    }
+
+    /**
+     * @brief Ranges, one per beam, to be refilled for every measurement.
+     */
+    inline ranges_t& getRanges()
+    {
+        return ranges_;
+    }
+
+    inline const ranges_t& getRanges() const
+    {
+        return ranges_;
+    }
+
+    /**
+     * @brief Reading within the range limits, which ends at an obstacle.
+     */
+    inline bool isValid(const float range) const
+    {
+        return std::isfinite(range) && range >= range_min_ && range < range_max_;
+    }
+
+    /**
+     * @brief Reading without a return, positive infinity or at least the
+     *        maximum range.
+     */
+    inline bool isMaxRange(const float range) const
+    {
+        return range >= range_max_;
+    }
+
+private:
+    double       angle_min_;
+    double       angle_increment_;
+    double       range_min_;
+    double       range_max_;
+    directions_t directions_;
+    ranges_t     ranges_;
+};
+}
+
+#endif // CSLIBS_NDT_2D_COMMON_LASER_SCAN_HPP
@@ -3,112 +3,122 @@
 
 #include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
 #include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/mono_gridmap.hpp>
 
 #include <cslibs_ndt_2d/conversion/gridmap.hpp>
 #include <cslibs_ndt_2d/conversion/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/raster.hpp>
 
 #include <cslibs_gridmaps/static_maps/binary_gridmap.h>
 #include <cslibs_gridmaps/static_maps/algorithms/distance_transform.hpp>
 
 namespace cslibs_ndt_2d {
 namespace conversion {
+namespace impl {
+template<typename map_t, typename Kernels>
+inline void toBinary(const map_t                                      &src,
+                     cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+                     const double                                      sampling_resolution,
+                     const double                                      threshold,
+                     const Kernels                                    &kernels)
+{
+    using dst_map_t = cslibs_gridmaps::static_maps::BinaryGridmap;
+    auto create = [&sampling_resolution](const cslibs_math_2d::Pose2d &origin, const std::size_t height, const std::size_t width) {
+        return dst_map_t::Ptr(new dst_map_t(origin, sampling_resolution, height, width));
+    };
+
+    const Window bundles = raster(src, dst, sampling_resolution, kernels, create, static_cast<int>(dst_map_t::FREE));
+    draw(src, bundles.min, bounds(*dst), sampling_resolution, kernels, [&dst, &threshold](const int x, const int y, const double v) {
+        dst->at(x, y) = v >= threshold ? dst_map_t::OCCUPIED : dst_map_t::FREE;
+    });
+}
+
+template<typename map_t, typename Kernels>
+inline void updateBinary(const map_t                                      &src,
+                         cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+                         const typename map_t::dirty_blocks_t             &dirty,
+                         const double                                      sampling_resolution,
+                         const double                                      threshold,
+                         const Kernels                                    &kernels)
+{
+    using dst_map_t = cslibs_gridmaps::static_maps::BinaryGridmap;
+    auto create = [&sampling_resolution](const cslibs_math_2d::Pose2d &origin, const std::size_t height, const std::size_t width) {
+        return dst_map_t::Ptr(new dst_map_t(origin, sampling_resolution, height, width));
+    };
+
+    Window bundles;
+    for (const Window &w : prepare(src, dst, dirty, sampling_resolution, kernels, create, static_cast<int>(dst_map_t::FREE), bundles)) {
+        fill(*dst, w, static_cast<int>(dst_map_t::FREE));
+        draw(src, bundles.min, w, sampling_resolution, kernels, [&dst, &threshold](const int x, const int y, const double v) {
+            dst->at(x, y) = v >= threshold ? dst_map_t::OCCUPIED : dst_map_t::FREE;
+        });
+    }
+}
+}
+
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+        const double &sampling_resolution,
+        const double &threshold = 0.169)
+{
+    if (!src)
+        return;
+    impl::toBinary(*src, dst, sampling_resolution, threshold, impl::Gaussians());
+}
+
+/**
+ * @brief Update a raster of the map in place, only the pixels of the dirty
+ *        blocks are sampled again. The raster grows with the map.
+ */
 inline void from(
         const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &src,
         cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+        const cslibs_ndt_2d::dynamic_maps::Gridmap::dirty_blocks_t &dirty,
         const double &sampling_resolution,
         const double &threshold = 0.169)
 {
     if (!src)
         return;
-    src->allocatePartiallyAllocatedBundles();
-
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
-    using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
-    dst.reset(new dst_map_t(src->getOrigin(),
-                            sampling_resolution,
-                            std::ceil(src->getHeight() / sampling_resolution),
-                            std::ceil(src->getWidth()  / sampling_resolution)));
-    std::fill(dst->getData().begin(), dst->getData().end(), 0);
-
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
-
-    auto sample = [](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        return 0.25 * (bundle.at(0)->data().sampleNonNormalized(p) +
-                       bundle.at(1)->data().sampleNonNormalized(p) +
-                       bundle.at(2)->data().sampleNonNormalized(p) +
-                       bundle.at(3)->data().sampleNonNormalized(p));
-    };
-
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
+    impl::updateBinary(*src, dst, dirty, sampling_resolution, threshold, impl::Gaussians());
+}
 
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) =
-                        sample(p, b) >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
-                                                    cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
-            }
-        }
-    });
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+        const double &sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double &threshold = 0.169)
+{
+    if (!src || !inverse_model)
+        return;
+    impl::toBinary(*src, dst, sampling_resolution, threshold, impl::Occupancies{inverse_model, src->getTime(), src->getDecay()});
 }
 
+/**
+ * @brief Update a raster of the map in place, only the pixels of the dirty
+ *        blocks are sampled again. The raster grows with the map.
+ *        With decay, the raster is drawn again as a whole whenever the
+ *        time of the map changed since the stamp.
+ */
 inline void from(
         const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr &src,
         cslibs_gridmaps::static_maps::BinaryGridmap::Ptr &dst,
+        const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::dirty_blocks_t &dirty,
+        RasterStamp &stamp,
         const double &sampling_resolution,
         const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
         const double &threshold = 0.169)
 {
     if (!src || !inverse_model)
         return;
-    src->allocatePartiallyAllocatedBundles();
-
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
-    using dst_map_t = cslibs_gridmaps::static_maps::ProbabilityGridmap;
-    dst.reset(new dst_map_t(src->getOrigin(),
-                            sampling_resolution,
-                            std::ceil(src->getHeight() / sampling_resolution),
-                            std::ceil(src->getWidth()  / sampling_resolution)));
-    std::fill(dst->getData().begin(), dst->getData().end(), 0);
-
-    const double bundle_resolution = src->getBundleResolution();
-    const int chunk_step = static_cast<int>(bundle_resolution / sampling_resolution);
-
-    auto sample = [&inverse_model](const cslibs_math_2d::Point2d &p, const src_map_t::distribution_bundle_t &bundle) {
-        auto sample = [&p, &inverse_model](const src_map_t::distribution_t *d) {
-            auto do_sample = [&p, &inverse_model, &d]() {
-                const auto &handle = d;
-                return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(inverse_model) : 0.0;
-            };
-            return d ? do_sample() : 0.0;
-        };
-        return 0.25 * (sample(bundle.at(0)) +
-                       sample(bundle.at(1)) +
-                       sample(bundle.at(2)) +
-                       sample(bundle.at(3)));
-    };
-
-    using index_t = std::array<int, 2>;
-    const index_t min_bi = src->getMinBundleIndex();
-
-    src->traverse([&dst, &bundle_resolution, &sampling_resolution, &chunk_step, &min_bi, &sample]
-                  (const index_t &bi, const src_map_t::distribution_bundle_t &b){
-        for (int k = 0 ; k < chunk_step ; ++ k) {
-            for (int l = 0 ; l < chunk_step ; ++ l) {
-                const cslibs_math_2d::Point2d p(bi[0] * bundle_resolution + k * sampling_resolution,
-                                                bi[1] * bundle_resolution + l * sampling_resolution);
-                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) =
-                        sample(p, b) >= threshold ? cslibs_gridmaps::static_maps::BinaryGridmap::OCCUPIED :
-                                                    cslibs_gridmaps::static_maps::BinaryGridmap::FREE;
-            }
-        }
-    });
+    if (stamp.expire(src->getTime(), src->getDecay()))
+        dst.reset();
+    impl::updateBinary(*src, dst, dirty, sampling_resolution, threshold, impl::Occupancies{inverse_model, src->getTime(), src->getDecay()});
 }
 }
 }
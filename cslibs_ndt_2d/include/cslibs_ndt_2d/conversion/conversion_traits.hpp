@@ -0,0 +1,113 @@
+#ifndef CSLIBS_NDT_2D_CONVERSION_CONVERSION_TRAITS_HPP
+#define CSLIBS_NDT_2D_CONVERSION_CONVERSION_TRAITS_HPP
+
+#include <cslibs_ndt/conversion/conversion_traits.hpp>
+
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/mono_gridmap.hpp>
+
+namespace cslibs_ndt_2d {
+namespace conversion {
+/**
+ * @brief Conversion traits of the maps of bundles of four distributions,
+ *        which are all read through the same members. Their distributions
+ *        live in world coordinates, bundle indices in map coordinates.
+ */
+template<typename MapT, bool Occupancy, bool Bounded>
+struct BundleConversionTraits
+{
+    static constexpr bool OCCUPANCY = Occupancy;
+    static constexpr bool BOUNDED   = Bounded;
+
+    using index_t  = typename MapT::index_t;
+    using bundle_t = typename MapT::distribution_const_bundle_t;
+
+    static inline bool lookup(const MapT    &map,
+                              const index_t &bi,
+                              bundle_t      &bundle)
+    {
+        return map.lookupDistributionBundle(bi, bundle);
+    }
+
+    /**
+     * @brief Edge length of a bundle, which is rasterised as one cell.
+     */
+    static inline double resolution(const MapT &map)
+    {
+        return map.getBundleResolution();
+    }
+
+    /**
+     * @brief Transform from map coordinates into the ones of the
+     *        distributions, the origin of the map.
+     */
+    static inline cslibs_math_2d::Transform2d frame(const MapT &map)
+    {
+        return map.getInitialOrigin();
+    }
+};
+
+/**
+ * @brief Conversion traits of mono maps, a cell holds a single distribution
+ *        in world coordinates.
+ */
+struct MonoConversionTraits
+{
+    using map_t = cslibs_ndt_2d::static_maps::mono::Gridmap;
+
+    static constexpr bool OCCUPANCY = false;
+    static constexpr bool BOUNDED   = true;
+
+    using index_t  = map_t::index_t;
+    using bundle_t = cslibs_ndt::Bundle<const map_t::distribution_t*, 1>;
+
+    static inline bool lookup(const map_t   &map,
+                              const index_t &i,
+                              bundle_t      &bundle)
+    {
+        bundle[0] = map.lookupDistribution(i);
+        return bundle[0] != nullptr;
+    }
+
+    static inline double resolution(const map_t &map)
+    {
+        return map.getResolution();
+    }
+
+    static inline cslibs_math_2d::Transform2d frame(const map_t &map)
+    {
+        return map.getInitialOrigin();
+    }
+};
+}
+}
+
+namespace cslibs_ndt {
+namespace conversion {
+/// the rasters of 2D maps sample double precision moments
+template<>
+struct ConversionTraits<cslibs_ndt_2d::dynamic_maps::Gridmap> :
+        cslibs_ndt_2d::conversion::BundleConversionTraits<cslibs_ndt_2d::dynamic_maps::Gridmap, false, false> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_2d::static_maps::Gridmap> :
+        cslibs_ndt_2d::conversion::BundleConversionTraits<cslibs_ndt_2d::static_maps::Gridmap, false, true> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_2d::dynamic_maps::OccupancyGridmap> :
+        cslibs_ndt_2d::conversion::BundleConversionTraits<cslibs_ndt_2d::dynamic_maps::OccupancyGridmap, true, false> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_2d::static_maps::OccupancyGridmap> :
+        cslibs_ndt_2d::conversion::BundleConversionTraits<cslibs_ndt_2d::static_maps::OccupancyGridmap, true, true> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_2d::static_maps::mono::Gridmap> :
+        cslibs_ndt_2d::conversion::MonoConversionTraits {};
+}
+}
+
+#endif // CSLIBS_NDT_2D_CONVERSION_CONVERSION_TRAITS_HPP
@@ -6,14 +6,15 @@
 
 namespace cslibs_ndt_2d {
 namespace conversion {
-inline cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr from(
-        const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr& src)
+template <typename T>
+inline typename cslibs_ndt_2d::dynamic_maps::OccupancyGridmapT<T>::Ptr from(
+        const std::shared_ptr<cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>>& src)
 {
     if (!src)
         return nullptr;
 
-    using src_map_t = cslibs_ndt_2d::static_maps::OccupancyGridmap;
-    using dst_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    using src_map_t = cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>;
+    using dst_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmapT<T>;
     typename dst_map_t::Ptr dst(new dst_map_t(src->getInitialOrigin(),
                                               src->getResolution()));
 
@@ -29,8 +30,9 @@ inline cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr from(
     return dst;
 }
 
-inline cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr from(
-        const cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr& src)
+template <typename T>
+inline typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::Ptr from(
+        const std::shared_ptr<cslibs_ndt_2d::dynamic_maps::OccupancyGridmapT<T>>& src)
 {
     if (!src)
         return nullptr;
@@ -44,8 +46,8 @@ inline cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr from(
     const std::array<std::size_t, 2> size =
             cslibs_math::common::cast<std::size_t>(std::ceil(cslibs_math::common::cast<double>(max_distribution_index - min_distribution_index) / 2.0));
 
-    using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
-    using dst_map_t = cslibs_ndt_2d::static_maps::OccupancyGridmap;
+    using src_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmapT<T>;
+    using dst_map_t = cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>;
     typename dst_map_t::Ptr dst(new dst_map_t(src->getInitialOrigin(),
                                               src->getResolution(),
                                               size,
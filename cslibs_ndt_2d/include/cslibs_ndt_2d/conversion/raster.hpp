@@ -0,0 +1,629 @@
+#ifndef CSLIBS_NDT_2D_CONVERSION_RASTER_HPP
+#define CSLIBS_NDT_2D_CONVERSION_RASTER_HPP
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math_2d/linear/pose.hpp>
+#include <cslibs_math_2d/linear/point.hpp>
+#include <cslibs_math/common/div.hpp>
+
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+#include <cslibs_ndt_2d/conversion/conversion_traits.hpp>
+
+#include <cslibs_gridmaps/utility/inverse_model.hpp>
+#include <cslibs_gridmaps/static_maps/algorithms/distance_transform.hpp>
+
+namespace cslibs_ndt_2d {
+namespace conversion {
+/**
+ * @brief Time and decay of a map which a raster was last drawn with. The
+ *        occupancies of a decaying map change with its time, without dirty
+ *        blocks, so a raster which is updated in place is drawn again as a
+ *        whole once they changed. A stamp is meant for one raster.
+ */
+struct RasterStamp
+{
+    double time          = 0.0;
+    double time_constant = 0.0;
+    bool   valid         = false;
+
+    /**
+     * @brief Record the time and decay of the map for the next update.
+     * @param time          time of the map
+     * @param time_constant decay constant of the map
+     * @return true if the raster has to be drawn again as a whole
+     */
+    inline bool expire(const double time,
+                       const double time_constant)
+    {
+        const bool expired = !valid || time_constant != this->time_constant ||
+                (time_constant > 0.0 && time != this->time);
+        this->time          = time;
+        this->time_constant = time_constant;
+        valid               = true;
+        return expired;
+    }
+};
+
+namespace impl {
+using index_t = std::array<int, 2>;
+
+/**
+ * @brief Pixels of a raster within inclusive bounds.
+ */
+struct Window
+{
+    index_t min;
+    index_t max;
+
+    inline Window grown(const int n) const
+    {
+        return Window{{{min[0] - n, min[1] - n}}, {{max[0] + n, max[1] + n}}};
+    }
+
+    inline Window clipped(const int width, const int height) const
+    {
+        return Window{{{std::max(min[0], 0),         std::max(min[1], 0)}},
+                      {{std::min(max[0], width - 1), std::min(max[1], height - 1)}}};
+    }
+
+    inline bool empty() const
+    {
+        return min[0] > max[0] || min[1] > max[1];
+    }
+
+    inline int width() const
+    {
+        return max[0] - min[0] + 1;
+    }
+
+    inline int height() const
+    {
+        return max[1] - min[1] + 1;
+    }
+};
+
+/**
+ * @brief Pixels up to a distance from a changed one, which a distance
+ *        transform has to update.
+ */
+inline int margin(const double sampling_resolution,
+                  const double maximum_distance)
+{
+    return static_cast<int>(std::ceil(maximum_distance / sampling_resolution));
+}
+
+/**
+ * @brief Gaussian of a distribution, prepared for the evaluation on a raster.
+ */
+struct EIGEN_ALIGN16 Kernel
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Eigen::Vector2d mean;
+    Eigen::Matrix2d information;
+    double          weight;
+};
+
+/**
+ * @brief Pixels of a bundle, or of a cell of a mono map, with the kernels of
+ *        its distributions. The moments are read once while the cells are
+ *        collected, so the map is not touched while the pixels are evaluated.
+ */
+struct EIGEN_ALIGN16 Cell
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    index_t               pixel;    /// first pixel
+    Eigen::Vector2d       origin;   /// sampling point of the first pixel
+    std::array<Kernel, 4> kernels;
+    std::size_t           size = 0;
+
+    template<typename distribution_t>
+    inline void add(const distribution_t &d,
+                    const double          weight)
+    {
+        /// sampleNonNormalized vanishes below 3 samples
+        if (d.getN() < 3 || weight == 0.0)
+            return;
+
+        Kernel &k     = kernels[size++];
+        k.mean        = d.getMean();
+        k.information = d.getInformationMatrix();
+        k.weight      = weight;
+    }
+};
+
+using cells_t = std::vector<Cell, Eigen::aligned_allocator<Cell>>;
+
+/**
+ * @brief Kernels of the distributions of a bundle, weighted equally.
+ */
+struct Gaussians
+{
+    template<typename bundle_t>
+    inline void operator()(const bundle_t &bundle,
+                           Cell           &cell) const
+    {
+        const std::size_t n = bundle.data().size();
+        for (std::size_t i = 0 ; i < n ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d)
+                cell.add(d->data(), 1.0 / n);
+        }
+    }
+
+    template<typename bundle_t>
+    inline bool populated(const bundle_t &bundle) const
+    {
+        for (std::size_t i = 0 ; i < bundle.data().size() ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d && d->data().getN() >= 3)
+                return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief Kernels of the occupancy distributions of a bundle, weighted by
+ *        their occupancy decayed up to the time of the map.
+ */
+struct Occupancies
+{
+    const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model;
+    const double                                       time;
+    const double                                       time_constant;
+
+    template<typename bundle_t>
+    inline void operator()(const bundle_t &bundle,
+                           Cell           &cell) const
+    {
+        const std::size_t n = bundle.data().size();
+        for (std::size_t i = 0 ; i < n ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d && d->getDistribution())
+                cell.add(*d->getDistribution(), d->getOccupancy(inverse_model, time, time_constant) / n);
+        }
+    }
+
+    template<typename bundle_t>
+    inline bool populated(const bundle_t &bundle) const
+    {
+        for (std::size_t i = 0 ; i < bundle.data().size() ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d && d->getDistribution() && d->getDistribution()->getN() >= 3)
+                return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief All pixels of a raster.
+ */
+template<typename raster_t>
+inline Window bounds(const raster_t &dst)
+{
+    return Window{{{0, 0}}, {{static_cast<int>(dst.getWidth()) - 1, static_cast<int>(dst.getHeight()) - 1}}};
+}
+
+/**
+ * @brief Bundles covered by a raster of a map, the allocated ones and the
+ *        neighbours of the populated ones. The neighbours share distributions
+ *        with them, so they are sampled without being allocated.
+ * @param kernels   kernels of the map, which tell populated bundles
+ */
+template<typename map_t, typename Kernels>
+inline Window extent(const map_t   &src,
+                     const Kernels &kernels,
+                     std::false_type)
+{
+    using bundle_t = typename map_t::distribution_bundle_t;
+
+    Window bundles{{{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}},
+                   {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}}};
+    src.traverse([&bundles, &kernels](const index_t &bi, const bundle_t &b) {
+        const int n = kernels.populated(b) ? 1 : 0;
+        for (std::size_t d = 0 ; d < 2 ; ++d) {
+            bundles.min[d] = std::min(bundles.min[d], bi[d] - n);
+            bundles.max[d] = std::max(bundles.max[d], bi[d] + n);
+        }
+    });
+    return bundles.empty() ? Window{{{0, 0}}, {{-1, -1}}} : bundles;
+}
+
+/**
+ * @brief Bounded maps are rasterised as a whole, over their metric size.
+ */
+template<typename map_t, typename Kernels>
+inline Window extent(const map_t   &src,
+                     const Kernels &,
+                     std::true_type)
+{
+    const index_t min_bi = src.getMinBundleIndex();
+    const double  bundle_resolution_inv = 1.0 / cslibs_ndt::conversion::conversion_traits_t<map_t>::resolution(src);
+    return Window{min_bi, {{min_bi[0] + static_cast<int>(std::round(src.getWidth()  * bundle_resolution_inv)) - 1,
+                            min_bi[1] + static_cast<int>(std::round(src.getHeight() * bundle_resolution_inv)) - 1}}};
+}
+
+template<typename map_t, typename Kernels>
+inline Window extent(const map_t   &src,
+                     const Kernels &kernels)
+{
+    using bounded_t = std::integral_constant<bool, cslibs_ndt::conversion::conversion_traits_t<map_t>::BOUNDED>;
+    return extent(src, kernels, bounded_t());
+}
+
+/**
+ * @brief Pixels of the bundles which changed with a dirty block.
+ * @param min_bi    minimum bundle index of the raster
+ */
+inline Window window(const index_t &min_bi,
+                     const index_t &block_min_bi,
+                     const index_t &block_max_bi,
+                     const int      chunk_step)
+{
+    return Window{{{(block_min_bi[0] - min_bi[0]) * chunk_step,         (block_min_bi[1] - min_bi[1]) * chunk_step}},
+                  {{(block_max_bi[0] + 1 - min_bi[0]) * chunk_step - 1, (block_max_bi[1] + 1 - min_bi[1]) * chunk_step - 1}}};
+}
+
+/**
+ * @brief Origin of a raster of bundles of a map, the raster is aligned with
+ *        the map, so the offset of its first bundle is rotated along.
+ */
+template<typename map_t>
+inline cslibs_math_2d::Pose2d origin(const map_t  &src,
+                                     const Window &bundles)
+{
+    const double bundle_resolution = cslibs_ndt::conversion::conversion_traits_t<map_t>::resolution(src);
+    const cslibs_math_2d::Pose2d initial = src.getInitialOrigin();
+    cslibs_math_2d::Pose2d origin = initial;
+    origin.translation() = initial * cslibs_math_2d::Point2d(bundles.min[0] * bundle_resolution,
+                                                             bundles.min[1] * bundle_resolution);
+    return origin;
+}
+
+/**
+ * @brief Pixels of a raster of a number of bundles.
+ */
+inline int pixels(const int    bundles,
+                  const double bundle_resolution,
+                  const double sampling_resolution)
+{
+    return static_cast<int>(std::ceil(bundles * bundle_resolution / sampling_resolution));
+}
+
+/**
+ * @brief Create a raster of a map, the map itself is not modified.
+ * @param kernels   kernels of the map
+ * @param create    (const pose_t &origin, std::size_t height, std::size_t width) -> raster
+ * @param value     value of the pixels
+ * @return          bundles of the raster
+ */
+template<typename map_t, typename raster_ptr_t, typename Kernels, typename Create, typename T>
+inline Window raster(const map_t   &src,
+                     raster_ptr_t  &dst,
+                     const double   sampling_resolution,
+                     const Kernels &kernels,
+                     const Create  &create,
+                     const T       &value)
+{
+    const double bundle_resolution = cslibs_ndt::conversion::conversion_traits_t<map_t>::resolution(src);
+    const Window bundles = extent(src, kernels);
+    dst = create(origin(src, bundles),
+                 pixels(bundles.height(), bundle_resolution, sampling_resolution),
+                 pixels(bundles.width(),  bundle_resolution, sampling_resolution));
+    std::fill(dst->getData().begin(), dst->getData().end(), value);
+    return bundles;
+}
+
+/**
+ * @brief Prepare an existing raster of a map for an update of the dirty
+ *        blocks. If the map grew, the raster grows along and keeps its
+ *        pixels, a raster which does not match is created from scratch.
+ *        The map itself is not modified.
+ * @param kernels   kernels of the map
+ * @param create    (const pose_t &origin, std::size_t height, std::size_t width) -> raster
+ * @param value     value of the pixels without bundles
+ * @param bundles   bundles of the raster
+ * @param margin    pixels around a change which depend on it
+ * @return          windows of the raster to redraw
+ */
+template<typename map_t, typename raster_ptr_t, typename Kernels, typename Create, typename T>
+inline std::vector<Window> prepare(const map_t                          &src,
+                                   raster_ptr_t                         &dst,
+                                   const typename map_t::dirty_blocks_t &dirty,
+                                   const double                          sampling_resolution,
+                                   const Kernels                        &kernels,
+                                   const Create                         &create,
+                                   const T                              &value,
+                                   Window                               &bundles,
+                                   const int                             margin = 0)
+{
+    if (!dst || dst->getResolution() != sampling_resolution) {
+        bundles = raster(src, dst, sampling_resolution, kernels, create, value);
+        return {bounds(*dst)};
+    }
+
+    bundles = extent(src, kernels);
+    const double                 bundle_resolution = cslibs_ndt::conversion::conversion_traits_t<map_t>::resolution(src);
+    const int                    chunk_step        = static_cast<int>(bundle_resolution / sampling_resolution);
+    const int                    height            = pixels(bundles.height(), bundle_resolution, sampling_resolution);
+    const int                    width             = pixels(bundles.width(),  bundle_resolution, sampling_resolution);
+    const cslibs_math_2d::Pose2d o                 = origin(src, bundles);
+
+    std::vector<Window> windows;
+
+    /// the raster grows and shrinks by whole bundles, so the previous one is moved by whole chunks along its axes
+    const cslibs_math_2d::Point2d previous = o.inverse() * dst->getOrigin().translation();
+    const index_t shift = {{static_cast<int>(std::round(previous(0) / bundle_resolution)) * chunk_step,
+                            static_cast<int>(std::round(previous(1) / bundle_resolution)) * chunk_step}};
+    if (shift[0] != 0 || shift[1] != 0 ||
+            height != static_cast<int>(dst->getHeight()) ||
+            width  != static_cast<int>(dst->getWidth())) {
+        raster_ptr_t grown = create(o, height, width);
+        std::fill(grown->getData().begin(), grown->getData().end(), value);
+
+        const Window kept = Window{shift, {{shift[0] + static_cast<int>(dst->getWidth())  - 1,
+                                            shift[1] + static_cast<int>(dst->getHeight()) - 1}}}.clipped(width, height);
+        for (int y = kept.min[1] ; y <= kept.max[1] ; ++y)
+            for (int x = kept.min[0] ; x <= kept.max[0] ; ++x)
+                grown->at(x, y) = dst->at(x - shift[0], y - shift[1]);
+
+        /// new pixels next to the previous raster might depend on it
+        if (margin > 0 && !kept.empty()) {
+            const Window ring = kept.grown(margin).clipped(width, height);
+            windows.emplace_back(Window{ring.min, {{ring.max[0], kept.min[1] - 1}}});
+            windows.emplace_back(Window{{{ring.min[0], kept.max[1] + 1}}, ring.max});
+            windows.emplace_back(Window{{{ring.min[0], kept.min[1]}}, {{kept.min[0] - 1, kept.max[1]}}});
+            windows.emplace_back(Window{{{kept.max[0] + 1, kept.min[1]}}, {{ring.max[0], kept.max[1]}}});
+        }
+        dst = grown;
+    }
+
+    dirty.traverse([&bundles, &windows, chunk_step, margin, width, height](const index_t &min_bi, const index_t &max_bi) {
+        windows.emplace_back(window(bundles.min, min_bi, max_bi, chunk_step).grown(margin).clipped(width, height));
+    });
+    windows.erase(std::remove_if(windows.begin(), windows.end(),
+                                 [](const Window &w) { return w.empty(); }),
+                  windows.end());
+
+    /// windows of adjacent blocks overlap, their union is cheaper than both
+    auto area = [](const Window &w) {
+        return static_cast<std::size_t>(w.width()) * static_cast<std::size_t>(w.height());
+    };
+    for (bool merged = true ; merged ; ) {
+        merged = false;
+        for (std::size_t i = 0 ; i < windows.size() && !merged ; ++i) {
+            for (std::size_t j = i + 1 ; j < windows.size() && !merged ; ++j) {
+                const Window u{{{std::min(windows[i].min[0], windows[j].min[0]), std::min(windows[i].min[1], windows[j].min[1])}},
+                               {{std::max(windows[i].max[0], windows[j].max[0]), std::max(windows[i].max[1], windows[j].max[1])}}};
+                if (area(u) <= area(windows[i]) + area(windows[j])) {
+                    windows[i] = u;
+                    windows.erase(windows.begin() + j);
+                    merged = true;
+                }
+            }
+        }
+    }
+    return windows;
+}
+
+template<typename raster_t, typename T>
+inline void fill(raster_t     &dst,
+                 const Window &w,
+                 const T      &value)
+{
+    for (int y = w.min[1] ; y <= w.max[1] ; ++y)
+        for (int x = w.min[0] ; x <= w.max[0] ; ++x)
+            dst.at(x, y) = value;
+}
+
+/**
+ * @brief Evaluate the kernels of cells at their pixels within a window. The
+ *        cells are grouped into square tiles of the raster, which are
+ *        processed in parallel. Within a cell, the exponent of a kernel is a
+ *        quadratic polynomial of the pixel, so all pixels of a cell are
+ *        evaluated at once.
+ * @param cells         cells of chunk_step x chunk_step pixels
+ * @param step_x        offset of the sampling points of adjacent pixels along x
+ * @param step_y        offset of the sampling points of adjacent pixels along y
+ * @param function      (int x, int y, double v), called concurrently for different pixels
+ * @param num_threads   number of threads
+ */
+template<typename Fn>
+inline void rasterize(const cells_t         &cells,
+                      const Window          &w,
+                      const int              chunk_step,
+                      const Eigen::Vector2d &step_x,
+                      const Eigen::Vector2d &step_y,
+                      const Fn              &function,
+                      const std::size_t      num_threads = std::thread::hardware_concurrency())
+{
+    static constexpr int tile_size = 64;
+
+    using tile_t = std::vector<const Cell*>;
+    std::unordered_map<index_t, tile_t, cslibs_ndt::parallel::IndexHash<index_t>> buckets;
+    for (const Cell &c : cells)
+        buckets[{{cslibs_math::common::div<int>(c.pixel[0], tile_size),
+                  cslibs_math::common::div<int>(c.pixel[1], tile_size)}}].emplace_back(&c);
+
+    std::vector<tile_t> tiles;
+    tiles.reserve(buckets.size());
+    for (auto &b : buckets)
+        tiles.emplace_back(std::move(b.second));
+    if (tiles.empty())
+        return;
+
+    /// pixel offsets of a whole cell, column major as the pixels are visited
+    const int n = chunk_step * chunk_step;
+    Eigen::ArrayXd ks(n), ls(n);
+    for (int l = 0 ; l < chunk_step ; ++l) {
+        ks.segment(l * chunk_step, chunk_step) = Eigen::ArrayXd::LinSpaced(chunk_step, 0, chunk_step - 1);
+        ls.segment(l * chunk_step, chunk_step).setConstant(l);
+    }
+
+    auto evaluate = [&w, chunk_step, n, &ks, &ls, &step_x, &step_y, &function]
+            (const Cell &c, Eigen::ArrayXd &v) {
+        const int k0 = std::max(w.min[0] - c.pixel[0], 0);
+        const int k1 = std::min(w.max[0] - c.pixel[0], chunk_step - 1);
+        const int l0 = std::max(w.min[1] - c.pixel[1], 0);
+        const int l1 = std::min(w.max[1] - c.pixel[1], chunk_step - 1);
+        if (k0 > k1 || l0 > l1)
+            return;
+
+        v.setZero();
+        for (std::size_t i = 0 ; i < c.size ; ++i) {
+            const Kernel          &g  = c.kernels[i];
+            const Eigen::Vector2d  d  = c.origin - g.mean;
+            const Eigen::Vector2d  id = g.information * d;
+            const Eigen::Vector2d  ix = g.information * step_x;
+            const double kk = step_x.dot(ix);
+            const double kl = 2.0 * step_y.dot(ix);
+            const double ll = step_y.dot(g.information * step_y);
+            const double k  = 2.0 * step_x.dot(id);
+            const double l  = 2.0 * step_y.dot(id);
+            const double q0 = d.dot(id);
+            v += g.weight * (-0.5 * ((kk * ks + kl * ls + k) * ks + (ll * ls + l) * ls + q0)).exp();
+        }
+        for (int l = l0 ; l <= l1 ; ++l)
+            for (int k = k0 ; k <= k1 ; ++k)
+                function(c.pixel[0] + k, c.pixel[1] + l, v(l * chunk_step + k));
+    };
+
+    std::atomic<std::size_t> next(0);
+    auto run = [&tiles, &next, &evaluate, n]() {
+        Eigen::ArrayXd v(n);
+        for (std::size_t t = next++ ; t < tiles.size() ; t = next++)
+            for (const Cell *c : tiles[t])
+                evaluate(*c, v);
+    };
+
+    const std::size_t threads = std::max<std::size_t>(1, std::min(num_threads, tiles.size()));
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1 ; t < threads ; ++t)
+        workers.emplace_back(run);
+    run();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+/**
+ * @brief Cells of the bundles of a map within a window of its raster. The
+ *        distributions are looked up without allocating bundles, so bundles
+ *        which are only partially allocated are sampled as well. The origins
+ *        of the cells are given in the frame of the distributions.
+ * @param min_bi    minimum bundle index of the raster
+ * @param kernels   (const bundle_t &b, Cell &c)
+ */
+template<typename map_t, typename Kernels>
+inline cells_t cells(const map_t   &src,
+                     const index_t &min_bi,
+                     const Window  &w,
+                     const double   sampling_resolution,
+                     const Kernels &kernels)
+{
+    using traits_t = cslibs_ndt::conversion::conversion_traits_t<map_t>;
+
+    const double                      bundle_resolution = traits_t::resolution(src);
+    const int                         chunk_step        = static_cast<int>(bundle_resolution / sampling_resolution);
+    const cslibs_math_2d::Transform2d frame             = traits_t::frame(src);
+
+    cells_t cells;
+    typename traits_t::bundle_t bundle;
+    for (int i = cslibs_math::common::div<int>(w.min[0], chunk_step) ; i <= cslibs_math::common::div<int>(w.max[0], chunk_step) ; ++i) {
+        for (int j = cslibs_math::common::div<int>(w.min[1], chunk_step) ; j <= cslibs_math::common::div<int>(w.max[1], chunk_step) ; ++j) {
+            const index_t bi = {{min_bi[0] + i, min_bi[1] + j}};
+            if (!traits_t::lookup(src, bi, bundle))
+                continue;
+
+            const cslibs_math_2d::Point2d o = frame * cslibs_math_2d::Point2d(bi[0] * bundle_resolution, bi[1] * bundle_resolution);
+            Cell c;
+            c.pixel  = {{i * chunk_step, j * chunk_step}};
+            c.origin = Eigen::Vector2d(o(0), o(1));
+            kernels(bundle, c);
+            if (c.size > 0)
+                cells.emplace_back(c);
+        }
+    }
+    return cells;
+}
+
+/**
+ * @brief Sample the bundles of a map at the pixels of a window of its raster.
+ *        The pixel axes are rotated along into the frame of the distributions.
+ * @param min_bi    minimum bundle index of the raster
+ * @param kernels   (const bundle_t &b, Cell &c)
+ * @param function  (int x, int y, double v), called concurrently for different pixels
+ */
+template<typename map_t, typename Kernels, typename Fn>
+inline void draw(const map_t   &src,
+                 const index_t &min_bi,
+                 const Window  &w,
+                 const double   sampling_resolution,
+                 const Kernels &kernels,
+                 const Fn      &function)
+{
+    using traits_t = cslibs_ndt::conversion::conversion_traits_t<map_t>;
+
+    const double yaw = traits_t::frame(src).yaw();
+    const double c   = std::cos(yaw) * sampling_resolution;
+    const double s   = std::sin(yaw) * sampling_resolution;
+    rasterize(cells(src, min_bi, w, sampling_resolution, kernels), w,
+              static_cast<int>(traits_t::resolution(src) / sampling_resolution),
+              Eigen::Vector2d(c, s),
+              Eigen::Vector2d(-s, c),
+              function);
+}
+
+/**
+ * @brief Distance transform of a window of a raster of a map. Distances up
+ *        to the maximum only depend on the pixels within that range, so it is
+ *        computed on a patch grown by it.
+ * @param min_bi    minimum bundle index of the raster
+ * @param kernels   (const bundle_t &b, Cell &c)
+ * @param function  (int x, int y, double distance)
+ */
+template<typename map_t, typename Kernels, typename Fn>
+inline void distance(const map_t   &src,
+                     const index_t &min_bi,
+                     const Window  &w,
+                     const int      width,
+                     const int      height,
+                     const double   sampling_resolution,
+                     const double   maximum_distance,
+                     const double   threshold,
+                     const Kernels &kernels,
+                     const Fn      &function)
+{
+    const Window patch = w.grown(margin(sampling_resolution, maximum_distance)).clipped(width, height);
+    std::vector<double> occ(static_cast<std::size_t>(patch.width() * patch.height()), 0.0);
+    draw(src, min_bi, patch, sampling_resolution, kernels, [&occ, &patch](const int x, const int y, const double v) {
+        occ[(y - patch.min[1]) * patch.width() + (x - patch.min[0])] = v;
+    });
+
+    std::vector<double> dist;
+    cslibs_gridmaps::static_maps::algorithms::DistanceTransform<double> distance_transform(
+                sampling_resolution, maximum_distance, threshold);
+    distance_transform.apply(occ, patch.width(), dist);
+
+    for (int y = w.min[1] ; y <= w.max[1] ; ++y)
+        for (int x = w.min[0] ; x <= w.max[0] ; ++x)
+            function(x, y, dist[(y - patch.min[1]) * patch.width() + (x - patch.min[0])]);
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_2D_CONVERSION_RASTER_HPP
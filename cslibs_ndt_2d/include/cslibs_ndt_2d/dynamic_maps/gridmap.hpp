@@ -5,12 +5,19 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <thread>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 #include <cslibs_math_2d/linear/point.hpp>
 
 #include <cslibs_ndt/common/distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/insert_batch.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/merge.hpp>
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/dirty_blocks.hpp>
+#include <cslibs_ndt/common/box.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -25,23 +32,25 @@ namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt_2d {
 namespace dynamic_maps {
-class EIGEN_ALIGN16 Gridmap
+template <typename T = double>
+class EIGEN_ALIGN16 GridmapT
 {
 public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    using allocator_t = Eigen::aligned_allocator<Gridmap>;
+    using allocator_t = Eigen::aligned_allocator<GridmapT>;
 
-    using ConstPtr                          = std::shared_ptr<const Gridmap>;
-    using Ptr                               = std::shared_ptr<Gridmap>;
+    using ConstPtr                          = std::shared_ptr<const GridmapT>;
+    using Ptr                               = std::shared_ptr<GridmapT>;
     using pose_t                            = cslibs_math_2d::Pose2d;
     using transform_t                       = cslibs_math_2d::Transform2d;
     using point_t                           = cslibs_math_2d::Point2d;
+    using batch_t                           = cslibs_ndt::InsertBatch<point_t, pose_t>;
     using index_t                           = std::array<int, 2>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
-    using distribution_t                    = cslibs_ndt::Distribution<2>;
+    using distribution_t                    = cslibs_ndt::Distribution<2, T>;
     using distribution_storage_t            = cis::Storage<distribution_t, index_t, cis::backend::kdtree::KDTree>;
     using distribution_storage_ptr_t        = std::shared_ptr<distribution_storage_t>;
     using distribution_storage_array_t      = std::array<distribution_storage_ptr_t, 4>;
@@ -49,15 +58,16 @@ public:
     using distribution_const_bundle_t       = cslibs_ndt::Bundle<const distribution_t*, 4>;
     using distribution_bundle_storage_t     = cis::Storage<distribution_bundle_t, index_t, cis::backend::kdtree::KDTree>;
     using distribution_bundle_storage_ptr_t = std::shared_ptr<distribution_bundle_storage_t>;
+    using dirty_blocks_t                    = cslibs_ndt::DirtyBlocks<index_t>;
 
-    inline Gridmap(const double resolution) :
-        Gridmap(pose_t::identity(),
-                resolution)
+    inline GridmapT(const double resolution) :
+        GridmapT(pose_t::identity(),
+                 resolution)
     {
     }
 
-    inline Gridmap(const pose_t &origin,
-                   const double &resolution) :
+    inline GridmapT(const pose_t &origin,
+                    const double &resolution) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -73,12 +83,12 @@ public:
     {
     }
 
-    inline Gridmap(const pose_t &origin,
-                   const double &resolution,
-                   const index_t &min_index,
-                   const index_t &max_index,
-                   const std::shared_ptr<distribution_bundle_storage_t> &bundles,
-                   const distribution_storage_array_t                   &storage) :
+    inline GridmapT(const pose_t &origin,
+                    const double &resolution,
+                    const index_t &min_index,
+                    const index_t &max_index,
+                    const std::shared_ptr<distribution_bundle_storage_t> &bundles,
+                    const distribution_storage_array_t                   &storage) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -91,10 +101,10 @@ public:
     {
     }
 
-    inline Gridmap(const double &origin_x,
-                   const double &origin_y,
-                   const double &origin_phi,
-                   const double &resolution) :
+    inline GridmapT(const double &origin_x,
+                    const double &origin_y,
+                    const double &origin_phi,
+                    const double &resolution) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -110,7 +120,7 @@ public:
     {
     }
 
-    inline Gridmap(const Gridmap &other) :
+    inline GridmapT(const GridmapT &other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -126,7 +136,7 @@ public:
     {
     }
 
-    inline Gridmap(Gridmap &&other) :
+    inline GridmapT(GridmapT &&other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -190,6 +200,7 @@ public:
     {
         const index_t bi = toBundleIndex(p);
         distribution_bundle_t *bundle = getAllocate(bi);
+        dirty_.mark(bi);
         bundle->at(0)->data().add(p);
         bundle->at(1)->data().add(p);
         bundle->at(2)->data().add(p);
@@ -198,10 +209,17 @@ public:
 
     inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
                        const pose_t &points_origin = pose_t())
+    {
+        insert(points->begin(), points->end(), points_origin);
+    }
+
+    template<typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
     {
         distribution_storage_t storage;
-        for (const auto &p : *points) {
-            const point_t pm = points_origin * p;
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
             if (pm.isNormal()) {
                 const index_t &bi = toBundleIndex(pm);
                 distribution_t *d = storage.get(bi);
@@ -211,6 +229,7 @@ public:
 
         storage.traverse([this](const index_t& bi, const distribution_t &d) {
             distribution_bundle_t *bundle = getAllocate(bi);
+            dirty_.mark(bi);
             bundle->at(0)->data() += d.data();
             bundle->at(1)->data() += d.data();
             bundle->at(2)->data() += d.data();
@@ -224,6 +243,159 @@ public:
         return bundle_storage_->get(bi);
     }
 
+    /**
+     * @brief Insert the clouds of several sensors, the moments of all clouds
+     *        are aggregated before the bundles are updated once.
+     * @param batch     clouds and sensor poses
+     */
+    inline void insert(const batch_t &batch)
+    {
+        distribution_storage_t storage;
+
+        for (const auto &entry : batch) {
+            const pose_t &points_origin = entry.second;
+            for (const auto &p : *(entry.first)) {
+                const point_t pm = points_origin * p;
+                if (!pm.isNormal())
+                    continue;
+                const index_t bi = toBundleIndex(pm);
+                distribution_t *d = storage.get(bi);
+                (d ? d : &storage.insert(bi, distribution_t()))->data().add(pm);
+            }
+        }
+
+        storage.traverse([this](const index_t& bi, const distribution_t &d) {
+            distribution_bundle_t *bundle = getAllocate(bi);
+            dirty_.mark(bi);
+            bundle->at(0)->data() += d.data();
+            bundle->at(1)->data() += d.data();
+            bundle->at(2)->data() += d.data();
+            bundle->at(3)->data() += d.data();
+        });
+    }
+
+    /**
+     * @brief Insert a batch of points using multiple threads, the moments are
+     *        aggregated per thread and merged per distribution storage.
+     * @param points        the points
+     * @param points_origin pose of the points in the world frame
+     * @param num_threads   number of threads to aggregate the points with
+     */
+    inline void insertParallel(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
+                               const pose_t &points_origin = pose_t(),
+                               const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        insertParallel(points->begin(), points->end(), points_origin, num_threads);
+    }
+
+    template<typename iterator_t>
+    inline void insertParallel(const iterator_t& points_begin, const iterator_t& points_end,
+                               const pose_t &points_origin = pose_t(),
+                               const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        auto locate = [this, &points_origin](const point_t &p, point_t &p_m, index_t &bi) {
+            p_m = points_origin * p;
+            if (!p_m.isNormal())
+                return false;
+            bi = toBundleIndex(p_m);
+            return true;
+        };
+        auto allocate = [this](const index_t &bi) {
+            dirty_.mark(bi);
+            return getAllocate(bi);
+        };
+        cslibs_ndt::parallel::insert<distribution_bundle_t, point_t, index_t>(points_begin, points_end, num_threads,
+                                                                              locate, allocate);
+    }
+
+    /**
+     * @brief Fuse another map into this one by composing the moments of its
+     *        distributions, so no points have to be inserted again. If both
+     *        grids are aligned, i.e. they share the resolution and are offset
+     *        by whole cells, every distribution is composed exactly with its
+     *        counterpart, one thread per storage. Otherwise the distributions
+     *        of storage 0, which partition the points of the other map, are
+     *        transformed and re-binned into the bundles their means fall into.
+     * @param other         the map to merge
+     * @param transform     transformation from the world frame of other into
+     *                      the world frame of this map
+     * @param num_threads   number of threads to re-bin with
+     */
+    inline void merge(const GridmapT &other,
+                      const transform_t &transform = transform_t(),
+                      const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        using moments_t     = typename distribution_t::distribution_t;
+        using partial_t     = cslibs_ndt::parallel::MomentsMap<index_t, moments_t>;
+        using rotation_t    = Eigen::Matrix<double, 2, 2>;
+        using translation_t = Eigen::Matrix<double, 2, 1>;
+
+        if (&other == this) {
+            const GridmapT copy(other);
+            merge(copy, transform, num_threads);
+            return;
+        }
+
+        auto decompose = [](const transform_t &t, rotation_t &R, translation_t &o) {
+            o = (t * point_t(0.0, 0.0)).data();
+            R.col(0) = (t * point_t(1.0, 0.0)).data() - o;
+            R.col(1) = (t * point_t(0.0, 1.0)).data() - o;
+        };
+        rotation_t    R;
+        translation_t t;
+        decompose(transform, R, t);
+
+        rotation_t    R_grid;
+        translation_t t_grid;
+        decompose(m_T_w_ * transform * other.w_T_m_, R_grid, t_grid);
+
+        index_t offset;
+        if (std::abs(resolution_ - other.resolution_) < 1e-9 &&
+                cslibs_ndt::merge::aligned<2>(R_grid, t_grid, resolution_, offset)) {
+            other.bundle_storage_->traverse([this, &offset](const index_t &bi, const distribution_bundle_t &) {
+                const index_t target = {{bi[0] + 2 * offset[0], bi[1] + 2 * offset[1]}};
+                getAllocate(target);
+                dirty_.mark(target);
+            });
+
+            std::array<std::thread, 4> threads;
+            for (std::size_t i = 0 ; i < 4 ; ++i)
+                threads[i] = std::thread([this, &other, &offset, &R, &t, i]() {
+                    const distribution_storage_ptr_t &storage = storage_[i];
+                    other.storage_[i]->traverse([&storage, &offset, &R, &t](const index_t &si, const distribution_t &d) {
+                        distribution_t *target = storage->get({{si[0] + offset[0], si[1] + offset[1]}});
+                        if (target && d.data().getN() > 0)
+                            target->data() += cslibs_ndt::merge::transform(d.data(), R, t);
+                    });
+                });
+            for (std::size_t i = 0 ; i < 4 ; ++i)
+                threads[i].join();
+            return;
+        }
+
+        std::vector<const distribution_t*> sources;
+        other.storage_[0]->traverse([&sources](const index_t &, const distribution_t &d) {
+            if (d.data().getN() > 0)
+                sources.emplace_back(&d);
+        });
+
+        auto rebin = [this, &R, &t](const distribution_t *d, partial_t &moments) {
+            const moments_t m = cslibs_ndt::merge::transform(d->data(), R, t);
+            const point_t mean(m.getMean()(0), m.getMean()(1));
+            moments[toBundleIndex(mean)] += m;
+        };
+        auto allocate = [this](const index_t &bi) {
+            dirty_.mark(bi);
+            return getAllocate(bi);
+        };
+        auto update = [](distribution_t &d, const moments_t &m) {
+            d.data() += m;
+        };
+        const std::vector<partial_t> partial =
+                cslibs_ndt::parallel::aggregate<partial_t>(sources.begin(), sources.end(), num_threads, rebin);
+        cslibs_ndt::parallel::merge<distribution_bundle_t, index_t>(partial, allocate, update);
+    }
+
     inline double sample(const point_t &p) const
     {
         const index_t bi = toBundleIndex(p);
@@ -262,6 +434,11 @@ public:
         return bundle ? evaluate() : 0.0;
     }
 
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_bundle_index_;
@@ -282,6 +459,26 @@ public:
         return getAllocate(bi);
     }
 
+    /**
+     * @brief Look up the distributions of a bundle without allocating it.
+     *        Neighbours of populated bundles share distributions with them,
+     *        so they can be sampled without allocatePartiallyAllocatedBundles,
+     *        which leaves the map unchanged and safe to read concurrently.
+     * @param bi        bundle index, the bundle does not need to exist
+     * @param bundle    the distributions, nullptr if not allocated
+     * @return true if any of the distributions exists
+     */
+    inline bool lookupDistributionBundle(const index_t               &bi,
+                                         distribution_const_bundle_t &bundle) const
+    {
+        bool found = false;
+        for (std::size_t i = 0 ; i < 4 ; ++i) {
+            bundle[i] = storage_[i]->get(toStorageIndex(bi, i));
+            found    |= bundle[i] != nullptr;
+        }
+        return found;
+    }
+
     inline double getBundleResolution() const
     {
         return bundle_resolution_;
@@ -313,6 +510,160 @@ public:
         return bundle_storage_->traverse(function);
     }
 
+    /**
+     * @brief Traverse all bundles in Z-order (Morton order), so that
+     *        spatially adjacent bundles are visited consecutively. The bundles
+     *        are collected and sorted first, which costs O(n log n), so use
+     *        traverse where the order does not matter.
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverseOrdered(const Fn& function) const
+    {
+        if (empty())
+            return;
+
+        cslibs_ndt::morton::Order<index_t, const distribution_bundle_t> order(min_bundle_index_);
+        bundle_storage_->traverse([&order](const index_t &bi, const distribution_bundle_t &b) {
+            order.add(bi, &b);
+        });
+        order.traverse(function);
+    }
+
+    /**
+     * @brief Traverse the bundles inside an axis-aligned box in Z-order.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1])
+            return;
+
+        cslibs_ndt::morton::Order<index_t, const distribution_bundle_t> order(lo);
+
+        /// small boxes are looked up cell by cell, large ones filter a full traversal
+        const std::size_t box_volume = static_cast<std::size_t>(hi[0] - lo[0] + 1) *
+                                       static_cast<std::size_t>(hi[1] - lo[1] + 1);
+        const std::size_t map_volume = static_cast<std::size_t>(max_bundle_index_[0] - min_bundle_index_[0] + 1) *
+                                       static_cast<std::size_t>(max_bundle_index_[1] - min_bundle_index_[1] + 1);
+        if (8 * box_volume <= map_volume) {
+            for (int i = lo[0] ; i <= hi[0] ; ++i)
+                for (int j = lo[1] ; j <= hi[1] ; ++j) {
+                    const index_t bi = {{i, j}};
+                    if (const distribution_bundle_t *bundle = bundle_storage_->get(bi))
+                        order.add(bi, bundle);
+                }
+        } else {
+            bundle_storage_->traverse([&order, &lo, &hi](const index_t &bi, const distribution_bundle_t &b) {
+                if (cslibs_ndt::box::contains(bi, lo, hi))
+                    order.add(bi, &b);
+            });
+        }
+        order.traverse(function);
+    }
+
+    /**
+     * @brief Extract the bundles inside an axis-aligned box into a new map,
+     *        the distributions are copied. All extracted bundles are dirty
+     *        in the new map.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the cropped map, nullptr if the box does not intersect the map
+     */
+    inline Ptr crop(const index_t &min_bi,
+                    const index_t &max_bi) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1])
+            return nullptr;
+
+        Ptr dst(new GridmapT(w_T_m_, resolution_));
+        traverse(lo, hi, [&dst](const index_t &bi, const distribution_bundle_t &b) {
+            distribution_bundle_t *b_dst = dst->getDistributionBundle(bi);
+            dst->dirty_.mark(bi);
+            for (std::size_t i = 0 ; i < 4 ; ++i)
+                b_dst->at(i)->data() = b.at(i)->data();
+        });
+        return dst;
+    }
+
+    /**
+     * @brief Remove the bundles matching a predicate together with the
+     *        distributions no remaining bundle refers to. The storages are
+     *        rebuilt in parallel, which releases their memory, and the
+     *        bounds are recomputed.
+     * @param predicate called with the bundle index and the bundle, returns
+     *                  true if the bundle is to be removed
+     * @return the number of removed bundles
+     */
+    template <typename Pred>
+    inline std::size_t prune(const Pred &predicate)
+    {
+        std::vector<std::pair<index_t, const distribution_bundle_t*>> kept;
+        std::size_t removed = 0;
+        bundle_storage_->traverse([this, &predicate, &kept, &removed](const index_t &bi, const distribution_bundle_t &b) {
+            if (predicate(bi, b)) {
+                ++ removed;
+                dirty_.mark(bi);
+            } else {
+                kept.emplace_back(bi, &b);
+            }
+        });
+        if (removed == 0)
+            return 0;
+
+        distribution_storage_array_t storage;
+        std::array<std::thread, 4> threads;
+        for (std::size_t i = 0 ; i < 4 ; ++i)
+            threads[i] = std::thread([this, &storage, &kept, i]() {
+                storage[i].reset(new distribution_storage_t);
+                for (const auto &k : kept) {
+                    const index_t si = toStorageIndex(k.first, i);
+                    if (!storage[i]->get(si))
+                        storage[i]->insert(si, *(k.second->at(i)));
+                }
+            });
+        for (std::size_t i = 0 ; i < 4 ; ++i)
+            threads[i].join();
+
+        distribution_bundle_storage_ptr_t bundle_storage(new distribution_bundle_storage_t);
+        min_bundle_index_ = {{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+        max_bundle_index_ = {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+        for (const auto &k : kept) {
+            distribution_bundle_t b;
+            for (std::size_t i = 0 ; i < 4 ; ++i)
+                b[i] = storage[i]->get(toStorageIndex(k.first, i));
+            bundle_storage->insert(k.first, b);
+            updateIndices(k.first);
+        }
+
+        storage_        = storage;
+        bundle_storage_ = bundle_storage;
+        return removed;
+    }
+
+    /**
+     * @brief Remove all bundles outside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the number of removed bundles
+     */
+    inline std::size_t evictOutside(const index_t &min_bi,
+                                    const index_t &max_bi)
+    {
+        return prune([&min_bi, &max_bi](const index_t &bi, const distribution_bundle_t &) {
+            return !cslibs_ndt::box::contains(bi, min_bi, max_bi);
+        });
+    }
+
     inline void getBundleIndices(std::vector<index_t> &indices) const
     {
         auto add_index = [&indices](const index_t &i, const distribution_bundle_t &) {
@@ -321,6 +672,26 @@ public:
         bundle_storage_->traverse(add_index);
     }
 
+    /**
+     * @brief Blocks of bundles changed by insertions, merges or pruning since
+     *        the last fetch, consumers of the map only need to reprocess these.
+     */
+    inline const dirty_blocks_t& getDirtyBlocks() const
+    {
+        return dirty_;
+    }
+
+    /**
+     * @brief Fetch the changed blocks and clear them, the next fetch only
+     *        reports the changes made in between.
+     */
+    inline dirty_blocks_t fetchDirtyBlocks()
+    {
+        dirty_blocks_t dirty(std::move(dirty_));
+        dirty_.clear();
+        return dirty;
+    }
+
     inline std::size_t getByteSize() const
     {
         return sizeof(*this) +
@@ -376,6 +747,8 @@ protected:
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
 
+    mutable dirty_blocks_t                          dirty_;
+
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
     {
@@ -416,8 +789,23 @@ protected:
 
     inline void updateIndices(const index_t &chunk_index) const
     {
-        min_bundle_index_ = std::min(min_bundle_index_, chunk_index);
-        max_bundle_index_ = std::max(max_bundle_index_, chunk_index);
+        /// component-wise, std::min and std::max compare arrays lexicographically
+        for (std::size_t d = 0 ; d < chunk_index.size() ; ++d) {
+            min_bundle_index_[d] = std::min(min_bundle_index_[d], chunk_index[d]);
+            max_bundle_index_[d] = std::max(max_bundle_index_[d], chunk_index[d]);
+        }
+    }
+
+    /**
+     * @brief Index of the distribution of storage i a bundle refers to.
+     */
+    inline index_t toStorageIndex(const index_t &bi,
+                                  const std::size_t i) const
+    {
+        const int s0 = static_cast<int>(i & 1ul);
+        const int s1 = static_cast<int>((i >> 1) & 1ul);
+        return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+                 cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2)}};
     }
 
     inline index_t toBundleIndex(const point_t &p_w) const
@@ -427,6 +815,8 @@ protected:
                  static_cast<int>(std::floor(p_m(1) * bundle_resolution_inv_))}};
     }
 };
+
+using Gridmap = GridmapT<double>;
 }
 }
 
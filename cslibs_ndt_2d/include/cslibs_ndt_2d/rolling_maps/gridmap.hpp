@@ -0,0 +1,410 @@
+#ifndef CSLIBS_NDT_2D_ROLLING_MAPS_GRIDMAP_HPP
+#define CSLIBS_NDT_2D_ROLLING_MAPS_GRIDMAP_HPP
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <memory>
+
+#include <cslibs_math_2d/linear/pose.hpp>
+#include <cslibs_math_2d/linear/point.hpp>
+
+#include <cslibs_ndt/common/distribution.hpp>
+#include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/rolling_array.hpp>
+#include <cslibs_ndt/common/box.hpp>
+
+#include <cslibs_math/linear/pointcloud.hpp>
+#include <cslibs_math/common/array.hpp>
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/common/mod.hpp>
+
+namespace cslibs_ndt_2d {
+namespace rolling_maps {
+/**
+ * @brief Robot-centric map covering a fixed window around a moving center.
+ *        Bundles and distributions live in wrap-around indexed dense arrays,
+ *        moving the window only resets the slices which enter it, so that
+ *        memory and lookup cost stay constant.
+ */
+template <typename T = double>
+class EIGEN_ALIGN16 GridmapT
+{
+public:
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using allocator_t = Eigen::aligned_allocator<GridmapT>;
+
+    using Ptr                               = std::shared_ptr<GridmapT>;
+    using ConstPtr                          = std::shared_ptr<const GridmapT>;
+    using pose_t                            = cslibs_math_2d::Pose2d;
+    using transform_t                       = cslibs_math_2d::Transform2d;
+    using point_t                           = cslibs_math_2d::Point2d;
+    using index_t                           = std::array<int, 2>;
+    using size_t                            = std::array<std::size_t, 2>;
+    using size_m_t                          = std::array<double, 2>;
+    using distribution_t                    = cslibs_ndt::Distribution<2, T>;
+    using distribution_storage_t            = cslibs_ndt::RollingArray<distribution_t, 2>;
+    using distribution_storage_array_t      = std::array<distribution_storage_t, 4>;
+    using distribution_bundle_t             = cslibs_ndt::Bundle<distribution_t*, 4>;
+    using distribution_const_bundle_t       = cslibs_ndt::Bundle<const distribution_t*, 4>;
+    using distribution_bundle_storage_t     = cslibs_ndt::RollingArray<distribution_bundle_t, 2>;
+
+    /**
+     * @brief Create a rolling map.
+     * @param origin        origin of the map frame
+     * @param resolution    distribution resolution
+     * @param size          window size in distributions per dimension
+     * @param center        initial window center in world coordinates
+     */
+    inline GridmapT(const pose_t  &origin,
+                    const double   resolution,
+                    const size_t  &size,
+                    const point_t &center = point_t()) :
+        resolution_(resolution),
+        bundle_resolution_(0.5 * resolution_),
+        bundle_resolution_inv_(1.0 / bundle_resolution_),
+        w_T_m_(origin),
+        m_T_w_(w_T_m_.inverse()),
+        size_(size),
+        size_m_{{size[0] * resolution,
+                 size[1] * resolution}},
+        storage_{{distribution_storage_t(size_t{{size[0] + 1, size[1] + 1}}),
+                 distribution_storage_t(size_t{{size[0] + 1, size[1] + 1}}),
+                 distribution_storage_t(size_t{{size[0] + 1, size[1] + 1}}),
+                 distribution_storage_t(size_t{{size[0] + 1, size[1] + 1}})}},
+        bundle_storage_(size_t{{size[0] * 2, size[1] * 2}})
+    {
+        windowAt(toBundleIndex(center), min_bundle_index_, max_bundle_index_);
+        distribution_bundle_storage_t::forEach(min_bundle_index_, max_bundle_index_, [this](const index_t &bi) {
+            bundle_storage_.at(bi).data().fill(nullptr);
+        });
+    }
+
+    /// bundles point into the map's own arrays
+    GridmapT(const GridmapT &other) = delete;
+    GridmapT& operator = (const GridmapT &other) = delete;
+
+    /**
+     * @brief Center the window at a new position, bundles and distributions
+     *        leaving the window are dropped.
+     * @param center    window center in world coordinates
+     */
+    inline void moveTo(const point_t &center)
+    {
+        index_t min_bi, max_bi;
+        windowAt(toBundleIndex(center), min_bi, max_bi);
+        if (min_bi == min_bundle_index_)
+            return;
+
+        distribution_bundle_storage_t::forEachEntering(min_bundle_index_, max_bundle_index_, min_bi, max_bi,
+                                                      [this](const index_t &bi) {
+            bundle_storage_.at(bi).data().fill(nullptr);
+        });
+        for (std::size_t s = 0 ; s < 4 ; ++s) {
+            index_t prev_lo, prev_hi, lo, hi;
+            storageRange(s, min_bundle_index_, max_bundle_index_, prev_lo, prev_hi);
+            storageRange(s, min_bi, max_bi, lo, hi);
+            distribution_storage_t &storage = storage_[s];
+            distribution_storage_t::forEachEntering(prev_lo, prev_hi, lo, hi, [&storage](const index_t &i) {
+                storage.at(i) = distribution_t();
+            });
+        }
+
+        min_bundle_index_ = min_bi;
+        max_bundle_index_ = max_bi;
+    }
+
+    /**
+     * @brief Get minimum of the window in map coordinates.
+     * @return the minimum
+     */
+    inline point_t getMin() const
+    {
+        return point_t(min_bundle_index_[0] * bundle_resolution_,
+                       min_bundle_index_[1] * bundle_resolution_);
+    }
+
+    /**
+     * @brief Get maximum of the window in map coordinates.
+     * @return the maximum
+     */
+    inline point_t getMax() const
+    {
+        return point_t((max_bundle_index_[0] + 1) * bundle_resolution_,
+                       (max_bundle_index_[1] + 1) * bundle_resolution_);
+    }
+
+    /**
+     * @brief Get the origin of the window.
+     * @return the origin
+     */
+    inline pose_t getOrigin() const
+    {
+        pose_t origin = w_T_m_;
+        origin.translation() = getMin();
+        return origin;
+    }
+
+    /**
+     * @brief Get the origin of the map frame.
+     * @return the initial origin
+     */
+    inline pose_t getInitialOrigin() const
+    {
+        return w_T_m_;
+    }
+
+    inline void insert(const point_t &p)
+    {
+        const index_t bi = toBundleIndex(p);
+        distribution_bundle_t *bundle = getAllocate(bi);
+        if (!bundle)
+            return;
+
+        bundle->at(0)->data().add(p);
+        bundle->at(1)->data().add(p);
+        bundle->at(2)->data().add(p);
+        bundle->at(3)->data().add(p);
+    }
+
+    inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
+                       const pose_t &points_origin = pose_t())
+    {
+        insert(points->begin(), points->end(), points_origin);
+    }
+
+    template<typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
+    {
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
+            if (pm.isNormal())
+                insert(pm);
+        }
+    }
+
+    inline double sample(const point_t &p) const
+    {
+        const index_t bi = toBundleIndex(p);
+        const distribution_bundle_t *bundle = get(bi);
+        auto evaluate = [&p, &bundle]() {
+            return 0.25 * (bundle->at(0)->data().sample(p) +
+                           bundle->at(1)->data().sample(p) +
+                           bundle->at(2)->data().sample(p) +
+                           bundle->at(3)->data().sample(p));
+        };
+        return bundle ? evaluate() : 0.0;
+    }
+
+    inline double sampleNonNormalized(const point_t &p) const
+    {
+        const index_t bi = toBundleIndex(p);
+        const distribution_bundle_t *bundle = get(bi);
+        auto evaluate = [&p, &bundle]() {
+            return 0.25 * (bundle->at(0)->data().sampleNonNormalized(p) +
+                           bundle->at(1)->data().sampleNonNormalized(p) +
+                           bundle->at(2)->data().sampleNonNormalized(p) +
+                           bundle->at(3)->data().sampleNonNormalized(p));
+        };
+        return bundle ? evaluate() : 0.0;
+    }
+
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
+    inline index_t getMinBundleIndex() const
+    {
+        return min_bundle_index_;
+    }
+
+    inline index_t getMaxBundleIndex() const
+    {
+        return max_bundle_index_;
+    }
+
+    inline const distribution_bundle_t* getDistributionBundle(const point_t &p) const
+    {
+        const index_t bi = toBundleIndex(p);
+        return getAllocate(bi);
+    }
+
+    inline const distribution_bundle_t* getDistributionBundle(const index_t &bi) const
+    {
+        return getAllocate(bi);
+    }
+
+    inline distribution_bundle_t* getDistributionBundle(const index_t &bi)
+    {
+        return getAllocate(bi);
+    }
+
+    inline double getBundleResolution() const
+    {
+        return bundle_resolution_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline size_t getSize() const
+    {
+        return size_;
+    }
+
+    inline size_m_t getSizeM() const
+    {
+        return size_m_;
+    }
+
+    template <typename Fn>
+    inline void traverse(const Fn& function) const
+    {
+        traverse(min_bundle_index_, max_bundle_index_, function);
+    }
+
+    /**
+     * @brief Traverse the allocated bundles inside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        distribution_bundle_storage_t::forEach(lo, hi, [this, &function](const index_t &bi) {
+            const distribution_bundle_t &bundle = bundle_storage_.at(bi);
+            if (bundle.at(0))
+                function(bi, bundle);
+        });
+    }
+
+    inline void getBundleIndices(std::vector<index_t> &indices) const
+    {
+        auto add_index = [&indices](const index_t &i, const distribution_bundle_t &d) {
+            indices.emplace_back(i);
+        };
+        traverse(add_index);
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) +
+                bundle_storage_.byte_size() +
+                storage_[0].byte_size() +
+                storage_[1].byte_size() +
+                storage_[2].byte_size() +
+                storage_[3].byte_size();
+    }
+
+    inline virtual bool validate(const pose_t &p_w) const
+    {
+        return inWindow(toBundleIndex(p_w.translation()));
+    }
+
+protected:
+    const double                                    resolution_;
+    const double                                    bundle_resolution_;
+    const double                                    bundle_resolution_inv_;
+    const transform_t                               w_T_m_;
+    const transform_t                               m_T_w_;
+
+    const size_t                                    size_;
+    const size_m_t                                  size_m_;
+    index_t                                         min_bundle_index_;
+    index_t                                         max_bundle_index_;
+
+    mutable distribution_storage_array_t            storage_;
+    mutable distribution_bundle_storage_t           bundle_storage_;
+
+    inline bool inWindow(const index_t &bi) const
+    {
+        return (bi[0] >= min_bundle_index_[0] && bi[0] <= max_bundle_index_[0]) &&
+               (bi[1] >= min_bundle_index_[1] && bi[1] <= max_bundle_index_[1]);
+    }
+
+    inline void windowAt(const index_t &center,
+                         index_t &min_bi,
+                         index_t &max_bi) const
+    {
+        for (std::size_t d = 0 ; d < 2 ; ++d) {
+            min_bi[d] = center[d] - static_cast<int>(size_[d]);
+            max_bi[d] = min_bi[d] + static_cast<int>(size_[d] * 2) - 1;
+        }
+    }
+
+    /**
+     * @brief Range of distribution indices referenced by the bundles of a
+     *        window, storages shifted along an axis use the rounded up half
+     *        of the bundle index.
+     */
+    inline void storageRange(const std::size_t s,
+                            const index_t &min_bi,
+                            const index_t &max_bi,
+                            index_t &lo,
+                            index_t &hi) const
+    {
+        for (std::size_t d = 0 ; d < 2 ; ++d) {
+            const int shift = static_cast<int>((s >> d) & 1ul);
+            lo[d] = cslibs_math::common::div<int>(min_bi[d] + shift, 2);
+            hi[d] = cslibs_math::common::div<int>(max_bi[d] + shift, 2);
+        }
+    }
+
+    inline distribution_bundle_t* get(const index_t &bi) const
+    {
+        if (!inWindow(bi))
+            return nullptr;
+
+        distribution_bundle_t &bundle = bundle_storage_.at(bi);
+        return bundle.at(0) ? &bundle : nullptr;
+    }
+
+    inline distribution_bundle_t* getAllocate(const index_t &bi) const
+    {
+        if (!inWindow(bi))
+            return nullptr;
+
+        distribution_bundle_t &bundle = bundle_storage_.at(bi);
+        if (!bundle.at(0)) {
+            const int divx = cslibs_math::common::div<int>(bi[0], 2);
+            const int divy = cslibs_math::common::div<int>(bi[1], 2);
+            const int modx = cslibs_math::common::mod<int>(bi[0], 2);
+            const int mody = cslibs_math::common::mod<int>(bi[1], 2);
+
+            const index_t storage_0_index = {{divx,        divy}};
+            const index_t storage_1_index = {{divx + modx, divy}};
+            const index_t storage_2_index = {{divx,        divy + mody}};
+            const index_t storage_3_index = {{divx + modx, divy + mody}};
+
+            bundle[0] = &storage_[0].at(storage_0_index);
+            bundle[1] = &storage_[1].at(storage_1_index);
+            bundle[2] = &storage_[2].at(storage_2_index);
+            bundle[3] = &storage_[3].at(storage_3_index);
+        }
+        return &bundle;
+    }
+
+    inline index_t toBundleIndex(const point_t &p_w) const
+    {
+        const point_t p_m = m_T_w_ * p_w;
+        return {{static_cast<int>(std::floor(p_m(0) * bundle_resolution_inv_)),
+                 static_cast<int>(std::floor(p_m(1) * bundle_resolution_inv_))}};
+    }
+};
+
+using Gridmap = GridmapT<double>;
+}
+}
+
+#endif // CSLIBS_NDT_2D_ROLLING_MAPS_GRIDMAP_HPP
@@ -17,14 +17,15 @@
 
 namespace cslibs_ndt_2d {
 namespace dynamic_maps {
-inline bool saveBinary(const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &map,
+template <typename T>
+inline bool saveBinary(const std::shared_ptr<cslibs_ndt_2d::dynamic_maps::GridmapT<T>> &map,
                        const std::string &path)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 4>;
-    using index_t    = cslibs_ndt_2d::dynamic_maps::Gridmap::index_t;
-    using storages_t = cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_storage_array_t;
-    using binary_t   = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2>;
+    using index_t    = typename cslibs_ndt_2d::dynamic_maps::GridmapT<T>::index_t;
+    using storages_t = typename cslibs_ndt_2d::dynamic_maps::GridmapT<T>::distribution_storage_array_t;
+    using binary_t   = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2, T>;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -72,15 +73,16 @@ inline bool saveBinary(const cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &map,
     return success;
 }
 
+template <typename T>
 inline bool loadBinary(const std::string &path,
-                       cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &map)
+                       std::shared_ptr<cslibs_ndt_2d::dynamic_maps::GridmapT<T>> &map)
 {
     using path_t           = boost::filesystem::path;
     using paths_t          = std::array<path_t, 4>;
-    using index_t          = cslibs_ndt_2d::dynamic_maps::Gridmap::index_t;
-    using binary_t         = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2>;
-    using bundle_storage_t = cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_bundle_storage_t;
-    using storages_t       = cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_storage_array_t;
+    using index_t          = typename cslibs_ndt_2d::dynamic_maps::GridmapT<T>::index_t;
+    using binary_t         = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2, T>;
+    using bundle_storage_t = typename cslibs_ndt_2d::dynamic_maps::GridmapT<T>::distribution_bundle_storage_t;
+    using storages_t       = typename cslibs_ndt_2d::dynamic_maps::GridmapT<T>::distribution_storage_array_t;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -124,7 +126,7 @@ inline bool loadBinary(const std::string &path,
         return false;
 
     auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_2d::dynamic_maps::Gridmap::distribution_bundle_t b;
+        typename cslibs_ndt_2d::dynamic_maps::GridmapT<T>::distribution_bundle_t b;
         const int divx = cslibs_math::common::div<int>(bi[0], 2);
         const int divy = cslibs_math::common::div<int>(bi[1], 2);
         const int modx = cslibs_math::common::mod<int>(bi[0], 2);
@@ -144,12 +146,12 @@ inline bool loadBinary(const std::string &path,
     for(const index_t &index : indices)
         allocate_bundle(index);
 
-    map.reset(new cslibs_ndt_2d::dynamic_maps::Gridmap(origin,
-                                                       resolution,
-                                                       min_index,
-                                                       max_index,
-                                                       bundles,
-                                                       storages));
+    map.reset(new cslibs_ndt_2d::dynamic_maps::GridmapT<T>(origin,
+                                                          resolution,
+                                                          min_index,
+                                                          max_index,
+                                                          bundles,
+                                                          storages));
 
     return true;
 }
@@ -17,14 +17,15 @@
 
 namespace cslibs_ndt_2d {
 namespace static_maps {
-inline bool saveBinary(const cslibs_ndt_2d::static_maps::Gridmap::Ptr &map,
+template <typename T>
+inline bool saveBinary(const std::shared_ptr<cslibs_ndt_2d::static_maps::GridmapT<T>> &map,
                        const std::string &path)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 4>;
-    using index_t    = cslibs_ndt_2d::static_maps::Gridmap::index_t;
-    using storages_t = cslibs_ndt_2d::static_maps::Gridmap::distribution_storage_array_t;
-    using binary_t   = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2>;
+    using index_t    = typename cslibs_ndt_2d::static_maps::GridmapT<T>::index_t;
+    using storages_t = typename cslibs_ndt_2d::static_maps::GridmapT<T>::distribution_storage_array_t;
+    using binary_t   = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2, T>;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -72,16 +73,17 @@ inline bool saveBinary(const cslibs_ndt_2d::static_maps::Gridmap::Ptr &map,
     return success;
 }
 
+template <typename T>
 inline bool loadBinary(const std::string &path,
-                       cslibs_ndt_2d::static_maps::Gridmap::Ptr &map)
+                       std::shared_ptr<cslibs_ndt_2d::static_maps::GridmapT<T>> &map)
 {
     using path_t           = boost::filesystem::path;
     using paths_t          = std::array<path_t, 4>;
-    using index_t          = cslibs_ndt_2d::static_maps::Gridmap::index_t;
-    using size_t           = cslibs_ndt_2d::static_maps::Gridmap::size_t;
-    using binary_t         = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2>;
-    using bundle_storage_t = cslibs_ndt_2d::static_maps::Gridmap::distribution_bundle_storage_t;
-    using storages_t       = cslibs_ndt_2d::static_maps::Gridmap::distribution_storage_array_t;
+    using index_t          = typename cslibs_ndt_2d::static_maps::GridmapT<T>::index_t;
+    using size_t           = typename cslibs_ndt_2d::static_maps::GridmapT<T>::size_t;
+    using binary_t         = cslibs_ndt::binary<cslibs_ndt::Distribution, 2, 2, T>;
+    using bundle_storage_t = typename cslibs_ndt_2d::static_maps::GridmapT<T>::distribution_bundle_storage_t;
+    using storages_t       = typename cslibs_ndt_2d::static_maps::GridmapT<T>::distribution_storage_array_t;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -132,7 +134,7 @@ inline bool loadBinary(const std::string &path,
         return false;
 
     auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_2d::static_maps::Gridmap::distribution_bundle_t b;
+        typename cslibs_ndt_2d::static_maps::GridmapT<T>::distribution_bundle_t b;
         const int divx = cslibs_math::common::div<int>(bi[0], 2);
         const int divy = cslibs_math::common::div<int>(bi[1], 2);
         const int modx = cslibs_math::common::mod<int>(bi[0], 2);
@@ -152,12 +154,12 @@ inline bool loadBinary(const std::string &path,
     for(const index_t &index : indices)
         allocate_bundle(index);
 
-    map.reset(new cslibs_ndt_2d::static_maps::Gridmap(origin,
-                                                      resolution,
-                                                      size,
-                                                      bundles,
-                                                      storages,
-                                                      min_index));
+    map.reset(new cslibs_ndt_2d::static_maps::GridmapT<T>(origin,
+                                                         resolution,
+                                                         size,
+                                                         bundles,
+                                                         storages,
+                                                         min_index));
 
     return true;
 }
@@ -17,14 +17,15 @@
 
 namespace cslibs_ndt_2d {
 namespace static_maps {
-inline bool saveBinary(const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &map,
+template <typename T>
+inline bool saveBinary(const std::shared_ptr<cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>> &map,
                        const std::string &path)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 4>;
-    using index_t    = cslibs_ndt_2d::static_maps::OccupancyGridmap::index_t;
-    using storages_t = cslibs_ndt_2d::static_maps::OccupancyGridmap::distribution_storage_array_t;
-    using binary_t   = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 2, 2>;
+    using index_t    = typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::index_t;
+    using storages_t = typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::distribution_storage_array_t;
+    using binary_t   = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 2, 2, T>;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -51,6 +52,9 @@ inline bool saveBinary(const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &
         n["size"]       = map->getSize();
         n["min_index"]  = map->getMinBundleIndex();
         n["bundles"]    = indices;
+        n["version"]    = cslibs_ndt::occupancy_format_version;
+        n["time"]       = map->getTime();
+        n["decay"]      = map->getDecay();
         yaml << n;
     }
 
@@ -72,16 +76,17 @@ inline bool saveBinary(const cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &
     return success;
 }
 
+template <typename T>
 inline bool loadBinary(const std::string &path,
-                       cslibs_ndt_2d::static_maps::OccupancyGridmap::Ptr &map)
+                       std::shared_ptr<cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>> &map)
 {
     using path_t           = boost::filesystem::path;
     using paths_t          = std::array<path_t, 4>;
-    using index_t          = cslibs_ndt_2d::static_maps::OccupancyGridmap::index_t;
-    using size_t           = cslibs_ndt_2d::static_maps::OccupancyGridmap::size_t;
-    using binary_t         = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 2, 2>;
-    using bundle_storage_t = cslibs_ndt_2d::static_maps::OccupancyGridmap::distribution_bundle_storage_t;
-    using storages_t       = cslibs_ndt_2d::static_maps::OccupancyGridmap::distribution_storage_array_t;
+    using index_t          = typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::index_t;
+    using size_t           = typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::size_t;
+    using binary_t         = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 2, 2, T>;
+    using bundle_storage_t = typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::distribution_bundle_storage_t;
+    using storages_t       = typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::distribution_storage_array_t;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -110,6 +115,10 @@ inline bool loadBinary(const std::string &path,
     const double                      resolution = n["resolution"].as<double>();
     const size_t                      size       = n["size"].as<size_t>();
     const std::vector<index_t>        indices    = n["bundles"].as<std::vector<index_t>>();
+    /// maps saved before the decay was persisted have no version
+    const std::size_t                 version    = n["version"] ? n["version"].as<std::size_t>() : 1ul;
+    const double                      time       = n["time"]    ? n["time"].as<double>()         : 0.0;
+    const double                      decay      = n["decay"]   ? n["decay"].as<double>()        : 0.0;
     const index_t                     min_index  = n["min_index"].as<index_t>();
 
     bundles->template set<cslibs_indexed_storage::option::tags::array_size>(size[0] * 2, size[1] * 2);
@@ -121,8 +130,8 @@ inline bool loadBinary(const std::string &path,
     for (std::size_t i = 0 ; i < 4 ; ++i) {
         const int off   = (i > 1) ? 1 : 0;
         const size_t sz = {{size[0] + off, size[1] + off}};
-        threads[i] = std::thread([&storages, &paths, i, &sz, &os, &success](){
-            success = success && binary_t::load(paths[i], storages[i], sz, os);
+        threads[i] = std::thread([&storages, &paths, i, &sz, &os, version, &success](){
+            success = success && binary_t::load(paths[i], storages[i], sz, os, version);
         });
     }
     for (std::size_t i = 0 ; i < 4 ; ++i)
@@ -132,7 +141,7 @@ inline bool loadBinary(const std::string &path,
         return false;
 
     auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_2d::static_maps::OccupancyGridmap::distribution_bundle_t b;
+        typename cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>::distribution_bundle_t b;
         const int divx = cslibs_math::common::div<int>(bi[0], 2);
         const int divy = cslibs_math::common::div<int>(bi[1], 2);
         const int modx = cslibs_math::common::mod<int>(bi[0], 2);
@@ -152,12 +161,14 @@ inline bool loadBinary(const std::string &path,
     for(const index_t &index : indices)
         allocate_bundle(index);
 
-    map.reset(new cslibs_ndt_2d::static_maps::OccupancyGridmap(origin,
-                                                               resolution,
-                                                               size,
-                                                               bundles,
-                                                               storages,
-                                                               min_index));
+    map.reset(new cslibs_ndt_2d::static_maps::OccupancyGridmapT<T>(origin,
+                                                                  resolution,
+                                                                  size,
+                                                                  bundles,
+                                                                  storages,
+                                                                  min_index));
+    map->setTime(time);
+    map->setDecay(decay);
 
     return true;
 }
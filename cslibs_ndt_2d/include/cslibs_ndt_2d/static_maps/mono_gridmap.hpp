@@ -224,6 +224,20 @@ public:
         return getAllocate(i);
     }
 
+    /**
+     * @brief Look up the distribution of a cell without allocating it.
+     * @param i     index of the cell
+     * @return      the distribution, nullptr if it is not allocated or the
+     *              cell lies outside the map
+     */
+    inline const distribution_t* lookupDistribution(const index_t &i) const
+    {
+        for (std::size_t d = 0 ; d < 2 ; ++d)
+            if (i[d] < min_index_[d] || i[d] >= min_index_[d] + static_cast<int>(size_[d]))
+                return nullptr;
+        return storage_->get(i);
+    }
+
     inline double getResolution() const
     {
         return resolution_;
@@ -11,6 +11,11 @@
 
 #include <cslibs_ndt/common/occupancy_distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/insert_batch.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/box.hpp>
+
+#include <cslibs_ndt_2d/common/laser_scan.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -29,25 +34,28 @@ namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt_2d {
 namespace static_maps {
-class EIGEN_ALIGN16 OccupancyGridmap
+template <typename T = double>
+class EIGEN_ALIGN16 OccupancyGridmapT
 {
 public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    using allocator_t = Eigen::aligned_allocator<Gridmap>;
+    using allocator_t = Eigen::aligned_allocator<OccupancyGridmapT>;
 
-    using ConstPtr                          = std::shared_ptr<const OccupancyGridmap>;
-    using Ptr                               = std::shared_ptr<OccupancyGridmap>;
+    using ConstPtr                          = std::shared_ptr<const OccupancyGridmapT>;
+    using Ptr                               = std::shared_ptr<OccupancyGridmapT>;
     using pose_t                            = cslibs_math_2d::Pose2d;
     using transform_t                       = cslibs_math_2d::Transform2d;
     using point_t                           = cslibs_math_2d::Point2d;
+    using batch_t                           = cslibs_ndt::InsertBatch<point_t, pose_t>;
+    using scan_t                            = cslibs_ndt_2d::LaserScan;
     using index_t                           = std::array<int, 2>;
     using size_t                            = std::array<std::size_t, 2>;
     using size_m_t                          = std::array<double, 2>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
-    using distribution_t                    = cslibs_ndt::OccupancyDistribution<2>;
+    using distribution_t                    = cslibs_ndt::OccupancyDistribution<2, T>;
     using distribution_storage_t            = cis::Storage<distribution_t, index_t, cis::backend::array::Array>;
     using distribution_storage_ptr_t        = std::shared_ptr<distribution_storage_t>;
     using distribution_storage_array_t      = std::array<distribution_storage_ptr_t, 4>;
@@ -58,10 +66,10 @@ public:
     using simple_iterator_t                 = cslibs_math_2d::algorithms::SimpleIterator;
     using inverse_sensor_model_t            = cslibs_gridmaps::utility::InverseModel;
 
-    inline OccupancyGridmap(const pose_t &origin,
-                            const double &resolution,
-                            const size_t &size,
-                            const index_t &min_bundle_index) :
+    inline OccupancyGridmapT(const pose_t &origin,
+                             const double &resolution,
+                             const size_t &size,
+                             const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -77,7 +85,9 @@ public:
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t)}},
-        bundle_storage_(new distribution_bundle_storage_t)
+        bundle_storage_(new distribution_bundle_storage_t),
+        time_(0.0),
+        decay_(0.0)
     {
         storage_[0]->template set<cis::option::tags::array_size>(size[0], size[1]);
         storage_[0]->template set<cis::option::tags::array_offset>(min_bundle_index[0] / 2,
@@ -93,12 +103,12 @@ public:
                 min_bundle_index[1]);
     }
 
-    inline OccupancyGridmap(const double &origin_x,
-                            const double &origin_y,
-                            const double &origin_phi,
-                            const double &resolution,
-                            const size_t &size,
-                            const index_t &min_bundle_index) :
+    inline OccupancyGridmapT(const double &origin_x,
+                             const double &origin_y,
+                             const double &origin_phi,
+                             const double &resolution,
+                             const size_t &size,
+                             const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -114,7 +124,9 @@ public:
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t)}},
-        bundle_storage_(new distribution_bundle_storage_t)
+        bundle_storage_(new distribution_bundle_storage_t),
+        time_(0.0),
+        decay_(0.0)
     {
         storage_[0]->template set<cis::option::tags::array_size>(size[0], size[1]);
         storage_[0]->template set<cis::option::tags::array_offset>(min_bundle_index[0] / 2,
@@ -130,12 +142,12 @@ public:
                 min_bundle_index[1]);
     }
 
-    inline OccupancyGridmap(const pose_t &origin,
-                            const double &resolution,
-                            const size_t &size,
-                            const std::shared_ptr<distribution_bundle_storage_t> &bundles,
-                            const distribution_storage_array_t                   &storage,
-                            const index_t &min_bundle_index) :
+    inline OccupancyGridmapT(const pose_t &origin,
+                             const double &resolution,
+                             const size_t &size,
+                             const std::shared_ptr<distribution_bundle_storage_t> &bundles,
+                             const distribution_storage_array_t                   &storage,
+                             const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -148,11 +160,13 @@ public:
         max_bundle_index_{{min_bundle_index[0] + static_cast<int>(size[0] * 2),
         min_bundle_index[1] + static_cast<int>(size[1] * 2)}},
         storage_(storage),
-        bundle_storage_(bundles)
+        bundle_storage_(bundles),
+        time_(0.0),
+        decay_(0.0)
     {
     }
 
-    inline OccupancyGridmap(const OccupancyGridmap &other) :
+    inline OccupancyGridmapT(const OccupancyGridmapT &other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -166,11 +180,13 @@ public:
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[1])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[2])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[3]))}},
-        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_))
+        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_)),
+        time_(other.time_),
+        decay_(other.decay_)
     {
     }
 
-    inline OccupancyGridmap(OccupancyGridmap &&other) :
+    inline OccupancyGridmapT(OccupancyGridmapT &&other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -181,7 +197,9 @@ public:
         min_bundle_index_(other.min_bundle_index_),
         max_bundle_index_(other.max_bundle_index_),
         storage_(other.storage_),
-        bundle_storage_(other.bundle_storage_)
+        bundle_storage_(other.bundle_storage_),
+        time_(other.time_),
+        decay_(other.decay_)
     {
     }
 
@@ -274,6 +292,129 @@ public:
         });
     }
 
+    /**
+     * @brief Insert the clouds of several sensors. Occupied moments and free
+     *        space counts of all rays are accumulated first, so that every
+     *        bundle is updated once, no matter how many sensors observe it.
+     * @param batch     clouds and sensor poses
+     */
+    template <typename line_iterator_t = simple_iterator_t>
+    inline void insert(const batch_t &batch)
+    {
+        distribution_storage_t accumulated;
+        accumulated.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2);
+        accumulated.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
+                                                                  min_bundle_index_[1]);
+
+        auto get_allocate = [&accumulated](const index_t &bi) {
+            distribution_t *d = accumulated.get(bi);
+            return d ? d : &accumulated.insert(bi, distribution_t());
+        };
+
+        for (const auto &entry : batch) {
+            const pose_t &points_origin = entry.second;
+            distribution_storage_t storage;
+            storage.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2);
+            storage.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
+                                                                  min_bundle_index_[1]);
+
+            for (const auto &p : *(entry.first)) {
+                const point_t pm = points_origin * p;
+                if (!pm.isNormal())
+                    continue;
+                index_t bi;
+                if (!toBundleIndex(pm, bi))
+                    continue;
+                distribution_t *d = storage.get(bi);
+                (d ? d : &storage.insert(bi, distribution_t()))->updateOccupied(pm);
+            }
+
+            const point_t start_p = m_T_w_ * points_origin.translation();
+            storage.traverse([this, &start_p, &get_allocate](const index_t& bi, const distribution_t &d) {
+                if (!d.getDistribution())
+                    return;
+                get_allocate(bi)->updateOccupied(d.getDistribution());
+
+                line_iterator_t it(start_p, m_T_w_ * point_t(d.getDistribution()->getMean()), bundle_resolution_);
+                const std::size_t n = d.numOccupied();
+                while (!it.done()) {
+                    const index_t bit = {{it.x(), it.y()}};
+                    if (valid(bit))
+                        get_allocate(bit)->updateFree(n);
+                    ++ it;
+                }
+            });
+        }
+
+        accumulated.traverse([this](const index_t& bi, const distribution_t &d) {
+            if (d.numFree() > 0)
+                updateFree(bi, d.numFree());
+            if (d.getDistribution())
+                updateOccupied(bi, d.getDistribution());
+        });
+    }
+
+    /**
+     * @brief Insert a planar range scan. The beam directions of the scan are
+     *        rotated into the world frame once per beam, readings at maximum
+     *        range only clear the free space along their ray. Free space
+     *        counts of all rays are aggregated per bundle, so that every
+     *        bundle is updated once.
+     * @param scan          the range scan
+     * @param scan_origin   sensor pose in the world frame
+     */
+    template <typename line_iterator_t = simple_iterator_t>
+    inline void insert(const scan_t &scan,
+                       const pose_t &scan_origin = pose_t())
+    {
+        const double   c = scan_origin.cos();
+        const double   s = scan_origin.sin();
+        const point_t &t = scan_origin.translation();
+        auto to_world = [c, s, &t](const point_t &d, const double r) {
+            return point_t(t(0) + r * (c * d(0) - s * d(1)),
+                           t(1) + r * (s * d(0) + c * d(1)));
+        };
+
+        distribution_storage_t storage;
+        storage.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2);
+        storage.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
+                min_bundle_index_[1]);
+        std::unordered_map<index_t, std::size_t, cslibs_ndt::parallel::IndexHash<index_t>> free;
+        const point_t start_p = m_T_w_ * t;
+        auto clear = [this, &start_p, &free](const point_t &end_p, const std::size_t n) {
+            line_iterator_t it(start_p, m_T_w_ * end_p, bundle_resolution_);
+            while (!it.done()) {
+                free[{{it.x(), it.y()}}] += n;
+                ++ it;
+            }
+        };
+
+        const LaserScan::ranges_t &ranges = scan.getRanges();
+        for (std::size_t i = 0 ; i < scan.size() ; ++i) {
+            const float r = ranges[i];
+            if (scan.isValid(r)) {
+                const point_t pm = to_world(scan.getDirection(i), r);
+                index_t bi;
+                if (toBundleIndex(pm, bi)) {
+                    distribution_t *d = storage.get(bi);
+                    (d ? d : &storage.insert(bi, distribution_t()))->updateOccupied(pm);
+                }
+            } else if (scan.isMaxRange(r)) {
+                clear(to_world(scan.getDirection(i), scan.getRangeMax()), 1);
+            }
+        }
+
+        storage.traverse([this, &clear](const index_t& bi, const distribution_t &d) {
+            if (!d.getDistribution())
+                return;
+            updateOccupied(bi, d.getDistribution());
+            clear(point_t(d.getDistribution()->getMean()), d.numOccupied());
+        });
+
+        for (const auto &f : free)
+            updateFree(f.first, f.second);
+    }
+
     template <typename line_iterator_t = simple_iterator_t>
     inline void insertVisible(const pose_t &origin,
                               const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
@@ -289,10 +430,10 @@ public:
 
         auto occupancy = [this, &ivm](const index_t &bi) {
             distribution_bundle_t *bundle = getAllocate(bi);
-            return 0.25 * (bundle->at(0)->getOccupancy(ivm) +
-                           bundle->at(1)->getOccupancy(ivm) +
-                           bundle->at(2)->getOccupancy(ivm) +
-                           bundle->at(3)->getOccupancy(ivm));
+            return 0.25 * (bundle->at(0)->getOccupancy(ivm, time_, decay_) +
+                           bundle->at(1)->getOccupancy(ivm, time_, decay_) +
+                           bundle->at(2)->getOccupancy(ivm, time_, decay_) +
+                           bundle->at(3)->getOccupancy(ivm, time_, decay_));
         };
         auto current_visibility = [this, &start_bi, &ivm_visibility, &occupancy](const index_t &bi) {
             const double occlusion_prob =
@@ -359,11 +500,11 @@ public:
 
         distribution_bundle_t *bundle = bundle_storage_->get(bi);
 
-        auto sample = [&p, &ivm] (const distribution_t *d) {
-            auto do_sample = [&p, &ivm, &d]() {
+        auto sample = [this, &p, &ivm] (const distribution_t *d) {
+            auto do_sample = [this, &p, &ivm, &d]() {
                 const auto &handle = d;
                 return handle->getDistribution() ?
-                            handle->getDistribution()->sample(p) * handle->getOccupancy(ivm) : 0.0;
+                            handle->getDistribution()->sample(p) * handle->getOccupancy(ivm, time_, decay_) : 0.0;
             };
             return d ? do_sample() : 0.0;
         };
@@ -394,11 +535,11 @@ public:
 
         distribution_bundle_t *bundle = bundle_storage_->get(bi);
 
-        auto sample = [&p, &ivm] (const distribution_t *d) {
-            auto do_sample = [&p, &ivm, &d]() {
+        auto sample = [this, &p, &ivm] (const distribution_t *d) {
+            auto do_sample = [this, &p, &ivm, &d]() {
                 const auto &handle = d;
                 return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm) : 0.0;
+                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm, time_, decay_) : 0.0;
             };
             return d ? do_sample() : 0.0;
         };
@@ -421,6 +562,61 @@ public:
         return valid(bi) ? getAllocate(bi) : nullptr;
     }
 
+    /**
+     * @brief Look up the distributions of a bundle without allocating it.
+     *        Neighbours of populated bundles share distributions with them,
+     *        so they can be sampled without allocatePartiallyAllocatedBundles,
+     *        which leaves the map unchanged and safe to read concurrently.
+     * @param bi        bundle index, the bundle does not need to exist
+     * @param bundle    the distributions, nullptr if not allocated
+     * @return true if any of the distributions exists
+     */
+    inline bool lookupDistributionBundle(const index_t               &bi,
+                                         distribution_const_bundle_t &bundle) const
+    {
+        if (!valid(bi))
+            return false;
+
+        bool found = false;
+        for (std::size_t i = 0 ; i < 4 ; ++i) {
+            bundle[i] = storage_[i]->get(toStorageIndex(bi, i));
+            found    |= bundle[i] != nullptr;
+        }
+        return found;
+    }
+
+    /**
+     * @brief Enable exponential forgetting for changing environments. The free
+     *        counts and moments of a cell are weighted down by exp(-dt / decay)
+     *        for the time dt passed since it was last touched. This is applied
+     *        lazily, when the cell is updated or read, there is no global pass.
+     * @param decay     time constant, zero disables forgetting
+     */
+    inline void setDecay(const double decay)
+    {
+        decay_ = decay;
+    }
+
+    inline double getDecay() const
+    {
+        return decay_;
+    }
+
+    /**
+     * @brief Set the current time, following updates and reads decay the
+     *        cells they touch up to it.
+     * @param time      current time, must not run backwards
+     */
+    inline void setTime(const double time)
+    {
+        time_ = time;
+    }
+
+    inline double getTime() const
+    {
+        return time_;
+    }
+
     inline double getBundleResolution() const
     {
         return bundle_resolution_;
@@ -451,6 +647,11 @@ public:
         return {{size_[0] * 2, size_[1] * 2}};
     }
 
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_bundle_index_;
@@ -472,6 +673,60 @@ public:
         return bundle_storage_->traverse(function);
     }
 
+    /**
+     * @brief Traverse the bundles inside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        for (int i = lo[0] ; i <= hi[0] ; ++i)
+            for (int j = lo[1] ; j <= hi[1] ; ++j) {
+                const index_t bi = {{i, j}};
+                if (const distribution_bundle_t *bundle = bundle_storage_->get(bi))
+                    function(bi, *bundle);
+            }
+    }
+
+    /**
+     * @brief Extract the bundles inside an axis-aligned box into a new map,
+     *        the distributions are copied together with their decay state,
+     *        the time and the decay constant of the map.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the cropped map, nullptr if the box does not intersect the map
+     */
+    inline Ptr crop(const index_t &min_bi,
+                    const index_t &max_bi) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1])
+            return nullptr;
+
+        /// the storages are aligned to even bundle indices
+        const index_t min_index = {{cslibs_math::common::div<int>(lo[0], 2) * 2,
+                                    cslibs_math::common::div<int>(lo[1], 2) * 2}};
+        const size_t  size      = {{static_cast<std::size_t>(cslibs_math::common::div<int>(hi[0], 2) - cslibs_math::common::div<int>(lo[0], 2) + 1),
+                                    static_cast<std::size_t>(cslibs_math::common::div<int>(hi[1], 2) - cslibs_math::common::div<int>(lo[1], 2) + 1)}};
+
+        Ptr dst(new OccupancyGridmapT(w_T_m_, resolution_, size, min_index));
+        dst->time_  = time_;
+        dst->decay_ = decay_;
+        traverse(lo, hi, [&dst](const index_t &bi, const distribution_bundle_t &b) {
+            distribution_bundle_t *b_dst = dst->getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < 4 ; ++i)
+                *(b_dst->at(i)) = b.at(i)->clone();
+        });
+        return dst;
+    }
+
     inline void getBundleIndices(std::vector<index_t> &indices) const
     {
         auto add_index = [&indices](const index_t &i, const distribution_bundle_t &d) {
@@ -545,6 +800,9 @@ protected:
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
 
+    double                                          time_;
+    double                                          decay_;
+
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
     {
@@ -581,12 +839,25 @@ protected:
         return get_allocate(bi);
     }
 
+    /**
+     * @brief Allocate a bundle which is about to be updated, its distributions
+     *        are decayed up to the current time first. Reads evaluate the decay
+     *        without modifying the distributions.
+     */
+    inline distribution_bundle_t *getAllocateDecayed(const index_t &bi) const
+    {
+        distribution_bundle_t *bundle = getAllocate(bi);
+        for (std::size_t i = 0 ; i < 4 ; ++i)
+            bundle->at(i)->decay(time_, decay_);
+        return bundle;
+    }
+
     inline void updateFree(const index_t &bi) const
     {
         if (!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateFree();
         bundle->at(1)->updateFree();
         bundle->at(2)->updateFree();
@@ -599,7 +870,7 @@ protected:
         if (!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateFree(n);
         bundle->at(1)->updateFree(n);
         bundle->at(2)->updateFree(n);
@@ -612,7 +883,7 @@ protected:
         if (!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateOccupied(p);
         bundle->at(1)->updateOccupied(p);
         bundle->at(2)->updateOccupied(p);
@@ -620,18 +891,30 @@ protected:
     }
 
     inline void updateOccupied(const index_t &bi,
-                               const distribution_t::distribution_ptr_t &d) const
+                               const typename distribution_t::distribution_ptr_t &d) const
     {
         if (!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateOccupied(d);
         bundle->at(1)->updateOccupied(d);
         bundle->at(2)->updateOccupied(d);
         bundle->at(3)->updateOccupied(d);
     }
 
+    /**
+     * @brief Index of the distribution of storage i a bundle refers to.
+     */
+    inline index_t toStorageIndex(const index_t &bi,
+                                  const std::size_t i) const
+    {
+        const int s0 = static_cast<int>(i & 1ul);
+        const int s1 = static_cast<int>((i >> 1) & 1ul);
+        return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+                 cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2)}};
+    }
+
     inline index_t toBundleIndex(const point_t &p_w) const
     {
         const point_t p_m = m_T_w_ * p_w;
@@ -661,6 +944,8 @@ protected:
         p_w = w_T_m_ * point_t(i[0] * resolution_, i[1] * resolution_);
     }
 };
+
+using OccupancyGridmap = OccupancyGridmapT<double>;
 }
 }
 
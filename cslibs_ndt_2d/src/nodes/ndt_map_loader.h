@@ -28,8 +28,8 @@ private:
     cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr          map_ndt_;
     cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr map_occ_ndt_;
 
-    nav_msgs::OccupancyGrid::Ptr                       map_ndt_grid_;
-    nav_msgs::OccupancyGrid::Ptr                       map_occ_ndt_grid_;
+    nav_msgs::OccupancyGrid::Ptr                               map_ndt_grid_;
+    nav_msgs::OccupancyGrid::Ptr                               map_occ_ndt_grid_;
 
 
     bool setup();
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+using dynamic_map_t           = cslibs_ndt_2d::dynamic_maps::Gridmap;
+using dynamic_occupancy_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using static_map_t            = cslibs_ndt_2d::static_maps::Gridmap;
+using static_occupancy_map_t  = cslibs_ndt_2d::static_maps::OccupancyGridmap;
+using index_t                 = dynamic_map_t::index_t;
+using pose_t                  = dynamic_map_t::pose_t;
+using point_t                 = dynamic_map_t::point_t;
+using cloud_t                 = cslibs_math::linear::Pointcloud<point_t>;
+using batch_t                 = dynamic_map_t::batch_t;
+
+const std::size_t NUM_SENSORS = 5;
+const std::size_t NUM_CYCLES  = 10;
+const std::size_t NUM_POINTS  = 2000;
+
+std::vector<cloud_t::Ptr> generateClouds()
+{
+    /// overlapping views of the walls of a room, partly outside of the static maps
+    rng_t<1> rng_coord(-5.0, 5.0);
+    std::vector<cloud_t::Ptr> clouds;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s) {
+        cloud_t::Ptr cloud(new cloud_t);
+        for (std::size_t i = 0 ; i < NUM_POINTS ; ++ i) {
+            cloud->insert(point_t(rng_coord.get(), -4.0));
+            cloud->insert(point_t(6.0, rng_coord.get()));
+            cloud->insert(point_t(2.5 * rng_coord.get(), 8.0));
+        }
+        clouds.emplace_back(cloud);
+    }
+    return clouds;
+}
+
+/// nearby sensors, so that their rays cross the same bundles
+std::vector<pose_t> generateOrigins()
+{
+    std::vector<pose_t> origins;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+        origins.emplace_back(pose_t(0.1 * s, -0.2 * s, 0.1 * s));
+    return origins;
+}
+
+batch_t generateBatch(const std::vector<cloud_t::Ptr> &clouds,
+                      const std::vector<pose_t>       &origins)
+{
+    batch_t batch;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+        batch.add(clouds[s], origins[s]);
+    return batch;
+}
+
+template <typename map_t, typename insert_t>
+double runCycles(map_t &map,
+                 const insert_t &insert)
+{
+    duration_t total(0.0);
+    for (std::size_t c = 0 ; c < NUM_CYCLES ; ++ c) {
+        const auto start = steady_clock_t::now();
+        insert(map);
+        total += steady_clock_t::now() - start;
+    }
+    return total.count() / NUM_CYCLES;
+}
+
+/// insert sequentially and batched, print the latencies and compare the storages
+template <typename map_t, typename compare_t>
+void testBatchInsert(map_t &sequential,
+                     map_t &batched,
+                     const std::string &name,
+                     const compare_t   &compare)
+{
+    const std::vector<cloud_t::Ptr> clouds  = generateClouds();
+    const std::vector<pose_t>       origins = generateOrigins();
+    const batch_t                   batch   = generateBatch(clouds, origins);
+
+    const double t_sequential = runCycles(sequential, [&clouds, &origins](map_t &map) {
+        for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+            map.insert(clouds[s], origins[s]);
+    });
+    const double t_batched = runCycles(batched, [&batch](map_t &map) {
+        map.insert(batch);
+    });
+    std::cout << "[batch insert] " << name << ", latency per cycle: sequential " << t_sequential
+              << " ms, batched " << t_batched << " ms" << std::endl;
+
+    for (std::size_t i = 0 ; i < 4 ; ++ i) {
+        std::size_t n_sequential = 0;
+        std::size_t n_batched    = 0;
+        sequential.getStorages()[i]->traverse([&n_sequential, &batched, &compare, i](const index_t &si, const typename map_t::distribution_t &d) {
+            ++ n_sequential;
+            const typename map_t::distribution_t *d_b = batched.getStorages()[i]->get(si);
+            ASSERT_TRUE(d_b);
+            compare(d, *d_b);
+        });
+        batched.getStorages()[i]->traverse([&n_batched](const index_t &, const typename map_t::distribution_t &) {
+            ++ n_batched;
+        });
+        EXPECT_GT(n_sequential, 0ul);
+        EXPECT_EQ(n_sequential, n_batched);
+    }
+}
+
+template <typename distribution_t>
+void compareDistributions(const distribution_t &a,
+                          const distribution_t &b)
+{
+    EXPECT_EQ(a.data().getN(), b.data().getN());
+    if (a.data().getN() > 0)
+        EXPECT_NEAR((a.data().getMean() - b.data().getMean()).norm(), 0.0, 1e-6);
+}
+
+/// the free counts are the ones the rays of all sensors contribute
+template <typename distribution_t>
+void compareOccupancyDistributions(const distribution_t &a,
+                                   const distribution_t &b)
+{
+    EXPECT_EQ(a.numFree(),     b.numFree());
+    EXPECT_EQ(a.numOccupied(), b.numOccupied());
+    ASSERT_EQ(static_cast<bool>(a.getDistribution()), static_cast<bool>(b.getDistribution()));
+    if (a.getDistribution()) {
+        EXPECT_EQ(a.getDistribution()->getN(), b.getDistribution()->getN());
+        if (a.getDistribution()->getN() > 0)
+            EXPECT_NEAR((a.getDistribution()->getMean() - b.getDistribution()->getMean()).norm(), 0.0, 1e-6);
+    }
+}
+
+TEST(Test_cslibs_ndt_2d, testBatchInsertGridmap)
+{
+    dynamic_map_t sequential(pose_t(), 1.0);
+    dynamic_map_t batched(pose_t(), 1.0);
+    testBatchInsert(sequential, batched, "gridmap",
+                    compareDistributions<dynamic_map_t::distribution_t>);
+}
+
+TEST(Test_cslibs_ndt_2d, testBatchInsertOccupancyGridmap)
+{
+    dynamic_occupancy_map_t sequential(pose_t(), 1.0);
+    dynamic_occupancy_map_t batched(pose_t(), 1.0);
+    testBatchInsert(sequential, batched, "occupancy gridmap",
+                    compareOccupancyDistributions<dynamic_occupancy_map_t::distribution_t>);
+}
+
+TEST(Test_cslibs_ndt_2d, testBatchInsertStaticGridmap)
+{
+    static_map_t sequential(pose_t(), 1.0, {{24, 24}}, {{-24, -24}});
+    static_map_t batched(pose_t(), 1.0, {{24, 24}}, {{-24, -24}});
+    testBatchInsert(sequential, batched, "static gridmap",
+                    compareDistributions<static_map_t::distribution_t>);
+}
+
+TEST(Test_cslibs_ndt_2d, testBatchInsertStaticOccupancyGridmap)
+{
+    static_occupancy_map_t sequential(pose_t(), 1.0, {{24, 24}}, {{-24, -24}});
+    static_occupancy_map_t batched(pose_t(), 1.0, {{24, 24}}, {{-24, -24}});
+    testBatchInsert(sequential, batched, "static occupancy gridmap",
+                    compareOccupancyDistributions<static_occupancy_map_t::distribution_t>);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/common/box.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <algorithm>
+#include <vector>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t           = cslibs_ndt_2d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using index_t         = map_t::index_t;
+using cloud_t         = cslibs_math::linear::Pointcloud<map_t::point_t>;
+
+cloud_t::Ptr generateCloud(const std::size_t size)
+{
+    rng_t<1> rng(-10.0, 10.0);
+    cloud_t::Ptr cloud(new cloud_t);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(map_t::point_t(rng.get(), rng.get()));
+    return cloud;
+}
+
+/// boxes inside, across the border of, larger than and outside of the map,
+/// the second one is below the map in x only, which a lexicographic clamp misses
+std::vector<std::pair<index_t, index_t>> generateBoxes(const index_t &min_bi,
+                                                        const index_t &max_bi)
+{
+    return {{index_t{{min_bi[0] + 3, min_bi[1] + 2}}, index_t{{max_bi[0] - 4, max_bi[1] - 5}}},
+            {index_t{{min_bi[0] - 5, max_bi[1] - 3}}, index_t{{min_bi[0] + 6, max_bi[1] + 5}}},
+            {index_t{{min_bi[0] - 1, min_bi[1] - 1}}, index_t{{max_bi[0] + 1, max_bi[1] + 1}}},
+            {index_t{{min_bi[0] + 1, min_bi[1] + 1}}, index_t{{min_bi[0] + 2, min_bi[1] + 2}}},
+            {index_t{{max_bi[0] + 1, min_bi[1]}},     index_t{{max_bi[0] + 8, max_bi[1]}}}};
+}
+
+template <typename map_t>
+std::vector<index_t> filterTraverse(const map_t &map,
+                                    const index_t &min_bi,
+                                    const index_t &max_bi)
+{
+    std::vector<index_t> indices;
+    map.traverse([&indices, &min_bi, &max_bi](const index_t &bi, const typename map_t::distribution_bundle_t &) {
+        if (cslibs_ndt::box::contains(bi, min_bi, max_bi))
+            indices.push_back(bi);
+    });
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+template <typename map_t>
+std::vector<index_t> boxTraverse(const map_t &map,
+                                 const index_t &min_bi,
+                                 const index_t &max_bi)
+{
+    std::vector<index_t> indices;
+    map.traverse(min_bi, max_bi, [&indices](const index_t &bi, const typename map_t::distribution_bundle_t &) {
+        indices.push_back(bi);
+    });
+    std::sort(indices.begin(), indices.end());
+    return indices;
+}
+
+TEST(Test_cslibs_ndt_2d, testTraverseBox)
+{
+    map_t map(map_t::pose_t(), 0.5);
+    map.insert(generateCloud(5000));
+
+    occupancy_map_t occupancy_map(occupancy_map_t::pose_t(), 0.5);
+    occupancy_map.insert(generateCloud(500));
+
+    for (const auto &box : generateBoxes(map.getMinBundleIndex(), map.getMaxBundleIndex()))
+        EXPECT_TRUE(filterTraverse(map, box.first, box.second) ==
+                    boxTraverse(map, box.first, box.second));
+    for (const auto &box : generateBoxes(occupancy_map.getMinBundleIndex(), occupancy_map.getMaxBundleIndex()))
+        EXPECT_TRUE(filterTraverse(occupancy_map, box.first, box.second) ==
+                    boxTraverse(occupancy_map, box.first, box.second));
+}
+
+TEST(Test_cslibs_ndt_2d, testCrop)
+{
+    map_t map(map_t::pose_t(), 0.5);
+    map.insert(generateCloud(5000));
+
+    for (const auto &box : generateBoxes(map.getMinBundleIndex(), map.getMaxBundleIndex())) {
+        const std::vector<index_t> expected = filterTraverse(map, box.first, box.second);
+        const map_t::Ptr cropped = map.crop(box.first, box.second);
+        if (expected.empty()) {
+            EXPECT_FALSE(cropped);
+            continue;
+        }
+        ASSERT_TRUE(cropped);
+        EXPECT_FALSE(cropped->getDirtyBlocks().empty());
+
+        std::vector<index_t> indices;
+        cropped->traverse([&indices](const index_t &bi, const map_t::distribution_bundle_t &) {
+            indices.push_back(bi);
+        });
+        std::sort(indices.begin(), indices.end());
+        EXPECT_TRUE(expected == indices);
+
+        /// bundles at the border share distributions with bundles outside
+        /// of the box, which are copied with all of their samples
+        for (const index_t &bi : expected) {
+            const map_t::distribution_bundle_t *b     = map.getDistributionBundle(bi);
+            const map_t::distribution_bundle_t *b_dst = cropped->getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < 4 ; ++ i) {
+                EXPECT_EQ(b->at(i)->data().getN(), b_dst->at(i)->data().getN());
+                if (b->at(i)->data().getN() > 0)
+                    EXPECT_TRUE(b->at(i)->data().getMean().isApprox(b_dst->at(i)->data().getMean()));
+            }
+        }
+    }
+}
+
+TEST(Test_cslibs_ndt_2d, testCropOccupancy)
+{
+    occupancy_map_t map(occupancy_map_t::pose_t(), 0.5);
+    map.setDecay(10.0);
+    map.setTime(2.0);
+    map.insert(generateCloud(500));
+
+    for (const auto &box : generateBoxes(map.getMinBundleIndex(), map.getMaxBundleIndex())) {
+        const std::vector<index_t> expected = filterTraverse(map, box.first, box.second);
+        const occupancy_map_t::Ptr cropped = map.crop(box.first, box.second);
+        if (expected.empty()) {
+            EXPECT_FALSE(cropped);
+            continue;
+        }
+        ASSERT_TRUE(cropped);
+        EXPECT_EQ(map.getTime(),  cropped->getTime());
+        EXPECT_EQ(map.getDecay(), cropped->getDecay());
+        EXPECT_FALSE(cropped->getDirtyBlocks().empty());
+
+        std::vector<index_t> indices;
+        cropped->traverse([&indices](const index_t &bi, const occupancy_map_t::distribution_bundle_t &) {
+            indices.push_back(bi);
+        });
+        std::sort(indices.begin(), indices.end());
+        EXPECT_TRUE(expected == indices);
+
+        for (const index_t &bi : expected) {
+            const occupancy_map_t::distribution_bundle_t *b     = map.getDistributionBundle(bi);
+            const occupancy_map_t::distribution_bundle_t *b_dst = cropped->getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < 4 ; ++ i) {
+                EXPECT_EQ(b->at(i)->numFree(),     b_dst->at(i)->numFree());
+                EXPECT_EQ(b->at(i)->numOccupied(), b_dst->at(i)->numOccupied());
+                EXPECT_EQ(b->at(i)->getStamp(),    b_dst->at(i)->getStamp());
+                if (b->at(i)->getDistribution()) {
+                    ASSERT_TRUE(b_dst->at(i)->getDistribution());
+                    /// deep copies, the crop does not alias the source
+                    EXPECT_NE(b->at(i)->getDistribution().get(), b_dst->at(i)->getDistribution().get());
+                    EXPECT_TRUE(b->at(i)->getDistribution()->getMean().isApprox(b_dst->at(i)->getDistribution()->getMean()));
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
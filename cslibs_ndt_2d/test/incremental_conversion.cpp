@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/conversion/probability_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/distance_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/likelihood_field_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/binary_gridmap.hpp>
+
+#include <cslibs_math_2d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t           = cslibs_ndt_2d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using probability_t   = cslibs_gridmaps::static_maps::ProbabilityGridmap;
+using distance_t      = cslibs_gridmaps::static_maps::DistanceGridmap;
+using likelihood_t    = cslibs_gridmaps::static_maps::LikelihoodFieldGridmap;
+using binary_t        = cslibs_gridmaps::static_maps::BinaryGridmap;
+using ivm_t           = cslibs_gridmaps::utility::InverseModel;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION          = 1.0;
+const double SAMPLING_RESOLUTION = 0.05;
+
+/// walls of a square room
+cslibs_math_2d::Pointcloud2d::Ptr generateRoom(const double x,
+                                               const double y,
+                                               const double size,
+                                               const std::size_t points)
+{
+    rng_t<1> rng(0.0, size);
+    rng_t<1> rng_noise(-0.05, 0.05);
+    cslibs_math_2d::Pointcloud2d::Ptr cloud(new cslibs_math_2d::Pointcloud2d);
+    for (std::size_t i = 0 ; i < points ; ++ i) {
+        const double s = rng.get();
+        const double n = rng_noise.get();
+        switch (i % 4) {
+        case 0: cloud->insert(cslibs_math_2d::Point2d(x + s,        y + n));        break;
+        case 1: cloud->insert(cslibs_math_2d::Point2d(x + s,        y + size + n)); break;
+        case 2: cloud->insert(cslibs_math_2d::Point2d(x + n,        y + s));        break;
+        case 3: cloud->insert(cslibs_math_2d::Point2d(x + size + n, y + s));        break;
+        }
+    }
+    return cloud;
+}
+
+template <typename raster_t>
+void testEqual(const raster_t &expected,
+               const raster_t &raster)
+{
+    ASSERT_EQ(expected.getHeight(), raster.getHeight());
+    ASSERT_EQ(expected.getWidth(),  raster.getWidth());
+    EXPECT_NEAR((expected.getOrigin().translation() - raster.getOrigin().translation()).length(), 0.0, 1e-9);
+
+    std::size_t different = 0;
+    for (std::size_t i = 0 ; i < expected.getData().size() ; ++ i)
+        if (std::abs(expected.getData()[i] - raster.getData()[i]) > 1e-9)
+            ++ different;
+    EXPECT_EQ(different, 0ul);
+}
+
+TEST(Test_cslibs_ndt_2d, testIncrementalConversion)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateRoom(0.0, 0.0, 10.0, 4000));
+
+    probability_t::Ptr probability;
+    distance_t::Ptr    distance;
+    likelihood_t::Ptr  likelihood;
+    binary_t::Ptr      binary;
+    auto update = [&]() {
+        const map_t::dirty_blocks_t dirty = map->fetchDirtyBlocks();
+        cslibs_ndt_2d::conversion::from(map, probability, dirty, SAMPLING_RESOLUTION);
+        cslibs_ndt_2d::conversion::from(map, distance,    dirty, SAMPLING_RESOLUTION);
+        cslibs_ndt_2d::conversion::from(map, likelihood,  dirty, SAMPLING_RESOLUTION);
+        cslibs_ndt_2d::conversion::from(map, binary,      dirty, SAMPLING_RESOLUTION);
+    };
+    update();
+
+    /// a change within the map and one which grows it
+    map->insert(generateRoom(2.0, 3.0, 3.0, 1000));
+    update();
+    map->insert(generateRoom(8.0, -4.0, 6.0, 2000));
+    update();
+
+    probability_t::Ptr full_probability;
+    distance_t::Ptr    full_distance;
+    likelihood_t::Ptr  full_likelihood;
+    binary_t::Ptr      full_binary;
+    cslibs_ndt_2d::conversion::from(map, full_probability, SAMPLING_RESOLUTION);
+    cslibs_ndt_2d::conversion::from(map, full_distance,    SAMPLING_RESOLUTION);
+    cslibs_ndt_2d::conversion::from(map, full_likelihood,  SAMPLING_RESOLUTION);
+    cslibs_ndt_2d::conversion::from(map, full_binary,      SAMPLING_RESOLUTION);
+    testEqual(*full_probability, *probability);
+    testEqual(*full_distance,    *distance);
+    testEqual(*full_likelihood,  *likelihood);
+    testEqual(*full_binary,      *binary);
+}
+
+TEST(Test_cslibs_ndt_2d, testIncrementalConversionOccupancy)
+{
+    const ivm_t::Ptr ivm(new ivm_t(0.5, 0.45, 0.65));
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    map->insert(generateRoom(0.0, 0.0, 10.0, 4000), occupancy_map_t::pose_t(5.0, 5.0, 0.0));
+
+    probability_t::Ptr probability;
+    distance_t::Ptr    distance;
+    cslibs_ndt_2d::conversion::RasterStamp probability_stamp, distance_stamp;
+    auto update = [&]() {
+        const occupancy_map_t::dirty_blocks_t dirty = map->fetchDirtyBlocks();
+        cslibs_ndt_2d::conversion::from(map, probability, dirty, probability_stamp, SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, distance,    dirty, distance_stamp,    SAMPLING_RESOLUTION, ivm);
+    };
+    update();
+
+    map->insert(generateRoom(2.0, 6.0, 2.0, 500), occupancy_map_t::pose_t(5.0, 5.0, 0.0));
+    update();
+    map->insert(generateRoom(-6.0, -2.0, 4.0, 1000), occupancy_map_t::pose_t(-4.0, 0.0, 0.0));
+    update();
+
+    probability_t::Ptr full_probability;
+    distance_t::Ptr    full_distance;
+    cslibs_ndt_2d::conversion::from(map, full_probability, SAMPLING_RESOLUTION, ivm);
+    cslibs_ndt_2d::conversion::from(map, full_distance,    SAMPLING_RESOLUTION, ivm);
+    testEqual(*full_probability, *probability);
+    testEqual(*full_distance,    *distance);
+}
+
+TEST(Test_cslibs_ndt_2d, testIncrementalConversionDecay)
+{
+    const ivm_t::Ptr ivm(new ivm_t(0.5, 0.45, 0.65));
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    map->setDecay(10.0);
+    map->setTime(0.0);
+    map->insert(generateRoom(0.0, 0.0, 10.0, 4000), occupancy_map_t::pose_t(5.0, 5.0, 0.0));
+
+    probability_t::Ptr probability;
+    distance_t::Ptr    distance;
+    likelihood_t::Ptr  likelihood;
+    binary_t::Ptr      binary;
+    cslibs_ndt_2d::conversion::RasterStamp probability_stamp, distance_stamp, likelihood_stamp, binary_stamp;
+    auto update = [&]() {
+        const occupancy_map_t::dirty_blocks_t dirty = map->fetchDirtyBlocks();
+        cslibs_ndt_2d::conversion::from(map, probability, dirty, probability_stamp, SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, distance,    dirty, distance_stamp,    SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, likelihood,  dirty, likelihood_stamp,  SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, binary,      dirty, binary_stamp,      SAMPLING_RESOLUTION, ivm);
+    };
+    auto compare = [&]() {
+        probability_t::Ptr full_probability;
+        distance_t::Ptr    full_distance;
+        likelihood_t::Ptr  full_likelihood;
+        binary_t::Ptr      full_binary;
+        cslibs_ndt_2d::conversion::from(map, full_probability, SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, full_distance,    SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, full_likelihood,  SAMPLING_RESOLUTION, ivm);
+        cslibs_ndt_2d::conversion::from(map, full_binary,      SAMPLING_RESOLUTION, ivm);
+        testEqual(*full_probability, *probability);
+        testEqual(*full_distance,    *distance);
+        testEqual(*full_likelihood,  *likelihood);
+        testEqual(*full_binary,      *binary);
+    };
+    update();
+    compare();
+
+    /// the occupancies change with the time alone, without dirty blocks
+    const auto before = probability->getData();
+    map->setTime(15.0);
+    update();
+    compare();
+    EXPECT_FALSE(probability->getData() == before);
+
+    /// and along with an update
+    map->setTime(20.0);
+    map->insert(generateRoom(2.0, 6.0, 2.0, 500), occupancy_map_t::pose_t(5.0, 5.0, 0.0));
+    update();
+    compare();
+}
+
+TEST(Test_cslibs_ndt_2d, testIncrementalConversionBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    for (int i = 0 ; i < 5 ; ++ i)
+        for (int j = 0 ; j < 5 ; ++ j)
+            map->insert(generateRoom(i * 10.0, j * 10.0, 10.0, 4000));
+
+    distance_t::Ptr dst;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_2d::conversion::from(map, dst, map->fetchDirtyBlocks(), SAMPLING_RESOLUTION);
+    const duration_t t_full = steady_clock_t::now() - start;
+    std::cout << "[incremental conversion] full distance transform of " << dst->getWidth() << " x "
+              << dst->getHeight() << " pixels " << t_full.count() << " ms" << std::endl;
+
+    /// a scan worth of changes only updates the pixels around them
+    map->insert(generateRoom(22.0, 22.0, 4.0, 1000));
+    start = steady_clock_t::now();
+    cslibs_ndt_2d::conversion::from(map, dst, map->fetchDirtyBlocks(), SAMPLING_RESOLUTION);
+    const duration_t t_incremental = steady_clock_t::now() - start;
+    std::cout << "[incremental conversion] update " << t_incremental.count() << " ms" << std::endl;
+    EXPECT_LT(t_incremental.count(), t_full.count());
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_2d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math_2d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+#include <array>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const std::size_t NUM_BEAMS  = 1081;
+const std::size_t NUM_CYCLES = 40;
+const double      RANGE_MAX  = 20.0;
+
+/// every max_range_step-th beam has no return, none if the step is 0
+cslibs_ndt_2d::LaserScan generateScan(const std::size_t max_range_step)
+{
+    rng_t<1> rng_range(0.5, 15.0);
+    cslibs_ndt_2d::LaserScan scan(-0.75 * M_PI, 1.5 * M_PI / (NUM_BEAMS - 1), NUM_BEAMS, 0.1, RANGE_MAX);
+    for (std::size_t i = 0 ; i < NUM_BEAMS ; ++ i)
+        scan.getRanges()[i] = max_range_step > 0 && i % max_range_step == 0 ? std::numeric_limits<float>::infinity()
+                                                                            : static_cast<float>(rng_range.get());
+    return scan;
+}
+
+/// only the max range beams of the scan, the others are invalid
+cslibs_ndt_2d::LaserScan maxRangeBeams(const cslibs_ndt_2d::LaserScan &scan)
+{
+    cslibs_ndt_2d::LaserScan max_range(scan);
+    for (float &r : max_range.getRanges())
+        if (!scan.isMaxRange(r))
+            r = std::numeric_limits<float>::quiet_NaN();
+    return max_range;
+}
+
+/// the returns of the scan as a cartesian cloud in the sensor frame
+cslibs_math_2d::Pointcloud2d::Ptr toCloud(const cslibs_ndt_2d::LaserScan &scan)
+{
+    cslibs_math_2d::Pointcloud2d::Ptr cloud(new cslibs_math_2d::Pointcloud2d);
+    for (std::size_t i = 0 ; i < scan.size() ; ++ i) {
+        const float  r     = scan.getRanges()[i];
+        const double angle = scan.getAngleMin() + i * scan.getAngleIncrement();
+        if (scan.isValid(r))
+            cloud->insert(cslibs_math_2d::Point2d(r * std::cos(angle), r * std::sin(angle)));
+    }
+    return cloud;
+}
+
+/// free and occupied counts of every distribution of every bundle
+template <typename map_t>
+using counts_t = std::map<typename map_t::index_t, std::array<std::pair<std::size_t, std::size_t>, 4>>;
+
+template <typename map_t>
+counts_t<map_t> counts(const map_t &map)
+{
+    counts_t<map_t> c;
+    map.traverse([&c](const typename map_t::index_t &bi, const typename map_t::distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 4 ; ++ i)
+            c[bi][i] = std::make_pair(b.at(i)->numFree(), b.at(i)->numOccupied());
+    });
+    return c;
+}
+
+template <typename map_t>
+void testScanInsertion(map_t &map_cloud,
+                       map_t &map_scan)
+{
+    const cslibs_ndt_2d::LaserScan scan = generateScan(0);
+    const typename map_t::pose_t origin(0.3, -0.2, 0.4);
+
+    duration_t t_cloud(0.0);
+    duration_t t_scan(0.0);
+    for (std::size_t c = 0 ; c < NUM_CYCLES ; ++ c) {
+        /// the cloud path includes the conversion every scan had to go through
+        auto start = steady_clock_t::now();
+        map_cloud.insert(toCloud(scan), origin);
+        t_cloud += steady_clock_t::now() - start;
+
+        start = steady_clock_t::now();
+        map_scan.insert(scan, origin);
+        t_scan += steady_clock_t::now() - start;
+    }
+    std::cout << "[laser scan] latency per scan: cloud " << t_cloud.count() / NUM_CYCLES
+              << " ms, scan " << t_scan.count() / NUM_CYCLES << " ms" << std::endl;
+
+    /// without max range beams both paths cast the same rays
+    EXPECT_TRUE(counts(map_cloud) == counts(map_scan));
+}
+
+/// max range beams only clear the free space along their rays
+template <typename map_t>
+void testMaxRangeClearing(map_t &map_cloud,
+                          map_t &map_scan,
+                          map_t &map_cleared)
+{
+    const cslibs_ndt_2d::LaserScan scan = generateScan(10);
+    const typename map_t::pose_t origin(0.3, -0.2, 0.4);
+
+    map_cloud.insert(toCloud(scan), origin);
+    map_scan.insert(scan, origin);
+    map_cleared.insert(maxRangeBeams(scan), origin);
+
+    const counts_t<map_t> c_cloud   = counts(map_cloud);
+    const counts_t<map_t> c_scan    = counts(map_scan);
+    const counts_t<map_t> c_cleared = counts(map_cleared);
+
+    std::size_t cleared = 0;
+    for (const auto &c : c_cleared)
+        for (std::size_t i = 0 ; i < 4 ; ++ i) {
+            EXPECT_EQ(c.second[i].second, 0ul);
+            cleared += c.second[i].first;
+        }
+    EXPECT_GT(cleared, 0ul);
+
+    /// the scan map holds the returns of the cloud map plus the cleared rays
+    for (const auto &c : c_scan) {
+        const auto c_c = c_cloud.find(c.first);
+        const auto c_m = c_cleared.find(c.first);
+        EXPECT_TRUE(c_c != c_cloud.end() || c_m != c_cleared.end());
+        for (std::size_t i = 0 ; i < 4 ; ++ i) {
+            const std::size_t free     = (c_c != c_cloud.end()   ? c_c->second[i].first  : 0) +
+                                         (c_m != c_cleared.end() ? c_m->second[i].first  : 0);
+            const std::size_t occupied =  c_c != c_cloud.end()   ? c_c->second[i].second : 0;
+            EXPECT_EQ(free,     c.second[i].first);
+            EXPECT_EQ(occupied, c.second[i].second);
+        }
+    }
+    for (const auto &c : c_cloud)
+        EXPECT_TRUE(c_scan.find(c.first) != c_scan.end());
+    for (const auto &c : c_cleared)
+        EXPECT_TRUE(c_scan.find(c.first) != c_scan.end());
+}
+
+TEST(Test_cslibs_ndt_2d, testScanInsertionDynamic)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    map_t map_cloud(map_t::pose_t(), 0.5);
+    map_t map_scan(map_t::pose_t(), 0.5);
+    testScanInsertion(map_cloud, map_scan);
+}
+
+TEST(Test_cslibs_ndt_2d, testMaxRangeClearingDynamic)
+{
+    using map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    map_t map_cloud(map_t::pose_t(), 0.5);
+    map_t map_scan(map_t::pose_t(), 0.5);
+    map_t map_cleared(map_t::pose_t(), 0.5);
+    testMaxRangeClearing(map_cloud, map_scan, map_cleared);
+}
+
+TEST(Test_cslibs_ndt_2d, testScanInsertionStatic)
+{
+    using map_t = cslibs_ndt_2d::static_maps::OccupancyGridmap;
+    map_t map_cloud(map_t::pose_t(), 0.5, {{100, 100}}, {{-100, -100}});
+    map_t map_scan(map_t::pose_t(), 0.5, {{100, 100}}, {{-100, -100}});
+    testScanInsertion(map_cloud, map_scan);
+}
+
+TEST(Test_cslibs_ndt_2d, testMaxRangeClearingStatic)
+{
+    using map_t = cslibs_ndt_2d::static_maps::OccupancyGridmap;
+    map_t map_cloud(map_t::pose_t(), 0.5, {{100, 100}}, {{-100, -100}});
+    map_t map_scan(map_t::pose_t(), 0.5, {{100, 100}}, {{-100, -100}});
+    map_t map_cleared(map_t::pose_t(), 0.5, {{100, 100}}, {{-100, -100}});
+    testMaxRangeClearing(map_cloud, map_scan, map_cleared);
+}
+
+TEST(Test_cslibs_ndt_2d, testScanDirectionTable)
+{
+    cslibs_ndt_2d::LaserScan scan(-1.0, 0.01, 201, 0.0, 10.0);
+    for (std::size_t i = 0 ; i < scan.size() ; ++ i) {
+        const double angle = -1.0 + 0.01 * i;
+        EXPECT_NEAR(scan.getDirection(i)(0), std::cos(angle), 1e-12);
+        EXPECT_NEAR(scan.getDirection(i)(1), std::sin(angle), 1e-12);
+    }
+
+    EXPECT_TRUE(scan.isValid(5.0f));
+    EXPECT_FALSE(scan.isValid(10.0f));
+    EXPECT_FALSE(scan.isValid(std::numeric_limits<float>::quiet_NaN()));
+    EXPECT_TRUE(scan.isMaxRange(std::numeric_limits<float>::infinity()));
+    EXPECT_FALSE(scan.isMaxRange(std::numeric_limits<float>::quiet_NaN()));
+
+    scan.configure(0.0, 0.02, 101);
+    EXPECT_EQ(scan.size(), 101ul);
+    EXPECT_EQ(scan.getRanges().size(), 101ul);
+    EXPECT_NEAR(scan.getDirection(100)(1), std::sin(2.0), 1e-12);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt/common/merge.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t           = cslibs_ndt_2d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using index_t         = map_t::index_t;
+using pose_t          = map_t::pose_t;
+using point_t         = map_t::point_t;
+using transform_t     = map_t::transform_t;
+using cloud_t         = cslibs_math::linear::Pointcloud<point_t>;
+using moments_t       = map_t::distribution_t::distribution_t;
+using rotation_t      = cslibs_ndt::merge::rotation_t<2>;
+using translation_t   = cslibs_ndt::merge::translation_t<2>;
+
+const double RESOLUTION = 0.5;
+
+cloud_t::Ptr generateCloud(const std::size_t size)
+{
+    rng_t<1> rng(-5.0, 5.0);
+    cloud_t::Ptr cloud(new cloud_t);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(point_t(rng.get(), rng.get()));
+    return cloud;
+}
+
+void decompose(const transform_t &transform,
+               rotation_t        &R,
+               translation_t     &t)
+{
+    t = (transform * point_t(0.0, 0.0)).data();
+    R.col(0) = (transform * point_t(1.0, 0.0)).data() - t;
+    R.col(1) = (transform * point_t(0.0, 1.0)).data() - t;
+}
+
+void testEqual(const map_t &expected,
+               const map_t &map)
+{
+    std::size_t bundles = 0;
+    expected.traverse([&map, &bundles](const index_t &bi, const map_t::distribution_bundle_t &b) {
+        const map_t::distribution_bundle_t *bm = map.getDistributionBundle(bi);
+        ASSERT_NE(bm, nullptr);
+        for (std::size_t i = 0 ; i < 4 ; ++ i) {
+            EXPECT_EQ(b.at(i)->data().getN(), bm->at(i)->data().getN());
+            if (b.at(i)->data().getN() > 0) {
+                EXPECT_NEAR((b.at(i)->data().getMean() - bm->at(i)->data().getMean()).norm(), 0.0, 1e-9);
+                EXPECT_NEAR((b.at(i)->data().getCovariance() - bm->at(i)->data().getCovariance()).norm(), 0.0, 1e-9);
+            }
+        }
+        ++ bundles;
+    });
+    EXPECT_GT(bundles, 0ul);
+
+    std::size_t found = 0;
+    map.traverse([&found](const index_t &, const map_t::distribution_bundle_t &) {
+        ++ found;
+    });
+    EXPECT_EQ(bundles, found);
+}
+
+TEST(Test_cslibs_ndt_2d, testMergeAligned)
+{
+    const cloud_t::Ptr a = generateCloud(10000);
+    const cloud_t::Ptr b = generateCloud(10000);
+    const pose_t origin(0.3, 0.1, 0.4);
+
+    map_t expected(origin, RESOLUTION);
+    expected.insert(a);
+    expected.insert(b);
+
+    /// same grid
+    map_t map(origin, RESOLUTION);
+    map_t other(origin, RESOLUTION);
+    map.insert(a);
+    other.insert(b);
+    map.merge(other);
+    testEqual(expected, map);
+
+    /// grids offset by whole cells
+    map_t shifted_map(origin, RESOLUTION);
+    map_t shifted(origin * pose_t(1.0, -1.5, 0.0), RESOLUTION);
+    shifted_map.insert(a);
+    shifted.insert(b);
+    shifted_map.merge(shifted);
+    testEqual(expected, shifted_map);
+}
+
+TEST(Test_cslibs_ndt_2d, testMergeTransformed)
+{
+    const cloud_t::Ptr a = generateCloud(10000);
+    const cloud_t::Ptr b = generateCloud(10000);
+    const pose_t      origin(0.3, 0.1, 0.4);
+    const transform_t transform(0.2, 0.1, 0.3);
+
+    map_t map(origin, RESOLUTION);
+    map_t other(pose_t(), RESOLUTION);
+    map.insert(a);
+    other.insert(b);
+    const map_t before(map);
+    map.merge(other, transform);
+
+    /// every distribution of storage 0 of the other map is transformed and
+    /// composed into the storage 0 distribution of the bundle its mean falls into
+    rotation_t    R;
+    translation_t t;
+    decompose(transform, R, t);
+
+    std::map<index_t, moments_t> expected;
+    before.getStorages()[0]->traverse([&expected](const index_t &si, const map_t::distribution_t &d) {
+        expected[si] += d.data();
+    });
+    other.getStorages()[0]->traverse([&expected, &map, &R, &t](const index_t &, const map_t::distribution_t &d) {
+        if (d.data().getN() == 0)
+            return;
+        const moments_t m  = cslibs_ndt::merge::transform(d.data(), R, t);
+        const index_t   bi = map.getBundleIndex(point_t(m.getMean()(0), m.getMean()(1)));
+        expected[{{cslibs_math::common::div<int>(bi[0], 2),
+                   cslibs_math::common::div<int>(bi[1], 2)}}] += m;
+    });
+
+    std::size_t n_map = 0;
+    std::size_t n_expected = 0;
+    map.getStorages()[0]->traverse([&expected, &n_map](const index_t &si, const map_t::distribution_t &d) {
+        n_map += d.data().getN();
+        const auto e = expected.find(si);
+        ASSERT_TRUE(e != expected.end());
+        EXPECT_EQ(e->second.getN(), d.data().getN());
+        if (d.data().getN() > 0) {
+            EXPECT_NEAR((e->second.getMean() - d.data().getMean()).norm(), 0.0, 1e-9);
+            EXPECT_NEAR((e->second.getCovariance() - d.data().getCovariance()).norm(), 0.0, 1e-9);
+        }
+    });
+    for (const auto &e : expected)
+        n_expected += e.second.getN();
+    EXPECT_EQ(n_expected, n_map);
+    EXPECT_EQ(n_map, a->size() + b->size());
+}
+
+TEST(Test_cslibs_ndt_2d, testMergeOccupancy)
+{
+    const cloud_t::Ptr a = generateCloud(2000);
+    const cloud_t::Ptr b = generateCloud(2000);
+    const pose_t origin(0.3, 0.1, 0.4);
+    const pose_t sensor(0.5, 0.5, 0.0);
+
+    occupancy_map_t expected(origin, RESOLUTION);
+    expected.insert(a, sensor);
+    expected.insert(b, sensor);
+
+    occupancy_map_t map(origin, RESOLUTION);
+    occupancy_map_t other(origin * pose_t(-2.0, 1.0, 0.0), RESOLUTION);
+    map.insert(a, sensor);
+    other.insert(b, sensor);
+    map.merge(other);
+
+    expected.traverse([&map](const index_t &bi, const occupancy_map_t::distribution_bundle_t &b) {
+        const occupancy_map_t::distribution_bundle_t *bm = map.getDistributionBundle(bi);
+        ASSERT_NE(bm, nullptr);
+        for (std::size_t i = 0 ; i < 4 ; ++ i) {
+            EXPECT_EQ(b.at(i)->numFree(),     bm->at(i)->numFree());
+            EXPECT_EQ(b.at(i)->numOccupied(), bm->at(i)->numOccupied());
+            ASSERT_EQ(static_cast<bool>(b.at(i)->getDistribution()), static_cast<bool>(bm->at(i)->getDistribution()));
+            if (b.at(i)->getDistribution() && b.at(i)->getDistribution()->getN() > 0)
+                EXPECT_NEAR((b.at(i)->getDistribution()->getMean() - bm->at(i)->getDistribution()->getMean()).norm(), 0.0, 1e-9);
+        }
+    });
+}
+
+TEST(Test_cslibs_ndt_2d, testMergeOccupancyTransformed)
+{
+    const cloud_t::Ptr a = generateCloud(2000);
+    const cloud_t::Ptr b = generateCloud(2000);
+    const pose_t      origin(0.3, 0.1, 0.4);
+    const pose_t      sensor(0.5, 0.5, 0.0);
+    const transform_t transform(0.2, 0.1, 0.3);
+
+    occupancy_map_t map(origin, RESOLUTION);
+    occupancy_map_t other(pose_t(), RESOLUTION);
+    map.insert(a, sensor);
+    other.insert(b, sensor);
+
+    /// re-binned, the free and occupied counts of storage 0 are kept
+    auto count = [](const occupancy_map_t &m, std::size_t &free, std::size_t &occupied) {
+        free     = 0;
+        occupied = 0;
+        m.getStorages()[0]->traverse([&free, &occupied](const index_t &, const occupancy_map_t::distribution_t &d) {
+            free     += d.numFree();
+            occupied += d.numOccupied();
+        });
+    };
+    std::size_t free_map, occupied_map, free_other, occupied_other;
+    count(map,   free_map,   occupied_map);
+    count(other, free_other, occupied_other);
+
+    map.merge(other, transform);
+    std::size_t free_merged, occupied_merged;
+    count(map, free_merged, occupied_merged);
+    EXPECT_EQ(free_map + free_other, free_merged);
+    EXPECT_EQ(occupied_map + occupied_other, occupied_merged);
+    EXPECT_EQ(occupied_merged, a->size() + b->size());
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,323 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/conversion/probability_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/binary_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/distance_gridmap.hpp>
+#include <cslibs_ndt_2d/conversion/likelihood_field_gridmap.hpp>
+
+#include <cslibs_math_2d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using dynamic_map_t  = cslibs_ndt_2d::dynamic_maps::Gridmap;
+using static_map_t   = cslibs_ndt_2d::static_maps::Gridmap;
+using mono_map_t     = cslibs_ndt_2d::static_maps::mono::Gridmap;
+using occupancy_t    = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using probability_t  = cslibs_gridmaps::static_maps::ProbabilityGridmap;
+using binary_t       = cslibs_gridmaps::static_maps::BinaryGridmap;
+using distance_t     = cslibs_gridmaps::static_maps::DistanceGridmap;
+using likelihood_t   = cslibs_gridmaps::static_maps::LikelihoodFieldGridmap;
+using index_t        = std::array<int, 2>;
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION          = 1.0;
+const double SAMPLING_RESOLUTION = 0.05;
+
+cslibs_math_2d::Pointcloud2d::Ptr generatePoints(const double min,
+                                                 const double max,
+                                                 const std::size_t size)
+{
+    rng_t<1> rng(min, max);
+    cslibs_math_2d::Pointcloud2d::Ptr cloud(new cslibs_math_2d::Pointcloud2d);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_2d::Point2d(rng.get(), rng.get()));
+    return cloud;
+}
+
+/// pixel by pixel sampling of the bundles, as the conversions did before,
+/// the distributions are in world coordinates
+template <typename map_t>
+probability_t::Ptr sampleBundles(const map_t &src)
+{
+    probability_t::Ptr dst(new probability_t(src.getOrigin(),
+                                             SAMPLING_RESOLUTION,
+                                             std::ceil(src.getHeight() / SAMPLING_RESOLUTION),
+                                             std::ceil(src.getWidth()  / SAMPLING_RESOLUTION)));
+    std::fill(dst->getData().begin(), dst->getData().end(), 0);
+
+    const double  bundle_resolution = src.getBundleResolution();
+    const int     chunk_step        = static_cast<int>(bundle_resolution / SAMPLING_RESOLUTION);
+    const index_t min_bi            = src.getMinBundleIndex();
+    const cslibs_math_2d::Pose2d origin = src.getInitialOrigin();
+    src.traverse([&](const index_t &bi, const typename map_t::distribution_bundle_t &b) {
+        for (int k = 0 ; k < chunk_step ; ++ k) {
+            for (int l = 0 ; l < chunk_step ; ++ l) {
+                const cslibs_math_2d::Point2d p = origin * cslibs_math_2d::Point2d(bi[0] * bundle_resolution + k * SAMPLING_RESOLUTION,
+                                                                                   bi[1] * bundle_resolution + l * SAMPLING_RESOLUTION);
+                dst->at((bi[0] - min_bi[0]) * chunk_step + k, (bi[1] - min_bi[1]) * chunk_step + l) =
+                        0.25 * (b.at(0)->data().sampleNonNormalized(p) +
+                                b.at(1)->data().sampleNonNormalized(p) +
+                                b.at(2)->data().sampleNonNormalized(p) +
+                                b.at(3)->data().sampleNonNormalized(p));
+            }
+        }
+    });
+    return dst;
+}
+
+template <typename map_t>
+std::size_t countBundles(const map_t &src)
+{
+    std::size_t count = 0;
+    src.traverse([&count](const index_t &, const typename map_t::distribution_bundle_t &) {
+        ++ count;
+    });
+    return count;
+}
+
+void testEqual(const probability_t &expected,
+               const probability_t &raster)
+{
+    ASSERT_EQ(expected.getHeight(), raster.getHeight());
+    ASSERT_EQ(expected.getWidth(),  raster.getWidth());
+
+    std::size_t different = 0;
+    for (std::size_t i = 0 ; i < expected.getData().size() ; ++ i)
+        if (std::abs(expected.getData()[i] - raster.getData()[i]) > 1e-9)
+            ++ different;
+    EXPECT_EQ(different, 0ul);
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterDynamic)
+{
+    const dynamic_map_t::Ptr map(new dynamic_map_t(dynamic_map_t::pose_t(1.0, -2.0, 0.3), RESOLUTION));
+    map->insert(generatePoints(-5.0, 5.0, 10000));
+
+    const std::size_t bundles = countBundles(*map);
+    probability_t::Ptr raster;
+    cslibs_ndt_2d::conversion::from(map, raster, SAMPLING_RESOLUTION);
+    EXPECT_EQ(bundles, countBundles(*map));
+
+    map->allocatePartiallyAllocatedBundles();
+    testEqual(*sampleBundles(*map), *raster);
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterStatic)
+{
+    const dynamic_map_t::Ptr map(new dynamic_map_t(dynamic_map_t::pose_t(), RESOLUTION));
+    map->insert(generatePoints(-5.0, 5.0, 10000));
+    const static_map_t::Ptr static_map = cslibs_ndt_2d::conversion::from<double>(map);
+
+    const std::size_t bundles = countBundles(*static_map);
+    probability_t::Ptr raster;
+    cslibs_ndt_2d::conversion::from(static_map, raster, SAMPLING_RESOLUTION);
+    EXPECT_EQ(bundles, countBundles(*static_map));
+
+    static_map->allocatePartiallyAllocatedBundles();
+    testEqual(*sampleBundles(*static_map), *raster);
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterMono)
+{
+    const mono_map_t::Ptr map(new mono_map_t(mono_map_t::pose_t(1.0, -2.0, 0.3), RESOLUTION,
+                                             mono_map_t::size_t{{10, 10}}, mono_map_t::index_t{{-5, -5}}));
+    const cslibs_math_2d::Pointcloud2d::Ptr points = generatePoints(-4.0, 4.0, 10000);
+    for (const auto &p : *points)
+        map->insert(map->getInitialOrigin() * p);
+
+    probability_t::Ptr raster;
+    cslibs_ndt_2d::conversion::from(map, raster, SAMPLING_RESOLUTION);
+
+    /// the distributions of a mono map are sampled in world coordinates, at the pixels of their cells
+    std::size_t different = 0;
+    const mono_map_t::index_t min_index = map->getMinIndex();
+    for (std::size_t i = 0 ; i < raster->getHeight() ; ++ i) {
+        for (std::size_t j = 0 ; j < raster->getWidth() ; ++ j) {
+            const cslibs_math_2d::Point2d p(j * SAMPLING_RESOLUTION, i * SAMPLING_RESOLUTION);
+            const mono_map_t::index_t idx = {{min_index[0] + static_cast<int>(p(0) / RESOLUTION),
+                                              min_index[1] + static_cast<int>(p(1) / RESOLUTION)}};
+            if (std::abs(map->sampleNonNormalized(map->getInitialOrigin() * (map->getMin() + p), idx) - raster->at(j, i)) > 1e-9)
+                ++ different;
+        }
+    }
+    EXPECT_EQ(different, 0ul);
+}
+
+/// the other rasters of a map are thresholded or transformed versions of its probabilities
+template <typename map_ptr_t, typename... Args>
+void testConversions(const map_ptr_t &map,
+                     const Args&... args)
+{
+    probability_t::Ptr probability;
+    binary_t::Ptr      binary;
+    distance_t::Ptr    distance;
+    likelihood_t::Ptr  likelihood;
+    cslibs_ndt_2d::conversion::from(map, probability, SAMPLING_RESOLUTION, args...);
+    cslibs_ndt_2d::conversion::from(map, binary,      SAMPLING_RESOLUTION, args...);
+    cslibs_ndt_2d::conversion::from(map, distance,    SAMPLING_RESOLUTION, args...);
+    cslibs_ndt_2d::conversion::from(map, likelihood,  SAMPLING_RESOLUTION, args...);
+    ASSERT_TRUE(probability && binary && distance && likelihood);
+    ASSERT_EQ(probability->getWidth(),  binary->getWidth());
+    ASSERT_EQ(probability->getHeight(), binary->getHeight());
+    EXPECT_EQ(probability->getWidth(),  distance->getWidth());
+    EXPECT_EQ(probability->getHeight(), likelihood->getHeight());
+
+    std::size_t different = 0, occupied = 0;
+    for (std::size_t i = 0 ; i < probability->getData().size() ; ++ i) {
+        const bool o = probability->getData()[i] >= 0.169;
+        if (o != (binary->getData()[i] == binary_t::OCCUPIED))
+            ++ different;
+        if (o && distance->getData()[i] != 0.0)
+            ++ different;
+        occupied += o ? 1 : 0;
+    }
+    EXPECT_GT(occupied, 0ul);
+    EXPECT_EQ(different, 0ul);
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterConversionTraits)
+{
+    const cslibs_math_2d::Pointcloud2d::Ptr points = generatePoints(-4.0, 4.0, 10000);
+
+    const dynamic_map_t::Ptr map(new dynamic_map_t(dynamic_map_t::pose_t(), RESOLUTION));
+    map->insert(points);
+    testConversions(map);
+    testConversions(cslibs_ndt_2d::conversion::from<double>(map));
+
+    const mono_map_t::Ptr mono_map(new mono_map_t(mono_map_t::pose_t(1.0, -2.0, 0.3), RESOLUTION,
+                                                  mono_map_t::size_t{{10, 10}}, mono_map_t::index_t{{-5, -5}}));
+    for (const auto &p : *points)
+        mono_map->insert(mono_map->getInitialOrigin() * p);
+    testConversions(mono_map);
+
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    const occupancy_t::Ptr occupancy_map(new occupancy_t(occupancy_t::pose_t(), RESOLUTION));
+    occupancy_map->insert(points);
+    testConversions(occupancy_map, ivm);
+    testConversions(cslibs_ndt_2d::conversion::from<double>(occupancy_map), ivm);
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterBenchmark)
+{
+    const dynamic_map_t::Ptr map(new dynamic_map_t(dynamic_map_t::pose_t(), RESOLUTION));
+    map->insert(generatePoints(0.0, 50.0, 250000));
+
+    probability_t::Ptr raster;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_2d::conversion::from(map, raster, SAMPLING_RESOLUTION);
+    const duration_t t_raster = steady_clock_t::now() - start;
+
+    map->allocatePartiallyAllocatedBundles();
+    start = steady_clock_t::now();
+    const probability_t::Ptr expected = sampleBundles(*map);
+    const duration_t t_pixels = steady_clock_t::now() - start;
+
+    std::cout << "[raster] " << raster->getWidth() << " x " << raster->getHeight() << " pixels, per pixel "
+              << t_pixels.count() << " ms, tiles " << t_raster.count() << " ms" << std::endl;
+    testEqual(*expected, *raster);
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterReadOnly)
+{
+    /// sparse scans leave many partially allocated bundles around the populated ones
+    const dynamic_map_t::Ptr map(new dynamic_map_t(dynamic_map_t::pose_t(), RESOLUTION));
+    const dynamic_map_t::Ptr allocated(new dynamic_map_t(dynamic_map_t::pose_t(), RESOLUTION));
+    rng_t<1> rng(0.0, 2.0 * M_PI);
+    for (int r = 10 ; r <= 100 ; r += 10) {
+        cslibs_math_2d::Pointcloud2d::Ptr ring(new cslibs_math_2d::Pointcloud2d);
+        for (int i = 0 ; i < 50 * r ; ++ i) {
+            const double a = rng.get();
+            ring->insert(cslibs_math_2d::Point2d(r * std::cos(a), r * std::sin(a)));
+        }
+        map->insert(ring);
+        allocated->insert(ring);
+    }
+
+    const std::size_t bytes   = map->getByteSize();
+    const std::size_t bundles = countBundles(*map);
+    probability_t::Ptr raster;
+    cslibs_ndt_2d::conversion::from(map, raster, SAMPLING_RESOLUTION);
+    EXPECT_EQ(bytes,   map->getByteSize());
+    EXPECT_EQ(bundles, countBundles(*map));
+
+    allocated->allocatePartiallyAllocatedBundles();
+    testEqual(*sampleBundles(*allocated), *raster);
+
+    std::cout << "[raster] " << bundles << " bundles, " << bytes / 1024 << " KiB read only, "
+              << countBundles(*allocated) << " bundles, " << allocated->getByteSize() / 1024
+              << " KiB allocated" << std::endl;
+}
+
+TEST(Test_cslibs_ndt_2d, testRasterRotatedOrigin)
+{
+    /// more than a quarter turn, an offset which is not rotated along ends up on the other side
+    const dynamic_map_t::pose_t origin(1.0, -2.0, 0.5 * M_PI + 0.2);
+    const dynamic_map_t::Ptr map(new dynamic_map_t(origin, RESOLUTION));
+    const dynamic_map_t::Ptr allocated(new dynamic_map_t(origin, RESOLUTION));
+    const cslibs_math_2d::Pointcloud2d::Ptr points = generatePoints(2.0, 8.0, 5000);
+    map->insert(points);
+    allocated->insert(points);
+
+    probability_t::Ptr raster;
+    cslibs_ndt_2d::conversion::from(map, raster, SAMPLING_RESOLUTION);
+    map->fetchDirtyBlocks();
+
+    /// the raster is aligned with the map and starts at a bundle
+    const double                  bundle_resolution = map->getBundleResolution();
+    const int                     chunk_step        = static_cast<int>(bundle_resolution / SAMPLING_RESOLUTION);
+    const cslibs_math_2d::Point2d first             = origin.inverse() * raster->getOrigin().translation();
+    const index_t min_bi = {{static_cast<int>(std::round(first(0) / bundle_resolution)),
+                             static_cast<int>(std::round(first(1) / bundle_resolution))}};
+    EXPECT_NEAR(first(0), min_bi[0] * bundle_resolution, 1e-9);
+    EXPECT_NEAR(first(1), min_bi[1] * bundle_resolution, 1e-9);
+    EXPECT_NEAR(std::cos(raster->getOrigin().yaw() - origin.yaw()), 1.0, 1e-9);
+
+    /// every pixel samples its bundle at the world coordinates of the pixel
+    allocated->allocatePartiallyAllocatedBundles();
+    EXPECT_TRUE(min_bi == allocated->getMinBundleIndex());
+    std::map<index_t, const dynamic_map_t::distribution_bundle_t*> bundles;
+    allocated->traverse([&bundles](const index_t &bi, const dynamic_map_t::distribution_bundle_t &b) {
+        bundles[bi] = &b;
+    });
+    std::size_t different = 0, sampled = 0;
+    for (std::size_t i = 0 ; i < raster->getHeight() ; ++ i) {
+        for (std::size_t j = 0 ; j < raster->getWidth() ; ++ j) {
+            const index_t bi = {{min_bi[0] + static_cast<int>(j) / chunk_step,
+                                 min_bi[1] + static_cast<int>(i) / chunk_step}};
+            const auto b = bundles.find(bi);
+            const cslibs_math_2d::Point2d p = raster->getOrigin() * cslibs_math_2d::Point2d(j * SAMPLING_RESOLUTION, i * SAMPLING_RESOLUTION);
+            const double expected = b == bundles.end() ? 0.0 :
+                    0.25 * (b->second->at(0)->data().sampleNonNormalized(p) +
+                            b->second->at(1)->data().sampleNonNormalized(p) +
+                            b->second->at(2)->data().sampleNonNormalized(p) +
+                            b->second->at(3)->data().sampleNonNormalized(p));
+            if (std::abs(expected - raster->at(j, i)) > 1e-9)
+                ++ different;
+            sampled += expected > 0.0 ? 1 : 0;
+        }
+    }
+    EXPECT_GT(sampled, 0ul);
+    EXPECT_EQ(different, 0ul);
+
+    /// growing the map moves the previous raster along the axes of the map
+    map->insert(generatePoints(-6.0, -2.0, 2000));
+    cslibs_ndt_2d::conversion::from(map, raster, map->fetchDirtyBlocks(), SAMPLING_RESOLUTION);
+    probability_t::Ptr full;
+    cslibs_ndt_2d::conversion::from(map, full, SAMPLING_RESOLUTION);
+    EXPECT_NEAR(raster->getOrigin().tx(), full->getOrigin().tx(), 1e-9);
+    EXPECT_NEAR(raster->getOrigin().ty(), full->getOrigin().ty(), 1e-9);
+    testEqual(*full, *raster);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
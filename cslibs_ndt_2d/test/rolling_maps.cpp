@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_2d/rolling_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/rolling_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t   = cslibs_ndt_2d::rolling_maps::Gridmap;
+using index_t = map_t::index_t;
+
+/// distribution indices of a bundle, in storage order
+std::array<index_t, 4> distributionIndices(const index_t &bi)
+{
+    const int divx = cslibs_math::common::div<int>(bi[0], 2);
+    const int divy = cslibs_math::common::div<int>(bi[1], 2);
+    const int modx = cslibs_math::common::mod<int>(bi[0], 2);
+    const int mody = cslibs_math::common::mod<int>(bi[1], 2);
+    return {{index_t{{divx, divy}}, index_t{{divx + modx, divy}},
+             index_t{{divx, divy + mody}}, index_t{{divx + modx, divy + mody}}}};
+}
+
+TEST(Test_cslibs_ndt_2d, testRollingMapScrolling)
+{
+    rng_t<1> rng_step(-0.7, 0.7);
+    rng_t<1> rng_jump(-20.0, 20.0);
+    rng_t<1> rng_point(-2.0, 2.0);
+
+    map_t map(map_t::pose_t(), 0.5, {{6, 5}});
+    const std::size_t byte_size = map.getByteSize();
+
+    /// reference sample counts per storage and distribution index, dropped
+    /// as soon as no bundle of the window references the distribution
+    std::map<std::pair<std::size_t, index_t>, std::size_t> reference;
+
+    map_t::point_t center;
+    for (int step = 0 ; step < 300 ; ++ step) {
+        center = center + map_t::point_t(rng_step.get(), rng_step.get());
+        if (step % 50 == 0)
+            center = center + map_t::point_t(rng_jump.get(), rng_jump.get());
+        map.moveTo(center);
+
+        const index_t min_bi = map.getMinBundleIndex();
+        const index_t max_bi = map.getMaxBundleIndex();
+        EXPECT_EQ(max_bi[0] - min_bi[0] + 1, 12);
+        EXPECT_EQ(max_bi[1] - min_bi[1] + 1, 10);
+
+        std::map<std::pair<std::size_t, index_t>, std::size_t> referenced;
+        for (int i = min_bi[0] ; i <= max_bi[0] ; ++ i) {
+            for (int j = min_bi[1] ; j <= max_bi[1] ; ++ j) {
+                const std::array<index_t, 4> di = distributionIndices({{i, j}});
+                for (std::size_t s = 0 ; s < 4 ; ++ s) {
+                    auto it = reference.find({s, di[s]});
+                    referenced[{s, di[s]}] = it == reference.end() ? 0 : it->second;
+                }
+            }
+        }
+        reference.swap(referenced);
+
+        for (int i = 0 ; i < 50 ; ++ i) {
+            const map_t::point_t p = center + map_t::point_t(rng_point.get(), rng_point.get());
+            if (!map.validate(map_t::pose_t(p)))
+                continue;
+
+            map.insert(p);
+            const std::array<index_t, 4> di = distributionIndices(map.getBundleIndex(p));
+            for (std::size_t s = 0 ; s < 4 ; ++ s)
+                ++ reference[{s, di[s]}];
+        }
+
+        map.traverse([&reference](const index_t &bi, const map_t::distribution_bundle_t &b) {
+            const std::array<index_t, 4> di = distributionIndices(bi);
+            for (std::size_t s = 0 ; s < 4 ; ++ s) {
+                const std::size_t n = reference[{s, di[s]}];
+                EXPECT_EQ(n, b.at(s)->data().getN());
+            }
+        });
+        EXPECT_EQ(byte_size, map.getByteSize());
+    }
+}
+
+TEST(Test_cslibs_ndt_2d, testRollingOccupancyMapClearing)
+{
+    using occupancy_map_t = cslibs_ndt_2d::rolling_maps::OccupancyGridmap;
+
+    occupancy_map_t map(occupancy_map_t::pose_t(), 1.0, {{4, 4}});
+
+    typename cslibs_math::linear::Pointcloud<occupancy_map_t::point_t>::Ptr cloud(
+                new cslibs_math::linear::Pointcloud<occupancy_map_t::point_t>);
+    for (int i = 0 ; i < 100 ; ++ i)
+        cloud->insert(occupancy_map_t::point_t(1.0 + 0.01 * i, 0.5));
+    cloud->insert(occupancy_map_t::point_t(50.0, 0.0));
+    map.insert(cloud);
+
+    cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    EXPECT_GT(map.sampleNonNormalized(occupancy_map_t::point_t(1.5, 0.5), ivm), 0.0);
+    EXPECT_EQ(map.sampleNonNormalized(occupancy_map_t::point_t(50.0, 0.0), ivm), 0.0);
+
+    std::size_t allocated = 0;
+    map.traverse([&allocated](const occupancy_map_t::index_t &, const occupancy_map_t::distribution_bundle_t &) {
+        ++ allocated;
+    });
+    EXPECT_GT(allocated, 2ul);
+
+    map.moveTo(occupancy_map_t::point_t(100.0, 0.0));
+    allocated = 0;
+    map.traverse([&allocated](const occupancy_map_t::index_t &, const occupancy_map_t::distribution_bundle_t &) {
+        ++ allocated;
+    });
+    EXPECT_EQ(allocated, 0ul);
+    EXPECT_EQ(map.sampleNonNormalized(occupancy_map_t::point_t(1.5, 0.5), ivm), 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
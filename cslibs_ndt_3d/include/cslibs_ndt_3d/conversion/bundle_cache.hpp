@@ -0,0 +1,341 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_BUNDLE_CACHE_HPP
+#define CSLIBS_NDT_3D_CONVERSION_BUNDLE_CACHE_HPP
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <unordered_set>
+
+#include <cslibs_ndt/common/dirty_blocks.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/morton.hpp>
+
+#include <cslibs_ndt_3d/conversion/conversion_traits.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief Result of the conversion of a bundle.
+ */
+template<typename value_t>
+struct Converted
+{
+    bool    valid = false;  /// false if the bundle is left out
+    value_t value;
+};
+
+/// bundles per chunk, the chunks of a range only depend on its size
+static constexpr std::size_t chunk_size = 1024;
+
+inline std::size_t chunkCount(const std::size_t n)
+{
+    return (n + chunk_size - 1) / chunk_size;
+}
+
+/**
+ * @brief Process a range in contiguous chunks in parallel. Several passes
+ *        over a range see the same chunks.
+ * @param function      (std::size_t chunk, std::size_t begin, std::size_t end),
+ *                      called concurrently for different chunks
+ * @param num_threads   number of threads
+ */
+template<typename Fn>
+inline void chunks(const std::size_t  n,
+                   const Fn          &function,
+                   const std::size_t  num_threads = std::thread::hardware_concurrency())
+{
+    const std::size_t count = chunkCount(n);
+    std::atomic<std::size_t> next(0);
+    auto run = [&function, &next, count, n]() {
+        for (std::size_t c = next++ ; c < count ; c = next++)
+            function(c, c * chunk_size, std::min(n, (c + 1) * chunk_size));
+    };
+
+    const std::size_t threads = std::max<std::size_t>(1, std::min(num_threads, count));
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1 ; t < threads ; ++t)
+        workers.emplace_back(run);
+    run();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+/**
+ * @brief The bundles of a map in the order of the traversal of its
+ *        conversion traits.
+ */
+template<typename map_t,
+         typename index_t  = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::index_t,
+         typename bundle_t = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t>
+inline std::vector<std::pair<index_t, bundle_t>> bundles(const map_t &src)
+{
+    std::vector<std::pair<index_t, bundle_t>> bs;
+    cslibs_ndt::conversion::conversion_traits_t<map_t>::traverse(src, [&bs](const index_t &bi, const bundle_t &b) {
+        bs.emplace_back(bi, b);
+    });
+    return bs;
+}
+
+/**
+ * @brief Computes the lazily evaluated members of a distribution of a map.
+ */
+struct PrepareDistribution
+{
+    template<typename distribution_t>
+    inline void operator()(const distribution_t &d) const
+    {
+        d.data().getCovariance();
+    }
+};
+
+/**
+ * @brief Same for occupancy maps. Occupancies are evaluated on demand, the
+ *        moments are prepared under the lock of the cell, so that several
+ *        conversions of the same map may run at once.
+ */
+struct PrepareOccupancy
+{
+    template<typename distribution_t>
+    inline void operator()(const distribution_t &d) const
+    {
+        d.prepare();
+    }
+};
+
+/**
+ * @brief Whether the neighbours of an allocated bundle of a map are visited
+ *        by traversePartiallyAllocatedBundles.
+ */
+struct PopulatedDistribution
+{
+    template<typename bundle_t>
+    inline bool operator()(const bundle_t &b) const
+    {
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            if (b.at(i)->data().getN() >= 3)
+                return true;
+        return false;
+    }
+};
+
+/**
+ * @brief Same for occupancy maps.
+ */
+struct PopulatedOccupancy
+{
+    template<typename bundle_t>
+    inline bool operator()(const bundle_t &b) const
+    {
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            if (b.at(i)->getDistribution() && b.at(i)->getDistribution()->getN() >= 3)
+                return true;
+        return false;
+    }
+};
+
+/**
+ * @brief Convert a sequence of bundles in parallel. Distributions are shared
+ *        between neighbouring bundles, so whatever they compute lazily is
+ *        computed sequentially first and only read while converting.
+ * @param prepare   (const distribution_t &d), called sequentially
+ * @param convert   (const index_t &bi, const bundle_t &b, value_t &v) -> bool,
+ *                  false if the bundle is left out, called concurrently
+ */
+template<typename value_t, typename index_t, typename bundle_t, typename Prepare, typename Convert>
+inline std::vector<Converted<value_t>> convert(const std::vector<std::pair<index_t, bundle_t>> &bundles,
+                                               const Prepare                                    &prepare,
+                                               const Convert                                    &convert,
+                                               const std::size_t                                 num_threads = std::thread::hardware_concurrency())
+{
+    for (const auto &b : bundles)
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            if (b.second.at(i))
+                prepare(*b.second.at(i));
+
+    std::vector<Converted<value_t>> converted(bundles.size());
+    chunks(bundles.size(), [&bundles, &convert, &converted](std::size_t, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin ; i < end ; ++i)
+            converted[i].valid = convert(bundles[i].first, bundles[i].second, converted[i].value);
+    }, num_threads);
+    return converted;
+}
+
+/**
+ * @brief Concatenate the valid values of a sequence of converted bundles in
+ *        order. The values per chunk are counted first, so the destination is
+ *        sized once and every chunk writes to its final position directly.
+ * @param at        (std::size_t i) -> const Converted<value_t>&
+ * @param resize    (std::size_t count), called once
+ * @param write     (std::size_t position, const value_t &v), called concurrently
+ */
+template<typename At, typename Resize, typename Write>
+inline void concatenate(const std::size_t  n,
+                        const At          &at,
+                        const Resize      &resize,
+                        const Write       &write,
+                        const std::size_t  num_threads = std::thread::hardware_concurrency())
+{
+    std::vector<std::size_t> offsets(chunkCount(n) + 1, 0);
+    chunks(n, [&at, &offsets](std::size_t c, std::size_t begin, std::size_t end) {
+        std::size_t count = 0;
+        for (std::size_t i = begin ; i < end ; ++i)
+            count += at(i).valid ? 1 : 0;
+        offsets[c + 1] = count;
+    }, num_threads);
+    for (std::size_t c = 1 ; c < offsets.size() ; ++c)
+        offsets[c] += offsets[c - 1];
+
+    resize(offsets.back());
+    chunks(n, [&at, &offsets, &write](std::size_t c, std::size_t begin, std::size_t end) {
+        std::size_t position = offsets[c];
+        for (std::size_t i = begin ; i < end ; ++i)
+            if (at(i).valid)
+                write(position++, at(i).value);
+    }, num_threads);
+}
+}
+
+/**
+ * @brief Converted bundles of a map which are kept between conversions, so
+ *        that only the bundles which might have changed with a set of dirty
+ *        blocks are looked up and converted again. A cache is meant for one
+ *        map and one set of conversion parameters, otherwise it has to be
+ *        cleared.
+ */
+template<typename value_t>
+class BundleCache
+{
+public:
+    using index_t        = std::array<int, 3>;
+    using entry_t        = impl::Converted<value_t>;
+    using dirty_blocks_t = cslibs_ndt::DirtyBlocks<index_t>;
+
+    inline void clear()
+    {
+        entries_.clear();
+        initialized_ = false;
+    }
+
+    inline std::size_t size() const
+    {
+        return entries_.size();
+    }
+
+    /**
+     * @brief Clear the cache if the time of a decaying map changed since the
+     *        last conversion, as its occupancies change without updates.
+     * @param time          time of the map
+     * @param time_constant decay constant of the map
+     */
+    inline void expire(const double time,
+                       const double time_constant)
+    {
+        if (time_constant > 0.0 && time != time_)
+            clear();
+        time_ = time;
+    }
+
+    /**
+     * @brief Bring the cache up to date with a map. The first update converts
+     *        all bundles, later ones only the bundles within the bounds of the
+     *        dirty blocks, which contain the neighbours sharing distributions.
+     *        Bundles are kept as traversePartiallyAllocatedBundles visits
+     *        them, i.e. allocated ones and the neighbours of populated ones.
+     * @param dirty     changed blocks since the last update, as fetched from
+     *                  the map
+     * @param populated (const bundle_t &b), true if the neighbourhood of the
+     *                  bundle is kept
+     * @param prepare   (const distribution_t &d), see impl::convert
+     * @param convert   (const index_t &bi, const const_bundle_t &b, value_t &v)
+     *                  -> bool, false if the bundle is left out, called
+     *                  concurrently
+     * @return the entries in Z-order of their bundle indices
+     */
+    template<typename map_t, typename Populated, typename Prepare, typename Convert>
+    inline std::vector<const entry_t*> update(const map_t          &src,
+                                              const dirty_blocks_t &dirty,
+                                              const Populated      &populated,
+                                              const Prepare        &prepare,
+                                              const Convert        &convert,
+                                              const std::size_t     num_threads = std::thread::hardware_concurrency())
+    {
+        using bundle_t       = typename map_t::distribution_bundle_t;
+        using const_bundle_t = typename map_t::distribution_const_bundle_t;
+        using set_t          = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+
+        std::vector<std::pair<index_t, const_bundle_t>> changed;
+        if (!initialized_) {
+            changed      = impl::bundles(src);
+            initialized_ = true;
+        } else {
+            set_t visit, keep;
+            dirty.traverse([&src, &visit, &keep, &populated](const index_t &min_bi, const index_t &max_bi) {
+                auto inside = [&min_bi, &max_bi](const index_t &bi) {
+                    return bi[0] >= min_bi[0] && bi[0] <= max_bi[0] &&
+                           bi[1] >= min_bi[1] && bi[1] <= max_bi[1] &&
+                           bi[2] >= min_bi[2] && bi[2] <= max_bi[2];
+                };
+                for (int z = min_bi[2] ; z <= max_bi[2] ; ++z)
+                    for (int y = min_bi[1] ; y <= max_bi[1] ; ++y)
+                        for (int x = min_bi[0] ; x <= max_bi[0] ; ++x)
+                            visit.insert({{x, y, z}});
+
+                /// populated bundles just outside keep their neighbours inside
+                const index_t lo = {{min_bi[0] - 1, min_bi[1] - 1, min_bi[2] - 1}};
+                const index_t hi = {{max_bi[0] + 1, max_bi[1] + 1, max_bi[2] + 1}};
+                src.traverse(lo, hi, [&keep, &populated, &inside](const index_t &bi, const bundle_t &b) {
+                    if (inside(bi))
+                        keep.insert(bi);
+                    if (!populated(b))
+                        return;
+                    for (int i = -1 ; i <= 1 ; ++i)
+                        for (int j = -1 ; j <= 1 ; ++j)
+                            for (int k = -1 ; k <= 1 ; ++k) {
+                                const index_t n = {{bi[0] + i, bi[1] + j, bi[2] + k}};
+                                if (inside(n))
+                                    keep.insert(n);
+                            }
+                });
+            });
+
+            const_bundle_t b;
+            for (const index_t &bi : visit) {
+                if (keep.find(bi) == keep.end()) {
+                    entries_.erase(key(bi));
+                    continue;
+                }
+                src.lookupDistributionBundle(bi, b);
+                changed.emplace_back(bi, b);
+            }
+        }
+
+        std::vector<entry_t> converted = impl::convert<value_t>(changed, prepare, convert, num_threads);
+        for (std::size_t i = 0 ; i < changed.size() ; ++i)
+            entries_[key(changed[i].first)] = std::move(converted[i]);
+
+        std::vector<const entry_t*> entries;
+        entries.reserve(entries_.size());
+        for (const auto &e : entries_)
+            entries.emplace_back(&e.second);
+        return entries;
+    }
+
+private:
+    /// Z-order code relative to the lowest index which fits 21 bits per dimension
+    static inline uint64_t key(const index_t &bi)
+    {
+        static const index_t offset = {{-(1 << 20), -(1 << 20), -(1 << 20)}};
+        return cslibs_ndt::morton::encode(bi, offset);
+    }
+
+    std::map<uint64_t, entry_t> entries_;
+    bool                        initialized_ = false;
+    double                      time_        = 0.0;
+};
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_BUNDLE_CACHE_HPP
@@ -0,0 +1,73 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_CONVERSION_TRAITS_HPP
+#define CSLIBS_NDT_3D_CONVERSION_CONVERSION_TRAITS_HPP
+
+#include <cslibs_ndt/conversion/conversion_traits.hpp>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+/**
+ * @brief Conversion traits of the maps of bundles of eight distributions,
+ *        which are all read through the same members.
+ */
+template<typename MapT, bool Occupancy, bool Bounded>
+struct BundleConversionTraits
+{
+    static constexpr bool OCCUPANCY = Occupancy;
+    static constexpr bool BOUNDED   = Bounded;
+
+    using index_t  = typename MapT::index_t;
+    using bundle_t = typename MapT::distribution_const_bundle_t;
+
+    static inline bool lookup(const MapT    &map,
+                              const index_t &bi,
+                              bundle_t      &bundle)
+    {
+        return map.lookupDistributionBundle(bi, bundle);
+    }
+
+    /**
+     * @brief Traverse the bundles as allocatePartiallyAllocatedBundles would
+     *        leave them, in Z-order, without modifying the map.
+     * @param function  (const index_t &bi, const bundle_t &b)
+     */
+    template<typename Fn>
+    static inline void traverse(const MapT &map,
+                                const Fn   &function)
+    {
+        map.traversePartiallyAllocatedBundles(function);
+    }
+};
+}
+}
+
+namespace cslibs_ndt {
+namespace conversion {
+/// the conversions of 3D maps sample double precision moments
+template<>
+struct ConversionTraits<cslibs_ndt_3d::dynamic_maps::Gridmap> :
+        cslibs_ndt_3d::conversion::BundleConversionTraits<cslibs_ndt_3d::dynamic_maps::Gridmap, false, false> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_3d::dynamic_maps::OrderedGridmap> :
+        cslibs_ndt_3d::conversion::BundleConversionTraits<cslibs_ndt_3d::dynamic_maps::OrderedGridmap, false, false> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_3d::static_maps::Gridmap> :
+        cslibs_ndt_3d::conversion::BundleConversionTraits<cslibs_ndt_3d::static_maps::Gridmap, false, true> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_3d::dynamic_maps::OccupancyGridmap> :
+        cslibs_ndt_3d::conversion::BundleConversionTraits<cslibs_ndt_3d::dynamic_maps::OccupancyGridmap, true, false> {};
+
+template<>
+struct ConversionTraits<cslibs_ndt_3d::static_maps::OccupancyGridmap> :
+        cslibs_ndt_3d::conversion::BundleConversionTraits<cslibs_ndt_3d::static_maps::OccupancyGridmap, true, true> {};
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_CONVERSION_TRAITS_HPP
@@ -0,0 +1,156 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_DISTANCE_FIELD_HPP
+#define CSLIBS_NDT_3D_CONVERSION_DISTANCE_FIELD_HPP
+
+#include <unordered_set>
+
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt_3d/voxel_grids/distance_field.hpp>
+
+#include <cslibs_ndt_3d/conversion/raster.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief Kernels of the distributions of a bundle which are occupied at the
+ *        time of the map.
+ */
+struct Obstacles
+{
+    const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model;
+    const double                                       threshold;
+    const double                                       time;
+    const double                                       time_constant;
+
+    template<typename bundle_t>
+    inline void operator()(const bundle_t &bundle,
+                           Cell           &cell) const
+    {
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d && d->getDistribution() && d->getOccupancy(inverse_model, time, time_constant) >= threshold)
+                cell.add(*d->getDistribution(), 1.0);
+        }
+    }
+};
+
+/**
+ * @brief Set the obstacles of the blocks of a set of bundles. Voxels are
+ *        obstacles within the given number of standard deviations of an
+ *        occupied distribution, bundles without such are cleared.
+ */
+template<typename map_t>
+inline void setObstacles(const map_t                               &src,
+                         const std::vector<index_t>                &bundles,
+                         cslibs_ndt_3d::voxel_grids::DistanceField &dst,
+                         const Obstacles                           &kernels,
+                         const double                               extent)
+{
+    using set_t = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+
+    const cells_t cs    = cells(src, bundles, kernels);
+    const double  limit = std::exp(-0.5 * extent * extent);
+
+    std::vector<std::vector<bool>> obstacles(cs.size());
+    rasterize(cs, dst.getBlockSize(), steps(src.getInitialOrigin(), dst.getResolution()),
+              [&cs, &obstacles, limit](const Cell &c, const Eigen::ArrayXd &v) {
+        std::vector<bool> &o = obstacles[&c - cs.data()];
+        o.resize(v.size());
+        for (int i = 0 ; i < v.size() ; ++i)
+            o[i] = v(i) >= limit;
+    });
+
+    set_t occupied;
+    for (std::size_t i = 0 ; i < cs.size() ; ++i) {
+        dst.setObstacles(cs[i].bundle, obstacles[i]);
+        occupied.insert(cs[i].bundle);
+    }
+    for (const index_t &bi : bundles)
+        if (occupied.find(bi) == occupied.end())
+            dst.setObstacles(bi, std::vector<bool>());
+    dst.update();
+}
+}
+
+/**
+ * @brief Distance field of the occupied distributions of a map, with a block
+ *        of voxels per bundle. The map is not modified.
+ * @param maximum_distance  distances are truncated to this
+ * @param threshold         distributions with a lower occupancy are free
+ * @param extent            voxels within this many standard deviations of an
+ *                          occupied distribution are obstacles
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::voxel_grids::DistanceField::Ptr &dst,
+        const double &sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double &maximum_distance = 2.0,
+        const double &threshold        = 0.5,
+        const double &extent           = 2.0)
+{
+    if (!src || !inverse_model)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::voxel_grids::DistanceField;
+    using index_t   = std::array<int, 3>;
+    using traits_t  = cslibs_ndt::conversion::conversion_traits_t<map_t>;
+    using bundle_t  = typename traits_t::bundle_t;
+
+    const int chunk_step = static_cast<int>(src->getBundleResolution() / sampling_resolution);
+    dst.reset(new dst_map_t(src->getInitialOrigin(), sampling_resolution, chunk_step, maximum_distance));
+
+    std::vector<index_t> bundles;
+    traits_t::traverse(*src, [&bundles](const index_t &bi, const bundle_t &) {
+        bundles.emplace_back(bi);
+    });
+    impl::setObstacles(*src, bundles, *dst, impl::Obstacles{inverse_model, threshold, src->getTime(), src->getDecay()}, extent);
+}
+
+/**
+ * @brief Update a distance field in place, only the obstacles of the bundles
+ *        which might have changed with a set of dirty blocks are recomputed
+ *        and the distances around them propagated. Falls back to a full
+ *        conversion if there is no compatible field yet.
+ * @param dirty     changed blocks, as fetched from the map
+ */
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        cslibs_ndt_3d::voxel_grids::DistanceField::Ptr &dst,
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::dirty_blocks_t &dirty,
+        const double &sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double &maximum_distance = 2.0,
+        const double &threshold        = 0.5,
+        const double &extent           = 2.0)
+{
+    if (!src || !inverse_model)
+        return;
+    if (!dst || dst->getResolution() != sampling_resolution ||
+            dst->getMaximumDistance() != maximum_distance) {
+        from(src, dst, sampling_resolution, inverse_model, maximum_distance, threshold, extent);
+        return;
+    }
+
+    using index_t = std::array<int, 3>;
+    using set_t   = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+
+    /// the bounds of the dirty blocks already contain the neighbours sharing distributions
+    set_t visit;
+    dirty.traverse([&visit](const index_t &min_bi, const index_t &max_bi) {
+        for (int z = min_bi[2] ; z <= max_bi[2] ; ++z)
+            for (int y = min_bi[1] ; y <= max_bi[1] ; ++y)
+                for (int x = min_bi[0] ; x <= max_bi[0] ; ++x)
+                    visit.insert({{x, y, z}});
+    });
+
+    const std::vector<index_t> bundles(visit.begin(), visit.end());
+    impl::setObstacles(*src, bundles, *dst, impl::Obstacles{inverse_model, threshold, src->getTime(), src->getDecay()}, extent);
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_DISTANCE_FIELD_HPP
@@ -3,13 +3,19 @@
 
 #include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
 #include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt_3d/conversion/bundle_cache.hpp>
 
 #include <cslibs_ndt_3d/DistributionArray.h>
 
+#include <unordered_set>
+
 namespace cslibs_ndt_3d {
 namespace conversion {
 inline Distribution from(const cslibs_math::statistics::Distribution<3, 3> &d,
-                         const int &id,
+                         const uint64_t &id,
                          const double &prob)
 {
     Distribution distr;
@@ -26,104 +32,434 @@ inline Distribution from(const cslibs_math::statistics::Distribution<3, 3> &d,
     return distr;
 }
 
+namespace impl {
+/**
+ * @brief Id of a bundle packed from its index, 21 bits per dimension, which
+ *        is the same for full and incremental conversions.
+ */
+inline uint64_t id(const std::array<int, 3> &bi)
+{
+    return (static_cast<uint64_t>(bi[0] & 0x1fffff) << 42) |
+           (static_cast<uint64_t>(bi[1] & 0x1fffff) << 21) |
+            static_cast<uint64_t>(bi[2] & 0x1fffff);
+}
+
+/**
+ * @brief Sum of the distributions of a bundle and the mixture of them sampled
+ *        at its mean, false if it is empty.
+ */
+inline bool combine(const cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t &b,
+                    cslibs_math::statistics::Distribution<3, 3> &d,
+                    double &prob)
+{
+    using point_t        = cslibs_math_3d::Point3d;
+    using distribution_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_t;
+    auto sample = [](const distribution_t *d,
+                     const point_t &p) -> double {
+        return d ? d->data().sampleNonNormalized(p) : 0.0;
+    };
+
+    for (std::size_t i = 0; i < 8; ++ i)
+        if (b.at(i))
+            d += b.at(i)->data();
+    if (d.getN() == 0)
+        return false;
+
+    const point_t mean(d.getMean());
+    prob = 0.0;
+    for (std::size_t i = 0; i < 8; ++ i)
+        prob += sample(b.at(i), mean);
+    prob *= 0.125;
+    return true;
+}
+
+/**
+ * @brief Same for occupancy maps, false if the bundle is empty or below the
+ *        threshold, the sum is computed anyway.
+ * @param prior         occupancy of distributions which are not allocated
+ * @param time          time of the map, occupancies are decayed up to it
+ * @param time_constant decay constant of the map
+ */
+inline bool combine(const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t &b,
+                    cslibs_math::statistics::Distribution<3, 3> &d,
+                    double &prob,
+                    const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+                    const double &threshold,
+                    const double prior,
+                    const double time,
+                    const double time_constant)
+{
+    using point_t        = cslibs_math_3d::Point3d;
+    using distribution_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t;
+    auto sample = [&ivm, time, time_constant](const distribution_t *d,
+                                              const point_t &p) -> double {
+        return d && d->getDistribution() ?
+                    d->getDistribution()->sampleNonNormalized(p) * d->getOccupancy(ivm, time, time_constant) : 0.0;
+    };
+
+    double occupancy = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++i) {
+        const distribution_t *handle = b.at(i);
+        occupancy += 0.125 * (handle ? handle->getOccupancy(ivm, time, time_constant) : prior);
+        if (handle && handle->getDistribution())
+            d += *handle->getDistribution();
+    }
+    if (d.getN() == 0 || occupancy < threshold)
+        return false;
+
+    const point_t mean(d.getMean());
+    prob = 0.0;
+    for (std::size_t i = 0; i < 8; ++ i)
+        prob += sample(b.at(i), mean);
+    prob *= 0.125;
+    return true;
+}
+
+/**
+ * @brief Distribution of a bundle, false if it is empty.
+ */
+inline bool from(const std::array<int, 3> &bi,
+                 const cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t &b,
+                 Distribution &dst)
+{
+    cslibs_math::statistics::Distribution<3, 3> d;
+    double prob;
+    if (!combine(b, d, prob))
+        return false;
+
+    dst = conversion::from(d, id(bi), prob);
+    return true;
+}
+
+inline void from(const std::array<int, 3> &bi,
+                 const cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t &b,
+                 cslibs_ndt_3d::DistributionArray &dst)
+{
+    Distribution distr;
+    if (from(bi, b, distr))
+        dst.data.emplace_back(distr);
+}
+
+/**
+ * @param prior     occupancy of distributions which are not allocated
+ * @param hidden    also convert bundles below the threshold, with probability 0
+ */
+inline bool from(const std::array<int, 3> &bi,
+                 const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t &b,
+                 Distribution &dst,
+                 const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+                 const double &threshold,
+                 const double prior,
+                 const double time,
+                 const double time_constant,
+                 const bool hidden)
+{
+    cslibs_math::statistics::Distribution<3, 3> d;
+    double prob;
+    if (combine(b, d, prob, ivm, threshold, prior, time, time_constant))
+        dst = conversion::from(d, id(bi), prob);
+    else if (hidden)
+        dst = conversion::from(d, id(bi), 0.0);
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @param hidden    also convert bundles below the threshold, with probability 0
+ */
+inline void from(const std::array<int, 3> &bi,
+                 const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t &b,
+                 cslibs_ndt_3d::DistributionArray &dst,
+                 const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+                 const double &threshold,
+                 const double time,
+                 const double time_constant,
+                 const bool hidden)
+{
+    using distribution_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t;
+
+    /// distributions which are not allocated count with the prior occupancy
+    Distribution distr;
+    if (from(bi, b, distr, ivm, threshold, distribution_t().getOccupancy(ivm), time, time_constant, hidden))
+        dst.data.emplace_back(distr);
+}
+
+/**
+ * @brief Write the valid ones of a sequence of converted distributions into
+ *        an array, which is sized once.
+ * @param at    (std::size_t i) -> const Converted<Distribution>&
+ */
+template<typename At>
+inline void write(const std::size_t                 n,
+                  const At                         &at,
+                  cslibs_ndt_3d::DistributionArray &dst)
+{
+    auto resize = [&dst](const std::size_t count) {
+        dst.data.resize(count);
+    };
+    auto write = [&dst](const std::size_t position, const Distribution &d) {
+        dst.data[position] = d;
+    };
+    concatenate(n, at, resize, write);
+}
+
+/**
+ * @brief Visit every bundle which might have changed with the dirty blocks
+ *        once, including the neighbours of populated bundles among them,
+ *        which are looked up without being allocated, so the cost is
+ *        proportional to the changed area.
+ * @param populated     (const bundle_t &b), true if the neighbourhood of the
+ *                      bundle has to be visited
+ * @param function      (const index_t &bi, const const_bundle_t &b)
+ */
+template<typename map_t, typename Populated, typename Fn>
+inline void traverseDirty(const map_t                            &src,
+                          const typename map_t::dirty_blocks_t   &dirty,
+                          const Populated                        &populated,
+                          const Fn                               &function)
+{
+    using index_t        = typename map_t::index_t;
+    using bundle_t       = typename map_t::distribution_bundle_t;
+    using const_bundle_t = typename map_t::distribution_const_bundle_t;
+    using set_t          = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+
+    set_t visit;
+    dirty.traverse([&src, &visit, &populated](const index_t &min_bi, const index_t &max_bi) {
+        src.traverse(min_bi, max_bi, [&visit, &populated](const index_t &bi, const bundle_t &b) {
+            visit.insert(bi);
+            if (!populated(b))
+                return;
+            for (int i = -1 ; i <= 1 ; ++i)
+                for (int j = -1 ; j <= 1 ; ++j)
+                    for (int k = -1 ; k <= 1 ; ++k)
+                        visit.insert({{bi[0] + i, bi[1] + j, bi[2] + k}});
+        });
+    });
+
+    const_bundle_t b;
+    for (const index_t &bi : visit) {
+        src.lookupDistributionBundle(bi, b);
+        function(bi, b);
+    }
+}
+}
+
+/**
+ * @brief One distribution per bundle, the bundles are converted in parallel
+ *        and stored in the order of their traversal.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::DistributionArray::Ptr &dst)
+{
+    if (!src)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::DistributionArray;
+    dst.reset(new dst_map_t());
+
+    using index_t  = std::array<int, 3>;
+    using bundle_t = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+    auto convert = [](const index_t &bi, const bundle_t &b, Distribution &d) {
+        return impl::from(bi, b, d);
+    };
+    const impl::PrepareDistribution prepare;
+
+    const auto bundles   = impl::bundles(*src);
+    const auto converted = impl::convert<Distribution>(bundles, prepare, convert);
+    impl::write(converted.size(), [&converted](const std::size_t i) -> const impl::Converted<Distribution>& {
+        return converted[i];
+    }, *dst);
+}
+
+/**
+ * @brief Same, in Z-order of the bundle indices. The distributions of
+ *        bundles which did not change since the last conversion with the
+ *        cache are reused instead of decomposed again.
+ * @param dirty     changed blocks since the last conversion with the cache,
+ *                  as fetched from the map
+ * @param cache     distributions per bundle
+ */
 inline void from(
         const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &src,
-        cslibs_ndt_3d::DistributionArray::Ptr &dst)
+        cslibs_ndt_3d::DistributionArray::Ptr &dst,
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::dirty_blocks_t &dirty,
+        BundleCache<Distribution> &cache)
 {
     if (!src)
         return;
-    src->allocatePartiallyAllocatedBundles();
 
-    using point_t   = cslibs_math_3d::Point3d;
     using dst_map_t = cslibs_ndt_3d::DistributionArray;
     dst.reset(new dst_map_t());
 
-    using distribution_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_t;
-    using distribution_bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t;
-    auto sample = [](const distribution_t *d,
-                     const point_t &p) -> double {
-        return d ? d->data().sampleNonNormalized(p) : 0.0;
+    using index_t  = std::array<int, 3>;
+    using bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t;
+    using entry_t  = BundleCache<Distribution>::entry_t;
+    auto convert = [](const index_t &bi, const bundle_t &b, Distribution &d) {
+        return impl::from(bi, b, d);
     };
-    auto sample_bundle = [&sample](const distribution_bundle_t &b,
-                                   const point_t &p) -> double {
-        return 0.125 * (sample(b.at(0), p) +
-                        sample(b.at(1), p) +
-                        sample(b.at(2), p) +
-                        sample(b.at(3), p) +
-                        sample(b.at(4), p) +
-                        sample(b.at(5), p) +
-                        sample(b.at(6), p) +
-                        sample(b.at(7), p));
+
+    const std::vector<const entry_t*> entries =
+            cache.update(*src, dirty, impl::PopulatedDistribution(), impl::PrepareDistribution(), convert);
+    impl::write(entries.size(), [&entries](const std::size_t i) -> const entry_t& {
+        return *entries[i];
+    }, *dst);
+}
+
+/**
+ * @brief Convert the bundles which might have changed with a set of dirty
+ *        blocks only, receivers update their distributions by id. Bundles
+ *        removed by pruning are not reported.
+ * @param src       the map
+ * @param dst       the changed distributions
+ * @param dirty     changed blocks, as fetched from the map
+ */
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &src,
+        cslibs_ndt_3d::DistributionArray::Ptr &dst,
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::dirty_blocks_t &dirty)
+{
+    if (!src)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::DistributionArray;
+    dst.reset(new dst_map_t());
+
+    using index_t                     = std::array<int, 3>;
+    using distribution_bundle_t       = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t;
+    using distribution_const_bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t;
+    auto populated = [](const distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            if (b.at(i)->data().getN() >= 3)
+                return true;
+        return false;
+    };
+    auto process_bundle = [&dst](const index_t &bi, const distribution_const_bundle_t &b) {
+        impl::from(bi, b, *dst);
     };
 
-    using index_t = std::array<int, 3>;
-    auto process_bundle = [&dst, &sample_bundle](const index_t &bi, const distribution_bundle_t &b) {
-        distribution_t::distribution_t d;
-        for (std::size_t i = 0; i < 8; ++ i)
-            d += b.at(i)->data();
-        if (d.getN() == 0)
-            return;
+    impl::traverseDirty(*src, dirty, populated, process_bundle);
+}
 
-        dst->data.emplace_back(from(d, b.id(), sample_bundle(b, point_t(d.getMean()))));
+/**
+ * @brief One distribution per bundle above the threshold, the bundles are
+ *        converted in parallel and stored in the order of their traversal.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::DistributionArray::Ptr &dst,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+        const double &threshold = 0.169)
+{
+    if (!src)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::DistributionArray;
+    dst.reset(new dst_map_t());
+
+    using index_t        = std::array<int, 3>;
+    using distribution_t = typename map_t::distribution_t;
+    using bundle_t       = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+
+    /// distributions which are not allocated count with the prior occupancy
+    const double prior         = distribution_t().getOccupancy(ivm);
+    const double time          = src->getTime();
+    const double time_constant = src->getDecay();
+    auto convert = [&ivm, &threshold, prior, time, time_constant](const index_t &bi, const bundle_t &b, Distribution &d) {
+        return impl::from(bi, b, d, ivm, threshold, prior, time, time_constant, false);
     };
+    const impl::PrepareOccupancy prepare;
 
-    src->traverse(process_bundle);
+    const auto bundles   = impl::bundles(*src);
+    const auto converted = impl::convert<Distribution>(bundles, prepare, convert);
+    impl::write(converted.size(), [&converted](const std::size_t i) -> const impl::Converted<Distribution>& {
+        return converted[i];
+    }, *dst);
 }
 
+/**
+ * @brief Same, in Z-order of the bundle indices. The distributions of
+ *        bundles which did not change since the last conversion with the
+ *        cache are reused instead of decomposed again.
+ * @param dirty     changed blocks since the last conversion with the cache,
+ *                  as fetched from the map
+ * @param cache     distributions per bundle
+ */
 inline void from(
         const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &src,
         cslibs_ndt_3d::DistributionArray::Ptr &dst,
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::dirty_blocks_t &dirty,
+        BundleCache<Distribution> &cache,
         const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
         const double &threshold = 0.169)
 {
     if (!src)
         return;
-    src->allocatePartiallyAllocatedBundles();
 
-    using point_t   = cslibs_math_3d::Point3d;
     using dst_map_t = cslibs_ndt_3d::DistributionArray;
     dst.reset(new dst_map_t());
 
+    using index_t        = std::array<int, 3>;
     using distribution_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t;
-    using distribution_bundle_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t;
-    auto sample = [&ivm](const distribution_t *d,
-                         const point_t &p) -> double {
-        auto evaluate = [&ivm, d, p] {
-            const auto &handle = d;
-            return d && handle->getDistribution() ?
-                        handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm) : 0.0;
-        };
-        return d ? evaluate() : 0.0;
+    using bundle_t       = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t;
+    using entry_t        = BundleCache<Distribution>::entry_t;
+
+    const double prior         = distribution_t().getOccupancy(ivm);
+    const double time          = src->getTime();
+    const double time_constant = src->getDecay();
+    auto convert = [&ivm, &threshold, prior, time, time_constant](const index_t &bi, const bundle_t &b, Distribution &d) {
+        return impl::from(bi, b, d, ivm, threshold, prior, time, time_constant, false);
     };
-    auto sample_bundle = [&sample](const distribution_bundle_t &b,
-                                   const point_t &p) -> double {
-        return 0.125 * (sample(b.at(0), p) +
-                        sample(b.at(1), p) +
-                        sample(b.at(2), p) +
-                        sample(b.at(3), p) +
-                        sample(b.at(4), p) +
-                        sample(b.at(5), p) +
-                        sample(b.at(6), p) +
-                        sample(b.at(7), p));
-    };    
-
-    using index_t = std::array<int, 3>;
-    auto process_bundle = [&dst, &ivm, &threshold, &sample_bundle](const index_t &bi, const distribution_bundle_t &b) {
-        distribution_t::distribution_t d;
-        double occupancy = 0.0;
-
-        for (std::size_t i = 0 ; i < 8 ; ++i) {
-            const auto &handle = b.at(i);
-            occupancy += 0.125 * handle->getOccupancy(ivm);
-            if (const auto &d_tmp = handle->getDistribution())
-                d += *d_tmp;
-        }
-        if (d.getN() == 0 || occupancy < threshold)
-            return;
-
-        dst->data.emplace_back(from(d, b.id(), sample_bundle(b, point_t(d.getMean()))));
+
+    cache.expire(time, time_constant);
+    const std::vector<const entry_t*> entries =
+            cache.update(*src, dirty, impl::PopulatedOccupancy(), impl::PrepareOccupancy(), convert);
+    impl::write(entries.size(), [&entries](const std::size_t i) -> const entry_t& {
+        return *entries[i];
+    }, *dst);
+}
+
+/**
+ * @brief Convert the bundles which might have changed with a set of dirty
+ *        blocks only, receivers update their distributions by id. Changed
+ *        bundles below the threshold are sent with probability 0, so they
+ *        can be removed. Bundles removed by pruning are not reported.
+ * @param src       the map
+ * @param dst       the changed distributions
+ * @param dirty     changed blocks, as fetched from the map
+ */
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &src,
+        cslibs_ndt_3d::DistributionArray::Ptr &dst,
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::dirty_blocks_t &dirty,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+        const double &threshold = 0.169)
+{
+    if (!src)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::DistributionArray;
+    dst.reset(new dst_map_t());
+
+    using index_t                     = std::array<int, 3>;
+    using distribution_bundle_t       = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t;
+    using distribution_const_bundle_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t;
+    auto populated = [](const distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            if (b.at(i)->numOccupied() >= 3)
+                return true;
+        return false;
+    };
+    const double time          = src->getTime();
+    const double time_constant = src->getDecay();
+    auto process_bundle = [&dst, &ivm, &threshold, time, time_constant](const index_t &bi, const distribution_const_bundle_t &b) {
+        impl::from(bi, b, *dst, ivm, threshold, time, time_constant, true);
     };
-    src->traverse(process_bundle);
+
+    impl::traverseDirty(*src, dirty, populated, process_bundle);
 }
 }
 }
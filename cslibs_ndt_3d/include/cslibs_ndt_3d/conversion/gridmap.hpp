@@ -6,14 +6,15 @@
 
 namespace cslibs_ndt_3d {
 namespace conversion {
-inline cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr from(
-        const cslibs_ndt_3d::static_maps::Gridmap::Ptr& src)
+template <typename T>
+inline typename cslibs_ndt_3d::dynamic_maps::GridmapT<T>::Ptr from(
+        const std::shared_ptr<cslibs_ndt_3d::static_maps::GridmapT<T>>& src)
 {
     if (!src)
         return nullptr;
 
-    using src_map_t = cslibs_ndt_3d::static_maps::Gridmap;
-    using dst_map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    using src_map_t = cslibs_ndt_3d::static_maps::GridmapT<T>;
+    using dst_map_t = cslibs_ndt_3d::dynamic_maps::GridmapT<T>;
     typename dst_map_t::Ptr dst(new dst_map_t(src->getInitialOrigin(),
                                               src->getResolution()));
 
@@ -28,8 +29,9 @@ inline cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr from(
     return dst;
 }
 
-inline cslibs_ndt_3d::static_maps::Gridmap::Ptr from(
-        const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr& src)
+template <typename T>
+inline typename cslibs_ndt_3d::static_maps::GridmapT<T>::Ptr from(
+        const std::shared_ptr<cslibs_ndt_3d::dynamic_maps::GridmapT<T>>& src)
 {
     if (!src)
         return nullptr;
@@ -43,8 +45,8 @@ inline cslibs_ndt_3d::static_maps::Gridmap::Ptr from(
     const std::array<std::size_t, 3> size =
             cslibs_math::common::cast<std::size_t>(std::ceil(cslibs_math::common::cast<double>(max_distribution_index - min_distribution_index) / 2.0));
 
-    using src_map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
-    using dst_map_t = cslibs_ndt_3d::static_maps::Gridmap;
+    using src_map_t = cslibs_ndt_3d::dynamic_maps::GridmapT<T>;
+    using dst_map_t = cslibs_ndt_3d::static_maps::GridmapT<T>;
     typename dst_map_t::Ptr dst(new dst_map_t(src->getInitialOrigin(),
                                               src->getResolution(),
                                               size,
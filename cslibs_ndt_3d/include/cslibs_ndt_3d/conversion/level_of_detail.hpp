@@ -0,0 +1,362 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_LEVEL_OF_DETAIL_HPP
+#define CSLIBS_NDT_3D_CONVERSION_LEVEL_OF_DETAIL_HPP
+
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+
+#include <Eigen/Eigenvalues>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief Inverse of id, the index of a bundle from its id.
+ */
+inline std::array<int, 3> index(const uint64_t id)
+{
+    auto extend = [](const uint64_t bits) {
+        const int v = static_cast<int>(bits & 0x1fffff);
+        return v & 0x100000 ? v - 0x200000 : v;
+    };
+    return {{extend(id >> 42), extend(id >> 21), extend(id)}};
+}
+}
+
+/**
+ * @brief Level of detail hierarchy of the distributions of a map. Level 0
+ *        holds one distribution per bundle, level k merges the moments of the
+ *        up to 8^k bundles of a block of 2^k bundles per dimension into one
+ *        distribution. The bundles are sorted in Z-order, so the children of
+ *        a node are a contiguous range of the level below.
+ *
+ *        A selection descends from the coarsest level and stops at the level
+ *        the distance to a viewpoint asks for, coarser ones are picked until
+ *        a target count is met. Nodes beyond the eviction distance are left
+ *        out.
+ */
+class LevelOfDetail
+{
+public:
+    using Ptr      = std::shared_ptr<LevelOfDetail>;
+    using ConstPtr = std::shared_ptr<const LevelOfDetail>;
+    using index_t  = std::array<int, 3>;
+
+    /**
+     * @brief Merged moments of a block of bundles.
+     */
+    struct Node
+    {
+        uint64_t        key;            /// Z-order code of the bundle at level 0
+        uint64_t        id;             /// id of the published distribution
+        double          weight;
+        Eigen::Vector3d mean;
+        Eigen::Matrix3d covariance;
+        double          prob;           /// weighted mean of the probabilities
+        double          radius;         /// bound of the distance of the children means to the mean
+        std::size_t     begin;          /// children in the level below
+        std::size_t     end;
+    };
+
+    /**
+     * @brief Constructor.
+     * @param levels    maximum number of levels, the hierarchy stops earlier
+     *                  once no nodes are merged any more
+     */
+    inline explicit LevelOfDetail(const std::size_t levels = 8) :
+        max_levels_(std::max<std::size_t>(1ul, levels))
+    {
+    }
+
+    /**
+     * @brief Build from an array of distributions, which are weighted
+     *        equally, since the messages do not carry sample counts.
+     */
+    inline void build(const cslibs_ndt_3d::DistributionArray &src)
+    {
+        std::vector<Node> nodes;
+        nodes.reserve(src.data.size());
+        for (const Distribution &d : src.data) {
+            Node n;
+            n.key    = key(impl::index(d.id.data));
+            n.id     = d.id.data;
+            n.weight = 1.0;
+            n.prob   = d.prob.data;
+            n.radius = 0.0;
+            for (int i = 0 ; i < 3 ; ++i)
+                n.mean(i) = d.mean[i].data;
+            for (int i = 0 ; i < 9 ; ++i)
+                n.covariance(i) = d.covariance[i].data;
+            nodes.emplace_back(n);
+        }
+        build(nodes);
+    }
+
+    /**
+     * @brief Build from a map, the bundles are weighted with their sample
+     *        counts and combined in parallel.
+     */
+    template<typename map_t>
+    inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> build(const map_t &src)
+    {
+        using bundle_t = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+        auto convert = [](const index_t &bi, const bundle_t &b, Node &n) {
+            cslibs_math::statistics::Distribution<3, 3> d;
+            double prob;
+            if (!impl::combine(b, d, prob))
+                return false;
+            n = node(bi, d, prob);
+            return true;
+        };
+        build(src, impl::PrepareDistribution(), convert);
+    }
+
+    /**
+     * @brief Same for occupancy maps, bundles below the threshold are left out.
+     */
+    template<typename map_t>
+    inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> build(const map_t                                     &src,
+                                                                          const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+                                                                          const double                                      threshold = 0.169)
+    {
+        using distribution_t = typename map_t::distribution_t;
+        using bundle_t       = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+
+        const double prior         = distribution_t().getOccupancy(ivm);
+        const double time          = src.getTime();
+        const double time_constant = src.getDecay();
+        auto convert = [&ivm, threshold, prior, time, time_constant](const index_t &bi, const bundle_t &b, Node &n) {
+            cslibs_math::statistics::Distribution<3, 3> d;
+            double prob;
+            if (!impl::combine(b, d, prob, ivm, threshold, prior, time, time_constant))
+                return false;
+            n = node(bi, d, prob);
+            return true;
+        };
+        build(src, impl::PrepareOccupancy(), convert);
+    }
+
+    inline std::size_t getLevels() const
+    {
+        return levels_.size();
+    }
+
+    inline const std::vector<Node>& getLevel(const std::size_t level) const
+    {
+        return levels_.at(level);
+    }
+
+    /**
+     * @brief Select the distributions to show from a viewpoint.
+     * @param viewpoint         in the frame of the distributions
+     * @param detail_distance   up to this distance level 0 is shown, the level
+     *                          grows by one whenever it doubles, 0 for the
+     *                          same level everywhere
+     * @param eviction_distance nodes farther away are left out, 0 for none
+     * @param max_count         coarser levels are chosen until at most this
+     *                          many distributions are selected, unless the
+     *                          coarsest level has more, 0 for no limit
+     * @param dst               the selected distributions, their ids encode
+     *                          the level
+     * @param num_threads       threads computing the eigen decompositions
+     * @return the level offset which was needed to meet the target count
+     */
+    inline std::size_t select(const Eigen::Vector3d            &viewpoint,
+                              const double                      detail_distance,
+                              const double                      eviction_distance,
+                              const std::size_t                 max_count,
+                              cslibs_ndt_3d::DistributionArray &dst,
+                              const std::size_t                 num_threads = std::thread::hardware_concurrency()) const
+    {
+        dst.data.clear();
+        if (levels_.empty())
+            return 0;
+
+        std::vector<const Node*> selected;
+        std::size_t bias = 0;
+        for ( ; ; ++bias) {
+            selected.clear();
+            for (const Node &n : levels_.back())
+                select(n, levels_.size() - 1, viewpoint, detail_distance, eviction_distance, bias, selected);
+            if (max_count == 0 || selected.size() <= max_count || bias + 1 >= levels_.size())
+                break;
+        }
+
+        dst.data.resize(selected.size());
+        impl::chunks(selected.size(), [&selected, &dst](std::size_t, std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin ; i < end ; ++i)
+                dst.data[i] = from(*selected[i]);
+        }, num_threads);
+        return bias;
+    }
+
+    /**
+     * @brief Id of a node which is not at level 0, which are ids of bundles
+     *        with the highest bit unset. The code of the block is prefixed
+     *        with a one, whose position gives the level.
+     */
+    static inline uint64_t id(const uint64_t key,
+                              const std::size_t level)
+    {
+        const std::size_t bits = 63 - 3 * level;
+        return (1ULL << 63) | (1ULL << bits) | (key >> (3 * level));
+    }
+
+private:
+    /// Z-order code relative to the lowest index which fits 21 bits per dimension
+    static inline uint64_t key(const index_t &bi)
+    {
+        static const index_t offset = {{-(1 << 20), -(1 << 20), -(1 << 20)}};
+        return cslibs_ndt::morton::encode(bi, offset);
+    }
+
+    static inline Node node(const index_t                                     &bi,
+                            const cslibs_math::statistics::Distribution<3, 3> &d,
+                            const double                                       prob)
+    {
+        Node n;
+        n.key        = key(bi);
+        n.id         = impl::id(bi);
+        n.weight     = static_cast<double>(d.getN());
+        n.mean       = d.getMean();
+        n.covariance = d.getCovariance();
+        n.prob       = prob;
+        n.radius     = 0.0;
+        return n;
+    }
+
+    static inline Distribution from(const Node &n)
+    {
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+        solver.computeDirect(n.covariance);
+
+        Distribution d;
+        d.id.data   = n.id;
+        d.prob.data = n.prob;
+        for (int i = 0 ; i < 3 ; ++i) {
+            d.mean[i].data         = n.mean(i);
+            d.eigen_values[i].data = solver.eigenvalues()(i);
+        }
+        for (int i = 0 ; i < 9 ; ++i) {
+            d.eigen_vectors[i].data = solver.eigenvectors()(i);
+            d.covariance[i].data    = n.covariance(i);
+        }
+        return d;
+    }
+
+    template<typename map_t, typename Prepare, typename Convert>
+    inline void build(const map_t   &src,
+                      const Prepare &prepare,
+                      const Convert &convert)
+    {
+        const auto bundles   = impl::bundles(src);
+        const auto converted = impl::convert<Node>(bundles, prepare, convert);
+
+        std::vector<Node> nodes;
+        nodes.reserve(converted.size());
+        for (const auto &c : converted)
+            if (c.valid)
+                nodes.emplace_back(c.value);
+        build(nodes);
+    }
+
+    /**
+     * @brief Merge the levels bottom up, each parent gets the moments of its
+     *        children about their common mean. The sample covariances of the
+     *        bundles are merged as they are, which deviates from the sample
+     *        covariance of all points by less than one sample per bundle.
+     */
+    inline void build(std::vector<Node> &nodes)
+    {
+        std::sort(nodes.begin(), nodes.end(), [](const Node &a, const Node &b) {
+            return a.key < b.key;
+        });
+
+        levels_.clear();
+        levels_.emplace_back();
+        levels_.back().swap(nodes);
+        while (levels_.size() < max_levels_ && levels_.back().size() > 1) {
+            const std::size_t level = levels_.size();
+            const std::vector<Node> &children = levels_.back();
+            std::vector<Node> parents;
+            for (std::size_t begin = 0, end = 0 ; begin < children.size() ; begin = end) {
+                const uint64_t block = children[begin].key >> (3 * level);
+                while (end < children.size() && children[end].key >> (3 * level) == block)
+                    ++end;
+                parents.emplace_back(merge(children, begin, end, level));
+            }
+            if (parents.size() == children.size())
+                break;
+            levels_.emplace_back(std::move(parents));
+        }
+    }
+
+    static inline Node merge(const std::vector<Node> &children,
+                             const std::size_t        begin,
+                             const std::size_t        end,
+                             const std::size_t        level)
+    {
+        Node n;
+        n.key    = children[begin].key;
+        n.id     = id(n.key, level);
+        n.weight = 0.0;
+        n.prob   = 0.0;
+        n.mean.setZero();
+        for (std::size_t i = begin ; i < end ; ++i) {
+            const Node &c = children[i];
+            n.weight += c.weight;
+            n.mean   += c.weight * c.mean;
+            n.prob   += c.weight * c.prob;
+        }
+        n.mean /= n.weight;
+        n.prob /= n.weight;
+
+        n.covariance.setZero();
+        n.radius = 0.0;
+        for (std::size_t i = begin ; i < end ; ++i) {
+            const Node &c = children[i];
+            const Eigen::Vector3d delta = c.mean - n.mean;
+            n.covariance += c.weight * (c.covariance + delta * delta.transpose());
+            n.radius      = std::max(n.radius, delta.norm() + c.radius);
+        }
+        n.covariance /= n.weight;
+        n.begin = begin;
+        n.end   = end;
+        return n;
+    }
+
+    inline void select(const Node               &n,
+                       const std::size_t         level,
+                       const Eigen::Vector3d    &viewpoint,
+                       const double              detail_distance,
+                       const double              eviction_distance,
+                       const std::size_t         bias,
+                       std::vector<const Node*> &selected) const
+    {
+        /// the closest the children can be
+        const double distance = std::max(0.0, (n.mean - viewpoint).norm() - n.radius);
+        if (eviction_distance > 0.0 && distance > eviction_distance)
+            return;
+
+        std::size_t wanted = bias;
+        if (detail_distance > 0.0 && distance > detail_distance)
+            wanted += static_cast<std::size_t>(std::log2(distance / detail_distance)) + 1;
+
+        if (level == 0 || level <= wanted) {
+            selected.emplace_back(&n);
+            return;
+        }
+        const std::vector<Node> &children = levels_[level - 1];
+        for (std::size_t i = n.begin ; i < n.end ; ++i)
+            select(children[i], level - 1, viewpoint, detail_distance, eviction_distance, bias, selected);
+    }
+
+    std::size_t                    max_levels_;
+    std::vector<std::vector<Node>> levels_;
+};
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_LEVEL_OF_DETAIL_HPP
@@ -0,0 +1,59 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_MESH_HPP
+#define CSLIBS_NDT_3D_CONVERSION_MESH_HPP
+
+#include <cslibs_ndt_3d/conversion/voxel_grid.hpp>
+
+#include <cslibs_ndt_3d/meshes/marching_cubes.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+/**
+ * @brief Surface of a map where its density crosses a value. The density is
+ *        sampled on a block sparse voxel grid with a block per bundle with
+ *        populated distributions, on which marching cubes runs per block.
+ *        The map is not modified.
+ * @param iso_value     density of the surface, the sampled density of a
+ *                      bundle is the mean of its distributions
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::meshes::Mesh::Ptr &dst,
+        const double sampling_resolution,
+        const double iso_value)
+{
+    if (!src)
+        return;
+
+    cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>::Ptr grid;
+    from(src, grid, sampling_resolution);
+    dst.reset(new cslibs_ndt_3d::meshes::Mesh);
+    cslibs_ndt_3d::meshes::extract(*grid, iso_value, *dst);
+}
+
+/**
+ * @brief Same for occupancy maps, the distributions are weighted by their
+ *        occupancy.
+ * @param threshold     bundles with a lower mean occupancy are left out
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::meshes::Mesh::Ptr &dst,
+        const double sampling_resolution,
+        const double iso_value,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double threshold = 0.0)
+{
+    if (!src || !inverse_model)
+        return;
+
+    cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>::Ptr grid;
+    from(src, grid, sampling_resolution, inverse_model, threshold);
+    dst.reset(new cslibs_ndt_3d::meshes::Mesh);
+    cslibs_ndt_3d::meshes::extract(*grid, iso_value, *dst);
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_MESH_HPP
@@ -0,0 +1,206 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_PACKED_DISTRIBUTIONS_HPP
+#define CSLIBS_NDT_3D_CONVERSION_PACKED_DISTRIBUTIONS_HPP
+
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+
+#include <cslibs_ndt_3d/PackedDistributionArray.h>
+
+#include <Eigen/Eigenvalues>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief A distribution as it is stored in a packed array.
+ */
+struct Packed
+{
+    uint64_t             id;
+    std::array<float, 3> mean;
+    std::array<float, 6> covariance;    /// upper triangle xx xy xz yy yz zz
+    float                prob;
+};
+
+inline Packed pack(const cslibs_math::statistics::Distribution<3, 3> &d,
+                   const uint64_t &id,
+                   const double &prob)
+{
+    const auto &m = d.getMean();
+    const auto  c = d.getCovariance();
+
+    Packed p;
+    p.id         = id;
+    p.mean       = {{static_cast<float>(m(0)), static_cast<float>(m(1)), static_cast<float>(m(2))}};
+    p.covariance = {{static_cast<float>(c(0, 0)), static_cast<float>(c(0, 1)), static_cast<float>(c(0, 2)),
+                     static_cast<float>(c(1, 1)), static_cast<float>(c(1, 2)), static_cast<float>(c(2, 2))}};
+    p.prob       = static_cast<float>(prob);
+    return p;
+}
+
+/**
+ * @brief Write the valid ones of a sequence of packed distributions into the
+ *        arrays of a message, which are sized once.
+ * @param at    (std::size_t i) -> const Converted<Packed>&
+ */
+template<typename At>
+inline void write(const std::size_t                       n,
+                  const At                               &at,
+                  cslibs_ndt_3d::PackedDistributionArray &dst)
+{
+    auto resize = [&dst](const std::size_t count) {
+        dst.ids.resize(count);
+        dst.means.resize(3 * count);
+        dst.covariances.resize(6 * count);
+        dst.probs.resize(count);
+    };
+    auto write = [&dst](const std::size_t position, const Packed &p) {
+        dst.ids[position]   = p.id;
+        dst.probs[position] = p.prob;
+        std::copy(p.mean.begin(),       p.mean.end(),       dst.means.begin()       + 3 * position);
+        std::copy(p.covariance.begin(), p.covariance.end(), dst.covariances.begin() + 6 * position);
+    };
+    concatenate(n, at, resize, write);
+}
+}
+
+/**
+ * @brief One packed distribution per bundle, the bundles are converted in
+ *        parallel and stored in the order of their traversal. Unlike the
+ *        unpacked array no eigen decomposition is computed, receivers do so
+ *        if they need it.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::PackedDistributionArray::Ptr &dst)
+{
+    if (!src)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::PackedDistributionArray;
+    dst.reset(new dst_map_t());
+
+    using index_t  = std::array<int, 3>;
+    using bundle_t = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+    auto convert = [](const index_t &bi, const bundle_t &b, impl::Packed &p) {
+        cslibs_math::statistics::Distribution<3, 3> d;
+        double prob;
+        if (!impl::combine(b, d, prob))
+            return false;
+        p = impl::pack(d, impl::id(bi), prob);
+        return true;
+    };
+    const impl::PrepareDistribution prepare;
+
+    const auto bundles   = impl::bundles(*src);
+    const auto converted = impl::convert<impl::Packed>(bundles, prepare, convert);
+    impl::write(converted.size(), [&converted](const std::size_t i) -> const impl::Converted<impl::Packed>& {
+        return converted[i];
+    }, *dst);
+}
+
+/**
+ * @brief One packed distribution per bundle above the threshold.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::PackedDistributionArray::Ptr &dst,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+        const double &threshold = 0.169)
+{
+    if (!src)
+        return;
+
+    using dst_map_t = cslibs_ndt_3d::PackedDistributionArray;
+    dst.reset(new dst_map_t());
+
+    using index_t        = std::array<int, 3>;
+    using distribution_t = typename map_t::distribution_t;
+    using bundle_t       = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+
+    /// distributions which are not allocated count with the prior occupancy
+    const double prior         = distribution_t().getOccupancy(ivm);
+    const double time          = src->getTime();
+    const double time_constant = src->getDecay();
+    auto convert = [&ivm, &threshold, prior, time, time_constant](const index_t &bi, const bundle_t &b, impl::Packed &p) {
+        cslibs_math::statistics::Distribution<3, 3> d;
+        double prob;
+        if (!impl::combine(b, d, prob, ivm, threshold, prior, time, time_constant))
+            return false;
+        p = impl::pack(d, impl::id(bi), prob);
+        return true;
+    };
+    const impl::PrepareOccupancy prepare;
+
+    const auto bundles   = impl::bundles(*src);
+    const auto converted = impl::convert<impl::Packed>(bundles, prepare, convert);
+    impl::write(converted.size(), [&converted](const std::size_t i) -> const impl::Converted<impl::Packed>& {
+        return converted[i];
+    }, *dst);
+}
+
+/**
+ * @brief Pack an array of distributions, the eigen decompositions are dropped.
+ */
+inline void from(
+        const cslibs_ndt_3d::DistributionArray &src,
+        cslibs_ndt_3d::PackedDistributionArray &dst)
+{
+    const std::size_t n = src.data.size();
+    dst.header = src.header;
+    dst.ids.resize(n);
+    dst.means.resize(3 * n);
+    dst.covariances.resize(6 * n);
+    dst.probs.resize(n);
+
+    static const std::array<int, 6> upper = {{0, 1, 2, 4, 5, 8}};
+    for (std::size_t i = 0 ; i < n ; ++i) {
+        const Distribution &d = src.data[i];
+        dst.ids[i]   = d.id.data;
+        dst.probs[i] = static_cast<float>(d.prob.data);
+        for (std::size_t j = 0 ; j < 3 ; ++j)
+            dst.means[3 * i + j] = static_cast<float>(d.mean[j].data);
+        for (std::size_t j = 0 ; j < 6 ; ++j)
+            dst.covariances[6 * i + j] = static_cast<float>(d.covariance[upper[j]].data);
+    }
+}
+
+/**
+ * @brief Unpack an array of distributions, the eigen decompositions are
+ *        computed from the covariances.
+ */
+inline void from(
+        const cslibs_ndt_3d::PackedDistributionArray &src,
+        cslibs_ndt_3d::DistributionArray &dst)
+{
+    const std::size_t n = src.ids.size();
+    dst.header = src.header;
+    dst.data.resize(n);
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+    for (std::size_t i = 0 ; i < n ; ++i) {
+        const float *c = &src.covariances[6 * i];
+        Eigen::Matrix3d covariance;
+        covariance << c[0], c[1], c[2],
+                      c[1], c[3], c[4],
+                      c[2], c[4], c[5];
+        solver.computeDirect(covariance);
+
+        Distribution &d = dst.data[i];
+        d.id.data   = src.ids[i];
+        d.prob.data = src.probs[i];
+        for (int j = 0 ; j < 3 ; ++j) {
+            d.mean[j].data         = src.means[3 * i + j];
+            d.eigen_values[j].data = solver.eigenvalues()(j);
+        }
+        for (int j = 0 ; j < 9 ; ++j) {
+            d.eigen_vectors[j].data = solver.eigenvectors()(j);
+            d.covariance[j].data    = covariance(j);
+        }
+    }
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_PACKED_DISTRIBUTIONS_HPP
@@ -0,0 +1,347 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_PROJECTION_HPP
+#define CSLIBS_NDT_3D_CONVERSION_PROJECTION_HPP
+
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt_2d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_2d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+#include <cslibs_ndt_3d/conversion/conversion_traits.hpp>
+
+#include <cslibs_gridmaps/static_maps/gridmap.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+/**
+ * @brief Moments of the x and y coordinates of the samples of a distribution,
+ *        which is the marginal distribution of a Gaussian.
+ */
+template<typename dst_distribution_t, typename src_distribution_t>
+inline dst_distribution_t marginalize(const src_distribution_t &d)
+{
+    return dst_distribution_t(d.getN(),
+                              d.getMean().template head<2>(),
+                              d.getCorrelated().template topLeftCorner<2, 2>());
+}
+
+/**
+ * @brief Distribution of a storage with its storage index.
+ */
+template<typename value_t>
+struct Entry
+{
+    std::array<int, 3>  si;
+    std::size_t         storage;
+    const value_t      *d;
+};
+
+/**
+ * @brief Distributions of the first storages of a map, whose cells lie
+ *        within a height band. These do not overlap along z, the first 4
+ *        tile the columns, the first one alone does so without overlaps.
+ * @param select    (const distribution_t &d) -> const value_t *, nullptr if
+ *                  the distribution is left out, called sequentially
+ */
+template<typename value_t, typename map_t, typename Select>
+inline std::vector<Entry<value_t>> entries(const map_t       &src,
+                                                  const std::size_t  storages,
+                                                  const double       min_z,
+                                                  const double       max_z,
+                                                  const Select      &select)
+{
+    using index_t = typename map_t::index_t;
+    using point_t = typename map_t::point_t;
+
+    const double r = src.getResolution();
+    const typename map_t::pose_t w_T_m = src.getInitialOrigin();
+
+    std::vector<Entry<value_t>> es;
+    for (std::size_t i = 0 ; i < storages ; ++i) {
+        /// cells of odd storages are shifted by half a cell
+        const double o[2] = {(i & 1ul) ? 0.0 : 0.5,
+                             ((i >> 1) & 1ul) ? 0.0 : 0.5};
+        src.getStorages()[i]->traverse([&](const index_t &si, const typename map_t::distribution_t &d) {
+            const point_t c = w_T_m * point_t((si[0] + o[0]) * r, (si[1] + o[1]) * r, (si[2] + 0.5) * r);
+            if (c(2) < min_z || c(2) > max_z)
+                return;
+            if (const value_t *v = select(d))
+                es.emplace_back(Entry<value_t>{si, i, v});
+        });
+    }
+    return es;
+}
+
+/**
+ * @brief Sum the marginal distributions of the cells of each column. The
+ *        storages of a 2D map with the same resolution and a level origin
+ *        share their x and y indices with the first 4 storages of a 3D map,
+ *        so a column of cells adds up to the 2D distribution of its samples.
+ * @param accumulate    (const distribution_t &d, value_t &v), called
+ *                      concurrently for different columns
+ * @param update        (dst_distribution_t &d, const value_t &v)
+ */
+template<typename value_t, typename src_map_t, typename dst_map_t,
+         typename Accumulate, typename Update>
+inline void project(const src_map_t  &src,
+                    dst_map_t        &dst,
+                    const double      min_z,
+                    const double      max_z,
+                    const Accumulate &accumulate,
+                    const Update     &update)
+{
+    using column_t  = std::array<int, 3>;
+    using partial_t = cslibs_ndt::parallel::MomentsMap<column_t, value_t>;
+
+    using distribution_t = typename src_map_t::distribution_t;
+    using entry_t        = Entry<distribution_t>;
+
+    const std::vector<entry_t> es = entries<distribution_t>(src, 4, min_z, max_z,
+                                                            [](const distribution_t &d) { return &d; });
+    const std::vector<partial_t> partial = cslibs_ndt::parallel::aggregate<partial_t>(
+                es.begin(), es.end(), std::thread::hardware_concurrency(),
+                [&accumulate](const entry_t &e, partial_t &p) {
+        accumulate(*e.d, p[column_t{{e.si[0], e.si[1], static_cast<int>(e.storage)}}]);
+    });
+
+    /// the bundle whose distribution i has storage index (x, y)
+    for (const partial_t &p : partial) {
+        for (const auto &c : p) {
+            const int i = c.first[2];
+            const typename dst_map_t::index_t bi = {{2 * c.first[0] - (i & 1),
+                                                     2 * c.first[1] - ((i >> 1) & 1)}};
+            update(*dst.getDistributionBundle(bi)->at(static_cast<std::size_t>(i)), c.second);
+        }
+    }
+}
+
+/**
+ * @brief Heights of the distributions of a column.
+ */
+struct Heights
+{
+    double elevation  = std::numeric_limits<double>::lowest();
+    double min_height = std::numeric_limits<double>::max();
+    double max_height = std::numeric_limits<double>::lowest();
+};
+
+inline cslibs_math_2d::Pose2d level(const cslibs_math_3d::Pose3d &origin)
+{
+    return cslibs_math_2d::Pose2d(origin.tx(), origin.ty(), origin.yaw());
+}
+
+/**
+ * @brief Height layers of the columns of cells of the first storage, with a
+ *        grid cell per column.
+ * @param select    (const distribution_t &d) -> const value_t *, the moments
+ *                  of a distribution, nullptr if it is left out
+ */
+template<typename value_t, typename map_t, typename Select>
+inline void layers(const map_t                                         &src,
+                   cslibs_gridmaps::static_maps::Gridmap<double>::Ptr  &elevation,
+                   cslibs_gridmaps::static_maps::Gridmap<double>::Ptr  &min_height,
+                   cslibs_gridmaps::static_maps::Gridmap<double>::Ptr  &max_height,
+                   const double                                         min_z,
+                   const double                                         max_z,
+                   const double                                         extent,
+                   const Select                                        &select)
+{
+    using column_t  = std::array<int, 2>;
+    using partial_t = cslibs_ndt::parallel::MomentsMap<column_t, Heights>;
+    using dst_map_t = cslibs_gridmaps::static_maps::Gridmap<double>;
+
+    using entry_t   = Entry<value_t>;
+
+    /// the height of a distribution needs its covariance
+    auto valid = [&select](const typename map_t::distribution_t &d) {
+        const value_t *v = select(d);
+        return v && v->getN() >= 3 ? v : nullptr;
+    };
+    const std::vector<entry_t> es = entries<value_t>(src, 1, min_z, max_z, valid);
+    const std::vector<partial_t> partial = cslibs_ndt::parallel::aggregate<partial_t>(
+                es.begin(), es.end(), std::thread::hardware_concurrency(),
+                [extent](const entry_t &e, partial_t &p) {
+        const value_t *d = e.d;
+
+        const double z     = d->getMean()(2);
+        const double sigma = std::sqrt(d->getCovariance()(2, 2));
+        Heights &h = p[column_t{{e.si[0], e.si[1]}}];
+        h.elevation  = std::max(h.elevation,  z);
+        h.min_height = std::min(h.min_height, z - extent * sigma);
+        h.max_height = std::max(h.max_height, z + extent * sigma);
+    });
+
+    column_t min_c = {{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+    column_t max_c = {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+    for (const partial_t &p : partial) {
+        for (const auto &c : p) {
+            for (std::size_t d = 0 ; d < 2 ; ++d) {
+                min_c[d] = std::min(min_c[d], c.first[d]);
+                max_c[d] = std::max(max_c[d], c.first[d]);
+            }
+        }
+    }
+
+    const double r = src.getResolution();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const std::size_t width  = min_c[0] <= max_c[0] ? static_cast<std::size_t>(max_c[0] - min_c[0] + 1) : 0ul;
+    const std::size_t height = min_c[1] <= max_c[1] ? static_cast<std::size_t>(max_c[1] - min_c[1] + 1) : 0ul;
+    cslibs_math_2d::Pose2d origin = level(src.getInitialOrigin());
+    if (width > 0)
+        origin.translation() = origin * cslibs_math_2d::Point2d(min_c[0] * r, min_c[1] * r);
+
+    elevation.reset(new dst_map_t(origin, r, height, width, nan));
+    min_height.reset(new dst_map_t(origin, r, height, width, nan));
+    max_height.reset(new dst_map_t(origin, r, height, width, nan));
+
+    /// columns split across partial maps are combined
+    for (const partial_t &p : partial) {
+        for (const auto &c : p) {
+            const std::size_t x = static_cast<std::size_t>(c.first[0] - min_c[0]);
+            const std::size_t y = static_cast<std::size_t>(c.first[1] - min_c[1]);
+            double &e  = elevation->at(x, y);
+            double &lo = min_height->at(x, y);
+            double &hi = max_height->at(x, y);
+            e  = std::isnan(e)  ? c.second.elevation  : std::max(e,  c.second.elevation);
+            lo = std::isnan(lo) ? c.second.min_height : std::min(lo, c.second.min_height);
+            hi = std::isnan(hi) ? c.second.max_height : std::max(hi, c.second.max_height);
+        }
+    }
+}
+}
+
+/**
+ * @brief Project the distributions within a height band onto a 2D map with
+ *        the same resolution, as if the samples within the band had been
+ *        inserted into it. The band is applied to the centres of the cells,
+ *        the origin of the map is assumed to be level.
+ * @param min_z     lower end of the band, in world coordinates
+ * @param max_z     upper end of the band, in world coordinates
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_2d::dynamic_maps::Gridmap::Ptr &dst,
+        const double &min_z,
+        const double &max_z)
+{
+    if (!src)
+        return;
+
+    using src_map_t = map_t;
+    using dst_map_t = cslibs_ndt_2d::dynamic_maps::Gridmap;
+    using value_t   = dst_map_t::distribution_t::distribution_t;
+
+    dst.reset(new dst_map_t(impl::level(src->getInitialOrigin()), src->getResolution()));
+    impl::project<value_t>(*src, *dst, min_z, max_z,
+                           [](const typename src_map_t::distribution_t &d, value_t &v) {
+        v += impl::marginalize<value_t>(d.data());
+    },
+                           [](dst_map_t::distribution_t &d, const value_t &v) {
+        d.data() += v;
+    });
+}
+
+/**
+ * @brief Project the free counts and the occupied distributions within a
+ *        height band onto a 2D map with the same resolution.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_2d::dynamic_maps::OccupancyGridmap::Ptr &dst,
+        const double &min_z,
+        const double &max_z)
+{
+    if (!src)
+        return;
+
+    using src_map_t          = map_t;
+    using dst_map_t          = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+    using dst_distribution_t = dst_map_t::distribution_t::distribution_t;
+    struct value_t
+    {
+        std::size_t        free = 0;
+        dst_distribution_t occupied;
+    };
+
+    dst.reset(new dst_map_t(impl::level(src->getInitialOrigin()), src->getResolution()));
+    impl::project<value_t>(*src, *dst, min_z, max_z,
+                           [](const typename src_map_t::distribution_t &d, value_t &v) {
+        v.free += d.numFree();
+        if (d.getDistribution())
+            v.occupied += impl::marginalize<dst_distribution_t>(*d.getDistribution());
+    },
+                           [](dst_map_t::distribution_t &d, const value_t &v) {
+        d.updateFree(v.free);
+        if (v.occupied.getN() > 0)
+            d.updateOccupied(dst_map_t::distribution_t::distribution_ptr_t(new dst_distribution_t(v.occupied)));
+    });
+}
+
+/**
+ * @brief Height layers of the distributions within a band, with a cell per
+ *        column of cells of the map: the highest mean, and the lowest and
+ *        highest height within the given number of standard deviations.
+ *        Columns without distributions are NaN.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_gridmaps::static_maps::Gridmap<double>::Ptr &elevation,
+        cslibs_gridmaps::static_maps::Gridmap<double>::Ptr &min_height,
+        cslibs_gridmaps::static_maps::Gridmap<double>::Ptr &max_height,
+        const double &min_z,
+        const double &max_z,
+        const double &extent = 2.0)
+{
+    if (!src)
+        return;
+
+    using src_map_t = map_t;
+    using value_t   = typename src_map_t::distribution_t::distribution_t;
+    impl::layers<value_t>(*src, elevation, min_height, max_height, min_z, max_z, extent,
+                          [](const typename src_map_t::distribution_t &d) { return &d.data(); });
+}
+
+/**
+ * @param threshold     distributions with a lower occupancy are left out
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_gridmaps::static_maps::Gridmap<double>::Ptr &elevation,
+        cslibs_gridmaps::static_maps::Gridmap<double>::Ptr &min_height,
+        cslibs_gridmaps::static_maps::Gridmap<double>::Ptr &max_height,
+        const double &min_z,
+        const double &max_z,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double &threshold = 0.5,
+        const double &extent    = 2.0)
+{
+    if (!src || !inverse_model)
+        return;
+
+    using src_map_t = map_t;
+    using value_t   = typename src_map_t::distribution_t::distribution_t;
+    const double time          = src->getTime();
+    const double time_constant = src->getDecay();
+    impl::layers<value_t>(*src, elevation, min_height, max_height, min_z, max_z, extent,
+                          [&inverse_model, threshold, time, time_constant](const typename src_map_t::distribution_t &d) {
+        return d.getOccupancy(inverse_model, time, time_constant) >= threshold ? d.getDistribution().get() : static_cast<const value_t*>(nullptr);
+    });
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_PROJECTION_HPP
@@ -0,0 +1,286 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_RASTER_HPP
+#define CSLIBS_NDT_3D_CONVERSION_RASTER_HPP
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+
+#include <eigen3/Eigen/Eigen>
+
+#include <cslibs_math_3d/linear/pose.hpp>
+#include <cslibs_math_3d/linear/point.hpp>
+
+#include <cslibs_gridmaps/utility/inverse_model.hpp>
+
+#include <cslibs_ndt_3d/conversion/conversion_traits.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+using index_t = std::array<int, 3>;
+
+/**
+ * @brief Gaussian of a distribution, prepared for the evaluation on a grid.
+ */
+struct EIGEN_ALIGN16 Kernel
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Eigen::Vector3d mean;
+    Eigen::Matrix3d information;
+    double          weight;
+};
+
+/**
+ * @brief Voxels of a bundle with the kernels of its distributions. The
+ *        moments are read once while the cells are collected, so the map is
+ *        not touched while the voxels are evaluated.
+ */
+struct EIGEN_ALIGN16 Cell
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    index_t               bundle;   /// bundle index
+    Eigen::Vector3d       origin;   /// sampling point of the first voxel, in world coordinates
+    std::array<Kernel, 8> kernels;
+    std::size_t           size = 0;
+
+    template<typename distribution_t>
+    inline void add(const distribution_t &d,
+                    const double          weight)
+    {
+        /// sampleNonNormalized vanishes below 3 samples
+        if (d.getN() < 3 || weight == 0.0)
+            return;
+
+        Kernel &k     = kernels[size++];
+        k.mean        = d.getMean();
+        k.information = d.getInformationMatrix();
+        k.weight      = weight;
+    }
+};
+
+using cells_t = std::vector<Cell, Eigen::aligned_allocator<Cell>>;
+
+/**
+ * @brief Kernels of the distributions of a bundle, weighted equally.
+ */
+struct Gaussians
+{
+    template<typename bundle_t>
+    inline void operator()(const bundle_t &bundle,
+                           Cell           &cell) const
+    {
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d)
+                cell.add(d->data(), 0.125);
+        }
+    }
+};
+
+/**
+ * @brief Kernels of the occupancy distributions of a bundle, weighted by
+ *        their occupancy decayed up to the time of the map. Bundles whose mean
+ *        occupancy is below the threshold are left out, missing distributions
+ *        count with the prior.
+ */
+struct Occupancies
+{
+    const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model;
+    const double                                       threshold;
+    const double                                       time;
+    const double                                       time_constant;
+
+    template<typename bundle_t>
+    inline void operator()(const bundle_t &bundle,
+                           Cell           &cell) const
+    {
+        using distribution_t = typename std::decay<decltype(*bundle.at(0))>::type;
+
+        if (threshold > 0.0) {
+            const double prior = distribution_t().getOccupancy(inverse_model);
+            double occupancy = 0.0;
+            for (std::size_t i = 0 ; i < 8 ; ++i) {
+                const auto *d = bundle.at(i);
+                occupancy += 0.125 * (d ? d->getOccupancy(inverse_model, time, time_constant) : prior);
+            }
+            if (occupancy < threshold)
+                return;
+        }
+
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            const auto *d = bundle.at(i);
+            if (d && d->getDistribution())
+                cell.add(*d->getDistribution(), 0.125 * d->getOccupancy(inverse_model, time, time_constant));
+        }
+    }
+};
+
+/**
+ * @brief Add the cell of a bundle, if it has kernels.
+ */
+template<typename map_t, typename bundle_t, typename Kernels>
+inline void cell(const map_t    &src,
+                 const index_t  &bi,
+                 const bundle_t &b,
+                 const Kernels  &kernels,
+                 cells_t        &cells)
+{
+    using point_t = typename map_t::point_t;
+
+    const double bundle_resolution = src.getBundleResolution();
+    Cell c;
+    c.bundle = bi;
+    const point_t o = src.getInitialOrigin() * point_t(bi[0] * bundle_resolution,
+                                                       bi[1] * bundle_resolution,
+                                                       bi[2] * bundle_resolution);
+    c.origin = Eigen::Vector3d(o(0), o(1), o(2));
+    kernels(b, c);
+    if (c.size > 0)
+        cells.emplace_back(c);
+}
+
+/**
+ * @brief Cells of the bundles of a map, as allocatePartiallyAllocatedBundles
+ *        would leave them, without modifying the map. Bundles without kernels
+ *        are left out.
+ * @param kernels   (const distribution_const_bundle_t &b, Cell &c)
+ */
+template<typename map_t, typename Kernels>
+inline cells_t cells(const map_t   &src,
+                     const Kernels &kernels)
+{
+    using traits_t = cslibs_ndt::conversion::conversion_traits_t<map_t>;
+    using bundle_t = typename traits_t::bundle_t;
+
+    cells_t cs;
+    traits_t::traverse(src, [&](const index_t &bi, const bundle_t &b) {
+        cell(src, bi, b, kernels, cs);
+    });
+    return cs;
+}
+
+/**
+ * @brief Cells of a set of bundles, which do not need to exist.
+ */
+template<typename map_t, typename Kernels>
+inline cells_t cells(const map_t                &src,
+                     const std::vector<index_t> &bundles,
+                     const Kernels              &kernels)
+{
+    using traits_t = cslibs_ndt::conversion::conversion_traits_t<map_t>;
+
+    typename traits_t::bundle_t b;
+    cells_t cs;
+    for (const index_t &bi : bundles) {
+        traits_t::lookup(src, bi, b);
+        cell(src, bi, b, kernels, cs);
+    }
+    return cs;
+}
+
+/**
+ * @brief Offsets of the sampling points of adjacent voxels along the axes
+ *        of a map, in world coordinates, as the columns of a matrix.
+ */
+template<typename pose_t>
+inline Eigen::Matrix3d steps(const pose_t &w_T_m,
+                             const double  sampling_resolution)
+{
+    using point_t = cslibs_math_3d::Point3d;
+
+    const point_t o = w_T_m * point_t(0.0, 0.0, 0.0);
+    const point_t x = w_T_m * point_t(sampling_resolution, 0.0, 0.0) - o;
+    const point_t y = w_T_m * point_t(0.0, sampling_resolution, 0.0) - o;
+    const point_t z = w_T_m * point_t(0.0, 0.0, sampling_resolution) - o;
+
+    Eigen::Matrix3d s;
+    s << x(0), y(0), z(0),
+         x(1), y(1), z(1),
+         x(2), y(2), z(2);
+    return s;
+}
+
+/**
+ * @brief Evaluate the kernels of cells at their voxels. Within a cell, the
+ *        exponent of a kernel is a quadratic polynomial of the voxel offset,
+ *        so all voxels of a cell are evaluated at once. The cells are
+ *        processed in parallel, in batches handed out on demand.
+ * @param cells         cells of chunk_step^3 voxels
+ * @param steps         offsets of the sampling points of adjacent voxels along
+ *                      x, y and z, as columns
+ * @param function      (const Cell &c, const Eigen::ArrayXd &v), the values
+ *                      of the voxels of the cell with x varying fastest,
+ *                      called concurrently for different cells
+ * @param num_threads   number of threads
+ */
+template<typename Fn>
+inline void rasterize(const cells_t         &cells,
+                      const int              chunk_step,
+                      const Eigen::Matrix3d &steps,
+                      const Fn              &function,
+                      const std::size_t      num_threads = std::thread::hardware_concurrency())
+{
+    static constexpr std::size_t batch_size = 64;
+    if (cells.empty())
+        return;
+
+    /// voxel offsets of a whole cell and their products
+    const int n = chunk_step * chunk_step * chunk_step;
+    Eigen::ArrayXd ks(n), ls(n), ms(n);
+    for (int m = 0 ; m < chunk_step ; ++m) {
+        for (int l = 0 ; l < chunk_step ; ++l) {
+            const int i = (m * chunk_step + l) * chunk_step;
+            ks.segment(i, chunk_step) = Eigen::ArrayXd::LinSpaced(chunk_step, 0, chunk_step - 1);
+            ls.segment(i, chunk_step).setConstant(l);
+            ms.segment(i, chunk_step).setConstant(m);
+        }
+    }
+    const Eigen::ArrayXd kk = ks * ks, ll = ls * ls, mm = ms * ms;
+    const Eigen::ArrayXd kl = ks * ls, km = ks * ms, lm = ls * ms;
+
+    auto evaluate = [&](const Cell &c, Eigen::ArrayXd &v) {
+        v.setZero();
+        for (std::size_t i = 0 ; i < c.size ; ++i) {
+            const Kernel          &g  = c.kernels[i];
+            const Eigen::Vector3d  d  = c.origin - g.mean;
+            const Eigen::Vector3d  id = g.information * d;
+            const Eigen::Matrix3d  q  = steps.transpose() * g.information * steps;
+            const Eigen::Vector3d  b  = 2.0 * steps.transpose() * id;
+            const double           q0 = d.dot(id);
+            v += g.weight * (-0.5 * (q(0, 0) * kk + q(1, 1) * ll + q(2, 2) * mm +
+                                     2.0 * (q(0, 1) * kl + q(0, 2) * km + q(1, 2) * lm) +
+                                     b(0) * ks + b(1) * ls + b(2) * ms + q0)).exp();
+        }
+        function(c, v);
+    };
+
+    const std::size_t batches = (cells.size() + batch_size - 1) / batch_size;
+    std::atomic<std::size_t> next(0);
+    auto run = [&cells, &next, &evaluate, batches, n]() {
+        Eigen::ArrayXd v(n);
+        for (std::size_t b = next++ ; b < batches ; b = next++) {
+            const std::size_t end = std::min(cells.size(), (b + 1) * batch_size);
+            for (std::size_t i = b * batch_size ; i < end ; ++i)
+                evaluate(cells[i], v);
+        }
+    };
+
+    const std::size_t threads = std::max<std::size_t>(1, std::min(num_threads, batches));
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1 ; t < threads ; ++t)
+        workers.emplace_back(run);
+    run();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_RASTER_HPP
@@ -3,24 +3,32 @@
 
 #include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
 #include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt_3d/conversion/bundle_cache.hpp>
 
 #include <sensor_msgs/PointCloud2.h>
 
 namespace cslibs_ndt_3d {
 namespace conversion {
-inline void from(
-        const std::vector<float> &tmp,
-        sensor_msgs::PointCloud2 &dst)
+namespace impl {
+/// x y z intensity
+using cloud_point_t = std::array<float, 4>;
+
+/**
+ * @brief Metadata of a cloud with fields x y z intensity.
+ */
+inline void header(const std::size_t         width,
+                   sensor_msgs::PointCloud2 &dst)
 {
-    // metadata
-    dst.width        = tmp.size() / 4;
+    dst.width        = static_cast<uint32_t>(width);
     dst.height       = 1;
     dst.is_dense     = false;
     dst.is_bigendian = false;
-    dst.point_step   = 4 * sizeof(float);
-    dst.row_step     = static_cast<uint32_t>(sizeof(float) * tmp.size());
+    dst.point_step   = sizeof(cloud_point_t);
+    dst.row_step     = static_cast<uint32_t>(sizeof(cloud_point_t) * width);
 
-    // fields x y z intensity
     dst.fields.resize(4);
     dst.fields[0].name = "x";
     dst.fields[1].name = "y";
@@ -31,59 +39,167 @@ inline void from(
         dst.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
         dst.fields[i].count    = dst.width;
     }
-
-    // data
-    std::size_t data_size = sizeof(float) * tmp.size();
-    dst.data.resize(data_size);
-    memcpy(&dst.data[0], &tmp[0], data_size);
 }
 
-inline void from(
-        cslibs_ndt_3d::dynamic_maps::Gridmap &src,
-        sensor_msgs::PointCloud2 &dst)
+/**
+ * @brief Write the valid ones of a sequence of converted points into the
+ *        buffer of a message, which is sized once.
+ * @param at    (std::size_t i) -> const Converted<cloud_point_t>&
+ */
+template<typename At>
+inline void write(const std::size_t         n,
+                  const At                 &at,
+                  sensor_msgs::PointCloud2 &dst)
 {
-    src.allocatePartiallyAllocatedBundles();
+    auto resize = [&dst](const std::size_t count) {
+        header(count, dst);
+        dst.data.resize(sizeof(cloud_point_t) * count);
+    };
+    auto write = [&dst](const std::size_t position, const cloud_point_t &p) {
+        memcpy(&dst.data[sizeof(cloud_point_t) * position], p.data(), sizeof(cloud_point_t));
+    };
+    concatenate(n, at, resize, write);
+}
 
-    using index_t = std::array<int, 3>;
-    using point_t = cslibs_math_3d::Point3d;
+/**
+ * @brief Mean of a bundle and the mixture of its distributions sampled there.
+ */
+inline bool point(const cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t &b,
+                  cloud_point_t &dst)
+{
+    using point_t        = cslibs_math_3d::Point3d;
     using distribution_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_t;
-    using distribution_bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_bundle_t;
     auto sample = [](const distribution_t *d,
                      const point_t &p) -> double {
         return d ? d->data().sampleNonNormalized(p) : 0.0;
     };
-    auto sample_bundle = [&sample](const distribution_bundle_t &b,
-                                   const point_t &p) -> double {
-        return 0.125 * (sample(b.at(0), p) +
-                        sample(b.at(1), p) +
-                        sample(b.at(2), p) +
-                        sample(b.at(3), p) +
-                        sample(b.at(4), p) +
-                        sample(b.at(5), p) +
-                        sample(b.at(6), p) +
-                        sample(b.at(7), p));
-    };
 
-    std::vector<float> tmp;
-    auto process_bundle = [&src, &tmp, &sample_bundle](const index_t &bi, const distribution_bundle_t &b) {
-        cslibs_math::statistics::Distribution<3, 3> d;
-        for (std::size_t i = 0 ; i < 8 ; ++i)
+    distribution_t::distribution_t d;
+    for (std::size_t i = 0 ; i < 8 ; ++i)
+        if (b.at(i))
             d += b.at(i)->data();
-        if (d.getN() == 0)
-            return;
-
-        cslibs_math_3d::Point3d mean(d.getMean());
-        tmp.emplace_back(static_cast<float>(mean(0)));
-        tmp.emplace_back(static_cast<float>(mean(1)));
-        tmp.emplace_back(static_cast<float>(mean(2)));
-        tmp.emplace_back(static_cast<float>(sample_bundle(b, mean)));
+    if (d.getN() == 0)
+        return false;
+
+    const point_t mean(d.getMean());
+    double intensity = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++i)
+        intensity += sample(b.at(i), mean);
+    dst = {{static_cast<float>(mean(0)), static_cast<float>(mean(1)), static_cast<float>(mean(2)),
+            static_cast<float>(0.125 * intensity)}};
+    return true;
+}
+
+/**
+ * @brief Same for occupancy maps, bundles below the threshold are left out.
+ * @param prior         occupancy of distributions which are not allocated
+ * @param time          time of the map, occupancies are decayed up to it
+ * @param time_constant decay constant of the map
+ */
+inline bool point(const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t &b,
+                  cloud_point_t &dst,
+                  const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+                  const double threshold,
+                  const double prior,
+                  const double time,
+                  const double time_constant)
+{
+    using point_t        = cslibs_math_3d::Point3d;
+    using distribution_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t;
+    auto sample = [&ivm, time, time_constant](const distribution_t *d,
+                                              const point_t &p) -> double {
+        return d && d->getDistribution() ?
+                    d->getDistribution()->sampleNonNormalized(p) * d->getOccupancy(ivm, time, time_constant) : 0.0;
     };
-    src.traverse(process_bundle);
-    from(tmp, dst);
+
+    distribution_t::distribution_t d;
+    double occupancy = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++i) {
+        const distribution_t *handle = b.at(i);
+        occupancy += 0.125 * (handle ? handle->getOccupancy(ivm, time, time_constant) : prior);
+        if (handle && handle->getDistribution())
+            d += *handle->getDistribution();
+    }
+    if (d.getN() == 0 || occupancy < threshold)
+        return false;
+
+    const point_t mean(d.getMean());
+    double intensity = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++i)
+        intensity += sample(b.at(i), mean);
+    dst = {{static_cast<float>(mean(0)), static_cast<float>(mean(1)), static_cast<float>(mean(2)),
+            static_cast<float>(0.125 * intensity)}};
+    return true;
+}
 }
 
 inline void from(
-        const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &src,
+        const std::vector<float> &tmp,
+        sensor_msgs::PointCloud2 &dst)
+{
+    impl::header(tmp.size() / 4, dst);
+
+    // data
+    std::size_t data_size = sizeof(float) * tmp.size();
+    dst.data.resize(data_size);
+    memcpy(&dst.data[0], &tmp[0], data_size);
+}
+
+/**
+ * @brief One point per bundle at its mean, with the mixture of its
+ *        distributions as intensity. The bundles are converted in parallel
+ *        and written into the message in the order of their traversal.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const map_t &src,
+        sensor_msgs::PointCloud2 &dst)
+{
+    using index_t  = std::array<int, 3>;
+    using bundle_t = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
+    auto convert = [](const index_t &, const bundle_t &b, impl::cloud_point_t &p) {
+        return impl::point(b, p);
+    };
+    const impl::PrepareDistribution prepare;
+
+    const auto bundles   = impl::bundles(src);
+    const auto converted = impl::convert<impl::cloud_point_t>(bundles, prepare, convert);
+    impl::write(converted.size(), [&converted](const std::size_t i) -> const impl::Converted<impl::cloud_point_t>& {
+        return converted[i];
+    }, dst);
+}
+
+/**
+ * @brief Same, in Z-order of the bundle indices. The points of bundles
+ *        which did not change since the last conversion with the cache are
+ *        reused.
+ * @param dirty     changed blocks since the last conversion with the cache,
+ *                  as fetched from the map
+ * @param cache     points per bundle
+ */
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::Gridmap &src,
+        sensor_msgs::PointCloud2 &dst,
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::dirty_blocks_t &dirty,
+        BundleCache<impl::cloud_point_t> &cache)
+{
+    using index_t  = std::array<int, 3>;
+    using bundle_t = cslibs_ndt_3d::dynamic_maps::Gridmap::distribution_const_bundle_t;
+    using entry_t  = BundleCache<impl::cloud_point_t>::entry_t;
+    auto convert = [](const index_t &, const bundle_t &b, impl::cloud_point_t &p) {
+        return impl::point(b, p);
+    };
+
+    const std::vector<const entry_t*> entries =
+            cache.update(src, dirty, impl::PopulatedDistribution(), impl::PrepareDistribution(), convert);
+    impl::write(entries.size(), [&entries](const std::size_t i) -> const entry_t& {
+        return *entries[i];
+    }, dst);
+}
+
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
         sensor_msgs::PointCloud2 &dst)
 {
     if (!src)
@@ -93,72 +209,105 @@ inline void from(
 }
 
 inline void from(
-        cslibs_ndt_3d::dynamic_maps::OccupancyGridmap &src,
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr &src,
+        sensor_msgs::PointCloud2 &dst,
+        const cslibs_ndt_3d::dynamic_maps::Gridmap::dirty_blocks_t &dirty,
+        BundleCache<impl::cloud_point_t> &cache)
+{
+    if (!src)
+        return;
+
+    from(*src, dst, dirty, cache);
+}
+
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const map_t &src,
         sensor_msgs::PointCloud2 &dst,
         const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
         const double &threshold = 0.169)
 {
-    src.allocatePartiallyAllocatedBundles();
+    using index_t        = std::array<int, 3>;
+    using distribution_t = typename map_t::distribution_t;
+    using bundle_t       = typename cslibs_ndt::conversion::conversion_traits_t<map_t>::bundle_t;
 
-    using index_t = std::array<int, 3>;
-    using point_t = cslibs_math_3d::Point3d;
-    using distribution_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t;
-    using distribution_bundle_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t;
-    auto sample = [&ivm](const distribution_t *d,
-                         const point_t &p) -> double {
-        auto evaluate = [&ivm, d, p] {
-            const auto &handle = d;
-            return d && handle->getDistribution() ?
-                        handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm) : 0.0;
-        };
-        return d ? evaluate() : 0.0;
-    };
-    auto sample_bundle = [&sample](const distribution_bundle_t &b,
-                                   const point_t &p) -> double {
-        return 0.125 * (sample(b.at(0), p) +
-                        sample(b.at(1), p) +
-                        sample(b.at(2), p) +
-                        sample(b.at(3), p) +
-                        sample(b.at(4), p) +
-                        sample(b.at(5), p) +
-                        sample(b.at(6), p) +
-                        sample(b.at(7), p));
+    /// distributions which are not allocated count with the prior occupancy
+    const double prior         = distribution_t().getOccupancy(ivm);
+    const double time          = src.getTime();
+    const double time_constant = src.getDecay();
+    auto convert = [&ivm, &threshold, prior, time, time_constant](const index_t &, const bundle_t &b, impl::cloud_point_t &p) {
+        return impl::point(b, p, ivm, threshold, prior, time, time_constant);
     };
+    const impl::PrepareOccupancy prepare;
+
+    const auto bundles   = impl::bundles(src);
+    const auto converted = impl::convert<impl::cloud_point_t>(bundles, prepare, convert);
+    impl::write(converted.size(), [&converted](const std::size_t i) -> const impl::Converted<impl::cloud_point_t>& {
+        return converted[i];
+    }, dst);
+}
+
+/**
+ * @brief Same, in Z-order of the bundle indices. The points of bundles
+ *        which did not change since the last conversion with the cache are
+ *        reused.
+ * @param dirty     changed blocks since the last conversion with the cache,
+ *                  as fetched from the map
+ * @param cache     points per bundle
+ */
+inline void from(
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap &src,
+        sensor_msgs::PointCloud2 &dst,
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::dirty_blocks_t &dirty,
+        BundleCache<impl::cloud_point_t> &cache,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+        const double &threshold = 0.169)
+{
+    using index_t        = std::array<int, 3>;
+    using distribution_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_t;
+    using bundle_t       = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_const_bundle_t;
+    using entry_t        = BundleCache<impl::cloud_point_t>::entry_t;
 
-    std::vector<float> tmp;
-    auto process_bundle = [&src, &tmp, &ivm, &threshold, &sample_bundle](const index_t &bi, const distribution_bundle_t &b) {
-        cslibs_math::statistics::Distribution<3, 3> d;
-        double occupancy = 0.0;
-
-        for (std::size_t i = 0 ; i < 8 ; ++i) {
-            const auto &handle = b.at(i);
-            occupancy += 0.125 * handle->getOccupancy(ivm);
-            if (const auto &d_tmp = handle->getDistribution())
-                d += *d_tmp;
-        }
-        if (d.getN() == 0 || occupancy < threshold)
-            return;
-
-        cslibs_math_3d::Point3d mean(d.getMean());
-        tmp.emplace_back(static_cast<float>(mean(0)));
-        tmp.emplace_back(static_cast<float>(mean(1)));
-        tmp.emplace_back(static_cast<float>(mean(2)));
-        tmp.emplace_back(static_cast<float>(sample_bundle(b, mean)));
+    const double prior         = distribution_t().getOccupancy(ivm);
+    const double time          = src.getTime();
+    const double time_constant = src.getDecay();
+    auto convert = [&ivm, &threshold, prior, time, time_constant](const index_t &, const bundle_t &b, impl::cloud_point_t &p) {
+        return impl::point(b, p, ivm, threshold, prior, time, time_constant);
     };
-    src.traverse(process_bundle);
-    from(tmp, dst);
+
+    cache.expire(time, time_constant);
+    const std::vector<const entry_t*> entries =
+            cache.update(src, dirty, impl::PopulatedOccupancy(), impl::PrepareOccupancy(), convert);
+    impl::write(entries.size(), [&entries](const std::size_t i) -> const entry_t& {
+        return *entries[i];
+    }, dst);
+}
+
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        sensor_msgs::PointCloud2 &dst,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
+        const double &threshold = 0.169)
+{
+    if (!src)
+        return;
+
+    from(*src, dst, ivm, threshold);
 }
 
 inline void from(
         const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &src,
         sensor_msgs::PointCloud2 &dst,
+        const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::dirty_blocks_t &dirty,
+        BundleCache<impl::cloud_point_t> &cache,
         const cslibs_gridmaps::utility::InverseModel::Ptr &ivm,
         const double &threshold = 0.169)
 {
     if (!src)
         return;
 
-    from(*src, dst, ivm, threshold);
+    from(*src, dst, dirty, cache, ivm, threshold);
 }
 
 }
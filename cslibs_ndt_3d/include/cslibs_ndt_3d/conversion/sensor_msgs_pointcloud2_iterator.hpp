@@ -0,0 +1,323 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_SENSOR_MSGS_POINTCLOUD2_ITERATOR_HPP
+#define CSLIBS_NDT_3D_CONVERSION_SENSOR_MSGS_POINTCLOUD2_ITERATOR_HPP
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+
+#include <cslibs_math_3d/linear/point.hpp>
+
+#include <cslibs_ndt/matching/match.hpp>
+
+#include <sensor_msgs/PointCloud2.h>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+/**
+ * @brief Forward iterator reading the x, y and z fields of a point cloud
+ *        message directly from its byte buffer. Points with a non-finite
+ *        coordinate are skipped, rows padded by the row step are respected.
+ * @tparam scalar_t     datatype of the coordinate fields, float or double
+ */
+template <typename scalar_t>
+class EIGEN_ALIGN16 PointCloud2Iterator
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = cslibs_math_3d::Point3d;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const value_type*;
+    using reference         = const value_type&;
+    using offsets_t         = std::array<std::size_t, 3>;
+
+    inline PointCloud2Iterator() :
+        point_(nullptr),
+        row_end_(nullptr),
+        end_(nullptr),
+        point_step_(0),
+        row_step_(0),
+        row_size_(0)
+    {
+    }
+
+    inline PointCloud2Iterator(const uint8_t   *point,
+                               const uint8_t   *end,
+                               const std::size_t point_step,
+                               const std::size_t row_step,
+                               const std::size_t width,
+                               const offsets_t  &offsets) :
+        point_(point),
+        row_end_(point == end ? end : point + width * point_step),
+        end_(end),
+        point_step_(point_step),
+        row_step_(row_step),
+        row_size_(width * point_step),
+        offsets_(offsets)
+    {
+        if (row_size_ == 0)
+            point_ = end_;
+        seek();
+    }
+
+    inline reference operator * () const
+    {
+        return value_;
+    }
+
+    inline pointer operator -> () const
+    {
+        return &value_;
+    }
+
+    inline PointCloud2Iterator& operator ++ ()
+    {
+        advance();
+        seek();
+        return *this;
+    }
+
+    inline PointCloud2Iterator operator ++ (int)
+    {
+        PointCloud2Iterator tmp(*this);
+        ++(*this);
+        return tmp;
+    }
+
+    inline bool operator == (const PointCloud2Iterator &other) const
+    {
+        return point_ == other.point_;
+    }
+
+    inline bool operator != (const PointCloud2Iterator &other) const
+    {
+        return point_ != other.point_;
+    }
+
+private:
+    const uint8_t *point_;
+    const uint8_t *row_end_;
+    const uint8_t *end_;
+    std::size_t    point_step_;
+    std::size_t    row_step_;
+    std::size_t    row_size_;
+    offsets_t      offsets_;
+    value_type     value_;
+
+    inline scalar_t read(const std::size_t offset) const
+    {
+        /// the buffer gives no alignment guarantees
+        scalar_t v;
+        std::memcpy(&v, point_ + offset, sizeof(scalar_t));
+        return v;
+    }
+
+    inline void advance()
+    {
+        point_ += point_step_;
+        if (point_ == row_end_) {
+            point_    = row_end_ - row_size_ + row_step_;
+            row_end_  = point_ + row_size_;
+            if (point_ >= end_)
+                point_ = end_;
+        }
+    }
+
+    /// move on to the next point with finite coordinates
+    inline void seek()
+    {
+        for (; point_ != end_ ; advance()) {
+            const scalar_t x = read(offsets_[0]);
+            const scalar_t y = read(offsets_[1]);
+            const scalar_t z = read(offsets_[2]);
+            if (std::isfinite(x) && std::isfinite(y) && std::isfinite(z)) {
+                value_ = value_type(static_cast<double>(x),
+                                    static_cast<double>(y),
+                                    static_cast<double>(z));
+                return;
+            }
+        }
+    }
+};
+
+/**
+ * @brief View on the points of a point cloud message, which does not copy
+ *        the message buffer. The message has to outlive the view.
+ */
+template <typename scalar_t>
+class PointCloud2View
+{
+public:
+    using iterator_t = PointCloud2Iterator<scalar_t>;
+    using offsets_t  = typename iterator_t::offsets_t;
+
+    inline PointCloud2View(const sensor_msgs::PointCloud2 &src,
+                           const offsets_t                &offsets) :
+        src_(src),
+        offsets_(offsets)
+    {
+    }
+
+    inline iterator_t begin() const
+    {
+        return iterator_t(src_.data.data(), end_ptr(),
+                          src_.point_step, src_.row_step, src_.width, offsets_);
+    }
+
+    inline iterator_t end() const
+    {
+        return iterator_t(end_ptr(), end_ptr(),
+                          src_.point_step, src_.row_step, src_.width, offsets_);
+    }
+
+private:
+    const sensor_msgs::PointCloud2 &src_;
+    const offsets_t                 offsets_;
+
+    inline const uint8_t* end_ptr() const
+    {
+        return src_.data.data() + static_cast<std::size_t>(src_.height) * src_.row_step;
+    }
+};
+
+namespace impl {
+/**
+ * @brief True if the host stores the most significant byte first.
+ */
+inline bool bigEndian()
+{
+    const uint16_t one = 1;
+    uint8_t first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+/**
+ * @brief Find the x, y and z fields, which have to share one datatype and
+ *        lie within a point. The buffer is read in host byte order, so the
+ *        message has to match it.
+ * @return the datatype, either FLOAT32 or FLOAT64
+ */
+inline uint8_t coordinateFields(const sensor_msgs::PointCloud2 &src,
+                                std::array<std::size_t, 3>     &offsets)
+{
+    static const std::array<const char*, 3> names = {{"x", "y", "z"}};
+
+    uint8_t datatype = 0;
+    for (std::size_t i = 0 ; i < 3 ; ++i) {
+        const sensor_msgs::PointField *field = nullptr;
+        for (const sensor_msgs::PointField &f : src.fields)
+            if (f.name == names[i])
+                field = &f;
+        if (!field)
+            throw std::runtime_error(std::string("[PointCloud2]: missing field '") + names[i] + "'");
+        if (field->datatype != sensor_msgs::PointField::FLOAT32 &&
+                field->datatype != sensor_msgs::PointField::FLOAT64)
+            throw std::runtime_error("[PointCloud2]: coordinates must be float32 or float64");
+        if (datatype != 0 && field->datatype != datatype)
+            throw std::runtime_error("[PointCloud2]: coordinates must share one datatype");
+        const std::size_t size = field->datatype == sensor_msgs::PointField::FLOAT64 ? sizeof(double) : sizeof(float);
+        if (static_cast<std::size_t>(field->offset) + size > src.point_step)
+            throw std::runtime_error(std::string("[PointCloud2]: field '") + names[i] + "' exceeds the point step");
+
+        datatype   = field->datatype;
+        offsets[i] = field->offset;
+    }
+    if (src.row_step < src.width * src.point_step ||
+            src.data.size() < static_cast<std::size_t>(src.height) * src.row_step)
+        throw std::runtime_error("[PointCloud2]: inconsistent buffer layout");
+    if (static_cast<bool>(src.is_bigendian) != bigEndian())
+        throw std::runtime_error("[PointCloud2]: byte order differs from the host");
+    return datatype;
+}
+
+/**
+ * @brief Call fn(begin, end) with iterators matching the coordinate datatype.
+ */
+template <typename Fn>
+inline void apply(const sensor_msgs::PointCloud2 &src,
+                  Fn                             &fn)
+{
+    std::array<std::size_t, 3> offsets;
+    if (coordinateFields(src, offsets) == sensor_msgs::PointField::FLOAT64) {
+        const PointCloud2View<double> view(src, offsets);
+        fn(view.begin(), view.end());
+    } else {
+        const PointCloud2View<float> view(src, offsets);
+        fn(view.begin(), view.end());
+    }
+}
+
+template <typename map_t>
+struct Insert
+{
+    map_t                        &dst;
+    const typename map_t::pose_t &points_origin;
+
+    template <typename iterator_t>
+    inline void operator () (const iterator_t &begin, const iterator_t &end)
+    {
+        dst.insert(begin, end, points_origin);
+    }
+};
+
+template <typename ndt_t>
+struct Match
+{
+    const ndt_t                                                    &map;
+    const cslibs_ndt::matching::Parameter                          &params;
+    const typename ndt_t::transform_t                              &initial_transform;
+    cslibs_ndt::matching::Result<typename ndt_t::transform_t>      &r;
+
+    template <typename iterator_t>
+    inline void operator () (const iterator_t &begin, const iterator_t &end)
+    {
+        r = cslibs_ndt::matching::match(begin, end, map, params, initial_transform);
+    }
+};
+}
+
+/**
+ * @brief Insert a point cloud message into a map without an intermediate
+ *        point cloud, applicable to gridmaps and occupancy gridmaps.
+ * @param dst           the map
+ * @param src           the message, points given in the sensor frame
+ * @param points_origin sensor pose in the world frame
+ */
+template <typename map_t>
+inline void insert(map_t                          &dst,
+                   const sensor_msgs::PointCloud2 &src,
+                   const typename map_t::pose_t   &points_origin = typename map_t::pose_t())
+{
+    impl::Insert<map_t> fn{dst, points_origin};
+    impl::apply(src, fn);
+}
+
+/**
+ * @brief Match a point cloud message against a map without an intermediate
+ *        point cloud.
+ * @param src               the message
+ * @param map               the map to match against
+ * @param params            matching parameters
+ * @param initial_transform initial guess
+ */
+template <typename ndt_t>
+inline cslibs_ndt::matching::Result<typename ndt_t::transform_t> match(
+        const sensor_msgs::PointCloud2        &src,
+        const ndt_t                           &map,
+        const cslibs_ndt::matching::Parameter &params,
+        const typename ndt_t::transform_t     &initial_transform)
+{
+    cslibs_ndt::matching::Result<typename ndt_t::transform_t> r;
+    impl::Match<ndt_t> fn{map, params, initial_transform, r};
+    impl::apply(src, fn);
+    return r;
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_SENSOR_MSGS_POINTCLOUD2_ITERATOR_HPP
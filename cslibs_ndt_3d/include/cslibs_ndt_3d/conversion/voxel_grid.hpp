@@ -0,0 +1,156 @@
+#ifndef CSLIBS_NDT_3D_CONVERSION_VOXEL_GRID_HPP
+#define CSLIBS_NDT_3D_CONVERSION_VOXEL_GRID_HPP
+
+#include <limits>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_ndt_3d/voxel_grids/voxel_grid.hpp>
+#include <cslibs_ndt_3d/voxel_grids/block_voxel_grid.hpp>
+
+#include <cslibs_ndt_3d/conversion/raster.hpp>
+
+namespace cslibs_ndt_3d {
+namespace conversion {
+namespace impl {
+template<typename map_t, typename Kernels>
+inline void toVoxelGrid(const map_t                                         &src,
+                        cslibs_ndt_3d::voxel_grids::VoxelGrid<double>::Ptr  &dst,
+                        const double                                         sampling_resolution,
+                        const Kernels                                       &kernels)
+{
+    using dst_map_t = cslibs_ndt_3d::voxel_grids::VoxelGrid<double>;
+    using point_t   = typename map_t::point_t;
+
+    const cells_t cs = cells(src, kernels);
+    index_t min_bi = {{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+    index_t max_bi = {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+    for (const Cell &c : cs) {
+        for (std::size_t d = 0 ; d < 3 ; ++d) {
+            min_bi[d] = std::min(min_bi[d], c.bundle[d]);
+            max_bi[d] = std::max(max_bi[d], c.bundle[d]);
+        }
+    }
+
+    const double bundle_resolution = src.getBundleResolution();
+    const int    chunk_step        = static_cast<int>(bundle_resolution / sampling_resolution);
+    typename map_t::pose_t origin  = src.getInitialOrigin();
+    if (cs.empty()) {
+        dst.reset(new dst_map_t(origin, sampling_resolution, dst_map_t::size_t{{0, 0, 0}}, 0.0));
+        return;
+    }
+
+    origin.translation() = origin * point_t(min_bi[0] * bundle_resolution,
+                                            min_bi[1] * bundle_resolution,
+                                            min_bi[2] * bundle_resolution);
+    dst.reset(new dst_map_t(origin, sampling_resolution,
+                            dst_map_t::size_t{{static_cast<std::size_t>((max_bi[0] - min_bi[0] + 1) * chunk_step),
+                                               static_cast<std::size_t>((max_bi[1] - min_bi[1] + 1) * chunk_step),
+                                               static_cast<std::size_t>((max_bi[2] - min_bi[2] + 1) * chunk_step)}},
+                            0.0));
+
+    rasterize(cs, chunk_step, steps(src.getInitialOrigin(), sampling_resolution),
+              [&dst, &min_bi, chunk_step](const Cell &c, const Eigen::ArrayXd &v) {
+        const int x = (c.bundle[0] - min_bi[0]) * chunk_step;
+        const int y = (c.bundle[1] - min_bi[1]) * chunk_step;
+        const int z = (c.bundle[2] - min_bi[2]) * chunk_step;
+        for (int m = 0 ; m < chunk_step ; ++m)
+            for (int l = 0 ; l < chunk_step ; ++l)
+                for (int k = 0 ; k < chunk_step ; ++k)
+                    dst->at(x + k, y + l, z + m) = v((m * chunk_step + l) * chunk_step + k);
+    });
+}
+
+template<typename map_t, typename Kernels>
+inline void toBlockVoxelGrid(const map_t                                             &src,
+                             cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>::Ptr &dst,
+                             const double                                             sampling_resolution,
+                             const Kernels                                           &kernels)
+{
+    using dst_map_t = cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>;
+
+    /// a block per bundle, so the block of a voxel is its bundle
+    const int chunk_step = static_cast<int>(src.getBundleResolution() / sampling_resolution);
+    dst.reset(new dst_map_t(src.getInitialOrigin(), sampling_resolution, chunk_step, 0.0));
+
+    /// blocks are allocated up front, the cells are then written concurrently
+    const cells_t cs = cells(src, kernels);
+    for (const Cell &c : cs)
+        dst->allocateBlock(c.bundle);
+
+    rasterize(cs, chunk_step, steps(src.getInitialOrigin(), sampling_resolution),
+              [&dst](const Cell &c, const Eigen::ArrayXd &v) {
+        dst_map_t::block_t &b = *dst->getBlock(c.bundle);
+        std::copy(v.data(), v.data() + v.size(), b.begin());
+    });
+}
+}
+
+/**
+ * @brief Sample a map on a dense voxel grid, which covers the bundles with
+ *        populated distributions. The map is not modified.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::voxel_grids::VoxelGrid<double>::Ptr &dst,
+        const double sampling_resolution)
+{
+    if (!src)
+        return;
+    impl::toVoxelGrid(*src, dst, sampling_resolution, impl::Gaussians());
+}
+
+/**
+ * @brief Sample a map on a block sparse voxel grid, with a block of voxels
+ *        for each bundle with populated distributions. The map is not modified.
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, false> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>::Ptr &dst,
+        const double sampling_resolution)
+{
+    if (!src)
+        return;
+    impl::toBlockVoxelGrid(*src, dst, sampling_resolution, impl::Gaussians());
+}
+
+/**
+ * @param threshold     bundles with a lower mean occupancy are left empty
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::voxel_grids::VoxelGrid<double>::Ptr &dst,
+        const double sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double threshold = 0.0)
+{
+    if (!src || !inverse_model)
+        return;
+    impl::toVoxelGrid(*src, dst, sampling_resolution, impl::Occupancies{inverse_model, threshold, src->getTime(), src->getDecay()});
+}
+
+/**
+ * @param threshold     bundles with a lower mean occupancy are left out
+ */
+template<typename map_t>
+inline cslibs_ndt::conversion::enable_conversion_t<map_t, true> from(
+        const std::shared_ptr<map_t> &src,
+        cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>::Ptr &dst,
+        const double sampling_resolution,
+        const cslibs_gridmaps::utility::InverseModel::Ptr &inverse_model,
+        const double threshold = 0.0)
+{
+    if (!src || !inverse_model)
+        return;
+    impl::toBlockVoxelGrid(*src, dst, sampling_resolution, impl::Occupancies{inverse_model, threshold, src->getTime(), src->getDecay()});
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_CONVERSION_VOXEL_GRID_HPP
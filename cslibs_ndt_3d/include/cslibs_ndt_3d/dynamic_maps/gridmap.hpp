@@ -5,6 +5,8 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <thread>
+#include <unordered_set>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 
@@ -13,6 +15,14 @@
 
 #include <cslibs_ndt/common/distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/insert_batch.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/merge.hpp>
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/morton_storage.hpp>
+#include <cslibs_ndt/common/backend.hpp>
+#include <cslibs_ndt/common/dirty_blocks.hpp>
+#include <cslibs_ndt/common/box.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -27,34 +37,43 @@ namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt_3d {
 namespace dynamic_maps {
-class EIGEN_ALIGN16 Gridmap
+/**
+ * @brief Sparse map of bundles of distributions.
+ * @tparam T        scalar of the moments
+ * @tparam backend  storage of the distributions and bundles, see
+ *                  cslibs_ndt::backend, Morton keeps them in Z-order
+ */
+template <typename T = double, typename backend_t = cslibs_ndt::backend::KDTree>
+class EIGEN_ALIGN16 GridmapT
 {
 public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    using allocator_t = Eigen::aligned_allocator<Gridmap>;
+    using allocator_t = Eigen::aligned_allocator<GridmapT>;
 
-    using Ptr                               = std::shared_ptr<Gridmap>;
-    using ConstPtr                          = std::shared_ptr<const Gridmap>;
+    using Ptr                               = std::shared_ptr<GridmapT>;
+    using ConstPtr                          = std::shared_ptr<const GridmapT>;
     using pose_2d_t                         = cslibs_math_2d::Pose2d;
     using pose_t                            = cslibs_math_3d::Pose3d;
     using transform_t                       = cslibs_math_3d::Transform3d;
     using point_t                           = cslibs_math_3d::Point3d;
+    using batch_t                           = cslibs_ndt::InsertBatch<point_t, pose_t>;
     using index_t                           = std::array<int, 3>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
-    using distribution_t                    = cslibs_ndt::Distribution<3>;
-    using distribution_storage_t            = cis::Storage<distribution_t, index_t, cis::backend::kdtree::KDTree>;
+    using distribution_t                    = cslibs_ndt::Distribution<3, T>;
+    using distribution_storage_t            = typename backend_t::template storage_t<distribution_t, index_t>;
     using distribution_storage_ptr_t        = std::shared_ptr<distribution_storage_t>;
     using distribution_storage_array_t      = std::array<distribution_storage_ptr_t, 8>;
     using distribution_bundle_t             = cslibs_ndt::Bundle<distribution_t*, 8>;
     using distribution_const_bundle_t       = cslibs_ndt::Bundle<const distribution_t*, 8>;
-    using distribution_bundle_storage_t     = cis::Storage<distribution_bundle_t, index_t, cis::backend::kdtree::KDTree>;
+    using distribution_bundle_storage_t     = typename backend_t::template storage_t<distribution_bundle_t, index_t>;
     using distribution_bundle_storage_ptr_t = std::shared_ptr<distribution_bundle_storage_t>;
+    using dirty_blocks_t                    = cslibs_ndt::DirtyBlocks<index_t>;
 
-    inline Gridmap(const pose_t &origin,
-                   const double  resolution) :
+    inline GridmapT(const pose_t &origin,
+                    const double  resolution) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -74,12 +93,12 @@ public:
     {
     }
 
-    inline Gridmap(const pose_t &origin,
-                   const double &resolution,
-                   const index_t &min_index,
-                   const index_t &max_index,
-                   const std::shared_ptr<distribution_bundle_storage_t> &bundles,
-                   const distribution_storage_array_t                   &storage) :
+    inline GridmapT(const pose_t &origin,
+                    const double &resolution,
+                    const index_t &min_index,
+                    const index_t &max_index,
+                    const std::shared_ptr<distribution_bundle_storage_t> &bundles,
+                    const distribution_storage_array_t                   &storage) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -92,7 +111,7 @@ public:
     {
     }
 
-    inline Gridmap(const Gridmap &other) :
+    inline GridmapT(const GridmapT &other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -112,7 +131,7 @@ public:
     {
     }
 
-    inline Gridmap(Gridmap &&other) :
+    inline GridmapT(GridmapT &&other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -178,6 +197,7 @@ public:
     {
         const index_t bi = toBundleIndex(p);
         distribution_bundle_t *bundle = getAllocate(bi);
+        dirty_.mark(bi);
         bundle->at(0)->data().add(p);
         bundle->at(1)->data().add(p);
         bundle->at(2)->data().add(p);
@@ -192,6 +212,7 @@ public:
                        index_t &bi)
     {
         distribution_bundle_t *bundle = getAllocate(bi);
+        dirty_.mark(bi);
         bundle->at(0)->data().add(p);
         bundle->at(1)->data().add(p);
         bundle->at(2)->data().add(p);
@@ -224,6 +245,7 @@ public:
 
         storage.traverse([this](const index_t& bi, const distribution_t &d) {
             distribution_bundle_t *bundle = getAllocate(bi);
+            dirty_.mark(bi);
             bundle->at(0)->data() += d.data();
             bundle->at(1)->data() += d.data();
             bundle->at(2)->data() += d.data();
@@ -235,6 +257,164 @@ public:
         });
     }
 
+    /**
+     * @brief Insert the clouds of several sensors, the moments of all clouds
+     *        are aggregated before the bundles are updated once.
+     * @param batch     clouds and sensor poses
+     */
+    inline void insert(const batch_t &batch)
+    {
+        distribution_storage_t storage;
+
+        for (const auto &entry : batch) {
+            const pose_t &points_origin = entry.second;
+            for (const auto &p : *(entry.first)) {
+                const point_t pm = points_origin * p;
+                if (!pm.isNormal())
+                    continue;
+                const index_t bi = toBundleIndex(pm);
+                distribution_t *d = storage.get(bi);
+                (d ? d : &storage.insert(bi, distribution_t()))->data().add(pm);
+            }
+        }
+
+        storage.traverse([this](const index_t& bi, const distribution_t &d) {
+            distribution_bundle_t *bundle = getAllocate(bi);
+            dirty_.mark(bi);
+            bundle->at(0)->data() += d.data();
+            bundle->at(1)->data() += d.data();
+            bundle->at(2)->data() += d.data();
+            bundle->at(3)->data() += d.data();
+            bundle->at(4)->data() += d.data();
+            bundle->at(5)->data() += d.data();
+            bundle->at(6)->data() += d.data();
+            bundle->at(7)->data() += d.data();
+        });
+    }
+
+    /**
+     * @brief Insert a batch of points using multiple threads, the moments are
+     *        aggregated per thread and merged per distribution storage.
+     * @param points        the points
+     * @param points_origin pose of the points in the world frame
+     * @param num_threads   number of threads to aggregate the points with
+     */
+    inline void insertParallel(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
+                               const pose_t &points_origin = pose_t(),
+                               const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        insertParallel(points->begin(), points->end(), points_origin, num_threads);
+    }
+
+    template<typename iterator_t>
+    inline void insertParallel(const iterator_t& points_begin, const iterator_t& points_end,
+                               const pose_t &points_origin = pose_t(),
+                               const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        auto locate = [this, &points_origin](const point_t &p, point_t &p_m, index_t &bi) {
+            p_m = points_origin * p;
+            if (!p_m.isNormal())
+                return false;
+            bi = toBundleIndex(p_m);
+            return true;
+        };
+        auto allocate = [this](const index_t &bi) {
+            dirty_.mark(bi);
+            return getAllocate(bi);
+        };
+        cslibs_ndt::parallel::insert<distribution_bundle_t, point_t, index_t>(points_begin, points_end, num_threads,
+                                                                              locate, allocate);
+    }
+
+    /**
+     * @brief Fuse another map into this one by composing the moments of its
+     *        distributions, so no points have to be inserted again. If both
+     *        grids are aligned, i.e. they share the resolution and are offset
+     *        by whole cells, every distribution is composed exactly with its
+     *        counterpart, one thread per storage. Otherwise the distributions
+     *        of storage 0, which partition the points of the other map, are
+     *        transformed and re-binned into the bundles their means fall into.
+     * @param other         the map to merge
+     * @param transform     transformation from the world frame of other into
+     *                      the world frame of this map
+     * @param num_threads   number of threads to re-bin with
+     */
+    inline void merge(const GridmapT &other,
+                      const transform_t &transform = transform_t(),
+                      const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        using moments_t     = typename distribution_t::distribution_t;
+        using partial_t     = cslibs_ndt::parallel::MomentsMap<index_t, moments_t>;
+        using rotation_t    = Eigen::Matrix<double, 3, 3>;
+        using translation_t = Eigen::Matrix<double, 3, 1>;
+
+        if (&other == this) {
+            const GridmapT copy(other);
+            merge(copy, transform, num_threads);
+            return;
+        }
+
+        auto decompose = [](const transform_t &t, rotation_t &R, translation_t &o) {
+            o = (t * point_t(0.0, 0.0, 0.0)).data();
+            R.col(0) = (t * point_t(1.0, 0.0, 0.0)).data() - o;
+            R.col(1) = (t * point_t(0.0, 1.0, 0.0)).data() - o;
+            R.col(2) = (t * point_t(0.0, 0.0, 1.0)).data() - o;
+        };
+        rotation_t    R;
+        translation_t t;
+        decompose(transform, R, t);
+
+        rotation_t    R_grid;
+        translation_t t_grid;
+        decompose(m_T_w_ * transform * other.w_T_m_, R_grid, t_grid);
+
+        index_t offset;
+        if (std::abs(resolution_ - other.resolution_) < 1e-9 &&
+                cslibs_ndt::merge::aligned<3>(R_grid, t_grid, resolution_, offset)) {
+            other.bundle_storage_->traverse([this, &offset](const index_t &bi, const distribution_bundle_t &) {
+                const index_t target = {{bi[0] + 2 * offset[0], bi[1] + 2 * offset[1], bi[2] + 2 * offset[2]}};
+                getAllocate(target);
+                dirty_.mark(target);
+            });
+
+            std::array<std::thread, 8> threads;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                threads[i] = std::thread([this, &other, &offset, &R, &t, i]() {
+                    const distribution_storage_ptr_t &storage = storage_[i];
+                    other.storage_[i]->traverse([&storage, &offset, &R, &t](const index_t &si, const distribution_t &d) {
+                        distribution_t *target = storage->get({{si[0] + offset[0], si[1] + offset[1], si[2] + offset[2]}});
+                        if (target && d.data().getN() > 0)
+                            target->data() += cslibs_ndt::merge::transform(d.data(), R, t);
+                    });
+                });
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                threads[i].join();
+            return;
+        }
+
+        std::vector<const distribution_t*> sources;
+        other.storage_[0]->traverse([&sources](const index_t &, const distribution_t &d) {
+            if (d.data().getN() > 0)
+                sources.emplace_back(&d);
+        });
+
+        auto rebin = [this, &R, &t](const distribution_t *d, partial_t &moments) {
+            const moments_t m = cslibs_ndt::merge::transform(d->data(), R, t);
+            const point_t mean(m.getMean()(0), m.getMean()(1), m.getMean()(2));
+            moments[toBundleIndex(mean)] += m;
+        };
+        auto allocate = [this](const index_t &bi) {
+            dirty_.mark(bi);
+            return getAllocate(bi);
+        };
+        auto update = [](distribution_t &d, const moments_t &m) {
+            d.data() += m;
+        };
+        const std::vector<partial_t> partial =
+                cslibs_ndt::parallel::aggregate<partial_t>(sources.begin(), sources.end(), num_threads, rebin);
+        cslibs_ndt::parallel::merge<distribution_bundle_t, index_t>(partial, allocate, update);
+    }
+
     inline double sample(const point_t &p) const
     {
         const index_t bi = toBundleIndex(p);
@@ -272,6 +452,11 @@ public:
     }
 
 
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_index_;
@@ -298,6 +483,26 @@ public:
         return getAllocate(bi);
     }
 
+    /**
+     * @brief Look up the distributions of a bundle without allocating it.
+     *        Neighbours of populated bundles share distributions with them,
+     *        so they can be sampled without allocatePartiallyAllocatedBundles,
+     *        which leaves the map unchanged and safe to read concurrently.
+     * @param bi        bundle index, the bundle does not need to exist
+     * @param bundle    the distributions, nullptr if not allocated
+     * @return true if any of the distributions exists
+     */
+    inline bool lookupDistributionBundle(const index_t               &bi,
+                                         distribution_const_bundle_t &bundle) const
+    {
+        bool found = false;
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            bundle[i] = storage_[i]->get(toStorageIndex(bi, i));
+            found    |= bundle[i] != nullptr;
+        }
+        return found;
+    }
+
     inline double getBundleResolution() const
     {
         return bundle_resolution_;
@@ -329,6 +534,134 @@ public:
         return bundle_storage_->traverse(function);
     }
 
+    /**
+     * @brief Traverse all bundles in Z-order (Morton order), so that
+     *        spatially adjacent bundles are visited consecutively. With the
+     *        Morton backend the bundles are stored in this order and are
+     *        streamed, otherwise they are collected and sorted first, which
+     *        costs O(n log n), so use traverse where the order does not matter.
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverseOrdered(const Fn& function) const
+    {
+        traverseOrdered(function, ordered_t());
+    }
+
+    /**
+     * @brief Traverse the bundles inside an axis-aligned box in Z-order.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2])
+            return;
+
+        traverse(lo, hi, function, ordered_t());
+    }
+
+    /**
+     * @brief Extract the bundles inside an axis-aligned box into a new map,
+     *        the distributions are copied. All extracted bundles are dirty
+     *        in the new map.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the cropped map, nullptr if the box does not intersect the map
+     */
+    inline Ptr crop(const index_t &min_bi,
+                    const index_t &max_bi) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2])
+            return nullptr;
+
+        Ptr dst(new GridmapT(w_T_m_, resolution_));
+        traverse(lo, hi, [&dst](const index_t &bi, const distribution_bundle_t &b) {
+            distribution_bundle_t *b_dst = dst->getDistributionBundle(bi);
+            dst->dirty_.mark(bi);
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                b_dst->at(i)->data() = b.at(i)->data();
+        });
+        return dst;
+    }
+
+    /**
+     * @brief Remove the bundles matching a predicate together with the
+     *        distributions no remaining bundle refers to. The storages are
+     *        rebuilt in parallel, which releases their memory, and the
+     *        bounds are recomputed.
+     * @param predicate called with the bundle index and the bundle, returns
+     *                  true if the bundle is to be removed
+     * @return the number of removed bundles
+     */
+    template <typename Pred>
+    inline std::size_t prune(const Pred &predicate)
+    {
+        std::vector<std::pair<index_t, const distribution_bundle_t*>> kept;
+        std::size_t removed = 0;
+        bundle_storage_->traverse([this, &predicate, &kept, &removed](const index_t &bi, const distribution_bundle_t &b) {
+            if (predicate(bi, b)) {
+                ++ removed;
+                dirty_.mark(bi);
+            } else {
+                kept.emplace_back(bi, &b);
+            }
+        });
+        if (removed == 0)
+            return 0;
+
+        distribution_storage_array_t storage;
+        std::array<std::thread, 8> threads;
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            threads[i] = std::thread([this, &storage, &kept, i]() {
+                storage[i].reset(new distribution_storage_t);
+                for (const auto &k : kept) {
+                    const index_t si = toStorageIndex(k.first, i);
+                    if (!storage[i]->get(si))
+                        storage[i]->insert(si, *(k.second->at(i)));
+                }
+            });
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            threads[i].join();
+
+        distribution_bundle_storage_ptr_t bundle_storage(new distribution_bundle_storage_t);
+        min_index_ = {{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+        max_index_ = {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+        for (const auto &k : kept) {
+            distribution_bundle_t b;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                b[i] = storage[i]->get(toStorageIndex(k.first, i));
+            bundle_storage->insert(k.first, b);
+            updateIndices(k.first);
+        }
+
+        storage_        = storage;
+        bundle_storage_ = bundle_storage;
+        return removed;
+    }
+
+    /**
+     * @brief Remove all bundles outside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the number of removed bundles
+     */
+    inline std::size_t evictOutside(const index_t &min_bi,
+                                    const index_t &max_bi)
+    {
+        return prune([&min_bi, &max_bi](const index_t &bi, const distribution_bundle_t &) {
+            return !cslibs_ndt::box::contains(bi, min_bi, max_bi);
+        });
+    }
+
     inline void getBundleIndices(std::vector<index_t> &indices) const
     {
         auto add_index = [&indices](const index_t &i, const distribution_bundle_t &d) {
@@ -337,6 +670,26 @@ public:
         bundle_storage_->traverse(add_index);
     }
 
+    /**
+     * @brief Blocks of bundles changed by insertions, merges or pruning since
+     *        the last fetch, consumers of the map only need to reprocess these.
+     */
+    inline const dirty_blocks_t& getDirtyBlocks() const
+    {
+        return dirty_;
+    }
+
+    /**
+     * @brief Fetch the changed blocks and clear them, the next fetch only
+     *        reports the changes made in between.
+     */
+    inline dirty_blocks_t fetchDirtyBlocks()
+    {
+        dirty_blocks_t dirty(std::move(dirty_));
+        dirty_.clear();
+        return dirty;
+    }
+
     inline std::size_t getByteSize() const
     {
         return sizeof(*this) +
@@ -403,6 +756,50 @@ public:
         }
     }
 
+    /**
+     * @brief Traverse the bundles as allocatePartiallyAllocatedBundles would
+     *        leave them, in Z-order, without allocating the missing ones.
+     * @param function  called with the bundle index and its distributions,
+     *                  nullptr where not allocated
+     */
+    template <typename Fn>
+    inline void traversePartiallyAllocatedBundles(const Fn &function) const
+    {
+        if (empty())
+            return;
+
+        using set_t = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+        auto expand = [](const distribution_t *d) {
+            return d->data().getN() >= 3;
+        };
+
+        set_t   bis;
+        index_t min_bi = min_index_;
+        bundle_storage_->traverse([&bis, &min_bi, &expand](const index_t &bi, const distribution_bundle_t &b) {
+            bis.insert(bi);
+            bool populated = false;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                populated |= expand(b.at(i));
+            if (!populated)
+                return;
+            for (int i = -1 ; i <= 1 ; ++i)
+                for (int j = -1 ; j <= 1 ; ++j)
+                    for (int k = -1 ; k <= 1 ; ++k)
+                        bis.insert({{bi[0] + i, bi[1] + j, bi[2] + k}});
+            for (std::size_t d = 0 ; d < 3 ; ++d)
+                min_bi[d] = std::min(min_bi[d], bi[d] - 1);
+        });
+
+        std::vector<distribution_const_bundle_t> bundles(bis.size());
+        cslibs_ndt::morton::Order<index_t, const distribution_const_bundle_t> order(min_bi, bis.size());
+        std::size_t n = 0;
+        for (const index_t &bi : bis) {
+            lookupDistributionBundle(bi, bundles[n]);
+            order.add(bi, &bundles[n ++]);
+        }
+        order.traverse(function);
+    }
+
 protected:
     const double                                    resolution_;
     const double                                    bundle_resolution_;
@@ -415,6 +812,72 @@ protected:
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
 
+    mutable dirty_blocks_t                          dirty_;
+
+    using ordered_t = cslibs_ndt::IsMortonStorage<distribution_bundle_storage_t>;
+
+    template <typename Fn>
+    inline void traverseOrdered(const Fn &function,
+                                std::true_type) const
+    {
+        bundle_storage_->traverse(function);
+    }
+
+    template <typename Fn>
+    inline void traverseOrdered(const Fn &function,
+                                std::false_type) const
+    {
+        if (empty())
+            return;
+
+        cslibs_ndt::morton::Order<index_t, const distribution_bundle_t> order(min_index_);
+        bundle_storage_->traverse([&order](const index_t &bi, const distribution_bundle_t &b) {
+            order.add(bi, &b);
+        });
+        order.traverse(function);
+    }
+
+    template <typename Fn>
+    inline void traverse(const index_t &lo,
+                         const index_t &hi,
+                         const Fn      &function,
+                         std::true_type) const
+    {
+        bundle_storage_->traverse(lo, hi, function);
+    }
+
+    template <typename Fn>
+    inline void traverse(const index_t &lo,
+                         const index_t &hi,
+                         const Fn      &function,
+                         std::false_type) const
+    {
+        cslibs_ndt::morton::Order<index_t, const distribution_bundle_t> order(lo);
+
+        /// small boxes are looked up cell by cell, large ones filter a full traversal
+        const std::size_t box_volume = static_cast<std::size_t>(hi[0] - lo[0] + 1) *
+                                       static_cast<std::size_t>(hi[1] - lo[1] + 1) *
+                                       static_cast<std::size_t>(hi[2] - lo[2] + 1);
+        const std::size_t map_volume = static_cast<std::size_t>(max_index_[0] - min_index_[0] + 1) *
+                                       static_cast<std::size_t>(max_index_[1] - min_index_[1] + 1) *
+                                       static_cast<std::size_t>(max_index_[2] - min_index_[2] + 1);
+        if (8 * box_volume <= map_volume) {
+            for (int i = lo[0] ; i <= hi[0] ; ++i)
+                for (int j = lo[1] ; j <= hi[1] ; ++j)
+                    for (int k = lo[2] ; k <= hi[2] ; ++k) {
+                        const index_t bi = {{i, j, k}};
+                        if (const distribution_bundle_t *bundle = bundle_storage_->get(bi))
+                            order.add(bi, bundle);
+                    }
+        } else {
+            bundle_storage_->traverse([&order, &lo, &hi](const index_t &bi, const distribution_bundle_t &b) {
+                if (cslibs_ndt::box::contains(bi, lo, hi))
+                    order.add(bi, &b);
+            });
+        }
+        order.traverse(function);
+    }
+
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
     {
@@ -465,8 +928,25 @@ protected:
 
     inline void updateIndices(const index_t &chunk_index) const
     {
-        min_index_ = std::min(min_index_, chunk_index);
-        max_index_ = std::max(max_index_, chunk_index);
+        /// component-wise, std::min and std::max compare arrays lexicographically
+        for (std::size_t d = 0 ; d < chunk_index.size() ; ++d) {
+            min_index_[d] = std::min(min_index_[d], chunk_index[d]);
+            max_index_[d] = std::max(max_index_[d], chunk_index[d]);
+        }
+    }
+
+    /**
+     * @brief Index of the distribution of storage i a bundle refers to.
+     */
+    inline index_t toStorageIndex(const index_t &bi,
+                                  const std::size_t i) const
+    {
+        const int s0 = static_cast<int>(i & 1ul);
+        const int s1 = static_cast<int>((i >> 1) & 1ul);
+        const int s2 = static_cast<int>((i >> 2) & 1ul);
+        return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+                 cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2),
+                 cslibs_math::common::div<int>(bi[2], 2) + s2 * cslibs_math::common::mod<int>(bi[2], 2)}};
     }
 
     inline index_t toBundleIndex(const point_t &p_w) const
@@ -477,6 +957,9 @@ protected:
                  static_cast<int>(std::floor(p_m(2) * bundle_resolution_inv_))}};
     }
 };
+
+using Gridmap        = GridmapT<double>;
+using OrderedGridmap = GridmapT<double, cslibs_ndt::backend::Morton>;
 }
 }
 
@@ -5,6 +5,7 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <thread>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 
@@ -13,6 +14,12 @@
 
 #include <cslibs_ndt/common/occupancy_distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/insert_batch.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/merge.hpp>
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/dirty_blocks.hpp>
+#include <cslibs_ndt/common/box.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -28,29 +35,32 @@
 #include <cslibs_math_3d/algorithms/efla_iterator.hpp>
 
 #include <unordered_map>
+#include <unordered_set>
 namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt_3d {
 namespace dynamic_maps {
-class EIGEN_ALIGN16 OccupancyGridmap
+template <typename T = double>
+class EIGEN_ALIGN16 OccupancyGridmapT
 {
 public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    using allocator_t = Eigen::aligned_allocator<OccupancyGridmap>;
+    using allocator_t = Eigen::aligned_allocator<OccupancyGridmapT>;
 
-    using Ptr                               = std::shared_ptr<OccupancyGridmap>;
-    using ConstPtr                          = std::shared_ptr<const OccupancyGridmap>;
+    using Ptr                               = std::shared_ptr<OccupancyGridmapT>;
+    using ConstPtr                          = std::shared_ptr<const OccupancyGridmapT>;
     using pose_2d_t                         = cslibs_math_2d::Pose2d;
     using pose_t                            = cslibs_math_3d::Pose3d;
     using transform_t                       = cslibs_math_3d::Transform3d;
     using point_t                           = cslibs_math_3d::Point3d;
+    using batch_t                           = cslibs_ndt::InsertBatch<point_t, pose_t>;
     using index_t                           = std::array<int, 3>;
     using size_m_t                          = std::array<double, 3>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
-    using distribution_t                    = cslibs_ndt::OccupancyDistribution<3>;
+    using distribution_t                    = cslibs_ndt::OccupancyDistribution<3, T>;
     using distribution_storage_t            = cis::Storage<distribution_t, index_t, cis::backend::kdtree::KDTree>;
     using distribution_storage_ptr_t        = std::shared_ptr<distribution_storage_t>;
     using distribution_storage_array_t      = std::array<distribution_storage_ptr_t, 8>;
@@ -58,18 +68,19 @@ public:
     using distribution_const_bundle_t       = cslibs_ndt::Bundle<const distribution_t*, 8>;
     using distribution_bundle_storage_t     = cis::Storage<distribution_bundle_t, index_t, cis::backend::kdtree::KDTree>;
     using distribution_bundle_storage_ptr_t = std::shared_ptr<distribution_bundle_storage_t>;
+    using dirty_blocks_t                    = cslibs_ndt::DirtyBlocks<index_t>;
     using simple_iterator_t                 = cslibs_math_3d::algorithms::SimpleIterator;
     using inverse_sensor_model_t            = cslibs_gridmaps::utility::InverseModel;
 
-    inline OccupancyGridmap(const pose_t &origin,
-                            const double  resolution) :
+    inline OccupancyGridmapT(const pose_t &origin,
+                             const double  resolution) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
         w_T_m_(origin),
         m_T_w_(w_T_m_.inverse()),
-        min_index_{{std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}},
-        max_index_{{std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}},
+        min_index_{{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}},
+        max_index_{{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}},
         storage_{{distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
@@ -78,16 +89,18 @@ public:
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t)}},
-        bundle_storage_(new distribution_bundle_storage_t)
+        bundle_storage_(new distribution_bundle_storage_t),
+        time_(0.0),
+        decay_(0.0)
     {
     }
 
-    inline OccupancyGridmap(const pose_t &origin,
-                            const double resolution,
-                            const index_t &min_index,
-                            const index_t &max_index,
-                            const std::shared_ptr<distribution_bundle_storage_t> &bundles,
-                            const distribution_storage_array_t                   &storage) :
+    inline OccupancyGridmapT(const pose_t &origin,
+                             const double resolution,
+                             const index_t &min_index,
+                             const index_t &max_index,
+                             const std::shared_ptr<distribution_bundle_storage_t> &bundles,
+                             const distribution_storage_array_t                   &storage) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -96,11 +109,13 @@ public:
         min_index_(min_index),
         max_index_(max_index),
         storage_(storage),
-        bundle_storage_(bundles)
+        bundle_storage_(bundles),
+        time_(0.0),
+        decay_(0.0)
     {
     }
 
-    inline OccupancyGridmap(const OccupancyGridmap &other) :
+    inline OccupancyGridmapT(const OccupancyGridmapT &other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -116,11 +131,13 @@ public:
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[5])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[6])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[7]))}},
-        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_))
+        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_)),
+        time_(other.time_),
+        decay_(other.decay_)
     {
     }
 
-    inline OccupancyGridmap(OccupancyGridmap &&other) :
+    inline OccupancyGridmapT(OccupancyGridmapT &&other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -129,7 +146,9 @@ public:
         min_index_(other.min_index_),
         max_index_(other.max_index_),
         storage_(other.storage_),
-        bundle_storage_(other.bundle_storage_)
+        bundle_storage_(other.bundle_storage_),
+        time_(other.time_),
+        decay_(other.decay_)
     {
     }
 
@@ -215,7 +234,7 @@ public:
     inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
                        const pose_t &points_origin = pose_t())
     {
-        insert(points->begin(), points->end(), points_origin);
+        insert<line_iterator_t>(points->begin(), points->end(), points_origin);
     }
 
     template <typename line_iterator_t = simple_iterator_t, typename iterator_t>
@@ -247,6 +266,58 @@ public:
         });
     }
 
+    /**
+     * @brief Insert the clouds of several sensors. Occupied moments and free
+     *        space counts of all rays are accumulated first, so that every
+     *        bundle is updated once, no matter how many sensors observe it.
+     * @param batch     clouds and sensor poses
+     */
+    template <typename line_iterator_t = simple_iterator_t>
+    inline void insert(const batch_t &batch)
+    {
+        cslibs_ndt::parallel::MomentsMap<index_t, distribution_t> accumulated;
+
+        auto get_allocate = [&accumulated](const index_t &bi) {
+            return &accumulated[bi];
+        };
+
+        for (const auto &entry : batch) {
+            const pose_t &points_origin = entry.second;
+            distribution_storage_t storage;
+
+            for (const auto &p : *(entry.first)) {
+                const point_t pm = points_origin * p;
+                if (!pm.isNormal())
+                    continue;
+                const index_t bi = toBundleIndex(pm);
+                distribution_t *d = storage.get(bi);
+                (d ? d : &storage.insert(bi, distribution_t()))->updateOccupied(pm);
+            }
+
+            const point_t start_p = m_T_w_ * points_origin.translation();
+            storage.traverse([this, &start_p, &get_allocate](const index_t& bi, const distribution_t &d) {
+                if (!d.getDistribution())
+                    return;
+                get_allocate(bi)->updateOccupied(d.getDistribution());
+
+                line_iterator_t it(start_p, m_T_w_ * point_t(d.getDistribution()->getMean()), bundle_resolution_);
+                const std::size_t n = d.numOccupied();
+                while (!it.done()) {
+                    const index_t bit = {{it.x(), it.y(), it.z()}};
+                    get_allocate(bit)->updateFree(n);
+                    ++ it;
+                }
+            });
+        }
+
+        for (const auto &a : accumulated) {
+            if (a.second.numFree() > 0)
+                updateFree(a.first, a.second.numFree());
+            if (a.second.getDistribution())
+                updateOccupied(a.first, a.second.getDistribution());
+        }
+    }
+
     template <typename line_iterator_t = simple_iterator_t>
     inline void insertVisible(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
                               const inverse_sensor_model_t::Ptr &ivm,
@@ -261,14 +332,14 @@ public:
         const index_t start_bi = toBundleIndex(points_origin.translation());
         auto occupancy = [this, &ivm](const index_t &bi) {
             distribution_bundle_t *bundle = getAllocate(bi);
-            return 0.125 * (bundle->at(0)->getOccupancy(ivm) +
-                            bundle->at(1)->getOccupancy(ivm) +
-                            bundle->at(2)->getOccupancy(ivm) +
-                            bundle->at(3)->getOccupancy(ivm) +
-                            bundle->at(4)->getOccupancy(ivm) +
-                            bundle->at(5)->getOccupancy(ivm) +
-                            bundle->at(6)->getOccupancy(ivm) +
-                            bundle->at(7)->getOccupancy(ivm));
+            return 0.125 * (bundle->at(0)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(1)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(2)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(3)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(4)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(5)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(6)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(7)->getOccupancy(ivm, time_, decay_));
         };
         auto current_visibility = [this, &start_bi, &ivm_visibility, &occupancy](const index_t &bi) {
             const double occlusion_prob =
@@ -313,6 +384,103 @@ public:
         });
     }
 
+    /**
+     * @brief Fuse another map into this one by composing the free counts and
+     *        the moments of its distributions, so no measurements have to be
+     *        inserted again. If both
+     *        grids are aligned, i.e. they share the resolution and are offset
+     *        by whole cells, every distribution is composed exactly with its
+     *        counterpart, one thread per storage. Otherwise the distributions
+     *        of storage 0, which partition the points of the other map, are
+     *        transformed and re-binned into the bundles their means fall into,
+     *        or their cell centers, if they only contain free space.
+     *        With decay, cells are brought to the later one of their stamps
+     *        before they are composed.
+     * @param other         the map to merge
+     * @param transform     transformation from the world frame of other into
+     *                      the world frame of this map
+     * @param num_threads   number of threads to re-bin with
+     */
+    inline void merge(const OccupancyGridmapT &other,
+                      const transform_t &transform = transform_t(),
+                      const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        using partial_t     = cslibs_ndt::parallel::MomentsMap<index_t, distribution_t>;
+        using rotation_t    = Eigen::Matrix<double, 3, 3>;
+        using translation_t = Eigen::Matrix<double, 3, 1>;
+
+        if (&other == this) {
+            const OccupancyGridmapT copy(other);
+            merge(copy, transform, num_threads);
+            return;
+        }
+
+        auto decompose = [](const transform_t &t, rotation_t &R, translation_t &o) {
+            o = (t * point_t(0.0, 0.0, 0.0)).data();
+            R.col(0) = (t * point_t(1.0, 0.0, 0.0)).data() - o;
+            R.col(1) = (t * point_t(0.0, 1.0, 0.0)).data() - o;
+            R.col(2) = (t * point_t(0.0, 0.0, 1.0)).data() - o;
+        };
+        rotation_t    R;
+        translation_t t;
+        decompose(transform, R, t);
+
+        rotation_t    R_grid;
+        translation_t t_grid;
+        decompose(m_T_w_ * transform * other.w_T_m_, R_grid, t_grid);
+
+        index_t offset;
+        if (std::abs(resolution_ - other.resolution_) < 1e-9 &&
+                cslibs_ndt::merge::aligned<3>(R_grid, t_grid, resolution_, offset)) {
+            other.bundle_storage_->traverse([this, &offset](const index_t &bi, const distribution_bundle_t &) {
+                const index_t target = {{bi[0] + 2 * offset[0], bi[1] + 2 * offset[1], bi[2] + 2 * offset[2]}};
+                getAllocateDecayed(target);
+                dirty_.mark(target);
+            });
+
+            std::array<std::thread, 8> threads;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                threads[i] = std::thread([this, &other, &offset, &R, &t, i]() {
+                    const distribution_storage_ptr_t &storage = storage_[i];
+                    const double                      decay   = decay_;
+                    other.storage_[i]->traverse([&storage, &offset, &R, &t, decay](const index_t &si, const distribution_t &d) {
+                        distribution_t *target = storage->get({{si[0] + offset[0], si[1] + offset[1], si[2] + offset[2]}});
+                        if (target)
+                            target->merge(cslibs_ndt::merge::transform(d, R, t), decay);
+                    });
+                });
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                threads[i].join();
+            return;
+        }
+
+        std::vector<std::pair<index_t, const distribution_t*>> sources;
+        other.storage_[0]->traverse([&sources](const index_t &si, const distribution_t &d) {
+            if (d.numFree() > 0 || d.numOccupied() > 0)
+                sources.emplace_back(si, &d);
+        });
+
+        const transform_t w_T_o = transform * other.w_T_m_;
+        const double      r     = other.resolution_;
+        auto rebin = [this, &R, &t, &w_T_o, r](const std::pair<index_t, const distribution_t*> &s, partial_t &values) {
+            const distribution_t d = cslibs_ndt::merge::transform(*s.second, R, t);
+            const point_t p = d.getDistribution() ?
+                        point_t(d.getDistribution()->getMean()(0), d.getDistribution()->getMean()(1), d.getDistribution()->getMean()(2)) :
+                        w_T_o * point_t((s.first[0] + 0.5) * r, (s.first[1] + 0.5) * r, (s.first[2] + 0.5) * r);
+            values[toBundleIndex(p)].merge(d, decay_);
+        };
+        auto allocate = [this](const index_t &bi) {
+            dirty_.mark(bi);
+            return getAllocateDecayed(bi);
+        };
+        auto update = [this](distribution_t &d, const distribution_t &v) {
+            d.merge(v, decay_);
+        };
+        const std::vector<partial_t> partial =
+                cslibs_ndt::parallel::aggregate<partial_t>(sources.begin(), sources.end(), num_threads, rebin);
+        cslibs_ndt::parallel::merge<distribution_bundle_t, index_t>(partial, allocate, update);
+    }
+
     inline double sample(const point_t &p,
                          const inverse_sensor_model_t::Ptr &ivm) const
     {
@@ -322,11 +490,11 @@ public:
         const index_t bi = toBundleIndex(p);
         distribution_bundle_t *bundle = bundle_storage_->get(bi);
 
-        auto sample = [&p, &ivm] (const distribution_t *d) {
-            auto do_sample = [&p, &ivm, &d]() {
+        auto sample = [this, &p, &ivm] (const distribution_t *d) {
+            auto do_sample = [this, &p, &ivm, &d]() {
                 const auto &handle = d;
                 return handle->getDistribution() ?
-                            handle->getDistribution()->sample(p) * handle->getOccupancy(ivm) : 0.0;
+                            handle->getDistribution()->sample(p) * handle->getOccupancy(ivm, time_, decay_) : 0.0;
             };
             return d ? do_sample() : 0.0;
         };
@@ -353,11 +521,11 @@ public:
         const index_t bi = toBundleIndex(p);
         distribution_bundle_t *bundle  = bundle_storage_->get(bi);
 
-        auto sample = [&p, &ivm] (const distribution_t *d) {
-            auto do_sample = [&p, &ivm, &d]() {
+        auto sample = [this, &p, &ivm] (const distribution_t *d) {
+            auto do_sample = [this, &p, &ivm, &d]() {
                 const auto &handle = d;
                 return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm) : 0.0;
+                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm, time_, decay_) : 0.0;
             };
             return d ? do_sample() : 0.0;
         };
@@ -375,6 +543,11 @@ public:
         return bundle ? evaluate() : 0.0;
     }
 
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_index_;
@@ -401,6 +574,58 @@ public:
         return getAllocate(bi);
     }
 
+    /**
+     * @brief Look up the distributions of a bundle without allocating it.
+     *        Neighbours of populated bundles share distributions with them,
+     *        so they can be sampled without allocatePartiallyAllocatedBundles,
+     *        which leaves the map unchanged and safe to read concurrently.
+     * @param bi        bundle index, the bundle does not need to exist
+     * @param bundle    the distributions, nullptr if not allocated
+     * @return true if any of the distributions exists
+     */
+    inline bool lookupDistributionBundle(const index_t               &bi,
+                                         distribution_const_bundle_t &bundle) const
+    {
+        bool found = false;
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            bundle[i] = storage_[i]->get(toStorageIndex(bi, i));
+            found    |= bundle[i] != nullptr;
+        }
+        return found;
+    }
+
+    /**
+     * @brief Enable exponential forgetting for changing environments. The free
+     *        counts and moments of a cell are weighted down by exp(-dt / decay)
+     *        for the time dt passed since it was last touched. This is applied
+     *        lazily, when the cell is updated or read, there is no global pass.
+     * @param decay     time constant, zero disables forgetting
+     */
+    inline void setDecay(const double decay)
+    {
+        decay_ = decay;
+    }
+
+    inline double getDecay() const
+    {
+        return decay_;
+    }
+
+    /**
+     * @brief Set the current time, following updates and reads decay the
+     *        cells they touch up to it.
+     * @param time      current time, must not run backwards
+     */
+    inline void setTime(const double time)
+    {
+        time_ = time;
+    }
+
+    inline double getTime() const
+    {
+        return time_;
+    }
+
     inline double getBundleResolution() const
     {
         return bundle_resolution_;
@@ -429,6 +654,166 @@ public:
         return bundle_storage_->traverse(function);
     }
 
+    /**
+     * @brief Traverse all bundles in Z-order (Morton order), so that
+     *        spatially adjacent bundles are visited consecutively. The bundles
+     *        are collected and sorted first, which costs O(n log n), so use
+     *        traverse where the order does not matter.
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverseOrdered(const Fn& function) const
+    {
+        if (empty())
+            return;
+
+        cslibs_ndt::morton::Order<index_t, const distribution_bundle_t> order(min_index_);
+        bundle_storage_->traverse([&order](const index_t &bi, const distribution_bundle_t &b) {
+            order.add(bi, &b);
+        });
+        order.traverse(function);
+    }
+
+    /**
+     * @brief Traverse the bundles inside an axis-aligned box in Z-order.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2])
+            return;
+
+        cslibs_ndt::morton::Order<index_t, const distribution_bundle_t> order(lo);
+
+        /// small boxes are looked up cell by cell, large ones filter a full traversal
+        const std::size_t box_volume = static_cast<std::size_t>(hi[0] - lo[0] + 1) *
+                                       static_cast<std::size_t>(hi[1] - lo[1] + 1) *
+                                       static_cast<std::size_t>(hi[2] - lo[2] + 1);
+        const std::size_t map_volume = static_cast<std::size_t>(max_index_[0] - min_index_[0] + 1) *
+                                       static_cast<std::size_t>(max_index_[1] - min_index_[1] + 1) *
+                                       static_cast<std::size_t>(max_index_[2] - min_index_[2] + 1);
+        if (8 * box_volume <= map_volume) {
+            for (int i = lo[0] ; i <= hi[0] ; ++i)
+                for (int j = lo[1] ; j <= hi[1] ; ++j)
+                    for (int k = lo[2] ; k <= hi[2] ; ++k) {
+                        const index_t bi = {{i, j, k}};
+                        if (const distribution_bundle_t *bundle = bundle_storage_->get(bi))
+                            order.add(bi, bundle);
+                    }
+        } else {
+            bundle_storage_->traverse([&order, &lo, &hi](const index_t &bi, const distribution_bundle_t &b) {
+                if (cslibs_ndt::box::contains(bi, lo, hi))
+                    order.add(bi, &b);
+            });
+        }
+        order.traverse(function);
+    }
+
+    /**
+     * @brief Extract the bundles inside an axis-aligned box into a new map,
+     *        the distributions are copied together with their decay state,
+     *        the time and the decay constant of the map. All extracted bundles
+     *        are dirty in the new map.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the cropped map, nullptr if the box does not intersect the map
+     */
+    inline Ptr crop(const index_t &min_bi,
+                    const index_t &max_bi) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2])
+            return nullptr;
+
+        Ptr dst(new OccupancyGridmapT(w_T_m_, resolution_));
+        dst->time_  = time_;
+        dst->decay_ = decay_;
+        traverse(lo, hi, [&dst](const index_t &bi, const distribution_bundle_t &b) {
+            distribution_bundle_t *b_dst = dst->getDistributionBundle(bi);
+            dst->dirty_.mark(bi);
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                *(b_dst->at(i)) = b.at(i)->clone();
+        });
+        return dst;
+    }
+
+    /**
+     * @brief Remove the bundles matching a predicate together with the
+     *        distributions no remaining bundle refers to. The storages are
+     *        rebuilt in parallel, which releases their memory, and the
+     *        bounds are recomputed.
+     * @param predicate called with the bundle index and the bundle, returns
+     *                  true if the bundle is to be removed
+     * @return the number of removed bundles
+     */
+    template <typename Pred>
+    inline std::size_t prune(const Pred &predicate)
+    {
+        std::vector<std::pair<index_t, const distribution_bundle_t*>> kept;
+        std::size_t removed = 0;
+        bundle_storage_->traverse([this, &predicate, &kept, &removed](const index_t &bi, const distribution_bundle_t &b) {
+            if (predicate(bi, b)) {
+                ++ removed;
+                dirty_.mark(bi);
+            } else {
+                kept.emplace_back(bi, &b);
+            }
+        });
+        if (removed == 0)
+            return 0;
+
+        distribution_storage_array_t storage;
+        std::array<std::thread, 8> threads;
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            threads[i] = std::thread([this, &storage, &kept, i]() {
+                storage[i].reset(new distribution_storage_t);
+                for (const auto &k : kept) {
+                    const index_t si = toStorageIndex(k.first, i);
+                    if (!storage[i]->get(si))
+                        storage[i]->insert(si, *(k.second->at(i)));
+                }
+            });
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            threads[i].join();
+
+        distribution_bundle_storage_ptr_t bundle_storage(new distribution_bundle_storage_t);
+        min_index_ = {{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+        max_index_ = {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+        for (const auto &k : kept) {
+            distribution_bundle_t b;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                b[i] = storage[i]->get(toStorageIndex(k.first, i));
+            bundle_storage->insert(k.first, b);
+            updateIndices(k.first);
+        }
+
+        storage_        = storage;
+        bundle_storage_ = bundle_storage;
+        return removed;
+    }
+
+    /**
+     * @brief Remove all bundles outside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the number of removed bundles
+     */
+    inline std::size_t evictOutside(const index_t &min_bi,
+                                    const index_t &max_bi)
+    {
+        return prune([&min_bi, &max_bi](const index_t &bi, const distribution_bundle_t &) {
+            return !cslibs_ndt::box::contains(bi, min_bi, max_bi);
+        });
+    }
+
     inline void getBundleIndices(std::vector<index_t> &indices) const
     {
         auto add_index = [&indices](const index_t &i, const distribution_bundle_t &d) {
@@ -437,6 +822,26 @@ public:
         bundle_storage_->traverse(add_index);
     }
 
+    /**
+     * @brief Blocks of bundles changed by insertions, merges or pruning since
+     *        the last fetch, consumers of the map only need to reprocess these.
+     */
+    inline const dirty_blocks_t& getDirtyBlocks() const
+    {
+        return dirty_;
+    }
+
+    /**
+     * @brief Fetch the changed blocks and clear them, the next fetch only
+     *        reports the changes made in between.
+     */
+    inline dirty_blocks_t fetchDirtyBlocks()
+    {
+        dirty_blocks_t dirty(std::move(dirty_));
+        dirty_.clear();
+        return dirty;
+    }
+
     inline std::size_t getByteSize() const
     {
         return sizeof(*this) +
@@ -509,6 +914,50 @@ public:
         }
     }
 
+    /**
+     * @brief Traverse the bundles as allocatePartiallyAllocatedBundles would
+     *        leave them, in Z-order, without allocating the missing ones.
+     * @param function  called with the bundle index and its distributions,
+     *                  nullptr where not allocated
+     */
+    template <typename Fn>
+    inline void traversePartiallyAllocatedBundles(const Fn &function) const
+    {
+        if (empty())
+            return;
+
+        using set_t = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+        auto expand = [](const distribution_t *d) {
+            return d && d->getDistribution() && d->getDistribution()->getN() >= 3;
+        };
+
+        set_t   bis;
+        index_t min_bi = min_index_;
+        bundle_storage_->traverse([&bis, &min_bi, &expand](const index_t &bi, const distribution_bundle_t &b) {
+            bis.insert(bi);
+            bool populated = false;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                populated |= expand(b.at(i));
+            if (!populated)
+                return;
+            for (int i = -1 ; i <= 1 ; ++i)
+                for (int j = -1 ; j <= 1 ; ++j)
+                    for (int k = -1 ; k <= 1 ; ++k)
+                        bis.insert({{bi[0] + i, bi[1] + j, bi[2] + k}});
+            for (std::size_t d = 0 ; d < 3 ; ++d)
+                min_bi[d] = std::min(min_bi[d], bi[d] - 1);
+        });
+
+        std::vector<distribution_const_bundle_t> bundles(bis.size());
+        cslibs_ndt::morton::Order<index_t, const distribution_const_bundle_t> order(min_bi, bis.size());
+        std::size_t n = 0;
+        for (const index_t &bi : bis) {
+            lookupDistributionBundle(bi, bundles[n]);
+            order.add(bi, &bundles[n ++]);
+        }
+        order.traverse(function);
+    }
+
 private:
     const double                                    resolution_;
     const double                                    bundle_resolution_;
@@ -522,6 +971,11 @@ private:
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
 
+    mutable dirty_blocks_t                          dirty_;
+
+    double                                          time_;
+    double                                          decay_;
+
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
     {
@@ -569,9 +1023,23 @@ private:
         return get_allocate(bi);
     }
 
-    inline void updateFree(const index_t &bi) const
+    /**
+     * @brief Allocate a bundle which is about to be updated, its distributions
+     *        are decayed up to the current time first. Reads evaluate the decay
+     *        without modifying the distributions.
+     */
+    inline distribution_bundle_t *getAllocateDecayed(const index_t &bi) const
     {
         distribution_bundle_t *bundle = getAllocate(bi);
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            bundle->at(i)->decay(time_, decay_);
+        return bundle;
+    }
+
+    inline void updateFree(const index_t &bi) const
+    {
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
+        dirty_.mark(bi);
         bundle->at(0)->updateFree();
         bundle->at(1)->updateFree();
         bundle->at(2)->updateFree();
@@ -585,7 +1053,8 @@ private:
     inline void updateFree(const index_t &bi,
                            const std::size_t &n) const
     {
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
+        dirty_.mark(bi);
         bundle->at(0)->updateFree(n);
         bundle->at(1)->updateFree(n);
         bundle->at(2)->updateFree(n);
@@ -599,7 +1068,8 @@ private:
     inline void updateOccupied(const index_t &bi,
                                const point_t &p) const
     {
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
+        dirty_.mark(bi);
         bundle->at(0)->updateOccupied(p);
         bundle->at(1)->updateOccupied(p);
         bundle->at(2)->updateOccupied(p);
@@ -611,9 +1081,10 @@ private:
     }
 
     inline void updateOccupied(const index_t &bi,
-                               const distribution_t::distribution_ptr_t &d) const
+                               const typename distribution_t::distribution_ptr_t &d) const
     {
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
+        dirty_.mark(bi);
         bundle->at(0)->updateOccupied(d);
         bundle->at(1)->updateOccupied(d);
         bundle->at(2)->updateOccupied(d);
@@ -626,8 +1097,25 @@ private:
 
     inline void updateIndices(const index_t &bi) const
     {
-        min_index_ = std::min(min_index_, bi);
-        max_index_ = std::max(max_index_, bi);
+        /// component-wise, std::min and std::max compare arrays lexicographically
+        for (std::size_t d = 0 ; d < bi.size() ; ++d) {
+            min_index_[d] = std::min(min_index_[d], bi[d]);
+            max_index_[d] = std::max(max_index_[d], bi[d]);
+        }
+    }
+
+    /**
+     * @brief Index of the distribution of storage i a bundle refers to.
+     */
+    inline index_t toStorageIndex(const index_t &bi,
+                                  const std::size_t i) const
+    {
+        const int s0 = static_cast<int>(i & 1ul);
+        const int s1 = static_cast<int>((i >> 1) & 1ul);
+        const int s2 = static_cast<int>((i >> 2) & 1ul);
+        return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+                 cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2),
+                 cslibs_math::common::div<int>(bi[2], 2) + s2 * cslibs_math::common::mod<int>(bi[2], 2)}};
     }
 
     inline index_t toBundleIndex(const point_t &p_w) const
@@ -638,6 +1126,8 @@ private:
                  static_cast<int>(std::floor(p_m(2) * bundle_resolution_inv_))}};
     }
 };
+
+using OccupancyGridmap = OccupancyGridmapT<double>;
 }
 }
 
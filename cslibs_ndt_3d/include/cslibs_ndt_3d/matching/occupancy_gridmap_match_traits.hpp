@@ -10,8 +10,8 @@ namespace cslibs_ndt {
 namespace matching {
 
 template<typename MapT> struct IsOccupancyGridmap : std::false_type {};
-template<> struct IsOccupancyGridmap<cslibs_ndt_3d::dynamic_maps::OccupancyGridmap> : std::true_type {};
-template<> struct IsOccupancyGridmap<cslibs_ndt_3d::static_maps::OccupancyGridmap> : std::true_type {};
+template<typename T> struct IsOccupancyGridmap<cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>> : std::true_type {};
+template<typename T> struct IsOccupancyGridmap<cslibs_ndt_3d::static_maps::OccupancyGridmapT<T>> : std::true_type {};
 
 template<typename MapT>
 struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap<MapT>::value>::type>
@@ -61,7 +61,7 @@ struct MatchTraits<MapT, typename std::enable_if<IsOccupancyGridmap<MapT>::value
             const auto info   = d->getInformationMatrix();
             const auto q      = (point.data() - d->getMean()).eval();
             const auto q_info = (q.transpose() * info).eval();
-            const auto p_occ  = distribution_wrapper->getOccupancy(model);
+            const auto p_occ  = distribution_wrapper->getOccupancy(model, map.getTime(), map.getDecay());
             const auto e      = -0.5 * double(q_info * q) * (d2 * (1 - p_occ));
             const auto s      = d1 * p_occ * std::exp(e);
             if (!std::isnormal(s) || s <= 1e-5)
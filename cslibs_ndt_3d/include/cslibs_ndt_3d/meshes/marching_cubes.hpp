@@ -0,0 +1,373 @@
+#ifndef CSLIBS_NDT_3D_MESHES_MARCHING_CUBES_HPP
+#define CSLIBS_NDT_3D_MESHES_MARCHING_CUBES_HPP
+
+#include <array>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <cslibs_ndt_3d/meshes/mesh.hpp>
+#include <cslibs_ndt_3d/voxel_grids/block_voxel_grid.hpp>
+
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+namespace cslibs_ndt_3d {
+namespace meshes {
+namespace impl {
+/**
+ * @brief Edge of a cube from a corner along an axis, corner c of a cube is at
+ *        (c & 1, (c >> 1) & 1, (c >> 2) & 1).
+ */
+struct Edge
+{
+    int corner;
+    int axis;
+};
+
+inline const std::array<Edge, 12>& edges()
+{
+    static const std::array<Edge, 12> es = []() {
+        std::array<Edge, 12> es;
+        std::size_t e = 0;
+        for (int axis = 0 ; axis < 3 ; ++axis)
+            for (int c = 0 ; c < 8 ; ++c)
+                if (!((c >> axis) & 1))
+                    es[e++] = Edge{c, axis};
+        return es;
+    }();
+    return es;
+}
+
+/**
+ * @brief Edge between two adjacent corners.
+ */
+inline int edge(const int a,
+                const int b)
+{
+    const int corner = std::min(a, b);
+    const int axis   = (a ^ b) == 1 ? 0 : ((a ^ b) == 2 ? 1 : 2);
+    const std::array<Edge, 12> &es = edges();
+    for (int e = 0 ; e < 12 ; ++e)
+        if (es[e].corner == corner && es[e].axis == axis)
+            return e;
+    return -1;
+}
+
+/**
+ * @brief Whether two edges lie on a common face.
+ */
+inline bool coplanar(const int a,
+                     const int b)
+{
+    const Edge &ea = edges()[a];
+    const Edge &eb = edges()[b];
+    for (int axis = 0 ; axis < 3 ; ++axis)
+        if (axis != ea.axis && axis != eb.axis && ((ea.corner >> axis) & 1) == ((eb.corner >> axis) & 1))
+            return true;
+    return false;
+}
+
+using triangle_t  = std::array<uint8_t, 3>;
+using triangles_t = std::vector<triangle_t>;
+
+/**
+ * @brief Triangulate a polygon without diagonals between vertices on a common
+ *        face, the cube on the other side of the face could use the same
+ *        diagonal, which would join four triangles. The triangle on the edge
+ *        from the last to the first vertex is chosen first, the rest recursively.
+ * @return false if there is no such triangulation
+ */
+inline bool triangulate(const std::vector<uint8_t> &polygon,
+                        triangles_t                &ts)
+{
+    const std::size_t l = polygon.size();
+    if (l < 3)
+        return true;
+
+    for (std::size_t k = 1 ; k + 1 < l ; ++k) {
+        if ((k > 1 && coplanar(polygon[0], polygon[k])) || (k + 2 < l && coplanar(polygon[k], polygon[l - 1])))
+            continue;
+
+        triangles_t t;
+        if (triangulate(std::vector<uint8_t>(polygon.begin(), polygon.begin() + k + 1), t) &&
+                triangulate(std::vector<uint8_t>(polygon.begin() + k, polygon.end()), t)) {
+            ts.emplace_back(triangle_t{{polygon[0], polygon[k], polygon[l - 1]}});
+            ts.insert(ts.end(), t.begin(), t.end());
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Triangles of a cube by the edges their vertices lie on, for a set of
+ *        corners inside the surface.
+ *
+ *        On every face, each run of inside corners, counter clockwise about
+ *        the outward normal, is cut off by a segment from the edge entering
+ *        it to the edge leaving it. This also separates diagonal inside
+ *        corners and only depends on the corners of the face, so adjacent
+ *        cubes agree. The segments of all faces form closed loops around
+ *        the inside corners, which are triangulated without diagonals on the
+ *        faces.
+ * @param configuration     bit c is set if corner c is inside
+ */
+inline triangles_t triangulate(const int configuration)
+{
+    auto inside = [configuration](const int c) {
+        return ((configuration >> c) & 1) != 0;
+    };
+
+    static const std::array<int, 4> cu = {{0, 1, 1, 0}};
+    static const std::array<int, 4> cv = {{0, 0, 1, 1}};
+    std::array<int, 12> next;
+    next.fill(-1);
+    for (int axis = 0 ; axis < 3 ; ++axis) {
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        for (int side = 0 ; side < 2 ; ++side) {
+            std::array<int, 4> q;
+            for (int k = 0 ; k < 4 ; ++k) {
+                const int j = side ? k : (4 - k) % 4;
+                q[k] = (side << axis) | (cu[j] << u) | (cv[j] << v);
+            }
+            for (int k = 0 ; k < 4 ; ++k) {
+                if (!inside(q[k]) || inside(q[(k + 1) % 4]))
+                    continue;
+                int i = k;
+                while (inside(q[(i + 3) % 4]))
+                    i = (i + 3) % 4;
+                next[edge(q[(i + 3) % 4], q[i])] = edge(q[k], q[(k + 1) % 4]);
+            }
+        }
+    }
+
+    triangles_t ts;
+    std::array<bool, 12> visited;
+    visited.fill(false);
+    for (int e = 0 ; e < 12 ; ++e) {
+        if (next[e] < 0 || visited[e])
+            continue;
+        std::vector<uint8_t> loop;
+        for (int f = e ; !visited[f] ; f = next[f]) {
+            visited[f] = true;
+            loop.emplace_back(static_cast<uint8_t>(f));
+        }
+        if (!triangulate(loop, ts))
+            for (std::size_t i = 1 ; i + 1 < loop.size() ; ++i)
+                ts.emplace_back(triangle_t{{loop[0], loop[i], loop[i + 1]}});
+    }
+    return ts;
+}
+
+/**
+ * @brief Triangulations of all 256 configurations, generated once.
+ */
+inline const triangles_t& triangles(const int configuration)
+{
+    static const std::array<triangles_t, 256> table = []() {
+        std::array<triangles_t, 256> table;
+        for (int c = 0 ; c < 256 ; ++c)
+            table[c] = triangulate(c);
+        return table;
+    }();
+    return table[configuration];
+}
+
+/**
+ * @brief Triangles of the cubes of a block, the cubes with their lowest
+ *        corner in it.
+ */
+struct Block
+{
+    using key_t = std::array<int, 4>;   /// lowest voxel and axis of an edge
+
+    std::vector<Mesh::vertex_t>               vertices;
+    std::vector<uint32_t>                     indices;
+    std::vector<std::pair<uint32_t, key_t>>   shared;     /// vertices on edges shared with other blocks
+};
+
+/**
+ * @brief Run marching cubes on a block. The voxels of the block and of the
+ *        first layer of its upper neighbours are gathered first, so each
+ *        block is looked up once. Vertices are shared within the block.
+ * @param samples   buffer of (n + 1)^3 voxels
+ * @param ids       buffer of 3 (n + 1)^3 vertex ids
+ */
+template<typename T>
+inline void extract(const cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<T> &src,
+                    const std::array<int, 3>                            &bi,
+                    const T                                             &iso_value,
+                    Block                                               &dst,
+                    std::vector<T>                                      &samples,
+                    std::vector<uint32_t>                               &ids)
+{
+    using point_t = cslibs_math_3d::Point3d;
+    using block_t = typename cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<T>::block_t;
+
+    const int n = src.getBlockSize();
+    const int m = n + 1;
+    auto sample = [m](const int x, const int y, const int z) {
+        return (z * m + y) * m + x;
+    };
+
+    bool above = false;
+    bool below = false;
+    for (int o = 0 ; o < 8 ; ++o) {
+        const int ox = o & 1, oy = (o >> 1) & 1, oz = (o >> 2) & 1;
+        const block_t *b = src.getBlock({{bi[0] + ox, bi[1] + oy, bi[2] + oz}});
+        for (int z = oz * n ; z < (oz ? m : n) ; ++z) {
+            for (int y = oy * n ; y < (oy ? m : n) ; ++y) {
+                for (int x = ox * n ; x < (ox ? m : n) ; ++x) {
+                    const T &v = b ? (*b)[((z - oz * n) * n + (y - oy * n)) * n + (x - ox * n)] : src.getDefaultValue();
+                    samples[sample(x, y, z)] = v;
+                    (v >= iso_value ? above : below) = true;
+                }
+            }
+        }
+    }
+    if (!above || !below)
+        return;
+
+    std::fill(ids.begin(), ids.end(), std::numeric_limits<uint32_t>::max());
+    const std::array<Edge, 12> &es = edges();
+    const std::array<int, 3> base = {{bi[0] * n, bi[1] * n, bi[2] * n}};
+    const double resolution = src.getResolution();
+
+    for (int z = 0 ; z < n ; ++z) {
+        for (int y = 0 ; y < n ; ++y) {
+            for (int x = 0 ; x < n ; ++x) {
+                int configuration = 0;
+                for (int c = 0 ; c < 8 ; ++c)
+                    if (samples[sample(x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1))] >= iso_value)
+                        configuration |= 1 << c;
+
+                for (const triangle_t &t : triangles(configuration)) {
+                    for (const uint8_t e : t) {
+                        const Edge &edge = es[e];
+                        const std::array<int, 3> c = {{x + (edge.corner & 1), y + ((edge.corner >> 1) & 1), z + ((edge.corner >> 2) & 1)}};
+                        uint32_t &id = ids[sample(c[0], c[1], c[2]) * 3 + edge.axis];
+                        if (id == std::numeric_limits<uint32_t>::max()) {
+                            std::array<int, 3> d = c;
+                            ++d[edge.axis];
+                            const T va = samples[sample(c[0], c[1], c[2])];
+                            const T vb = samples[sample(d[0], d[1], d[2])];
+                            std::array<double, 3> p = {{static_cast<double>(base[0] + c[0]),
+                                                        static_cast<double>(base[1] + c[1]),
+                                                        static_cast<double>(base[2] + c[2])}};
+                            p[edge.axis] += static_cast<double>(iso_value - va) / static_cast<double>(vb - va);
+                            const point_t p_w = src.getOrigin() * point_t(p[0] * resolution, p[1] * resolution, p[2] * resolution);
+
+                            id = static_cast<uint32_t>(dst.vertices.size());
+                            dst.vertices.emplace_back(Mesh::vertex_t{{static_cast<float>(p_w(0)),
+                                                                      static_cast<float>(p_w(1)),
+                                                                      static_cast<float>(p_w(2))}});
+                            const int u = (edge.axis + 1) % 3;
+                            const int v = (edge.axis + 2) % 3;
+                            if (c[u] == 0 || c[u] == n || c[v] == 0 || c[v] == n)
+                                dst.shared.emplace_back(id, Block::key_t{{base[0] + c[0], base[1] + c[1], base[2] + c[2], edge.axis}});
+                        }
+                        dst.indices.emplace_back(id);
+                    }
+                }
+            }
+        }
+    }
+}
+}
+
+/**
+ * @brief Extract the surface where a block sparse voxel grid crosses a value.
+ *        Voxels of missing blocks have the default value, so the surface is
+ *        closed if it lies below the value. The cubes are processed block by
+ *        block in parallel, vertices on edges shared between blocks are merged
+ *        afterwards. The output does not depend on the number of threads.
+ * @param iso_value     voxels with at least this value are inside
+ * @param dst           the triangles are counter clockwise seen from voxels
+ *                      below the value
+ * @param num_threads   number of threads
+ */
+template<typename T>
+inline void extract(const cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<T> &src,
+                    const T                                             &iso_value,
+                    Mesh                                                &dst,
+                    const std::size_t                                    num_threads = std::thread::hardware_concurrency())
+{
+    using index_t = std::array<int, 3>;
+    using block_t = typename cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<T>::block_t;
+    static constexpr std::size_t batch_size = 16;
+
+    dst.vertices.clear();
+    dst.indices.clear();
+
+    /// cubes of missing blocks touch the blocks above them
+    std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>> unique;
+    src.traverse([&unique](const index_t &bi, const block_t &) {
+        for (int o = 0 ; o < 8 ; ++o)
+            unique.insert({{bi[0] - (o & 1), bi[1] - ((o >> 1) & 1), bi[2] - ((o >> 2) & 1)}});
+    });
+    std::vector<index_t> bis(unique.begin(), unique.end());
+    std::sort(bis.begin(), bis.end());
+
+    /// the table is generated before the workers start
+    impl::triangles(0);
+
+    const int m = src.getBlockSize() + 1;
+    std::vector<impl::Block> blocks(bis.size());
+    const std::size_t batches = (bis.size() + batch_size - 1) / batch_size;
+    std::atomic<std::size_t> next(0);
+    auto run = [&src, &iso_value, &bis, &blocks, &next, batches, m]() {
+        std::vector<T>        samples(m * m * m);
+        std::vector<uint32_t> ids(3 * m * m * m);
+        for (std::size_t b = next++ ; b < batches ; b = next++) {
+            const std::size_t end = std::min(bis.size(), (b + 1) * batch_size);
+            for (std::size_t i = b * batch_size ; i < end ; ++i)
+                impl::extract(src, bis[i], iso_value, blocks[i], samples, ids);
+        }
+    };
+
+    const std::size_t threads = std::max<std::size_t>(1, std::min(num_threads, batches));
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1 ; t < threads ; ++t)
+        workers.emplace_back(run);
+    run();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    std::size_t vertices = 0;
+    std::size_t indices  = 0;
+    for (const impl::Block &b : blocks) {
+        vertices += b.vertices.size();
+        indices  += b.indices.size();
+    }
+    dst.vertices.reserve(vertices);
+    dst.indices.reserve(indices);
+
+    std::unordered_map<impl::Block::key_t, uint32_t, cslibs_ndt::parallel::IndexHash<impl::Block::key_t>> welded;
+    std::vector<uint32_t> remap;
+    for (const impl::Block &b : blocks) {
+        remap.assign(b.vertices.size(), std::numeric_limits<uint32_t>::max());
+        for (const auto &s : b.shared) {
+            const auto w = welded.emplace(s.second, static_cast<uint32_t>(dst.vertices.size()));
+            if (w.second)
+                dst.vertices.emplace_back(b.vertices[s.first]);
+            remap[s.first] = w.first->second;
+        }
+        for (std::size_t i = 0 ; i < b.vertices.size() ; ++i) {
+            if (remap[i] == std::numeric_limits<uint32_t>::max()) {
+                remap[i] = static_cast<uint32_t>(dst.vertices.size());
+                dst.vertices.emplace_back(b.vertices[i]);
+            }
+        }
+        for (const uint32_t i : b.indices)
+            dst.indices.emplace_back(remap[i]);
+    }
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_MESHES_MARCHING_CUBES_HPP
@@ -0,0 +1,37 @@
+#ifndef CSLIBS_NDT_3D_MESHES_MESH_HPP
+#define CSLIBS_NDT_3D_MESHES_MESH_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace cslibs_ndt_3d {
+namespace meshes {
+/**
+ * @brief Indexed triangle mesh in world coordinates. Every three indices form
+ *        a triangle, whose vertices are counter clockwise seen from outside.
+ */
+struct Mesh
+{
+    using Ptr      = std::shared_ptr<Mesh>;
+    using ConstPtr = std::shared_ptr<const Mesh>;
+    using vertex_t = std::array<float, 3>;
+
+    std::vector<vertex_t> vertices;
+    std::vector<uint32_t> indices;
+
+    inline std::size_t getTriangleCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) + vertices.size() * sizeof(vertex_t) + indices.size() * sizeof(uint32_t);
+    }
+};
+}
+}
+
+#endif // CSLIBS_NDT_3D_MESHES_MESH_HPP
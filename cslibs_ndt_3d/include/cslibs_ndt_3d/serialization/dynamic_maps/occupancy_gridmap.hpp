@@ -17,14 +17,15 @@
 
 namespace cslibs_ndt_3d {
 namespace dynamic_maps {
-inline bool saveBinary(const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &map,
+template <typename T>
+inline bool saveBinary(const std::shared_ptr<cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>> &map,
                        const std::string &path)
 {
     using path_t     = boost::filesystem::path;
     using paths_t    = std::array<path_t, 8>;
-    using index_t    = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::index_t;
-    using storages_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_storage_array_t;
-    using binary_t   = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 3, 3>;
+    using index_t    = typename cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>::index_t;
+    using storages_t = typename cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>::distribution_storage_array_t;
+    using binary_t   = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 3, 3, T>;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -55,6 +56,9 @@ inline bool saveBinary(const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr
         n["min_index"]  = map->getMinBundleIndex();
         n["max_index"]  = map->getMaxBundleIndex();
         n["bundles"]    = indices;
+        n["version"]    = cslibs_ndt::occupancy_format_version;
+        n["time"]       = map->getTime();
+        n["decay"]      = map->getDecay();
         yaml << n;
     }
 
@@ -80,15 +84,16 @@ inline bool saveBinary(const cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr
     return success;
 }
 
+template <typename T>
 inline bool loadBinary(const std::string &path,
-                       cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr &map)
+                       std::shared_ptr<cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>> &map)
 {
     using path_t           = boost::filesystem::path;
     using paths_t          = std::array<path_t, 8>;
-    using index_t          = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::index_t;
-    using binary_t         = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 3, 3>;
-    using bundle_storage_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_storage_t;
-    using storages_t       = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_storage_array_t;
+    using index_t          = typename cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>::index_t;
+    using binary_t         = cslibs_ndt::binary<cslibs_ndt::OccupancyDistribution, 3, 3, T>;
+    using bundle_storage_t = typename cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>::distribution_bundle_storage_t;
+    using storages_t       = typename cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>::distribution_storage_array_t;
 
     /// step one: check if the root diretory exists
     path_t path_root(path);
@@ -122,12 +127,16 @@ inline bool loadBinary(const std::string &path,
     const index_t                     min_index  = n["min_index"].as<index_t>();
     const index_t                     max_index  = n["max_index"].as<index_t>();
     const std::vector<index_t>        indices    = n["bundles"].as<std::vector<index_t>>();
+    /// maps saved before the decay was persisted have no version
+    const std::size_t                 version    = n["version"] ? n["version"].as<std::size_t>() : 1ul;
+    const double                      time       = n["time"]    ? n["time"].as<double>()         : 0.0;
+    const double                      decay      = n["decay"]   ? n["decay"].as<double>()        : 0.0;
 
     std::array<std::thread, 8> threads;
     std::atomic_bool success(true);
     for (std::size_t i = 0 ; i < 8 ; ++i)
-        threads[i] = std::thread([&storages, &paths, i, &success](){
-            success = success && binary_t::load(paths[i], storages[i]);
+        threads[i] = std::thread([&storages, &paths, i, version, &success](){
+            success = success && binary_t::load(paths[i], storages[i], version);
         });
     for (std::size_t i = 0 ; i < 8 ; ++i)
         threads[i].join();
@@ -136,7 +145,7 @@ inline bool loadBinary(const std::string &path,
         return false;
 
     auto allocate_bundle = [&storages, &bundles](const index_t &bi) {
-        cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::distribution_bundle_t b;
+        typename cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>::distribution_bundle_t b;
         const int divx = cslibs_math::common::div<int>(bi[0], 2);
         const int divy = cslibs_math::common::div<int>(bi[1], 2);
         const int divz = cslibs_math::common::div<int>(bi[2], 2);
@@ -166,12 +175,14 @@ inline bool loadBinary(const std::string &path,
     for (const index_t &index : indices)
         allocate_bundle(index);
 
-    map.reset(new cslibs_ndt_3d::dynamic_maps::OccupancyGridmap(origin,
-                                                                resolution,
-                                                                min_index,
-                                                                max_index,
-                                                                bundles,
-                                                                storages));
+    map.reset(new cslibs_ndt_3d::dynamic_maps::OccupancyGridmapT<T>(origin,
+                                                                   resolution,
+                                                                   min_index,
+                                                                   max_index,
+                                                                   bundles,
+                                                                   storages));
+    map->setTime(time);
+    map->setDecay(decay);
 
     return true;
 }
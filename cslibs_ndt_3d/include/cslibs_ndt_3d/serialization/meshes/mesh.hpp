@@ -0,0 +1,50 @@
+#ifndef CSLIBS_NDT_3D_SERIALIZATION_MESHES_MESH_HPP
+#define CSLIBS_NDT_3D_SERIALIZATION_MESHES_MESH_HPP
+
+#include <cslibs_ndt_3d/meshes/mesh.hpp>
+
+#include <fstream>
+#include <string>
+
+namespace cslibs_ndt_3d {
+namespace meshes {
+/**
+ * @brief Write a mesh as binary little endian PLY file, with float vertices
+ *        and triangles as lists of int indices.
+ */
+inline bool savePly(const Mesh::ConstPtr &mesh,
+                    const std::string    &path)
+{
+    if (!mesh)
+        return false;
+
+    std::ofstream out(path, std::fstream::trunc | std::fstream::binary);
+    if (!out.is_open())
+        return false;
+
+    out << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << mesh->vertices.size() << "\n"
+        << "property float x\n"
+        << "property float y\n"
+        << "property float z\n"
+        << "element face " << mesh->getTriangleCount() << "\n"
+        << "property list uchar int vertex_indices\n"
+        << "end_header\n";
+
+    /// the buffers are written as they are, which assumes a little endian host
+    if (!mesh->vertices.empty())
+        out.write(reinterpret_cast<const char*>(mesh->vertices.data()),
+                  static_cast<std::streamsize>(mesh->vertices.size() * sizeof(Mesh::vertex_t)));
+
+    const uint8_t corners = 3;
+    for (std::size_t i = 0 ; i + 2 < mesh->indices.size() ; i += 3) {
+        out.write(reinterpret_cast<const char*>(&corners), sizeof(corners));
+        out.write(reinterpret_cast<const char*>(&mesh->indices[i]), 3 * sizeof(uint32_t));
+    }
+    return out.good();
+}
+}
+}
+
+#endif // CSLIBS_NDT_3D_SERIALIZATION_MESHES_MESH_HPP
@@ -5,6 +5,8 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <unordered_set>
+#include <thread>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 
@@ -13,6 +15,10 @@
 
 #include <cslibs_ndt/common/distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/insert_batch.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/box.hpp>
 
 #include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
@@ -27,26 +33,28 @@ namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt_3d {
 namespace static_maps {
-class EIGEN_ALIGN16 Gridmap
+template <typename T = double>
+class EIGEN_ALIGN16 GridmapT
 {
 public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    using allocator_t = Eigen::aligned_allocator<Gridmap>;
+    using allocator_t = Eigen::aligned_allocator<GridmapT>;
 
-    using Ptr                               = std::shared_ptr<Gridmap>;
-    using ConstPtr                          = std::shared_ptr<Gridmap>;
+    using Ptr                               = std::shared_ptr<GridmapT>;
+    using ConstPtr                          = std::shared_ptr<GridmapT>;
     using pose_2d_t                         = cslibs_math_2d::Pose2d;
     using pose_t                            = cslibs_math_3d::Pose3d;
     using transform_t                       = cslibs_math_3d::Transform3d;
     using point_t                           = cslibs_math_3d::Point3d;
+    using batch_t                           = cslibs_ndt::InsertBatch<point_t, pose_t>;
     using index_t                           = std::array<int, 3>;
     using size_t                            = std::array<std::size_t, 3>;
     using size_m_t                          = std::array<double, 3>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
-    using distribution_t                    = cslibs_ndt::Distribution<3>;
+    using distribution_t                    = cslibs_ndt::Distribution<3, T>;
     using distribution_storage_t            = cis::Storage<distribution_t, index_t, cis::backend::array::Array>;
     using distribution_storage_ptr_t        = std::shared_ptr<distribution_storage_t>;
     using distribution_storage_array_t      = std::array<distribution_storage_ptr_t, 8>;
@@ -55,10 +63,10 @@ public:
     using distribution_bundle_storage_t     = cis::Storage<distribution_bundle_t, index_t, cis::backend::array::Array>;
     using distribution_bundle_storage_ptr_t = std::shared_ptr<distribution_bundle_storage_t>;
 
-    inline Gridmap(const pose_t &origin,
-                   const double &resolution,
-                   const size_t &size,
-                   const index_t &min_bundle_index) :
+    inline GridmapT(const pose_t &origin,
+                    const double &resolution,
+                    const size_t &size,
+                    const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -100,12 +108,12 @@ public:
                                                                        min_bundle_index[2]);
     }
 
-    inline Gridmap(const double &origin_x,
-                   const double &origin_y,
-                   const double &origin_phi,
-                   const double &resolution,
-                   const size_t &size,
-                   const index_t &min_bundle_index) :
+    inline GridmapT(const double &origin_x,
+                    const double &origin_y,
+                    const double &origin_phi,
+                    const double &resolution,
+                    const size_t &size,
+                    const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -147,12 +155,12 @@ public:
                                                                        min_bundle_index[2]);
     }
 
-    inline Gridmap(const pose_t &origin,
-                   const double &resolution,
-                   const size_t &size,
-                   const std::shared_ptr<distribution_bundle_storage_t> &bundles,
-                   const distribution_storage_array_t                   &storage,
-                   const index_t &min_bundle_index) :
+    inline GridmapT(const pose_t &origin,
+                    const double &resolution,
+                    const size_t &size,
+                    const std::shared_ptr<distribution_bundle_storage_t> &bundles,
+                    const distribution_storage_array_t                   &storage,
+                    const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -171,7 +179,7 @@ public:
     {
     }
 
-    inline Gridmap(const Gridmap &other) :
+    inline GridmapT(const GridmapT &other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -193,7 +201,7 @@ public:
     {
     }
 
-    inline Gridmap(Gridmap &&other) :
+    inline GridmapT(GridmapT &&other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -250,6 +258,11 @@ public:
         return w_T_m_;
     }
 
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_bundle_index_;
@@ -279,14 +292,21 @@ public:
 
     inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
                        const pose_t &points_origin = pose_t())
+    {
+        insert(points->begin(), points->end(), points_origin);
+    }
+
+    template<typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
     {
         distribution_storage_t storage;
         storage.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2, size_[2] * 2);
         storage.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
                 min_bundle_index_[1],
                 min_bundle_index_[2]);
-        for (const auto &p : *points) {
-            const point_t pm = points_origin * p;
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
             if (pm.isNormal()) {
                 index_t bi;
                 if(toBundleIndex(pm, bi)) {
@@ -309,6 +329,76 @@ public:
         });
     }
 
+    /**
+     * @brief Insert the clouds of several sensors, the moments of all clouds
+     *        are aggregated before the bundles are updated once.
+     * @param batch     clouds and sensor poses
+     */
+    inline void insert(const batch_t &batch)
+    {
+        distribution_storage_t storage;
+        storage.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2, size_[2] * 2);
+        storage.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
+                                                              min_bundle_index_[1],
+                                                              min_bundle_index_[2]);
+
+        for (const auto &entry : batch) {
+            const pose_t &points_origin = entry.second;
+            for (const auto &p : *(entry.first)) {
+                const point_t pm = points_origin * p;
+                if (!pm.isNormal())
+                    continue;
+                index_t bi;
+                if (!toBundleIndex(pm, bi))
+                    continue;
+                distribution_t *d = storage.get(bi);
+                (d ? d : &storage.insert(bi, distribution_t()))->data().add(pm);
+            }
+        }
+
+        storage.traverse([this](const index_t& bi, const distribution_t &d) {
+            distribution_bundle_t *bundle = getAllocate(bi);
+            bundle->at(0)->data() += d.data();
+            bundle->at(1)->data() += d.data();
+            bundle->at(2)->data() += d.data();
+            bundle->at(3)->data() += d.data();
+            bundle->at(4)->data() += d.data();
+            bundle->at(5)->data() += d.data();
+            bundle->at(6)->data() += d.data();
+            bundle->at(7)->data() += d.data();
+        });
+    }
+
+    /**
+     * @brief Insert a batch of points using multiple threads, the moments are
+     *        aggregated per thread and merged per distribution storage.
+     * @param points        the points
+     * @param points_origin pose of the points in the world frame
+     * @param num_threads   number of threads to aggregate the points with
+     */
+    inline void insertParallel(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
+                               const pose_t &points_origin = pose_t(),
+                               const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        insertParallel(points->begin(), points->end(), points_origin, num_threads);
+    }
+
+    template<typename iterator_t>
+    inline void insertParallel(const iterator_t& points_begin, const iterator_t& points_end,
+                               const pose_t &points_origin = pose_t(),
+                               const std::size_t num_threads = std::thread::hardware_concurrency())
+    {
+        auto locate = [this, &points_origin](const point_t &p, point_t &p_m, index_t &bi) {
+            p_m = points_origin * p;
+            return p_m.isNormal() && toBundleIndex(p_m, bi);
+        };
+        auto allocate = [this](const index_t &bi) {
+            return getAllocate(bi);
+        };
+        cslibs_ndt::parallel::insert<distribution_bundle_t, point_t, index_t>(points_begin, points_end, num_threads,
+                                                                              locate, allocate);
+    }
+
     inline double sample(const point_t &p) const
     {
         index_t bi;
@@ -370,6 +460,29 @@ public:
         return getAllocate(bi);
     }
 
+    /**
+     * @brief Look up the distributions of a bundle without allocating it.
+     *        Neighbours of populated bundles share distributions with them,
+     *        so they can be sampled without allocatePartiallyAllocatedBundles,
+     *        which leaves the map unchanged and safe to read concurrently.
+     * @param bi        bundle index, the bundle does not need to exist
+     * @param bundle    the distributions, nullptr if not allocated
+     * @return true if any of the distributions exists
+     */
+    inline bool lookupDistributionBundle(const index_t               &bi,
+                                         distribution_const_bundle_t &bundle) const
+    {
+        if (!valid(bi))
+            return false;
+
+        bool found = false;
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            bundle[i] = storage_[i]->get(toStorageIndex(bi, i));
+            found    |= bundle[i] != nullptr;
+        }
+        return found;
+    }
+
     inline double getBundleResolution() const
     {
         return bundle_resolution_;
@@ -406,6 +519,60 @@ public:
         return bundle_storage_->traverse(function);
     }
 
+    /**
+     * @brief Traverse the bundles inside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        for (int i = lo[0] ; i <= hi[0] ; ++i)
+            for (int j = lo[1] ; j <= hi[1] ; ++j)
+                for (int k = lo[2] ; k <= hi[2] ; ++k) {
+                    const index_t bi = {{i, j, k}};
+                    if (const distribution_bundle_t *bundle = bundle_storage_->get(bi))
+                        function(bi, *bundle);
+                }
+    }
+
+    /**
+     * @brief Extract the bundles inside an axis-aligned box into a new map,
+     *        the distributions are copied.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the cropped map, nullptr if the box does not intersect the map
+     */
+    inline Ptr crop(const index_t &min_bi,
+                    const index_t &max_bi) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2])
+            return nullptr;
+
+        /// the storages are aligned to even bundle indices
+        const index_t min_index = {{cslibs_math::common::div<int>(lo[0], 2) * 2,
+                                    cslibs_math::common::div<int>(lo[1], 2) * 2,
+                                    cslibs_math::common::div<int>(lo[2], 2) * 2}};
+        const size_t  size      = {{static_cast<std::size_t>(cslibs_math::common::div<int>(hi[0], 2) - cslibs_math::common::div<int>(lo[0], 2) + 1),
+                                    static_cast<std::size_t>(cslibs_math::common::div<int>(hi[1], 2) - cslibs_math::common::div<int>(lo[1], 2) + 1),
+                                    static_cast<std::size_t>(cslibs_math::common::div<int>(hi[2], 2) - cslibs_math::common::div<int>(lo[2], 2) + 1)}};
+
+        Ptr dst(new GridmapT(w_T_m_, resolution_, size, min_index));
+        traverse(lo, hi, [&dst](const index_t &bi, const distribution_bundle_t &b) {
+            distribution_bundle_t *b_dst = dst->getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                b_dst->at(i)->data() = b.at(i)->data();
+        });
+        return dst;
+    }
+
     inline void getBundleIndices(std::vector<index_t> &indices) const
     {
         auto add_index = [&indices](const index_t &i, const distribution_bundle_t &d) {
@@ -480,6 +647,47 @@ public:
 
     }
 
+    /**
+     * @brief Traverse the bundles as allocatePartiallyAllocatedBundles would
+     *        leave them, in Z-order, without allocating the missing ones.
+     * @param function  called with the bundle index and its distributions,
+     *                  nullptr where not allocated
+     */
+    template <typename Fn>
+    inline void traversePartiallyAllocatedBundles(const Fn &function) const
+    {
+        using set_t = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+        auto expand = [](const distribution_t *d) {
+            return d->data().getN() >= 3;
+        };
+
+        set_t bis;
+        bundle_storage_->traverse([this, &bis, &expand](const index_t &bi, const distribution_bundle_t &b) {
+            bis.insert(bi);
+            bool populated = false;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                populated |= expand(b.at(i));
+            if (!populated)
+                return;
+            for (int i = -1 ; i <= 1 ; ++i)
+                for (int j = -1 ; j <= 1 ; ++j)
+                    for (int k = -1 ; k <= 1 ; ++k) {
+                        const index_t bni = {{bi[0] + i, bi[1] + j, bi[2] + k}};
+                        if (valid(bni))
+                            bis.insert(bni);
+                    }
+        });
+
+        std::vector<distribution_const_bundle_t> bundles(bis.size());
+        cslibs_ndt::morton::Order<index_t, const distribution_const_bundle_t> order(min_bundle_index_, bis.size());
+        std::size_t n = 0;
+        for (const index_t &bi : bis) {
+            lookupDistributionBundle(bi, bundles[n]);
+            order.add(bi, &bundles[n ++]);
+        }
+        order.traverse(function);
+    }
+
 protected:
     const double                                    resolution_;
     const double                                    bundle_resolution_;
@@ -540,6 +748,20 @@ protected:
         return get_allocate(bi);
     }
 
+    /**
+     * @brief Index of the distribution of storage i a bundle refers to.
+     */
+    inline index_t toStorageIndex(const index_t &bi,
+                                  const std::size_t i) const
+    {
+        const int s0 = static_cast<int>(i & 1ul);
+        const int s1 = static_cast<int>((i >> 1) & 1ul);
+        const int s2 = static_cast<int>((i >> 2) & 1ul);
+        return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+                 cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2),
+                 cslibs_math::common::div<int>(bi[2], 2) + s2 * cslibs_math::common::mod<int>(bi[2], 2)}};
+    }
+
     inline index_t toBundleIndex(const point_t &p_w) const
     {
         const point_t p_m = m_T_w_ * p_w;
@@ -567,6 +789,8 @@ protected:
                (index[2] >= min_bundle_index_[2] && index[2] <= max_bundle_index_[2]);
     }
 };
+
+using Gridmap = GridmapT<double>;
 }
 }
 
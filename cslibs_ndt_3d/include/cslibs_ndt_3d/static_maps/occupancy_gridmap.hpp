@@ -5,6 +5,7 @@
 #include <vector>
 #include <cmath>
 #include <memory>
+#include <unordered_set>
 
 #include <cslibs_math_2d/linear/pose.hpp>
 
@@ -13,7 +14,12 @@
 
 #include <cslibs_ndt/common/occupancy_distribution.hpp>
 #include <cslibs_ndt/common/bundle.hpp>
+#include <cslibs_ndt/common/insert_batch.hpp>
+#include <cslibs_ndt/common/parallel_insert.hpp>
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/box.hpp>
 
+#include <cslibs_math/linear/pointcloud.hpp>
 #include <cslibs_math/common/array.hpp>
 #include <cslibs_math/common/div.hpp>
 #include <cslibs_math/common/mod.hpp>
@@ -29,25 +35,27 @@ namespace cis = cslibs_indexed_storage;
 
 namespace cslibs_ndt_3d {
 namespace static_maps {
-class EIGEN_ALIGN16 OccupancyGridmap
+template <typename T = double>
+class EIGEN_ALIGN16 OccupancyGridmapT
 {
 public:
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    using allocator_t = Eigen::aligned_allocator<OccupancyGridmap>;
+    using allocator_t = Eigen::aligned_allocator<OccupancyGridmapT>;
 
-    using Ptr                               = std::shared_ptr<OccupancyGridmap>;
+    using Ptr                               = std::shared_ptr<OccupancyGridmapT>;
     using pose_2d_t                         = cslibs_math_2d::Pose2d;
     using pose_t                            = cslibs_math_3d::Pose3d;
     using transform_t                       = cslibs_math_3d::Transform3d;
     using point_t                           = cslibs_math_3d::Point3d;
+    using batch_t                           = cslibs_ndt::InsertBatch<point_t, pose_t>;
     using index_t                           = std::array<int, 3>;
     using size_t                            = std::array<std::size_t, 3>;
     using size_m_t                          = std::array<double, 3>;
     using mutex_t                           = std::mutex;
     using lock_t                            = std::unique_lock<mutex_t>;
-    using distribution_t                    = cslibs_ndt::OccupancyDistribution<3>;
+    using distribution_t                    = cslibs_ndt::OccupancyDistribution<3, T>;
     using distribution_storage_t            = cis::Storage<distribution_t, index_t, cis::backend::array::Array>;
     using distribution_storage_ptr_t        = std::shared_ptr<distribution_storage_t>;
     using distribution_storage_array_t      = std::array<distribution_storage_ptr_t, 8>;
@@ -58,10 +66,10 @@ public:
     using simple_iterator_t                 = cslibs_math_3d::algorithms::SimpleIterator;
     using inverse_sensor_model_t            = cslibs_gridmaps::utility::InverseModel;
 
-    inline OccupancyGridmap(const pose_t &origin,
-                            const double &resolution,
-                            const size_t &size,
-                            const index_t &min_bundle_index) :
+    inline OccupancyGridmapT(const pose_t &origin,
+                             const double &resolution,
+                             const size_t &size,
+                             const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -83,7 +91,9 @@ public:
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t)}},
-        bundle_storage_(new distribution_bundle_storage_t)
+        bundle_storage_(new distribution_bundle_storage_t),
+        time_(0.0),
+        decay_(0.0)
     {
         storage_[0]->template set<cis::option::tags::array_size>(size[0], size[1], size[2]);
         storage_[0]->template set<cis::option::tags::array_offset>(min_bundle_index[0] / 2,
@@ -103,12 +113,12 @@ public:
                                                                        min_bundle_index[2]);
     }
 
-    inline OccupancyGridmap(const double &origin_x,
-                            const double &origin_y,
-                            const double &origin_phi,
-                            const double &resolution,
-                            const size_t &size,
-                            const index_t &min_bundle_index) :
+    inline OccupancyGridmapT(const double &origin_x,
+                             const double &origin_y,
+                             const double &origin_phi,
+                             const double &resolution,
+                             const size_t &size,
+                             const index_t &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -130,7 +140,9 @@ public:
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t),
                  distribution_storage_ptr_t(new distribution_storage_t)}},
-        bundle_storage_(new distribution_bundle_storage_t)
+        bundle_storage_(new distribution_bundle_storage_t),
+        time_(0.0),
+        decay_(0.0)
     {
         storage_[0]->template set<cis::option::tags::array_size>(size[0], size[1], size[2]);
         storage_[0]->template set<cis::option::tags::array_offset>(min_bundle_index[0] / 2,
@@ -150,12 +162,12 @@ public:
                                                                        min_bundle_index[2]);
     }
 
-    inline OccupancyGridmap(const pose_t &origin,
-                            const double &resolution,
-                            const size_t &size,
-                            const std::shared_ptr<distribution_bundle_storage_t> &bundles,
-                            const distribution_storage_array_t                   &storage,
-                            const index_t                                        &min_bundle_index) :
+    inline OccupancyGridmapT(const pose_t &origin,
+                             const double &resolution,
+                             const size_t &size,
+                             const std::shared_ptr<distribution_bundle_storage_t> &bundles,
+                             const distribution_storage_array_t                   &storage,
+                             const index_t                                        &min_bundle_index) :
         resolution_(resolution),
         bundle_resolution_(0.5 * resolution_),
         bundle_resolution_inv_(1.0 / bundle_resolution_),
@@ -170,11 +182,13 @@ public:
                            min_bundle_index[1] + static_cast<int>(size[1] * 2) - 1,
                            min_bundle_index[2] + static_cast<int>(size[2] * 2) - 1}},
         storage_(storage),
-        bundle_storage_(bundles)
+        bundle_storage_(bundles),
+        time_(0.0),
+        decay_(0.0)
     {
     }
 
-    inline OccupancyGridmap(const OccupancyGridmap &other) :
+    inline OccupancyGridmapT(const OccupancyGridmapT &other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -192,11 +206,13 @@ public:
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[5])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[6])),
         distribution_storage_ptr_t(new distribution_storage_t(*other.storage_[7]))}},
-        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_))
+        bundle_storage_(new distribution_bundle_storage_t(*other.bundle_storage_)),
+        time_(other.time_),
+        decay_(other.decay_)
     {
     }
 
-    inline OccupancyGridmap(OccupancyGridmap &&other) :
+    inline OccupancyGridmapT(OccupancyGridmapT &&other) :
         resolution_(other.resolution_),
         bundle_resolution_(other.bundle_resolution_),
         bundle_resolution_inv_(other.bundle_resolution_inv_),
@@ -207,7 +223,9 @@ public:
         min_bundle_index_(other.min_bundle_index_),
         max_bundle_index_(other.max_bundle_index_),
         storage_(other.storage_),
-        bundle_storage_(other.bundle_storage_)
+        bundle_storage_(other.bundle_storage_),
+        time_(other.time_),
+        decay_(other.decay_)
     {
     }
 
@@ -253,6 +271,11 @@ public:
         return w_T_m_;
     }
 
+    inline index_t getBundleIndex(const point_t &p) const
+    {
+        return toBundleIndex(p);
+    }
+
     inline index_t getMinBundleIndex() const
     {
         return min_bundle_index_;
@@ -280,6 +303,13 @@ public:
     template <typename line_iterator_t = simple_iterator_t>
     inline void insert(const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
                        const pose_t &points_origin = pose_t())
+    {
+        insert<line_iterator_t>(points->begin(), points->end(), points_origin);
+    }
+
+    template <typename line_iterator_t = simple_iterator_t, typename iterator_t>
+    inline void insert(const iterator_t& points_begin, const iterator_t& points_end,
+                       const pose_t &points_origin = pose_t())
     {
         distribution_storage_t storage;
         storage.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2, size_[2] * 2);
@@ -287,8 +317,8 @@ public:
                 min_bundle_index_[1],
                 min_bundle_index_[2]);
 
-        for (const auto &p : *points) {
-            const point_t pm = points_origin * p;
+        for (auto itr = points_begin; itr != points_end; ++itr) {
+            const point_t pm = points_origin * (*itr);
             if (pm.isNormal()) {
                 index_t bi;
                 if(toBundleIndex(pm,bi)) {
@@ -313,6 +343,70 @@ public:
         });
     }
 
+    /**
+     * @brief Insert the clouds of several sensors. Occupied moments and free
+     *        space counts of all rays are accumulated first, so that every
+     *        bundle is updated once, no matter how many sensors observe it.
+     * @param batch     clouds and sensor poses
+     */
+    template <typename line_iterator_t = simple_iterator_t>
+    inline void insert(const batch_t &batch)
+    {
+        distribution_storage_t accumulated;
+        accumulated.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2, size_[2] * 2);
+        accumulated.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
+                                                                  min_bundle_index_[1],
+                                                                  min_bundle_index_[2]);
+
+        auto get_allocate = [&accumulated](const index_t &bi) {
+            distribution_t *d = accumulated.get(bi);
+            return d ? d : &accumulated.insert(bi, distribution_t());
+        };
+
+        for (const auto &entry : batch) {
+            const pose_t &points_origin = entry.second;
+            distribution_storage_t storage;
+            storage.template set<cis::option::tags::array_size>(size_[0] * 2, size_[1] * 2, size_[2] * 2);
+            storage.template set<cis::option::tags::array_offset>(min_bundle_index_[0],
+                                                                  min_bundle_index_[1],
+                                                                  min_bundle_index_[2]);
+
+            for (const auto &p : *(entry.first)) {
+                const point_t pm = points_origin * p;
+                if (!pm.isNormal())
+                    continue;
+                index_t bi;
+                if (!toBundleIndex(pm, bi))
+                    continue;
+                distribution_t *d = storage.get(bi);
+                (d ? d : &storage.insert(bi, distribution_t()))->updateOccupied(pm);
+            }
+
+            const point_t start_p = m_T_w_ * points_origin.translation();
+            storage.traverse([this, &start_p, &get_allocate](const index_t& bi, const distribution_t &d) {
+                if (!d.getDistribution())
+                    return;
+                get_allocate(bi)->updateOccupied(d.getDistribution());
+
+                line_iterator_t it(start_p, m_T_w_ * point_t(d.getDistribution()->getMean()), bundle_resolution_);
+                const std::size_t n = d.numOccupied();
+                while (!it.done()) {
+                    const index_t bit = {{it.x(), it.y(), it.z()}};
+                    if (valid(bit))
+                        get_allocate(bit)->updateFree(n);
+                    ++ it;
+                }
+            });
+        }
+
+        accumulated.traverse([this](const index_t& bi, const distribution_t &d) {
+            if (d.numFree() > 0)
+                updateFree(bi, d.numFree());
+            if (d.getDistribution())
+                updateOccupied(bi, d.getDistribution());
+        });
+    }
+
     template <typename line_iterator_t = simple_iterator_t>
     inline void insertVisible(const pose_t &origin,
                               const typename cslibs_math::linear::Pointcloud<point_t>::ConstPtr &points,
@@ -327,14 +421,14 @@ public:
         const index_t start_bi = toBundleIndex(origin.translation());
         auto occupancy = [this, &ivm](const index_t &bi) {
             distribution_bundle_t *bundle = getAllocate(bi);
-            return 0.125 * (bundle->at(0)->getOccupancy(ivm) +
-                            bundle->at(1)->getOccupancy(ivm) +
-                            bundle->at(2)->getOccupancy(ivm) +
-                            bundle->at(3)->getOccupancy(ivm) +
-                            bundle->at(4)->getOccupancy(ivm) +
-                            bundle->at(5)->getOccupancy(ivm) +
-                            bundle->at(6)->getOccupancy(ivm) +
-                            bundle->at(7)->getOccupancy(ivm));
+            return 0.125 * (bundle->at(0)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(1)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(2)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(3)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(4)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(5)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(6)->getOccupancy(ivm, time_, decay_) +
+                            bundle->at(7)->getOccupancy(ivm, time_, decay_));
         };
         auto current_visibility = [this, &start_bi, &ivm_visibility, &occupancy](const index_t &bi) {
             const double occlusion_prob =
@@ -397,11 +491,11 @@ public:
 
         distribution_bundle_t *bundle = bundle_storage_->get(bi);
 
-        auto sample = [&p, &ivm] (const distribution_t *d) {
-            auto do_sample = [&p, &ivm, &d]() {
+        auto sample = [this, &p, &ivm] (const distribution_t *d) {
+            auto do_sample = [this, &p, &ivm, &d]() {
                 const auto &handle = d;
                 return handle->getDistribution() ?
-                            handle->getDistribution()->sample(p) * handle->getOccupancy(ivm) : 0.0;
+                            handle->getDistribution()->sample(p) * handle->getOccupancy(ivm, time_, decay_) : 0.0;
             };
             return d ? do_sample() : 0.0;
         };
@@ -431,11 +525,11 @@ public:
 
         distribution_bundle_t *bundle = bundle_storage_->get(bi);
 
-        auto sample = [&p, &ivm] (const distribution_t *d) {
-            auto do_sample = [&p, &ivm, &d]() {
+        auto sample = [this, &p, &ivm] (const distribution_t *d) {
+            auto do_sample = [this, &p, &ivm, &d]() {
                 const auto &handle = d;
                 return handle->getDistribution() ?
-                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm) : 0.0;
+                            handle->getDistribution()->sampleNonNormalized(p) * handle->getOccupancy(ivm, time_, decay_) : 0.0;
             };
             return d ? do_sample() : 0.0;
         };
@@ -463,6 +557,61 @@ public:
         return valid(bi) ? getAllocate(bi) : nullptr;
     }
 
+    /**
+     * @brief Look up the distributions of a bundle without allocating it.
+     *        Neighbours of populated bundles share distributions with them,
+     *        so they can be sampled without allocatePartiallyAllocatedBundles,
+     *        which leaves the map unchanged and safe to read concurrently.
+     * @param bi        bundle index, the bundle does not need to exist
+     * @param bundle    the distributions, nullptr if not allocated
+     * @return true if any of the distributions exists
+     */
+    inline bool lookupDistributionBundle(const index_t               &bi,
+                                         distribution_const_bundle_t &bundle) const
+    {
+        if (!valid(bi))
+            return false;
+
+        bool found = false;
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            bundle[i] = storage_[i]->get(toStorageIndex(bi, i));
+            found    |= bundle[i] != nullptr;
+        }
+        return found;
+    }
+
+    /**
+     * @brief Enable exponential forgetting for changing environments. The free
+     *        counts and moments of a cell are weighted down by exp(-dt / decay)
+     *        for the time dt passed since it was last touched. This is applied
+     *        lazily, when the cell is updated or read, there is no global pass.
+     * @param decay     time constant, zero disables forgetting
+     */
+    inline void setDecay(const double decay)
+    {
+        decay_ = decay;
+    }
+
+    inline double getDecay() const
+    {
+        return decay_;
+    }
+
+    /**
+     * @brief Set the current time, following updates and reads decay the
+     *        cells they touch up to it.
+     * @param time      current time, must not run backwards
+     */
+    inline void setTime(const double time)
+    {
+        time_ = time;
+    }
+
+    inline double getTime() const
+    {
+        return time_;
+    }
+
     inline double getBundleResolution() const
     {
         return bundle_resolution_;
@@ -499,6 +648,63 @@ public:
         return bundle_storage_->traverse(function);
     }
 
+    /**
+     * @brief Traverse the bundles inside an axis-aligned box.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @param function  called with the bundle index and the bundle
+     */
+    template <typename Fn>
+    inline void traverse(const index_t &min_bi,
+                         const index_t &max_bi,
+                         const Fn      &function) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        for (int i = lo[0] ; i <= hi[0] ; ++i)
+            for (int j = lo[1] ; j <= hi[1] ; ++j)
+                for (int k = lo[2] ; k <= hi[2] ; ++k) {
+                    const index_t bi = {{i, j, k}};
+                    if (const distribution_bundle_t *bundle = bundle_storage_->get(bi))
+                        function(bi, *bundle);
+                }
+    }
+
+    /**
+     * @brief Extract the bundles inside an axis-aligned box into a new map,
+     *        the distributions are copied together with their decay state,
+     *        the time and the decay constant of the map.
+     * @param min_bi    minimum bundle index of the box, inclusive
+     * @param max_bi    maximum bundle index of the box, inclusive
+     * @return the cropped map, nullptr if the box does not intersect the map
+     */
+    inline Ptr crop(const index_t &min_bi,
+                    const index_t &max_bi) const
+    {
+        const index_t lo = cslibs_ndt::box::maximum(min_bi, min_bundle_index_);
+        const index_t hi = cslibs_ndt::box::minimum(max_bi, max_bundle_index_);
+        if (lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2])
+            return nullptr;
+
+        /// the storages are aligned to even bundle indices
+        const index_t min_index = {{cslibs_math::common::div<int>(lo[0], 2) * 2,
+                                    cslibs_math::common::div<int>(lo[1], 2) * 2,
+                                    cslibs_math::common::div<int>(lo[2], 2) * 2}};
+        const size_t  size      = {{static_cast<std::size_t>(cslibs_math::common::div<int>(hi[0], 2) - cslibs_math::common::div<int>(lo[0], 2) + 1),
+                                    static_cast<std::size_t>(cslibs_math::common::div<int>(hi[1], 2) - cslibs_math::common::div<int>(lo[1], 2) + 1),
+                                    static_cast<std::size_t>(cslibs_math::common::div<int>(hi[2], 2) - cslibs_math::common::div<int>(lo[2], 2) + 1)}};
+
+        Ptr dst(new OccupancyGridmapT(w_T_m_, resolution_, size, min_index));
+        dst->time_  = time_;
+        dst->decay_ = decay_;
+        traverse(lo, hi, [&dst](const index_t &bi, const distribution_bundle_t &b) {
+            distribution_bundle_t *b_dst = dst->getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                *(b_dst->at(i)) = b.at(i)->clone();
+        });
+        return dst;
+    }
+
     inline void getBundleIndices(std::vector<index_t> &indices) const
     {
         auto add_index = [&indices](const index_t &i, const distribution_bundle_t &d) {
@@ -578,6 +784,47 @@ public:
         }
     }
 
+    /**
+     * @brief Traverse the bundles as allocatePartiallyAllocatedBundles would
+     *        leave them, in Z-order, without allocating the missing ones.
+     * @param function  called with the bundle index and its distributions,
+     *                  nullptr where not allocated
+     */
+    template <typename Fn>
+    inline void traversePartiallyAllocatedBundles(const Fn &function) const
+    {
+        using set_t = std::unordered_set<index_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+        auto expand = [](const distribution_t *d) {
+            return d && d->getDistribution() && d->getDistribution()->getN() >= 3;
+        };
+
+        set_t bis;
+        bundle_storage_->traverse([this, &bis, &expand](const index_t &bi, const distribution_bundle_t &b) {
+            bis.insert(bi);
+            bool populated = false;
+            for (std::size_t i = 0 ; i < 8 ; ++i)
+                populated |= expand(b.at(i));
+            if (!populated)
+                return;
+            for (int i = -1 ; i <= 1 ; ++i)
+                for (int j = -1 ; j <= 1 ; ++j)
+                    for (int k = -1 ; k <= 1 ; ++k) {
+                        const index_t bni = {{bi[0] + i, bi[1] + j, bi[2] + k}};
+                        if (valid(bni))
+                            bis.insert(bni);
+                    }
+        });
+
+        std::vector<distribution_const_bundle_t> bundles(bis.size());
+        cslibs_ndt::morton::Order<index_t, const distribution_const_bundle_t> order(min_bundle_index_, bis.size());
+        std::size_t n = 0;
+        for (const index_t &bi : bis) {
+            lookupDistributionBundle(bi, bundles[n]);
+            order.add(bi, &bundles[n ++]);
+        }
+        order.traverse(function);
+    }
+
 protected:
     const double                                    resolution_;
     const double                                    bundle_resolution_;
@@ -592,6 +839,9 @@ protected:
     mutable distribution_storage_array_t            storage_;
     mutable distribution_bundle_storage_ptr_t       bundle_storage_;
 
+    double                                          time_;
+    double                                          decay_;
+
     inline distribution_t* getAllocate(const distribution_storage_ptr_t &s,
                                        const index_t &i) const
     {
@@ -638,12 +888,25 @@ protected:
         return get_allocate(bi);
     }
 
+    /**
+     * @brief Allocate a bundle which is about to be updated, its distributions
+     *        are decayed up to the current time first. Reads evaluate the decay
+     *        without modifying the distributions.
+     */
+    inline distribution_bundle_t *getAllocateDecayed(const index_t &bi) const
+    {
+        distribution_bundle_t *bundle = getAllocate(bi);
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            bundle->at(i)->decay(time_, decay_);
+        return bundle;
+    }
+
     inline void updateFree(const index_t &bi) const
     {
         if(!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateFree();
         bundle->at(1)->updateFree();
         bundle->at(2)->updateFree();
@@ -660,7 +923,7 @@ protected:
         if(!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateFree(n);
         bundle->at(1)->updateFree(n);
         bundle->at(2)->updateFree(n);
@@ -677,7 +940,7 @@ protected:
         if(!valid(bi))
             return;
 
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateOccupied(p);
         bundle->at(1)->updateOccupied(p);
         bundle->at(2)->updateOccupied(p);
@@ -689,9 +952,9 @@ protected:
     }
 
     inline void updateOccupied(const index_t &bi,
-                               const distribution_t::distribution_ptr_t &d) const
+                               const typename distribution_t::distribution_ptr_t &d) const
     {
-        distribution_bundle_t *bundle = getAllocate(bi);
+        distribution_bundle_t *bundle = getAllocateDecayed(bi);
         bundle->at(0)->updateOccupied(d);
         bundle->at(1)->updateOccupied(d);
         bundle->at(2)->updateOccupied(d);
@@ -702,6 +965,20 @@ protected:
         bundle->at(7)->updateOccupied(d);
     }
 
+    /**
+     * @brief Index of the distribution of storage i a bundle refers to.
+     */
+    inline index_t toStorageIndex(const index_t &bi,
+                                  const std::size_t i) const
+    {
+        const int s0 = static_cast<int>(i & 1ul);
+        const int s1 = static_cast<int>((i >> 1) & 1ul);
+        const int s2 = static_cast<int>((i >> 2) & 1ul);
+        return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+                 cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2),
+                 cslibs_math::common::div<int>(bi[2], 2) + s2 * cslibs_math::common::mod<int>(bi[2], 2)}};
+    }
+
     inline index_t toBundleIndex(const point_t &p_w) const
     {
         const point_t p_m = m_T_w_ * p_w;
@@ -730,6 +1007,8 @@ protected:
     }
 
 };
+
+using OccupancyGridmap = OccupancyGridmapT<double>;
 }
 }
 
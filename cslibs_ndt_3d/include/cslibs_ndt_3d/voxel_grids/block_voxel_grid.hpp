@@ -0,0 +1,184 @@
+#ifndef CSLIBS_NDT_3D_VOXEL_GRIDS_BLOCK_VOXEL_GRID_HPP
+#define CSLIBS_NDT_3D_VOXEL_GRIDS_BLOCK_VOXEL_GRID_HPP
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include <cslibs_math_3d/linear/pose.hpp>
+#include <cslibs_math_3d/linear/point.hpp>
+#include <cslibs_math/common/div.hpp>
+#include <cslibs_math/common/mod.hpp>
+
+#include <cslibs_ndt/common/parallel_insert.hpp>
+
+namespace cslibs_ndt_3d {
+namespace voxel_grids {
+/**
+ * @brief Unbounded grid of voxels, which are stored in cubic blocks only
+ *        where something was written. Voxels of missing blocks have the
+ *        default value. Voxel (x, y, z) is sampled at its corner
+ *        (x, y, z) * resolution in grid coordinates.
+ */
+template<typename T>
+class EIGEN_ALIGN16 BlockVoxelGrid
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr       = std::shared_ptr<BlockVoxelGrid<T>>;
+    using ConstPtr  = std::shared_ptr<const BlockVoxelGrid<T>>;
+    using pose_t    = cslibs_math_3d::Pose3d;
+    using point_t   = cslibs_math_3d::Point3d;
+    using index_t   = std::array<int, 3>;
+    using block_t   = std::vector<T>;
+    using blocks_t  = std::unordered_map<index_t, block_t, cslibs_ndt::parallel::IndexHash<index_t>>;
+
+    /**
+     * @param block_size    voxels along an edge of a block
+     * @param value         value of voxels which were not written
+     */
+    inline BlockVoxelGrid(const pose_t &origin,
+                          const double  resolution,
+                          const int     block_size,
+                          const T      &value = T()) :
+        resolution_(resolution),
+        resolution_inv_(1.0 / resolution),
+        w_T_m_(origin),
+        m_T_w_(origin.inverse()),
+        block_size_(block_size),
+        value_(value)
+    {
+    }
+
+    inline const pose_t& getOrigin() const
+    {
+        return w_T_m_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline int getBlockSize() const
+    {
+        return block_size_;
+    }
+
+    inline const T& getDefaultValue() const
+    {
+        return value_;
+    }
+
+    inline std::size_t getBlockCount() const
+    {
+        return blocks_.size();
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) + blocks_.size() * (sizeof(typename blocks_t::value_type) +
+                                                 block_size_ * block_size_ * block_size_ * sizeof(T));
+    }
+
+    /**
+     * @brief Voxel containing a point.
+     * @param p_w   point in world coordinates
+     */
+    inline index_t toIndex(const point_t &p_w) const
+    {
+        const point_t p_m = m_T_w_ * p_w;
+        return {{static_cast<int>(std::floor(p_m(0) * resolution_inv_)),
+                 static_cast<int>(std::floor(p_m(1) * resolution_inv_)),
+                 static_cast<int>(std::floor(p_m(2) * resolution_inv_))}};
+    }
+
+    /**
+     * @brief Sampling point of a voxel in world coordinates.
+     */
+    inline point_t toPoint(const index_t &i) const
+    {
+        return w_T_m_ * point_t(i[0] * resolution_, i[1] * resolution_, i[2] * resolution_);
+    }
+
+    inline index_t toBlockIndex(const index_t &i) const
+    {
+        return {{cslibs_math::common::div<int>(i[0], block_size_),
+                 cslibs_math::common::div<int>(i[1], block_size_),
+                 cslibs_math::common::div<int>(i[2], block_size_)}};
+    }
+
+    /**
+     * @brief Position of a voxel within its block.
+     */
+    inline std::size_t toOffset(const index_t &i) const
+    {
+        return (cslibs_math::common::mod<int>(i[2], block_size_)  * block_size_ +
+                cslibs_math::common::mod<int>(i[1], block_size_)) * block_size_ +
+                cslibs_math::common::mod<int>(i[0], block_size_);
+    }
+
+    inline const T& at(const index_t &i) const
+    {
+        const block_t *b = getBlock(toBlockIndex(i));
+        return b ? (*b)[toOffset(i)] : value_;
+    }
+
+    /**
+     * @brief Voxel for writing, its block is allocated if missing.
+     */
+    inline T& get(const index_t &i)
+    {
+        return allocateBlock(toBlockIndex(i))[toOffset(i)];
+    }
+
+    inline const block_t* getBlock(const index_t &bi) const
+    {
+        const auto b = blocks_.find(bi);
+        return b != blocks_.end() ? &b->second : nullptr;
+    }
+
+    inline block_t* getBlock(const index_t &bi)
+    {
+        const auto b = blocks_.find(bi);
+        return b != blocks_.end() ? &b->second : nullptr;
+    }
+
+    /**
+     * @brief Allocate a block filled with the default value. References to
+     *        blocks stay valid while further blocks are allocated.
+     */
+    inline block_t& allocateBlock(const index_t &bi)
+    {
+        auto b = blocks_.find(bi);
+        if (b == blocks_.end())
+            b = blocks_.emplace(bi, block_t(block_size_ * block_size_ * block_size_, value_)).first;
+        return b->second;
+    }
+
+    /**
+     * @param function  (const index_t &bi, const block_t &b)
+     */
+    template<typename Fn>
+    inline void traverse(const Fn &function) const
+    {
+        for (const auto &b : blocks_)
+            function(b.first, b.second);
+    }
+
+private:
+    const double  resolution_;
+    const double  resolution_inv_;
+    const pose_t  w_T_m_;
+    const pose_t  m_T_w_;
+    const int     block_size_;
+    const T       value_;
+    blocks_t      blocks_;
+};
+}
+}
+
+#endif // CSLIBS_NDT_3D_VOXEL_GRIDS_BLOCK_VOXEL_GRID_HPP
@@ -0,0 +1,344 @@
+#ifndef CSLIBS_NDT_3D_VOXEL_GRIDS_DISTANCE_FIELD_HPP
+#define CSLIBS_NDT_3D_VOXEL_GRIDS_DISTANCE_FIELD_HPP
+
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <functional>
+
+#include <cslibs_ndt_3d/voxel_grids/block_voxel_grid.hpp>
+
+namespace cslibs_ndt_3d {
+namespace voxel_grids {
+/**
+ * @brief Euclidean distance field over obstacle voxels, which is updated
+ *        incrementally by a dynamic brushfire: every voxel keeps its nearest
+ *        obstacle, added obstacles lower the distances around them, removed
+ *        ones raise a wave which clears the voxels referring to them before
+ *        their neighbours fill them again. Distances are truncated at the
+ *        maximum distance, so only voxels within it are stored. Obstacle
+ *        voxels have distance 0.
+ */
+class EIGEN_ALIGN16 DistanceField
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr       = std::shared_ptr<DistanceField>;
+    using ConstPtr  = std::shared_ptr<const DistanceField>;
+    using pose_t    = cslibs_math_3d::Pose3d;
+    using point_t   = cslibs_math_3d::Point3d;
+    using index_t   = std::array<int, 3>;
+
+    struct Voxel
+    {
+        index_t obstacle;   /// nearest obstacle, invalid if none within the maximum distance
+        int     distance;   /// squared distance to it in voxels
+        bool    raise;      /// the voxel was cleared and its neighbours have to be checked
+    };
+
+    using voxels_t  = BlockVoxelGrid<Voxel>;
+    using block_t   = voxels_t::block_t;
+
+    /**
+     * @param block_size        voxels along an edge of a block
+     * @param maximum_distance  distances are truncated to this, in meters
+     */
+    inline DistanceField(const pose_t &origin,
+                         const double  resolution,
+                         const int     block_size,
+                         const double  maximum_distance) :
+        maximum_distance_(maximum_distance),
+        maximum_(static_cast<int>(std::floor(std::pow(maximum_distance / resolution, 2) + 1e-6))),
+        m_T_w_(origin.inverse()),
+        voxels_(origin, resolution, block_size, Voxel{invalid(), maximum_ + 1, false})
+    {
+    }
+
+    inline const pose_t& getOrigin() const
+    {
+        return voxels_.getOrigin();
+    }
+
+    inline double getResolution() const
+    {
+        return voxels_.getResolution();
+    }
+
+    inline int getBlockSize() const
+    {
+        return voxels_.getBlockSize();
+    }
+
+    inline double getMaximumDistance() const
+    {
+        return maximum_distance_;
+    }
+
+    inline const voxels_t& getVoxels() const
+    {
+        return voxels_;
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) + voxels_.getByteSize() - sizeof(voxels_t);
+    }
+
+    inline bool isObstacle(const index_t &i) const
+    {
+        return voxels_.at(i).obstacle == i;
+    }
+
+    /**
+     * @brief Mark a voxel as obstacle, distances are updated with update().
+     */
+    inline void setObstacle(const index_t &i)
+    {
+        Voxel &v = voxels_.get(i);
+        if (v.obstacle == i)
+            return;
+
+        v.obstacle = i;
+        v.distance = 0;
+        v.raise    = false;
+        open_.emplace(0, i);
+    }
+
+    /**
+     * @brief Remove an obstacle, distances are updated with update().
+     */
+    inline void removeObstacle(const index_t &i)
+    {
+        if (!isObstacle(i))
+            return;
+
+        Voxel &v = voxels_.get(i);
+        v.obstacle = invalid();
+        v.distance = maximum_ + 1;
+        v.raise    = true;
+        open_.emplace(0, i);
+    }
+
+    /**
+     * @brief Set the obstacles of a block at once.
+     * @param bi            block index
+     * @param obstacles     obstacle flags of the voxels of the block, with x
+     *                      varying fastest, empty if there are none
+     */
+    inline void setObstacles(const index_t           &bi,
+                             const std::vector<bool> &obstacles)
+    {
+        if (obstacles.empty() && !voxels_.getBlock(bi))
+            return;
+
+        const int s = voxels_.getBlockSize();
+        std::size_t n = 0;
+        for (int m = 0 ; m < s ; ++m) {
+            for (int l = 0 ; l < s ; ++l) {
+                for (int k = 0 ; k < s ; ++k, ++n) {
+                    const index_t i = {{bi[0] * s + k, bi[1] * s + l, bi[2] * s + m}};
+                    if (!obstacles.empty() && obstacles[n])
+                        setObstacle(i);
+                    else
+                        removeObstacle(i);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Propagate the changed obstacles.
+     * @return number of voxels processed
+     */
+    inline std::size_t update()
+    {
+        std::size_t processed = 0;
+        while (!open_.empty()) {
+            const entry_t e = open_.top();
+            open_.pop();
+
+            const Voxel &v = voxels_.at(e.second);
+            if (v.raise) {
+                raise(e.second);
+            } else if (e.first == v.distance && isValid(v.obstacle)) {
+                lower(e.second, v);
+            } else {
+                continue;
+            }
+            ++processed;
+        }
+        return processed;
+    }
+
+    /**
+     * @brief Distance of a voxel to the nearest obstacle, in meters.
+     */
+    inline double distance(const index_t &i) const
+    {
+        const int d = voxels_.at(i).distance;
+        return d > maximum_ ? maximum_distance_ : std::sqrt(static_cast<double>(d)) * voxels_.getResolution();
+    }
+
+    /**
+     * @brief Distance to the nearest obstacle, trilinearly interpolated
+     *        between the sampling points of the surrounding voxels.
+     * @param p_w   point in world coordinates
+     */
+    inline double distance(const point_t &p_w) const
+    {
+        double d;
+        interpolate(p_w, d, nullptr);
+        return d;
+    }
+
+    /**
+     * @brief Gradient of the interpolated distance, in world coordinates.
+     * @param p_w   point in world coordinates
+     */
+    inline point_t gradient(const point_t &p_w) const
+    {
+        double  d;
+        point_t g;
+        interpolate(p_w, d, &g);
+        return g;
+    }
+
+    /**
+     * @brief Distance and gradient at once.
+     */
+    inline double distance(const point_t &p_w,
+                           point_t       &gradient) const
+    {
+        double d;
+        interpolate(p_w, d, &gradient);
+        return d;
+    }
+
+private:
+    using entry_t = std::pair<int, index_t>;
+    using queue_t = std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>>;
+
+    const double    maximum_distance_;
+    const int       maximum_;
+    const pose_t    m_T_w_;
+    voxels_t        voxels_;
+    queue_t         open_;
+
+    static inline index_t invalid()
+    {
+        return {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+    }
+
+    static inline bool isValid(const index_t &o)
+    {
+        return o[0] != std::numeric_limits<int>::min();
+    }
+
+    static inline int squaredDistance(const index_t &a,
+                                      const index_t &b)
+    {
+        const int dx = a[0] - b[0];
+        const int dy = a[1] - b[1];
+        const int dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    template<typename Fn>
+    static inline void neighbours(const index_t &i,
+                                  const Fn      &function)
+    {
+        for (int m = -1 ; m <= 1 ; ++m)
+            for (int l = -1 ; l <= 1 ; ++l)
+                for (int k = -1 ; k <= 1 ; ++k)
+                    if (k != 0 || l != 0 || m != 0)
+                        function(index_t{{i[0] + k, i[1] + l, i[2] + m}});
+    }
+
+    /// clear the neighbours whose obstacle is gone, the others fill them again
+    inline void raise(const index_t &i)
+    {
+        neighbours(i, [this](const index_t &n) {
+            const Voxel &v = voxels_.at(n);
+            if (!isValid(v.obstacle) || v.raise)
+                return;
+
+            if (!isObstacle(v.obstacle)) {
+                Voxel &c = voxels_.get(n);
+                open_.emplace(c.distance, n);
+                c.obstacle = invalid();
+                c.distance = maximum_ + 1;
+                c.raise    = true;
+            } else {
+                open_.emplace(v.distance, n);
+            }
+        });
+        voxels_.get(i).raise = false;
+    }
+
+    inline void lower(const index_t &i,
+                      const Voxel   &v)
+    {
+        const index_t o = v.obstacle;
+        if (!isObstacle(o))
+            return;
+
+        neighbours(i, [this, &o](const index_t &n) {
+            const Voxel &u = voxels_.at(n);
+            if (u.raise)
+                return;
+
+            const int d = squaredDistance(o, n);
+            if (d < u.distance && d <= maximum_) {
+                Voxel &w = voxels_.get(n);
+                w.obstacle = o;
+                w.distance = d;
+                open_.emplace(d, n);
+            }
+        });
+    }
+
+    inline void interpolate(const point_t &p_w,
+                            double        &d,
+                            point_t       *g) const
+    {
+        const double  r     = voxels_.getResolution();
+        const pose_t &w_T_m = voxels_.getOrigin();
+        const point_t p_m   = m_T_w_ * p_w;
+
+        const double  u[3] = {p_m(0) / r, p_m(1) / r, p_m(2) / r};
+        const index_t i    = {{static_cast<int>(std::floor(u[0])),
+                               static_cast<int>(std::floor(u[1])),
+                               static_cast<int>(std::floor(u[2]))}};
+        const double  f[3] = {u[0] - i[0], u[1] - i[1], u[2] - i[2]};
+
+        double c[2][2][2];
+        for (int m = 0 ; m < 2 ; ++m)
+            for (int l = 0 ; l < 2 ; ++l)
+                for (int k = 0 ; k < 2 ; ++k)
+                    c[m][l][k] = distance(index_t{{i[0] + k, i[1] + l, i[2] + m}});
+
+        /// along x, then y, then z
+        const double c00 = c[0][0][0] + f[0] * (c[0][0][1] - c[0][0][0]);
+        const double c10 = c[0][1][0] + f[0] * (c[0][1][1] - c[0][1][0]);
+        const double c01 = c[1][0][0] + f[0] * (c[1][0][1] - c[1][0][0]);
+        const double c11 = c[1][1][0] + f[0] * (c[1][1][1] - c[1][1][0]);
+        const double c0  = c00 + f[1] * (c10 - c00);
+        const double c1  = c01 + f[1] * (c11 - c01);
+        d = c0 + f[2] * (c1 - c0);
+
+        if (!g)
+            return;
+
+        const double dx0 = (1.0 - f[1]) * (c[0][0][1] - c[0][0][0]) + f[1] * (c[0][1][1] - c[0][1][0]);
+        const double dx1 = (1.0 - f[1]) * (c[1][0][1] - c[1][0][0]) + f[1] * (c[1][1][1] - c[1][1][0]);
+        const point_t g_m(((1.0 - f[2]) * dx0 + f[2] * dx1) / r,
+                          ((1.0 - f[2]) * (c10 - c00) + f[2] * (c11 - c01)) / r,
+                          (c1 - c0) / r);
+        *g = w_T_m * g_m - w_T_m * point_t(0.0, 0.0, 0.0);
+    }
+};
+}
+}
+
+#endif // CSLIBS_NDT_3D_VOXEL_GRIDS_DISTANCE_FIELD_HPP
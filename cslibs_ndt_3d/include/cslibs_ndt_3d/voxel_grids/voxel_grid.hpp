@@ -0,0 +1,142 @@
+#ifndef CSLIBS_NDT_3D_VOXEL_GRIDS_VOXEL_GRID_HPP
+#define CSLIBS_NDT_3D_VOXEL_GRIDS_VOXEL_GRID_HPP
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <cslibs_math_3d/linear/pose.hpp>
+#include <cslibs_math_3d/linear/point.hpp>
+
+namespace cslibs_ndt_3d {
+namespace voxel_grids {
+/**
+ * @brief Dense grid of voxels, e.g. a volume sampled from a map. Voxel
+ *        (x, y, z) is sampled at its corner (x, y, z) * resolution in grid
+ *        coordinates, it is stored with x varying fastest.
+ */
+template<typename T>
+class EIGEN_ALIGN16 VoxelGrid
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using Ptr       = std::shared_ptr<VoxelGrid<T>>;
+    using ConstPtr  = std::shared_ptr<const VoxelGrid<T>>;
+    using pose_t    = cslibs_math_3d::Pose3d;
+    using point_t   = cslibs_math_3d::Point3d;
+    using index_t   = std::array<int, 3>;
+    using size_t    = std::array<std::size_t, 3>;
+    using data_t    = std::vector<T>;
+
+    inline VoxelGrid(const pose_t &origin,
+                     const double  resolution,
+                     const size_t &size,
+                     const T      &value = T()) :
+        resolution_(resolution),
+        resolution_inv_(1.0 / resolution),
+        w_T_m_(origin),
+        m_T_w_(origin.inverse()),
+        size_(size),
+        data_(size[0] * size[1] * size[2], value)
+    {
+    }
+
+    inline const pose_t& getOrigin() const
+    {
+        return w_T_m_;
+    }
+
+    inline double getResolution() const
+    {
+        return resolution_;
+    }
+
+    inline const size_t& getSize() const
+    {
+        return size_;
+    }
+
+    inline std::size_t getByteSize() const
+    {
+        return sizeof(*this) + data_.size() * sizeof(T);
+    }
+
+    inline bool valid(const index_t &i) const
+    {
+        return i[0] >= 0 && i[0] < static_cast<int>(size_[0]) &&
+               i[1] >= 0 && i[1] < static_cast<int>(size_[1]) &&
+               i[2] >= 0 && i[2] < static_cast<int>(size_[2]);
+    }
+
+    /**
+     * @brief Voxel containing a point.
+     * @param p_w   point in world coordinates
+     * @param i     index of the voxel
+     * @return true if the voxel is part of the grid
+     */
+    inline bool toIndex(const point_t &p_w,
+                        index_t       &i) const
+    {
+        const point_t p_m = m_T_w_ * p_w;
+        i = {{static_cast<int>(std::floor(p_m(0) * resolution_inv_)),
+              static_cast<int>(std::floor(p_m(1) * resolution_inv_)),
+              static_cast<int>(std::floor(p_m(2) * resolution_inv_))}};
+        return valid(i);
+    }
+
+    /**
+     * @brief Sampling point of a voxel in world coordinates.
+     */
+    inline point_t toPoint(const index_t &i) const
+    {
+        return w_T_m_ * point_t(i[0] * resolution_, i[1] * resolution_, i[2] * resolution_);
+    }
+
+    inline T& at(const std::size_t x,
+                 const std::size_t y,
+                 const std::size_t z)
+    {
+        return data_[(z * size_[1] + y) * size_[0] + x];
+    }
+
+    inline const T& at(const std::size_t x,
+                       const std::size_t y,
+                       const std::size_t z) const
+    {
+        return data_[(z * size_[1] + y) * size_[0] + x];
+    }
+
+    inline T& at(const index_t &i)
+    {
+        return at(i[0], i[1], i[2]);
+    }
+
+    inline const T& at(const index_t &i) const
+    {
+        return at(i[0], i[1], i[2]);
+    }
+
+    inline data_t& getData()
+    {
+        return data_;
+    }
+
+    inline const data_t& getData() const
+    {
+        return data_;
+    }
+
+private:
+    const double  resolution_;
+    const double  resolution_inv_;
+    const pose_t  w_T_m_;
+    const pose_t  m_T_w_;
+    const size_t  size_;
+    data_t        data_;
+};
+}
+}
+
+#endif // CSLIBS_NDT_3D_VOXEL_GRIDS_VOXEL_GRID_HPP
@@ -2,6 +2,7 @@
 
 #include <cslibs_ndt_3d/conversion/sensor_msgs_pointcloud2.hpp>
 #include <cslibs_ndt_3d/conversion/distributions.hpp>
+#include <cslibs_ndt_3d/conversion/level_of_detail.hpp>
 
 namespace cslibs_ndt_3d {
 NDTMapLoader::NDTMapLoader() :
@@ -42,6 +43,9 @@ bool NDTMapLoader::setup()
     pub_ndt_distributions_     = nh_.advertise<cslibs_ndt_3d::DistributionArray>(topic_ndt_distributions,     1);
     pub_occ_ndt_distributions_ = nh_.advertise<cslibs_ndt_3d::DistributionArray>(topic_occ_ndt_distributions, 1);
 
+    /// large maps are merged into coarser distributions, 0 publishes all
+    const int max_distributions = nh_.param<int>("max_distributions", 0);
+
     if (path_ndt != "") {
         if (!cslibs_ndt_3d::dynamic_maps::loadBinary(path_ndt, map_ndt_)) {
             std::cerr << "Could not load ndt 3d map '" << path_ndt << "'." << std::endl;
@@ -52,7 +56,14 @@ bool NDTMapLoader::setup()
         cslibs_ndt_3d::conversion::from(map_ndt_, *map_ndt_means_);
         map_ndt_means_->header.frame_id = "/map";
 
-        cslibs_ndt_3d::conversion::from(map_ndt_, map_ndt_distributions_);
+        if (max_distributions > 0) {
+            cslibs_ndt_3d::conversion::LevelOfDetail lod;
+            lod.build(*map_ndt_);
+            map_ndt_distributions_.reset(new cslibs_ndt_3d::DistributionArray);
+            lod.select(Eigen::Vector3d::Zero(), 0.0, 0.0, static_cast<std::size_t>(max_distributions), *map_ndt_distributions_);
+        } else {
+            cslibs_ndt_3d::conversion::from(map_ndt_, map_ndt_distributions_);
+        }
         if (map_ndt_distributions_)
             map_ndt_distributions_->header.frame_id = "/map";
     }
@@ -67,7 +78,14 @@ bool NDTMapLoader::setup()
         cslibs_ndt_3d::conversion::from(map_occ_ndt_, *map_occ_ndt_means_, ivm);
         map_occ_ndt_means_->header.frame_id = "/map";
 
-        cslibs_ndt_3d::conversion::from(map_occ_ndt_, map_occ_ndt_distributions_, ivm);
+        if (max_distributions > 0) {
+            cslibs_ndt_3d::conversion::LevelOfDetail lod;
+            lod.build(*map_occ_ndt_, ivm);
+            map_occ_ndt_distributions_.reset(new cslibs_ndt_3d::DistributionArray);
+            lod.select(Eigen::Vector3d::Zero(), 0.0, 0.0, static_cast<std::size_t>(max_distributions), *map_occ_ndt_distributions_);
+        } else {
+            cslibs_ndt_3d::conversion::from(map_occ_ndt_, map_occ_ndt_distributions_, ivm);
+        }
         if (map_occ_ndt_distributions_)
             map_occ_ndt_distributions_->header.frame_id = "/map";
     }
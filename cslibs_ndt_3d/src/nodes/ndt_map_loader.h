@@ -31,11 +31,11 @@ private:
     cslibs_ndt_3d::dynamic_maps::Gridmap::Ptr          map_ndt_;
     cslibs_ndt_3d::dynamic_maps::OccupancyGridmap::Ptr map_occ_ndt_;
 
-    sensor_msgs::PointCloud2::Ptr                      map_ndt_means_;
-    sensor_msgs::PointCloud2::Ptr                      map_occ_ndt_means_;
+    sensor_msgs::PointCloud2::Ptr                              map_ndt_means_;
+    sensor_msgs::PointCloud2::Ptr                              map_occ_ndt_means_;
 
-    cslibs_ndt_3d::DistributionArray::Ptr              map_ndt_distributions_;
-    cslibs_ndt_3d::DistributionArray::Ptr              map_occ_ndt_distributions_;
+    cslibs_ndt_3d::DistributionArray::Ptr                      map_ndt_distributions_;
+    cslibs_ndt_3d::DistributionArray::Ptr                      map_occ_ndt_distributions_;
 
     bool setup();
 
@@ -6,7 +6,11 @@
 #include <OGRE/OgreSceneNode.h>
 #include <OGRE/OgreSceneManager.h>
 
+#include <OGRE/OgreCamera.h>
+
 #include <rviz/visualization_manager.h>
+#include <rviz/view_manager.h>
+#include <rviz/view_controller.h>
 #include <rviz/properties/color_property.h>
 #include <rviz/properties/float_property.h>
 #include <rviz/properties/int_property.h>
@@ -17,7 +21,11 @@
 
 namespace cslibs_ndt_3d {
 NDTDisplay::NDTDisplay() :
-    accumulate_(true)
+    accumulate_(true),
+    level_of_detail_(false),
+    viewpoint_(Ogre::Vector3::ZERO),
+    frame_position_(Ogre::Vector3::ZERO),
+    frame_orientation_(Ogre::Quaternion::IDENTITY)
 {
     color_property_ = new rviz::ColorProperty("Color", QColor(204, 51, 204),
                                               "Color to draw the acceleration arrows.",
@@ -28,6 +36,22 @@ NDTDisplay::NDTDisplay() :
     bool_property_ = new rviz::BoolProperty("Accumulate", true,
                                             "Accumulate all received updates to one NDT map.",
                                             this, SLOT(updateAccumulation()));
+    lod_property_ = new rviz::BoolProperty("Level of Detail", false,
+                                           "Merge distributions far from the camera into coarser ones.",
+                                           this, SLOT(updateLevelOfDetail()));
+    detail_distance_property_ = new rviz::FloatProperty("Detail Distance", 20.0,
+                                                        "Up to this distance every distribution is shown, "
+                                                        "the merged blocks double in size whenever it doubles.",
+                                                        lod_property_, SLOT(updateSelection()), this);
+    detail_distance_property_->setMin(0.0);
+    eviction_distance_property_ = new rviz::FloatProperty("Eviction Distance", 0.0,
+                                                          "Distributions farther away are not shown, 0 for none.",
+                                                          lod_property_, SLOT(updateSelection()), this);
+    eviction_distance_property_->setMin(0.0);
+    max_count_property_ = new rviz::IntProperty("Max Distributions", 100000,
+                                                "Coarser levels are shown until at most this many distributions are left, 0 for no limit.",
+                                                lod_property_, SLOT(updateSelection()), this);
+    max_count_property_->setMin(0);
 }
 
 NDTDisplay::~NDTDisplay()
@@ -43,6 +67,22 @@ void NDTDisplay::reset()
 {
     MFDClass::reset();
     visuals_.clear();
+    distributions_.clear();
+    lod_ = conversion::LevelOfDetail();
+}
+
+void NDTDisplay::update(float, float)
+{
+    if (!level_of_detail_ || lod_.getLevels() == 0)
+        return;
+
+    /// the level changes with the distance doubling, small movements are not visible
+    rviz::ViewController *view = context_->getViewManager()->getCurrent();
+    const float step = 0.1f * std::max(detail_distance_property_->getFloat(),
+                                       eviction_distance_property_->getFloat());
+    if (!view || step <= 0.0f || view->getCamera()->getDerivedPosition().distance(viewpoint_) < step)
+        return;
+    select();
 }
 
 void NDTDisplay::updateColorAndAlpha()
@@ -60,8 +100,26 @@ void NDTDisplay::updateColorAndAlpha()
 void NDTDisplay::updateAccumulation()
 {
     accumulate_ = bool_property_->getBool();
-    if (!accumulate_)
+    if (!accumulate_) {
         visuals_.clear();
+        distributions_.clear();
+    }
+}
+
+void NDTDisplay::updateLevelOfDetail()
+{
+    /// the distributions are only kept with the level of detail, so it is
+    /// shown from the next message on
+    level_of_detail_ = lod_property_->getBool();
+    visuals_.clear();
+    distributions_.clear();
+    lod_ = conversion::LevelOfDetail();
+}
+
+void NDTDisplay::updateSelection()
+{
+    if (level_of_detail_ && lod_.getLevels() > 0)
+        select();
 }
 
 void NDTDisplay::processMessage(const DistributionArray::ConstPtr &msg)
@@ -79,6 +137,60 @@ void NDTDisplay::processMessage(const DistributionArray::ConstPtr &msg)
         return;
     }
 
+    frame_position_    = frame_position;
+    frame_orientation_ = frame_orientation;
+
+    if (level_of_detail_) {
+        if (!accumulate_)
+            distributions_.clear();
+        for (const auto &d : msg->data)
+            distributions_[d.id.data] = d;
+
+        DistributionArray all;
+        all.data.reserve(distributions_.size());
+        for (const auto &d : distributions_)
+            all.data.emplace_back(d.second);
+        lod_.build(all);
+        select();
+        return;
+    }
+
+    if (!accumulate_)
+        visuals_.clear();
+
+    for (const auto &d : msg->data)
+        show(d);
+}
+
+void NDTDisplay::select()
+{
+    rviz::ViewController *view = context_->getViewManager()->getCurrent();
+    if (view)
+        viewpoint_ = view->getCamera()->getDerivedPosition();
+    const Ogre::Vector3 v = frame_orientation_.Inverse() * (viewpoint_ - frame_position_);
+
+    DistributionArray selected;
+    lod_.select(Eigen::Vector3d(v.x, v.y, v.z),
+                detail_distance_property_->getFloat(),
+                eviction_distance_property_->getFloat(),
+                static_cast<std::size_t>(max_count_property_->getInt()),
+                selected);
+
+    /// visuals which are not selected any more are evicted
+    std::map<uint64_t, NDTVisual::Ptr> visuals;
+    for (const auto &d : selected.data) {
+        auto it = visuals_.find(d.id.data);
+        if (it != visuals_.end())
+            visuals[d.id.data] = it->second;
+    }
+    visuals_.swap(visuals);
+
+    for (const auto &d : selected.data)
+        show(d);
+}
+
+void NDTDisplay::show(const Distribution &d)
+{
     auto valid = [](const Ogre::Vector3    &position,
                     const Ogre::Quaternion &orientation,
                     const Ogre::Vector3    &scale) {
@@ -89,21 +201,21 @@ void NDTDisplay::processMessage(const DistributionArray::ConstPtr &msg)
         return p && o && s;
     };
 
-    auto getRotation = [&frame_orientation](const Distribution &d) {
+    auto getRotation = [this](const Distribution &d) {
         const tf::Matrix3x3 m(d.eigen_vectors[0].data, d.eigen_vectors[1].data, d.eigen_vectors[2].data,
                 d.eigen_vectors[3].data, d.eigen_vectors[4].data, d.eigen_vectors[5].data,
                 d.eigen_vectors[6].data, d.eigen_vectors[7].data, d.eigen_vectors[8].data);
         tf::Quaternion q;
         m.getRotation(q);
-        return frame_orientation * Ogre::Quaternion(static_cast<float>(q.w()),
-                                                    static_cast<float>(q.x()),
-                                                    static_cast<float>(q.y()),
-                                                    static_cast<float>(q.z()));
+        return frame_orientation_ * Ogre::Quaternion(static_cast<float>(q.w()),
+                                                     static_cast<float>(q.x()),
+                                                     static_cast<float>(q.y()),
+                                                     static_cast<float>(q.z()));
     };
-    auto getTranslation = [&frame_orientation, &frame_position](const Distribution &d) {
-        return frame_orientation * Ogre::Vector3(static_cast<float>(d.mean[0].data),
-                                                 static_cast<float>(d.mean[1].data),
-                                                 static_cast<float>(d.mean[2].data)) + frame_position;
+    auto getTranslation = [this](const Distribution &d) {
+        return frame_orientation_ * Ogre::Vector3(static_cast<float>(d.mean[0].data),
+                                                  static_cast<float>(d.mean[1].data),
+                                                  static_cast<float>(d.mean[2].data)) + frame_position_;
     };
 
     auto getScale = [](const Distribution &d) {
@@ -112,24 +224,19 @@ void NDTDisplay::processMessage(const DistributionArray::ConstPtr &msg)
                              static_cast<float>(3.0 * d.eigen_values[2].data));
     };
 
-    if (!accumulate_)
-        visuals_.clear();
-
-    for(const auto &d : msg->data) {
-        const Ogre::Vector3 &p    = getTranslation(d);
-        const Ogre::Quaternion &q = getRotation(d);
-        const Ogre::Vector3 &s    = getScale(d);
-
-        if (valid(p,q,s) && std::isnormal(d.prob.data)) {
-            NDTVisual::Ptr &v = visuals_[d.id.data];
-            if (!v)
-                v.reset(new NDTEllipsoid(context_->getSceneManager(), scene_node_));
-            v->setFramePosition(p);
-            v->setFrameOrientation(q);
-            v->setScale(s);
-            v->setColorScale(static_cast<float>(0.5 + 0.5 * d.prob.data));
-            v->setColor(color_);
-        }
+    const Ogre::Vector3 &p    = getTranslation(d);
+    const Ogre::Quaternion &q = getRotation(d);
+    const Ogre::Vector3 &s    = getScale(d);
+
+    if (valid(p,q,s) && std::isnormal(d.prob.data)) {
+        NDTVisual::Ptr &v = visuals_[d.id.data];
+        if (!v)
+            v.reset(new NDTEllipsoid(context_->getSceneManager(), scene_node_));
+        v->setFramePosition(p);
+        v->setFrameOrientation(q);
+        v->setScale(s);
+        v->setColorScale(static_cast<float>(0.5 + 0.5 * d.prob.data));
+        v->setColor(color_);
     }
 }
 }
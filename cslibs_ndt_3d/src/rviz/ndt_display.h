@@ -5,6 +5,10 @@
 #include <rviz/message_filter_display.h>
 
 #include <cslibs_ndt_3d/DistributionArray.h>
+#include <cslibs_ndt_3d/conversion/level_of_detail.hpp>
+
+#include <OGRE/OgreVector3.h>
+#include <OGRE/OgreQuaternion.h>
 #endif
 
 #include <map>
@@ -27,6 +31,11 @@ class BoolProperty;
 namespace cslibs_ndt_3d {
 class NDTVisual;
 
+/**
+ * @brief Shows one ellipsoid per distribution. With the level of detail
+ *        enabled, the received distributions are merged into coarser ones
+ *        with the distance to the camera, only the selection is shown.
+ */
 class NDTDisplay : public rviz::MessageFilterDisplay<DistributionArray>
 {
     Q_OBJECT
@@ -37,22 +46,39 @@ public:
 protected:
     virtual void onInitialize();
     virtual void reset();
+    virtual void update(float wall_dt, float ros_dt);
 
 private Q_SLOTS:
     void updateColorAndAlpha();
     void updateAccumulation();
+    void updateLevelOfDetail();
+    void updateSelection();
 
 private:
     void processMessage(const DistributionArray::ConstPtr &msg);
+    void show(const Distribution &d);
+    void select();
 
     bool accumulate_;
+    bool level_of_detail_;
     std::map<uint64_t, std::shared_ptr<NDTVisual>> visuals_;
 
+    /// all received distributions, the visuals only show a selection
+    std::map<uint64_t, Distribution> distributions_;
+    conversion::LevelOfDetail        lod_;
+    Ogre::Vector3                    viewpoint_;
+    Ogre::Vector3                    frame_position_;
+    Ogre::Quaternion                 frame_orientation_;
+
     std::array<float,4> color_;
 
     rviz::ColorProperty* color_property_;
     rviz::FloatProperty* alpha_property_;
     rviz::BoolProperty*  bool_property_;
+    rviz::BoolProperty*  lod_property_;
+    rviz::FloatProperty* detail_distance_property_;
+    rviz::FloatProperty* eviction_distance_property_;
+    rviz::IntProperty*   max_count_property_;
 };
 }
 
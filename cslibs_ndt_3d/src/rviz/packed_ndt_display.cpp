@@ -0,0 +1,143 @@
+#include "packed_ndt_display.h"
+
+#include "ndt_ellipsoid.h"
+
+#include <OGRE/OgreSceneNode.h>
+#include <OGRE/OgreSceneManager.h>
+
+#include <rviz/visualization_manager.h>
+#include <rviz/properties/color_property.h>
+#include <rviz/properties/float_property.h>
+#include <rviz/properties/bool_property.h>
+#include <rviz/frame_manager.h>
+
+#include <tf/tf.h>
+
+#include <Eigen/Eigenvalues>
+
+namespace cslibs_ndt_3d {
+PackedNDTDisplay::PackedNDTDisplay() :
+    accumulate_(true)
+{
+    color_property_ = new rviz::ColorProperty("Color", QColor(204, 51, 204),
+                                              "Color to draw the acceleration arrows.",
+                                              this, SLOT(updateColorAndAlpha()));
+    alpha_property_ = new rviz::FloatProperty("Alpha", 1.0,
+                                              "0 is fully transparent, 1.0 is fully opaque.",
+                                              this, SLOT(updateColorAndAlpha()));
+    bool_property_ = new rviz::BoolProperty("Accumulate", true,
+                                            "Accumulate all received updates to one NDT map.",
+                                            this, SLOT(updateAccumulation()));
+}
+
+PackedNDTDisplay::~PackedNDTDisplay()
+{
+}
+
+void PackedNDTDisplay::onInitialize()
+{
+    MFDClass::onInitialize();
+}
+
+void PackedNDTDisplay::reset()
+{
+    MFDClass::reset();
+    visuals_.clear();
+}
+
+void PackedNDTDisplay::updateColorAndAlpha()
+{
+    const Ogre::ColourValue color = color_property_->getOgreColor();
+
+    color_[0] = alpha_property_->getFloat();
+    color_[1] = color.r;
+    color_[2] = color.g;
+    color_[3] = color.b;
+    for (auto &v : visuals_)
+        v.second->setColor(color_);
+}
+
+void PackedNDTDisplay::updateAccumulation()
+{
+    accumulate_ = bool_property_->getBool();
+    if (!accumulate_)
+        visuals_.clear();
+}
+
+void PackedNDTDisplay::processMessage(const PackedDistributionArray::ConstPtr &msg)
+{
+    /// get the map frame
+    Ogre::Quaternion frame_orientation;
+    Ogre::Vector3 frame_position;
+
+    if (!context_->getFrameManager()->getTransform(msg->header.frame_id,
+                                                   msg->header.stamp,
+                                                   frame_position,
+                                                   frame_orientation)) {
+        ROS_DEBUG("Error transforming from frame '%s' to frame '%s'",
+                  msg->header.frame_id.c_str(), qPrintable(fixed_frame_));
+        return;
+    }
+
+    const std::size_t n = msg->ids.size();
+    if (msg->means.size() != 3 * n || msg->covariances.size() != 6 * n || msg->probs.size() != n) {
+        ROS_DEBUG("Packed distribution array with inconsistent sizes.");
+        return;
+    }
+
+    auto valid = [](const Ogre::Vector3    &position,
+                    const Ogre::Quaternion &orientation,
+                    const Ogre::Vector3    &scale) {
+        const bool p = std::isnormal(position.x) && std::isnormal(position.y) && std::isnormal(position.z);
+        const bool o = std::isnormal(orientation.x) && std::isnormal(orientation.y) &&
+                       std::isnormal(orientation.z) && std::isnormal(orientation.w);
+        const bool s = std::isnormal(scale.x) && std::isnormal(scale.y) && std::isnormal(scale.z);
+        return p && o && s;
+    };
+
+    if (!accumulate_)
+        visuals_.clear();
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+    for (std::size_t i = 0 ; i < n ; ++i) {
+        const float *c = &msg->covariances[6 * i];
+        const float *m = &msg->means[3 * i];
+        Eigen::Matrix3d covariance;
+        covariance << c[0], c[1], c[2],
+                      c[1], c[3], c[4],
+                      c[2], c[4], c[5];
+        solver.computeDirect(covariance);
+
+        /// same layout of the eigen vectors as in the unpacked message
+        const Eigen::Matrix3d &e = solver.eigenvectors();
+        const tf::Matrix3x3 r(e(0), e(1), e(2),
+                              e(3), e(4), e(5),
+                              e(6), e(7), e(8));
+        tf::Quaternion tf_q;
+        r.getRotation(tf_q);
+
+        const Ogre::Vector3    p = frame_orientation * Ogre::Vector3(m[0], m[1], m[2]) + frame_position;
+        const Ogre::Quaternion q = frame_orientation * Ogre::Quaternion(static_cast<float>(tf_q.w()),
+                                                                        static_cast<float>(tf_q.x()),
+                                                                        static_cast<float>(tf_q.y()),
+                                                                        static_cast<float>(tf_q.z()));
+        const Ogre::Vector3    s(static_cast<float>(3.0 * solver.eigenvalues()(0)),
+                                 static_cast<float>(3.0 * solver.eigenvalues()(1)),
+                                 static_cast<float>(3.0 * solver.eigenvalues()(2)));
+
+        if (valid(p,q,s) && std::isnormal(msg->probs[i])) {
+            NDTVisual::Ptr &v = visuals_[msg->ids[i]];
+            if (!v)
+                v.reset(new NDTEllipsoid(context_->getSceneManager(), scene_node_));
+            v->setFramePosition(p);
+            v->setFrameOrientation(q);
+            v->setScale(s);
+            v->setColorScale(0.5f + 0.5f * msg->probs[i]);
+            v->setColor(color_);
+        }
+    }
+}
+}
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(cslibs_ndt_3d::PackedNDTDisplay, rviz::Display)
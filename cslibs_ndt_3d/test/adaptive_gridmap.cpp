@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/matching/match.hpp>
+#include <cslibs_ndt_3d/matching/adaptive_gridmap_match_traits.hpp>
+#include <cslibs_ndt_3d/adaptive_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using adaptive_map_t = cslibs_ndt_3d::adaptive_maps::Gridmap;
+using dynamic_map_t  = cslibs_ndt_3d::dynamic_maps::Gridmap;
+
+const double      RESOLUTION = 0.125;
+const std::size_t MAX_DEPTH  = 4;
+
+/// floor and two walls of a room, a sphere standing in the corner
+cslibs_math_3d::Pointcloud3d::Ptr generateRoom(const std::size_t size)
+{
+    rng_t<1> rng(0.0, 8.0);
+    rng_t<1> rng_noise(-0.01, 0.01);
+    rng_t<1> rng_angle(-M_PI, M_PI);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < size ; ++ i) {
+        switch (i % 4) {
+        case 0:
+            cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng_noise.get()));
+            break;
+        case 1:
+            cloud->insert(cslibs_math_3d::Point3d(rng_noise.get(), rng.get(), 0.5 * rng.get()));
+            break;
+        case 2:
+            cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng_noise.get(), 0.5 * rng.get()));
+            break;
+        default: {
+            const double theta = rng_angle.get();
+            const double phi   = 0.5 * rng_angle.get();
+            const double r     = 1.0 + rng_noise.get();
+            cloud->insert(cslibs_math_3d::Point3d(2.0 + r * std::cos(phi) * std::cos(theta),
+                                                  2.0 + r * std::cos(phi) * std::sin(theta),
+                                                  1.0 + r * std::sin(phi)));
+        }
+        }
+    }
+    return cloud;
+}
+
+std::size_t countPoints(const adaptive_map_t &map)
+{
+    std::size_t n = 0;
+    map.traverse([&n](const adaptive_map_t::index_t &, const std::size_t, const adaptive_map_t::distribution_t &d) {
+        n += d.data().getN();
+    });
+    return n;
+}
+
+TEST(Test_cslibs_ndt_3d, testAdaptiveRefinement)
+{
+    adaptive_map_t map(adaptive_map_t::pose_t(), RESOLUTION, MAX_DEPTH);
+
+    /// a plane is flat at any scale and is kept in the roots
+    rng_t<1> rng(0.01, 3.99);
+    cslibs_math_3d::Pointcloud3d::Ptr plane(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < 2000 ; ++ i)
+        plane->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), 0.5));
+    map.insert(plane);
+
+    std::size_t leaves = 0;
+    map.traverse([&leaves](const adaptive_map_t::index_t &, const std::size_t depth, const adaptive_map_t::distribution_t &) {
+        EXPECT_EQ(depth, 0ul);
+        ++ leaves;
+    });
+    EXPECT_EQ(leaves, 4ul);
+    EXPECT_EQ(countPoints(map), plane->size());
+
+    /// a perpendicular wall turns the roots it crosses into corners
+    cslibs_math_3d::Pointcloud3d::Ptr wall(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < 2000 ; ++ i)
+        wall->insert(cslibs_math_3d::Point3d(rng.get(), 1.0, rng.get() * 0.25));
+    map.insert(wall);
+
+    std::size_t max_depth = 0;
+    map.traverse([&max_depth](const adaptive_map_t::index_t &, const std::size_t depth, const adaptive_map_t::distribution_t &) {
+        max_depth = std::max(max_depth, depth);
+    });
+    EXPECT_GT(max_depth, 0ul);
+    EXPECT_LE(max_depth, MAX_DEPTH);
+
+    /// children of a split which hold plane points inserted before do not
+    /// split again, so no point is lost
+    EXPECT_EQ(countPoints(map), plane->size() + wall->size());
+
+    /// nor with further batches into the children of the split roots
+    cslibs_math_3d::Pointcloud3d::Ptr corner(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < 2000 ; ++ i)
+        corner->insert(cslibs_math_3d::Point3d(1.0 + 0.01 * rng.get(), rng.get(), rng.get() * 0.25));
+    map.insert(corner);
+    EXPECT_EQ(countPoints(map), plane->size() + wall->size() + corner->size());
+
+    /// every point is covered by exactly one leaf
+    for (const cslibs_math_3d::Point3d &p : *wall) {
+        const adaptive_map_t::distribution_t *d = map.getDistribution(p);
+        ASSERT_NE(d, nullptr);
+        EXPECT_GT(d->data().getN(), 0ul);
+    }
+    EXPECT_EQ(map.getDistribution(cslibs_math_3d::Point3d(-5.0, -5.0, -5.0)), nullptr);
+    EXPECT_EQ(map.sample(cslibs_math_3d::Point3d(-5.0, -5.0, -5.0)), 0.0);
+
+    adaptive_map_t::tree_t copy(map.getTree());
+    EXPECT_EQ(copy.getByteSize(), map.getTree().getByteSize());
+}
+
+TEST(Test_cslibs_ndt_3d, testAdaptiveBenchmark)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr room = generateRoom(40000);
+    const cslibs_math_3d::Pointcloud3d::Ptr scan = generateRoom(4000);
+
+    adaptive_map_t adaptive(adaptive_map_t::pose_t(), RESOLUTION, MAX_DEPTH);
+    adaptive.insert(room);
+
+    std::size_t leaves = 0;
+    adaptive.traverse([&leaves](const adaptive_map_t::index_t &, const std::size_t, const adaptive_map_t::distribution_t &) {
+        ++ leaves;
+    });
+    /// within a batch the refinement is exact
+    EXPECT_EQ(countPoints(adaptive), room->size());
+
+    const cslibs_ndt::matching::Parameter params;
+    const cslibs_math_3d::Transform3d offset(0.05, 0.0, 0.0, 0.0, 0.0, 0.0);
+
+    /// scan and map are sampled from the same room, identity is the ground truth
+    auto error = [](const cslibs_math_3d::Transform3d &t) {
+        return t.translation().length();
+    };
+
+    const auto r_adaptive = cslibs_ndt::matching::match(scan->begin(), scan->end(), adaptive, params, offset);
+    const double e_adaptive = error(r_adaptive.transform());
+    std::cout << "[adaptive] " << leaves << " leaves, " << adaptive.getByteSize() << " bytes, "
+              << "matching error " << e_adaptive << std::endl;
+    EXPECT_LT(e_adaptive, error(offset));
+
+    for (const double resolution : {0.25, 0.5, 1.0}) {
+        dynamic_map_t dynamic(dynamic_map_t::pose_t(), resolution);
+        dynamic.insert(room);
+        const auto r_dynamic = cslibs_ndt::matching::match(scan->begin(), scan->end(), dynamic, params, offset);
+        std::cout << "[dynamic " << resolution << "] " << dynamic.getByteSize() << " bytes, "
+                  << "matching error " << error(r_dynamic.transform()) << std::endl;
+        if (resolution == 0.25)
+            EXPECT_LT(adaptive.getByteSize(), dynamic.getByteSize());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
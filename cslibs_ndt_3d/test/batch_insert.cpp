@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const std::size_t NUM_SENSORS = 5;
+const std::size_t NUM_CYCLES  = 10;
+const std::size_t NUM_POINTS  = 2000;
+
+std::vector<cslibs_math_3d::Pointcloud3d::Ptr> generateClouds()
+{
+    /// overlapping views of a box shaped room
+    rng_t<1> rng_coord(-5.0, 5.0);
+    std::vector<cslibs_math_3d::Pointcloud3d::Ptr> clouds;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s) {
+        cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+        for (std::size_t i = 0 ; i < NUM_POINTS ; ++ i) {
+            cloud->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), -2.0));
+            cloud->insert(cslibs_math_3d::Point3d(6.0, rng_coord.get(), rng_coord.get()));
+        }
+        clouds.emplace_back(cloud);
+    }
+    return clouds;
+}
+
+std::vector<cslibs_math_3d::Pose3d> generateOrigins()
+{
+    std::vector<cslibs_math_3d::Pose3d> origins;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+        origins.emplace_back(cslibs_math_3d::Pose3d(0.1 * s, -0.2 * s, 0.05 * s, 0.0, 0.0, 0.1 * s));
+    return origins;
+}
+
+template <typename map_t, typename insert_t>
+double runCycles(map_t &map,
+                 const insert_t &insert)
+{
+    duration_t total(0.0);
+    for (std::size_t c = 0 ; c < NUM_CYCLES ; ++ c) {
+        const auto start = steady_clock_t::now();
+        insert(map);
+        total += steady_clock_t::now() - start;
+    }
+    return total.count() / NUM_CYCLES;
+}
+
+TEST(Test_cslibs_ndt_3d, testBatchInsertGridmap)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    const std::vector<cslibs_math_3d::Pointcloud3d::Ptr> clouds  = generateClouds();
+    const std::vector<cslibs_math_3d::Pose3d>            origins = generateOrigins();
+
+    map_t::batch_t batch;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+        batch.add(clouds[s], origins[s]);
+
+    map_t sequential(map_t::pose_t(), 1.0);
+    map_t batched(map_t::pose_t(), 1.0);
+    const double t_sequential = runCycles(sequential, [&clouds, &origins](map_t &map) {
+        for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+            map.insert(clouds[s], origins[s]);
+    });
+    const double t_batched = runCycles(batched, [&batch](map_t &map) {
+        map.insert(batch);
+    });
+    std::cout << "[batch insert] gridmap, latency per cycle: sequential " << t_sequential
+              << " ms, batched " << t_batched << " ms" << std::endl;
+
+    std::size_t bundles = 0;
+    sequential.traverse([&batched, &bundles](const map_t::index_t &bi, const map_t::distribution_bundle_t &b) {
+        const map_t::distribution_bundle_t *bb = batched.getDistributionBundle(bi);
+        for (std::size_t i = 0 ; i < 8 ; ++ i) {
+            EXPECT_EQ(b.at(i)->data().getN(), bb->at(i)->data().getN());
+            EXPECT_NEAR((b.at(i)->data().getMean() - bb->at(i)->data().getMean()).norm(), 0.0, 1e-6);
+        }
+        ++ bundles;
+    });
+    EXPECT_GT(bundles, 0ul);
+}
+
+TEST(Test_cslibs_ndt_3d, testBatchInsertOccupancyGridmap)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+    const std::vector<cslibs_math_3d::Pointcloud3d::Ptr> clouds  = generateClouds();
+    const std::vector<cslibs_math_3d::Pose3d>            origins = generateOrigins();
+
+    map_t::batch_t batch;
+    for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+        batch.add(clouds[s], origins[s]);
+
+    map_t sequential(map_t::pose_t(), 1.0);
+    map_t batched(map_t::pose_t(), 1.0);
+    const double t_sequential = runCycles(sequential, [&clouds, &origins](map_t &map) {
+        for (std::size_t s = 0 ; s < NUM_SENSORS ; ++ s)
+            map.insert(clouds[s], origins[s]);
+    });
+    const double t_batched = runCycles(batched, [&batch](map_t &map) {
+        map.insert(batch);
+    });
+    std::cout << "[batch insert] occupancy gridmap, latency per cycle: sequential " << t_sequential
+              << " ms, batched " << t_batched << " ms" << std::endl;
+
+    std::size_t bundles = 0;
+    sequential.traverse([&batched, &bundles](const map_t::index_t &bi, const map_t::distribution_bundle_t &b) {
+        const map_t::distribution_bundle_t *bb = batched.getDistributionBundle(bi);
+        for (std::size_t i = 0 ; i < 8 ; ++ i) {
+            EXPECT_EQ(b.at(i)->numFree(),     bb->at(i)->numFree());
+            EXPECT_EQ(b.at(i)->numOccupied(), bb->at(i)->numOccupied());
+        }
+        ++ bundles;
+    });
+    EXPECT_GT(bundles, 0ul);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
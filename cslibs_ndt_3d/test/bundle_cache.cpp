@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/sensor_msgs_pointcloud2.hpp>
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include "generate_box.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <map>
+
+using map_t           = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using array_t         = cslibs_ndt_3d::DistributionArray;
+using cloud_point_t   = cslibs_ndt_3d::conversion::impl::cloud_point_t;
+using steady_clock_t  = std::chrono::steady_clock;
+using duration_t      = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION = 0.5;
+
+/// one bundle after the other, as converted before
+sensor_msgs::PointCloud2 sequential(const map_t &map)
+{
+    std::vector<float> tmp;
+    map.traversePartiallyAllocatedBundles([&tmp](const map_t::index_t &, const map_t::distribution_const_bundle_t &b) {
+        cloud_point_t p;
+        if (cslibs_ndt_3d::conversion::impl::point(b, p))
+            tmp.insert(tmp.end(), p.begin(), p.end());
+    });
+    sensor_msgs::PointCloud2 msg;
+    cslibs_ndt_3d::conversion::from(tmp, msg);
+    return msg;
+}
+
+void expectEqual(const sensor_msgs::PointCloud2 &a,
+                 const sensor_msgs::PointCloud2 &b)
+{
+    EXPECT_EQ(a.width,      b.width);
+    EXPECT_EQ(a.row_step,   b.row_step);
+    EXPECT_EQ(a.point_step, b.point_step);
+    ASSERT_EQ(a.data.size(), b.data.size());
+    EXPECT_TRUE(a.data == b.data);
+}
+
+/// cached conversions are in another order
+std::vector<cloud_point_t> sorted(const sensor_msgs::PointCloud2 &msg)
+{
+    std::vector<cloud_point_t> points(msg.width);
+    if (!points.empty())
+        memcpy(points.data(), msg.data.data(), msg.data.size());
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
+void expectSame(const sensor_msgs::PointCloud2 &a,
+                const sensor_msgs::PointCloud2 &b)
+{
+    EXPECT_EQ(a.width, b.width);
+    EXPECT_TRUE(sorted(a) == sorted(b));
+}
+
+void expectSame(const array_t &a,
+                const array_t &b)
+{
+    std::map<uint64_t, cslibs_ndt_3d::Distribution> distributions;
+    for (const auto &d : b.data)
+        distributions[d.id.data] = d;
+
+    ASSERT_EQ(a.data.size(), b.data.size());
+    for (const auto &d : a.data) {
+        ASSERT_EQ(distributions.count(d.id.data), 1ul);
+        const cslibs_ndt_3d::Distribution &e = distributions[d.id.data];
+        EXPECT_EQ(d.prob.data, e.prob.data);
+        for (std::size_t j = 0 ; j < 3 ; ++ j)
+            EXPECT_EQ(d.mean[j].data, e.mean[j].data);
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testParallelPointCloud2)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-10.0, -10.0, -1.0), cslibs_math_3d::Point3d(10.0, 10.0, 1.0), 100000));
+
+    /// same points in the same order
+    sensor_msgs::PointCloud2 msg;
+    cslibs_ndt_3d::conversion::from(map, msg);
+    EXPECT_GT(msg.width, cslibs_ndt_3d::conversion::impl::chunk_size);
+    expectEqual(msg, sequential(*map));
+
+    /// an empty map gives an empty cloud
+    const map_t::Ptr empty(new map_t(map_t::pose_t(), RESOLUTION));
+    cslibs_ndt_3d::conversion::from(empty, msg);
+    EXPECT_EQ(msg.width, 0ul);
+    EXPECT_TRUE(msg.data.empty());
+}
+
+TEST(Test_cslibs_ndt_3d, testBundleCachePointCloud2)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-5.0, -5.0, -1.0), cslibs_math_3d::Point3d(5.0, 5.0, 1.0), 50000));
+
+    cslibs_ndt_3d::conversion::BundleCache<cloud_point_t> cache;
+    sensor_msgs::PointCloud2 cached, full;
+    cslibs_ndt_3d::conversion::from(map, cached, map->fetchDirtyBlocks(), cache);
+    cslibs_ndt_3d::conversion::from(map, full);
+    expectSame(cached, full);
+    const std::size_t size = cache.size();
+    EXPECT_GE(size, cached.width);
+
+    /// changes inside and outside of the cached area
+    map->insert(generateBox(cslibs_math_3d::Point3d(1.0, 1.0, 0.0), cslibs_math_3d::Point3d(2.0, 2.0, 0.5), 5000));
+    map->insert(generateBox(cslibs_math_3d::Point3d(8.0, 8.0, 0.0), cslibs_math_3d::Point3d(9.0, 9.0, 0.5), 5000));
+    cslibs_ndt_3d::conversion::from(map, cached, map->fetchDirtyBlocks(), cache);
+    cslibs_ndt_3d::conversion::from(map, full);
+    expectSame(cached, full);
+    EXPECT_GT(cache.size(), size);
+
+    /// without changes nothing is converted again
+    cslibs_ndt_3d::conversion::from(map, cached, map->fetchDirtyBlocks(), cache);
+    expectSame(cached, full);
+}
+
+TEST(Test_cslibs_ndt_3d, testBundleCacheDistributions)
+{
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-4.0, -4.0, 1.0), cslibs_math_3d::Point3d(4.0, 4.0, 1.2), 20000),
+                occupancy_map_t::pose_t(0.0, 0.0, 0.0));
+
+    cslibs_ndt_3d::conversion::BundleCache<cslibs_ndt_3d::Distribution> cache;
+    array_t::Ptr cached, full;
+    cslibs_ndt_3d::conversion::from(map, cached, map->fetchDirtyBlocks(), cache, ivm);
+    cslibs_ndt_3d::conversion::from(map, full, ivm);
+    ASSERT_TRUE(cached.get() && full.get());
+    EXPECT_FALSE(full->data.empty());
+    expectSame(*cached, *full);
+
+    /// rays through the cached area free some of it
+    map->insert(generateBox(cslibs_math_3d::Point3d(-1.0, -1.0, 3.0), cslibs_math_3d::Point3d(1.0, 1.0, 3.2), 5000),
+                occupancy_map_t::pose_t(0.0, 0.0, 0.0));
+    cslibs_ndt_3d::conversion::from(map, cached, map->fetchDirtyBlocks(), cache, ivm);
+    cslibs_ndt_3d::conversion::from(map, full, ivm);
+    expectSame(*cached, *full);
+}
+
+TEST(Test_cslibs_ndt_3d, testConcurrentConversions)
+{
+    using ivm_t = cslibs_gridmaps::utility::InverseModel;
+    const ivm_t::Ptr ivm(new ivm_t(0.5, 0.45, 0.65));
+    const ivm_t::Ptr other(new ivm_t(0.5, 0.2, 0.8));
+
+    /// the same map twice, conversions of the first one run one after the other
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud =
+            generateBox(cslibs_math_3d::Point3d(-10.0, -10.0, 1.0), cslibs_math_3d::Point3d(10.0, 10.0, 1.5), 100000);
+    const occupancy_map_t::Ptr reference(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    reference->insert(cloud, occupancy_map_t::pose_t(0.0, 0.0, 0.0));
+    map->insert(cloud, occupancy_map_t::pose_t(0.0, 0.0, 0.0));
+
+    array_t::Ptr expected_array;
+    sensor_msgs::PointCloud2 expected_cloud;
+    cslibs_ndt_3d::conversion::from(reference, expected_array, ivm);
+    cslibs_ndt_3d::conversion::from(reference, expected_cloud, other);
+    ASSERT_TRUE(expected_array.get());
+    EXPECT_FALSE(expected_array->data.empty());
+
+    /// reading with different inverse models at once does not interfere
+    array_t::Ptr array;
+    sensor_msgs::PointCloud2 msg;
+    std::thread worker([&map, &array, &ivm]() {
+        cslibs_ndt_3d::conversion::from(map, array, ivm);
+    });
+    cslibs_ndt_3d::conversion::from(map, msg, other);
+    worker.join();
+
+    ASSERT_TRUE(array.get());
+    expectSame(*array, *expected_array);
+    expectEqual(msg, expected_cloud);
+
+    std::cout << "[concurrent] " << sizeof(occupancy_map_t::distribution_t) << " bytes per distribution, "
+              << "map " << map->getByteSize() << " bytes" << std::endl;
+}
+
+TEST(Test_cslibs_ndt_3d, testBundleCacheBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-20.0, -20.0, -2.0), cslibs_math_3d::Point3d(20.0, 20.0, 2.0), 500000));
+    map->fetchDirtyBlocks();
+
+    auto start = steady_clock_t::now();
+    const sensor_msgs::PointCloud2 reference = sequential(*map);
+    const duration_t t_sequential = steady_clock_t::now() - start;
+
+    sensor_msgs::PointCloud2 msg;
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, msg);
+    const duration_t t_parallel = steady_clock_t::now() - start;
+
+    cslibs_ndt_3d::conversion::BundleCache<cloud_point_t> cache;
+    cslibs_ndt_3d::conversion::from(map, msg, map_t::dirty_blocks_t(), cache);
+    map->insert(generateBox(cslibs_math_3d::Point3d(0.0, 0.0, 0.0), cslibs_math_3d::Point3d(1.0, 1.0, 1.0), 1000));
+    const map_t::dirty_blocks_t dirty = map->fetchDirtyBlocks();
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, msg, dirty, cache);
+    const duration_t t_cached = steady_clock_t::now() - start;
+
+    std::cout << "[point cloud] " << reference.width << " points, sequential " << t_sequential.count() << " ms, "
+              << "parallel " << t_parallel.count() << " ms, cached " << t_cached.count() << " ms" << std::endl;
+    EXPECT_GE(msg.width, reference.width);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
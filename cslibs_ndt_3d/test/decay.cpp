@@ -0,0 +1,298 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+#include <cslibs_ndt_3d/serialization/dynamic_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt/common/merge.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <cmath>
+#include <tuple>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t          = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using distribution_t = cslibs_ndt::OccupancyDistribution<3, double>;
+using ivm_t          = cslibs_gridmaps::utility::InverseModel;
+using array_t        = cslibs_ndt_3d::DistributionArray;
+using state_t        = std::tuple<std::size_t, std::size_t, double>;
+
+const double RESOLUTION = 0.5;
+const double DECAY      = 10.0;
+
+/// wall at a distance in front of the sensor
+cslibs_math_3d::Pointcloud3d::Ptr generateWall(const double x,
+                                               const std::size_t size)
+{
+    rng_t<1> rng(-1.0, 1.0);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(x, rng.get(), rng.get()));
+    return cloud;
+}
+
+TEST(Test_cslibs_ndt_3d, testDecayDistribution)
+{
+    const ivm_t::Ptr ivm(new ivm_t(0.5, 0.45, 0.65));
+
+    distribution_t d;
+    d.updateFree(100);
+    for (std::size_t i = 0 ; i < 100 ; ++ i)
+        d.updateOccupied(distribution_t::point_t(1.0, 2.0, 3.0) + distribution_t::point_t::Random() * 0.1);
+    const double occupancy = d.getOccupancy(ivm);
+    const distribution_t::point_t mean = d.getDistribution()->getMean();
+
+    /// disabled decay only stamps the cell
+    d.decay(1.0, 0.0);
+    EXPECT_EQ(d.numFree(), 100ul);
+    EXPECT_EQ(d.numOccupied(), 100ul);
+    EXPECT_EQ(d.getStamp(), 1.0);
+
+    /// reading does not modify the cell, many small steps are not lost to rounding
+    const double decayed = d.getOccupancy(ivm, 1.0 + DECAY, DECAY);
+    EXPECT_EQ(d.numFree(), 100ul);
+    for (std::size_t i = 1 ; i <= 1000 ; ++ i)
+        d.decay(1.0 + i * 0.001 * DECAY, DECAY);
+    EXPECT_EQ(d.numFree(),     static_cast<std::size_t>(std::round(100.0 / M_E)));
+    EXPECT_EQ(d.numOccupied(), static_cast<std::size_t>(std::round(100.0 / M_E)));
+    EXPECT_NEAR(d.getOccupancy(ivm), decayed, 1e-9);
+    EXPECT_LT(std::abs(decayed - 0.5), std::abs(occupancy - 0.5));
+
+    /// moments keep their shape
+    EXPECT_NEAR((d.getDistribution()->getMean() - mean).norm(), 0.0, 1e-9);
+
+    /// new observations outweigh the forgotten ones
+    d.updateFree(100);
+    EXPECT_EQ(d.numFree(), 137ul);
+
+    /// stale structure fades out completely
+    d.decay(1.0 + 20.0 * DECAY, DECAY);
+    EXPECT_EQ(d.numFree(), 0ul);
+    EXPECT_EQ(d.numOccupied(), 0ul);
+    EXPECT_EQ(d.getDistribution(), nullptr);
+}
+
+TEST(Test_cslibs_ndt_3d, testDecayGridmap)
+{
+    const ivm_t::Ptr ivm(new ivm_t(0.5, 0.45, 0.65));
+    const cslibs_math_3d::Pointcloud3d::Ptr wall  = generateWall(2.0, 1000);
+    const cslibs_math_3d::Pointcloud3d::Ptr moved = generateWall(4.0, 1000);
+    const cslibs_math_3d::Point3d p(2.0, 0.0, 0.0);
+
+    map_t map(map_t::pose_t(), RESOLUTION);
+    map_t reference(map_t::pose_t(), RESOLUTION);
+    map.setDecay(DECAY);
+    map.setTime(0.0);
+    map.insert(wall);
+    reference.insert(wall);
+    EXPECT_EQ(map.sample(p, ivm), reference.sample(p, ivm));
+
+    /// reads decay lazily, without touching the map
+    map.setTime(DECAY);
+    EXPECT_LT(map.sample(p, ivm), reference.sample(p, ivm));
+    EXPECT_GT(map.sample(p, ivm), 0.0);
+
+    /// the wall moved, the rays now pass through its old position
+    map.setTime(10.0 * DECAY);
+    map.insert(moved);
+    reference.insert(moved);
+
+    const map_t::distribution_bundle_t *bundle = map.getDistributionBundle(map.getBundleIndex(p));
+    ASSERT_NE(bundle, nullptr);
+    for (std::size_t i = 0 ; i < 8 ; ++ i)
+        EXPECT_EQ(bundle->at(i)->getDistribution(), nullptr);
+    EXPECT_EQ(map.sample(p, ivm), 0.0);
+    EXPECT_GT(reference.sample(p, ivm), 0.0);
+
+    const cslibs_math_3d::Point3d q(4.0, 0.0, 0.0);
+    EXPECT_EQ(map.sample(q, ivm), reference.sample(q, ivm));
+}
+
+/// counts and stamp of every distribution in the map
+std::vector<state_t> state(const map_t &map)
+{
+    std::vector<state_t> s;
+    map.traverse([&s](const map_t::index_t &, const map_t::distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 8 ; ++ i)
+            s.emplace_back(b.at(i)->numFree(), b.at(i)->numOccupied(), b.at(i)->getStamp());
+    });
+    return s;
+}
+
+std::map<uint64_t, double> probabilities(const array_t &a)
+{
+    std::map<uint64_t, double> p;
+    for (const auto &d : a.data)
+        p[d.id.data] = d.prob.data;
+    return p;
+}
+
+TEST(Test_cslibs_ndt_3d, testDecayReadOnly)
+{
+    const ivm_t::Ptr ivm(new ivm_t(0.5, 0.45, 0.65));
+    const cslibs_math_3d::Point3d p(2.0, 0.0, 0.0);
+
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->setDecay(DECAY);
+    map->setTime(0.0);
+    map->insert(generateWall(2.0, 1000));
+    map->fetchDirtyBlocks();
+
+    array_t::Ptr fresh;
+    cslibs_ndt_3d::conversion::from(map, fresh, ivm, 0.0);
+    ASSERT_FALSE(fresh->data.empty());
+
+    cslibs_ndt_3d::conversion::BundleCache<cslibs_ndt_3d::Distribution> cache;
+    array_t::Ptr cached;
+    cslibs_ndt_3d::conversion::from(map, cached, map_t::dirty_blocks_t(), cache, ivm, 0.0);
+    EXPECT_TRUE(probabilities(*cached) == probabilities(*fresh));
+
+    /// reads and conversions evaluate the decay without modifying the map
+    map->setTime(DECAY);
+    const std::vector<state_t> before = state(*map);
+    const map_t &const_map = *map;
+    ASSERT_NE(const_map.getDistributionBundle(const_map.getBundleIndex(p)), nullptr);
+    map->sample(p, ivm);
+    array_t::Ptr decayed;
+    cslibs_ndt_3d::conversion::from(map, decayed, ivm, 0.0);
+    EXPECT_TRUE(state(*map) == before);
+
+    const std::map<uint64_t, double> p_fresh   = probabilities(*fresh);
+    const std::map<uint64_t, double> p_decayed = probabilities(*decayed);
+    ASSERT_EQ(p_decayed.size(), p_fresh.size());
+    std::size_t changed = 0;
+    for (const auto &e : p_fresh) {
+        ASSERT_EQ(p_decayed.count(e.first), 1ul);
+        if (p_decayed.at(e.first) != e.second)
+            ++ changed;
+    }
+    EXPECT_GT(changed, 0ul);
+
+    /// the cache expires with the time, although no bundle was updated
+    cslibs_ndt_3d::conversion::from(map, cached, map->fetchDirtyBlocks(), cache, ivm, 0.0);
+    EXPECT_TRUE(probabilities(*cached) == p_decayed);
+
+    /// going back in time gives the fresh map again
+    map->setTime(0.0);
+    array_t::Ptr again;
+    cslibs_ndt_3d::conversion::from(map, again, ivm, 0.0);
+    EXPECT_TRUE(probabilities(*again) == p_fresh);
+}
+
+/// counts, stamps and scales of the distributions per bundle
+std::map<map_t::index_t, std::vector<std::tuple<std::size_t, std::size_t, double, double, double>>> cells(const map_t &map)
+{
+    std::map<map_t::index_t, std::vector<std::tuple<std::size_t, std::size_t, double, double, double>>> c;
+    map.traverse([&c](const map_t::index_t &bi, const map_t::distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 8 ; ++ i)
+            c[bi].emplace_back(b.at(i)->numFree(), b.at(i)->numOccupied(), b.at(i)->getStamp(),
+                               b.at(i)->getFreeScale(), b.at(i)->getOccupiedScale());
+    });
+    return c;
+}
+
+TEST(Test_cslibs_ndt_3d, testDecaySerialization)
+{
+    /// stamps far from zero, as with wall clock times
+    const double T = 1.5e9;
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->setDecay(DECAY);
+    map->setTime(T);
+    map->insert(generateWall(2.0, 1000));
+    /// partially decayed cells have fractional scales
+    map->setTime(T + 0.3 * DECAY);
+    map->insert(generateWall(3.0, 500));
+
+    const std::string path = "/tmp/decay_occ_map_binary_3d";
+    ASSERT_TRUE(cslibs_ndt_3d::dynamic_maps::saveBinary(map, path));
+    map_t::Ptr loaded;
+    ASSERT_TRUE(cslibs_ndt_3d::dynamic_maps::loadBinary(path, loaded));
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->getTime(),  map->getTime());
+    EXPECT_EQ(loaded->getDecay(), map->getDecay());
+    EXPECT_TRUE(cells(*loaded) == cells(*map));
+
+    /// the next update decays from the saved stamps instead of wiping the map
+    const cslibs_math_3d::Pointcloud3d::Ptr next = generateWall(4.0, 200);
+    map->setTime(T + 0.5 * DECAY);
+    loaded->setTime(T + 0.5 * DECAY);
+    map->insert(next);
+    loaded->insert(next);
+    EXPECT_TRUE(cells(*loaded) == cells(*map));
+
+    const cslibs_math_3d::Point3d p(2.0, 0.0, 0.0);
+    const map_t::distribution_bundle_t *bundle = loaded->getDistributionBundle(loaded->getBundleIndex(p));
+    ASSERT_NE(bundle, nullptr);
+    std::size_t occupied = 0;
+    for (std::size_t i = 0 ; i < 8 ; ++ i)
+        occupied += bundle->at(i)->numOccupied();
+    EXPECT_GT(occupied, 0ul);
+}
+
+TEST(Test_cslibs_ndt_3d, testDecayMerge)
+{
+    /// the older cell is decayed to the stamp of the newer one first
+    distribution_t older;
+    older.updateFree(100);
+    distribution_t newer;
+    newer.decay(DECAY, DECAY);
+    newer.updateFree(100);
+    newer.merge(older, DECAY);
+    EXPECT_EQ(newer.numFree(), 137ul);
+    EXPECT_EQ(newer.getStamp(), DECAY);
+    EXPECT_EQ(older.numFree(), 100ul);
+    EXPECT_EQ(older.getStamp(), 0.0);
+
+    /// the stamp survives a transformation
+    older.decay(0.5 * DECAY, DECAY);
+    const distribution_t transformed = cslibs_ndt::merge::transform(older,
+                                                                    Eigen::Matrix3d::Identity(),
+                                                                    Eigen::Vector3d::Zero());
+    EXPECT_EQ(transformed.numFree(),        older.numFree());
+    EXPECT_EQ(transformed.getStamp(),       older.getStamp());
+    EXPECT_EQ(transformed.getFreeScale(),   older.getFreeScale());
+
+    /// merging a stale submap does not resurrect the old wall
+    const cslibs_math_3d::Pointcloud3d::Ptr wall  = generateWall(2.0, 1000);
+    const cslibs_math_3d::Pointcloud3d::Ptr moved = generateWall(4.0, 1000);
+    const cslibs_math_3d::Point3d p(2.0, 0.0, 0.0);
+    auto occupied = [&p](const map_t &map) {
+        std::size_t n = 0;
+        const map_t::distribution_bundle_t *bundle = map.getDistributionBundle(map.getBundleIndex(p));
+        if (bundle)
+            for (std::size_t i = 0 ; i < 8 ; ++ i)
+                n += bundle->at(i)->numOccupied();
+        return n;
+    };
+
+    map_t submap(map_t::pose_t(), RESOLUTION);
+    submap.setDecay(DECAY);
+    submap.setTime(0.0);
+    submap.insert(wall);
+    ASSERT_GT(occupied(submap), 0ul);
+
+    /// aligned and re-binned
+    for (const map_t::pose_t &transform : {map_t::pose_t(), map_t::pose_t(0.01, 0.0, 0.0)}) {
+        map_t map(map_t::pose_t(), RESOLUTION);
+        map.setDecay(DECAY);
+        map.setTime(10.0 * DECAY);
+        map.insert(moved);
+        map.merge(submap, transform);
+        EXPECT_EQ(occupied(map), 0ul);
+
+        map_t reference(map_t::pose_t(), RESOLUTION);
+        reference.insert(moved);
+        reference.merge(submap, transform);
+        EXPECT_GT(occupied(reference), 0ul);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
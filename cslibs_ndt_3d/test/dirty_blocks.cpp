@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t          = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using array_t        = cslibs_ndt_3d::DistributionArray;
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION = 0.5;
+
+/// points on the floor of a square area
+cslibs_math_3d::Pointcloud3d::Ptr generateFloor(const double min,
+                                                const double max,
+                                                const std::size_t size)
+{
+    rng_t<1> rng(min, max);
+    rng_t<1> rng_z(-0.2, 0.2);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng_z.get()));
+    return cloud;
+}
+
+std::map<uint64_t, cslibs_ndt_3d::Distribution> byId(const array_t &a)
+{
+    std::map<uint64_t, cslibs_ndt_3d::Distribution> distributions;
+    for (const auto &d : a.data)
+        distributions[d.id.data] = d;
+    return distributions;
+}
+
+TEST(Test_cslibs_ndt_3d, testDirtyBlocks)
+{
+    map_t map(map_t::pose_t(), RESOLUTION);
+    EXPECT_TRUE(map.getDirtyBlocks().empty());
+
+    map.insert(generateFloor(0.0, 10.0, 10000));
+    EXPECT_FALSE(map.getDirtyBlocks().empty());
+    EXPECT_FALSE(map.fetchDirtyBlocks().empty());
+    EXPECT_TRUE(map.getDirtyBlocks().empty());
+
+    /// a single point marks a single block, whose bounds contain the point
+    const map_t::point_t p(-3.1, 4.2, 0.1);
+    map.insert(p);
+    const map_t::dirty_blocks_t dirty = map.fetchDirtyBlocks();
+    ASSERT_EQ(dirty.size(), 1ul);
+    const map_t::index_t bi = map.getBundleIndex(p);
+    dirty.traverse([&bi](const map_t::index_t &min_bi, const map_t::index_t &max_bi) {
+        for (std::size_t d = 0 ; d < 3 ; ++ d) {
+            EXPECT_LT(min_bi[d], bi[d]);
+            EXPECT_GT(max_bi[d], bi[d]);
+        }
+    });
+
+    /// pruning marks the removed bundles
+    map.evictOutside(map.getMinBundleIndex(), bi);
+    EXPECT_FALSE(map.getDirtyBlocks().empty());
+}
+
+TEST(Test_cslibs_ndt_3d, testDirtyBlocksConversion)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateFloor(0.0, 20.0, 40000));
+    map->fetchDirtyBlocks();
+
+    array_t::Ptr before;
+    cslibs_ndt_3d::conversion::from(map, before);
+
+    map->insert(generateFloor(5.0, 7.0, 1000));
+    array_t::Ptr changed;
+    cslibs_ndt_3d::conversion::from(map, changed, map->fetchDirtyBlocks());
+
+    array_t::Ptr after;
+    cslibs_ndt_3d::conversion::from(map, after);
+    EXPECT_LT(changed->data.size(), after->data.size());
+
+    /// the incremental conversion contains every changed distribution and agrees with a full one
+    const auto d_before  = byId(*before);
+    const auto d_changed = byId(*changed);
+    for (const auto &d : byId(*after)) {
+        const auto c = d_changed.find(d.first);
+        if (c != d_changed.end()) {
+            EXPECT_EQ(c->second.prob.data, d.second.prob.data);
+            for (std::size_t i = 0 ; i < 3 ; ++ i)
+                EXPECT_EQ(c->second.mean[i].data, d.second.mean[i].data);
+            continue;
+        }
+        const auto b = d_before.find(d.first);
+        ASSERT_NE(b, d_before.end());
+        EXPECT_EQ(b->second.prob.data, d.second.prob.data);
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testReadOnlyConversion)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    const map_t::Ptr allocated(new map_t(map_t::pose_t(), RESOLUTION));
+    const cslibs_math_3d::Pointcloud3d::Ptr floor = generateFloor(0.0, 20.0, 40000);
+    map->insert(floor);
+    allocated->insert(floor);
+
+    std::size_t bundles = 0;
+    map->traverse([&bundles](const map_t::index_t &, const map_t::distribution_bundle_t &) { ++ bundles; });
+    const std::size_t bytes = map->getByteSize();
+
+    array_t::Ptr read_only;
+    cslibs_ndt_3d::conversion::from(map, read_only);
+    EXPECT_EQ(bytes, map->getByteSize());
+
+    /// the same distributions as after allocating the neighbourhoods
+    allocated->allocatePartiallyAllocatedBundles();
+    array_t::Ptr expected;
+    cslibs_ndt_3d::conversion::from(allocated, expected);
+
+    const auto d_read_only = byId(*read_only);
+    ASSERT_EQ(d_read_only.size(), expected->data.size());
+    for (const auto &d : byId(*expected)) {
+        const auto r = d_read_only.find(d.first);
+        ASSERT_NE(r, d_read_only.end());
+        EXPECT_EQ(r->second.prob.data, d.second.prob.data);
+        for (std::size_t i = 0 ; i < 3 ; ++ i)
+            EXPECT_EQ(r->second.mean[i].data, d.second.mean[i].data);
+    }
+
+    std::size_t allocated_bundles = 0;
+    allocated->traverse([&allocated_bundles](const map_t::index_t &, const map_t::distribution_bundle_t &) { ++ allocated_bundles; });
+    std::cout << "[read only] " << bundles << " bundles, " << bytes / 1024 << " KiB read only, "
+              << allocated_bundles << " bundles, " << allocated->getByteSize() / 1024 << " KiB allocated" << std::endl;
+}
+
+TEST(Test_cslibs_ndt_3d, testDirtyBlocksBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateFloor(0.0, 50.0, 250000));
+    map->fetchDirtyBlocks();
+
+    array_t::Ptr dst;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, dst);
+    const duration_t t_full = steady_clock_t::now() - start;
+    std::cout << "[dirty blocks] full conversion of " << dst->data.size() << " distributions "
+              << t_full.count() << " ms" << std::endl;
+
+    /// the cost of an update grows with the area it changed, not with the map
+    duration_t t_smallest(0.0);
+    for (const double size : {2.0, 4.0, 8.0, 16.0}) {
+        map->insert(generateFloor(20.0, 20.0 + size, static_cast<std::size_t>(100 * size * size)));
+
+        start = steady_clock_t::now();
+        cslibs_ndt_3d::conversion::from(map, dst, map->fetchDirtyBlocks());
+        const duration_t t_incremental = steady_clock_t::now() - start;
+        std::cout << "[dirty blocks] " << size << " x " << size << " m changed, "
+                  << dst->data.size() << " distributions " << t_incremental.count() << " ms" << std::endl;
+        if (size == 2.0)
+            t_smallest = t_incremental;
+    }
+    EXPECT_LT(t_smallest.count(), t_full.count());
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/distance_field.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t          = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using field_t        = cslibs_ndt_3d::voxel_grids::DistanceField;
+using index_t        = std::array<int, 3>;
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION          = 0.5;
+const double SAMPLING_RESOLUTION = 0.05;
+const double MAXIMUM_DISTANCE    = 0.5;
+
+/// a floor with a wall
+cslibs_math_3d::Pointcloud3d::Ptr generateRoom(const double size,
+                                               const std::size_t count)
+{
+    rng_t<1> rng(0.0, size);
+    rng_t<1> rng_z(-0.05, 0.05);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < count ; ++ i) {
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng_z.get() - 1.0));
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), size + rng_z.get(), 0.2 * rng.get() - 1.0));
+    }
+    return cloud;
+}
+
+/// truncated distance to the nearest of a set of obstacles
+double nearest(const std::vector<index_t> &obstacles,
+               const index_t &i,
+               const double resolution,
+               const double maximum_distance)
+{
+    int d = std::numeric_limits<int>::max();
+    for (const index_t &o : obstacles) {
+        const int dx = o[0] - i[0], dy = o[1] - i[1], dz = o[2] - i[2];
+        d = std::min(d, dx * dx + dy * dy + dz * dz);
+    }
+    return std::min(maximum_distance, std::sqrt(static_cast<double>(d)) * resolution);
+}
+
+/// compare all stored voxels and the ones around them to brute force
+void expectDistances(const field_t &field,
+                     const std::vector<index_t> &obstacles)
+{
+    const int s = field.getBlockSize();
+    std::size_t different = 0;
+    double max_error = 0.0;
+    field.getVoxels().traverse([&](const index_t &bi, const field_t::block_t &) {
+        for (int m = -1 ; m <= s ; ++ m)
+            for (int l = -1 ; l <= s ; ++ l)
+                for (int k = -1 ; k <= s ; ++ k) {
+                    const index_t i = {{bi[0] * s + k, bi[1] * s + l, bi[2] * s + m}};
+                    const double error = field.distance(i) - nearest(obstacles, i, field.getResolution(), field.getMaximumDistance());
+                    if (std::abs(error) > 1e-9)
+                        ++ different;
+                    max_error = std::max(max_error, std::abs(error));
+                }
+    });
+    /// the brushfire may miss the exact nearest obstacle by a fraction of a voxel
+    EXPECT_LT(different, 10ul);
+    EXPECT_LT(max_error, 0.5 * field.getResolution());
+}
+
+TEST(Test_cslibs_ndt_3d, testDistanceFieldBrushfire)
+{
+    field_t field(field_t::pose_t(), 0.1, 8, 1.0);
+    rng_t<1> rng(-20, 20);
+    std::vector<index_t> obstacles;
+    for (std::size_t i = 0 ; i < 100 ; ++ i) {
+        obstacles.push_back({{static_cast<int>(rng.get()), static_cast<int>(rng.get()), static_cast<int>(rng.get())}});
+        field.setObstacle(obstacles.back());
+    }
+    EXPECT_GT(field.update(), 0ul);
+    expectDistances(field, obstacles);
+    EXPECT_EQ(field.distance(obstacles.front()), 0.0);
+
+    /// remove half of them and add a few new ones
+    for (std::size_t i = 0 ; i < 50 ; ++ i)
+        field.removeObstacle(obstacles[i]);
+    obstacles.erase(obstacles.begin(), obstacles.begin() + 50);
+    for (std::size_t i = 0 ; i < 10 ; ++ i) {
+        obstacles.push_back({{static_cast<int>(rng.get()), static_cast<int>(rng.get()), static_cast<int>(rng.get())}});
+        field.setObstacle(obstacles.back());
+    }
+    field.update();
+    expectDistances(field, obstacles);
+
+    /// an empty field is at the maximum distance everywhere
+    for (const index_t &o : obstacles)
+        field.removeObstacle(o);
+    field.update();
+    EXPECT_EQ(field.distance(index_t{{0, 0, 0}}), 1.0);
+    std::size_t stored = 0;
+    field.getVoxels().traverse([&stored](const index_t &, const field_t::block_t &b) {
+        for (const field_t::Voxel &v : b)
+            stored += v.obstacle[0] != std::numeric_limits<int>::min() ? 1 : 0;
+    });
+    EXPECT_EQ(stored, 0ul);
+}
+
+TEST(Test_cslibs_ndt_3d, testDistanceFieldGradient)
+{
+    field_t field(field_t::pose_t(1.0, 2.0, 3.0, 0.3, 0.2, 0.1), 0.1, 8, 1.0);
+    field.setObstacle({{0, 0, 0}});
+    field.update();
+
+    const field_t::point_t o = field.getOrigin() * field_t::point_t(0.0, 0.0, 0.0);
+    const field_t::point_t p = field.getOrigin() * field_t::point_t(0.33, 0.21, -0.17);
+    EXPECT_NEAR(field.distance(p), cslibs_math_3d::Point3d(p - o).length(), 0.05);
+
+    /// the gradient points away from the obstacle and matches finite differences
+    field_t::point_t g;
+    field.distance(p, g);
+    EXPECT_GT(g.dot(p - o), 0.0);
+    const double h = 1e-4;
+    for (std::size_t d = 0 ; d < 3 ; ++ d) {
+        field_t::point_t e;
+        e(d) = h;
+        const double numeric = (field.distance(p + e) - field.distance(p - e)) / (2.0 * h);
+        EXPECT_NEAR(g(d), numeric, 1e-3);
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testDistanceFieldIncremental)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    map->insert(generateRoom(3.0, 3000), cslibs_math_3d::Transform3d(1.5, 1.5, 1.0));
+    map->fetchDirtyBlocks();
+
+    field_t::Ptr field;
+    cslibs_ndt_3d::conversion::from(map, field, SAMPLING_RESOLUTION, ivm, MAXIMUM_DISTANCE);
+    ASSERT_TRUE(field.get());
+    ASSERT_GT(field->getVoxels().getBlockCount(), 0ul);
+
+    map->insert(generateRoom(1.5, 2000), cslibs_math_3d::Transform3d(1.5, 1.5, 1.5));
+    cslibs_ndt_3d::conversion::from(map, field, map->fetchDirtyBlocks(), SAMPLING_RESOLUTION, ivm, MAXIMUM_DISTANCE);
+
+    field_t::Ptr reference;
+    cslibs_ndt_3d::conversion::from(map, reference, SAMPLING_RESOLUTION, ivm, MAXIMUM_DISTANCE);
+
+    /// same obstacles and distances as a full conversion
+    std::size_t obstacles = 0, different = 0;
+    const int s = reference->getBlockSize();
+    auto compare = [&](const field_t &a, const field_t &b) {
+        a.getVoxels().traverse([&](const index_t &bi, const field_t::block_t &) {
+            for (int m = 0 ; m < s ; ++ m)
+                for (int l = 0 ; l < s ; ++ l)
+                    for (int k = 0 ; k < s ; ++ k) {
+                        const index_t i = {{bi[0] * s + k, bi[1] * s + l, bi[2] * s + m}};
+                        EXPECT_EQ(a.isObstacle(i), b.isObstacle(i));
+                        obstacles += a.isObstacle(i) ? 1 : 0;
+                        if (std::abs(a.distance(i) - b.distance(i)) > 1e-9)
+                            ++ different;
+                    }
+        });
+    };
+    compare(*reference, *field);
+    compare(*field, *reference);
+    EXPECT_GT(obstacles, 0ul);
+    EXPECT_LT(different, obstacles / 100);
+}
+
+TEST(Test_cslibs_ndt_3d, testDistanceFieldBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    map->insert(generateRoom(10.0, 20000), cslibs_math_3d::Transform3d(5.0, 5.0, 1.0));
+    map->fetchDirtyBlocks();
+
+    field_t::Ptr field;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, field, SAMPLING_RESOLUTION, ivm, MAXIMUM_DISTANCE);
+    const duration_t t_full = steady_clock_t::now() - start;
+
+    map->insert(generateRoom(1.0, 1000), cslibs_math_3d::Transform3d(5.0, 5.0, 1.5));
+    const map_t::dirty_blocks_t dirty = map->fetchDirtyBlocks();
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, field, dirty, SAMPLING_RESOLUTION, ivm, MAXIMUM_DISTANCE);
+    const duration_t t_update = steady_clock_t::now() - start;
+
+    const std::size_t queries = 1000000;
+    rng_t<1> rng(0.0, 10.0);
+    std::vector<field_t::point_t> points;
+    for (std::size_t i = 0 ; i < queries ; ++ i)
+        points.emplace_back(rng.get(), rng.get(), 0.1 * rng.get() - 0.5);
+    double sum = 0.0;
+    field_t::point_t g;
+    start = steady_clock_t::now();
+    for (const field_t::point_t &p : points)
+        sum += field->distance(p, g);
+    const duration_t t_queries = steady_clock_t::now() - start;
+
+    std::cout << "[distance field] " << field->getVoxels().getBlockCount() << " blocks " << field->getByteSize() / 1024 << " KiB, "
+              << "full " << t_full.count() << " ms, update " << t_update.count() << " ms, "
+              << queries / t_queries.count() * 1e-3 << " M queries/s" << std::endl;
+    EXPECT_GT(sum, 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,21 @@
+#ifndef CSLIBS_NDT_3D_TEST_GENERATE_BOX_HPP
+#define CSLIBS_NDT_3D_TEST_GENERATE_BOX_HPP
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+
+/// points in a box
+inline cslibs_math_3d::Pointcloud3d::Ptr generateBox(const cslibs_math_3d::Point3d &min,
+                                                     const cslibs_math_3d::Point3d &max,
+                                                     const std::size_t size)
+{
+    using rng_t = cslibs_math::random::Uniform<1>;
+    rng_t rng_x(min(0), max(0)), rng_y(min(1), max(1)), rng_z(min(2), max(2));
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(rng_x.get(), rng_y.get(), rng_z.get()));
+    return cloud;
+}
+
+#endif // CSLIBS_NDT_3D_TEST_GENERATE_BOX_HPP
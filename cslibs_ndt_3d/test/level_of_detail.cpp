@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/level_of_detail.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include "generate_box.hpp"
+
+#include <unordered_set>
+#include <iostream>
+#include <chrono>
+
+using map_t          = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using lod_t          = cslibs_ndt_3d::conversion::LevelOfDetail;
+using array_t        = cslibs_ndt_3d::DistributionArray;
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION = 0.5;
+
+bool unique(const array_t &a)
+{
+    std::unordered_set<uint64_t> ids;
+    for (const auto &d : a.data)
+        if (!ids.insert(d.id.data).second)
+            return false;
+    return true;
+}
+
+TEST(Test_cslibs_ndt_3d, testLevelOfDetailMoments)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-4.0, -4.0, -1.0), cslibs_math_3d::Point3d(4.0, 4.0, 1.0), 20000));
+
+    lod_t lod;
+    lod.build(*map);
+    ASSERT_GT(lod.getLevels(), 1ul);
+
+    /// the coarsest level has the moments of all bundles together
+    cslibs_math::statistics::Distribution<3, 3> all;
+    map->traversePartiallyAllocatedBundles([&all](const map_t::index_t &, const map_t::distribution_const_bundle_t &b) {
+        cslibs_math::statistics::Distribution<3, 3> d;
+        double prob;
+        if (cslibs_ndt_3d::conversion::impl::combine(b, d, prob))
+            all += d;
+    });
+    const std::vector<lod_t::Node> &top = lod.getLevel(lod.getLevels() - 1);
+    double weight = 0.0;
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    for (const lod_t::Node &n : top) {
+        weight += n.weight;
+        mean   += n.weight * n.mean;
+    }
+    mean /= weight;
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+    for (const lod_t::Node &n : top)
+        covariance += n.weight * (n.covariance + (n.mean - mean) * (n.mean - mean).transpose());
+    covariance /= weight;
+    EXPECT_NEAR(weight, static_cast<double>(all.getN()), 1e-6);
+    EXPECT_LT((mean - all.getMean()).norm(), 1e-9);
+    /// the sample covariances of the bundles are merged as they are
+    EXPECT_LT((covariance - all.getCovariance()).norm(), 1e-3 * all.getCovariance().norm());
+
+    /// every level covers the same bundles and has the same weight
+    for (std::size_t l = 1 ; l < lod.getLevels() ; ++l) {
+        const std::vector<lod_t::Node> &level = lod.getLevel(l);
+        std::size_t children = 0;
+        double level_weight = 0.0;
+        for (const lod_t::Node &n : level) {
+            children     += n.end - n.begin;
+            level_weight += n.weight;
+            for (std::size_t i = n.begin ; i < n.end ; ++i)
+                EXPECT_LE((lod.getLevel(l - 1)[i].mean - n.mean).norm(), n.radius + 1e-9);
+        }
+        EXPECT_EQ(children, lod.getLevel(l - 1).size());
+        EXPECT_NEAR(level_weight, weight, 1e-6 * weight);
+        EXPECT_LT(level.size(), lod.getLevel(l - 1).size());
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testLevelOfDetailSelection)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-10.0, -10.0, -1.0), cslibs_math_3d::Point3d(10.0, 10.0, 1.0), 50000));
+
+    array_t::Ptr full;
+    cslibs_ndt_3d::conversion::from(map, full);
+    ASSERT_TRUE(full.get());
+
+    lod_t lod;
+    lod.build(*full);
+    const Eigen::Vector3d viewpoint(0.0, 0.0, 0.0);
+
+    /// everything close enough gives the distributions themselves
+    array_t selected;
+    EXPECT_EQ(lod.select(viewpoint, 100.0, 0.0, 0, selected), 0ul);
+    ASSERT_EQ(selected.data.size(), full->data.size());
+    std::unordered_set<uint64_t> ids;
+    for (const auto &d : full->data)
+        ids.insert(d.id.data);
+    for (const auto &d : selected.data)
+        EXPECT_EQ(ids.count(d.id.data), 1ul);
+
+    /// far away parts are coarser
+    array_t coarse;
+    lod.select(viewpoint, 2.0, 0.0, 0, coarse);
+    EXPECT_LT(coarse.data.size(), selected.data.size());
+    EXPECT_TRUE(unique(coarse));
+
+    /// a target count
+    array_t limited;
+    EXPECT_GT(lod.select(viewpoint, 2.0, 0.0, 200, limited), 0ul);
+    EXPECT_LE(limited.data.size(), 200ul);
+    EXPECT_GT(limited.data.size(), 0ul);
+    EXPECT_TRUE(unique(limited));
+    for (const auto &d : limited.data)
+        EXPECT_GE(d.eigen_values[0].data, 0.0);
+
+    /// far away parts are evicted
+    array_t evicted;
+    lod.select(viewpoint, 100.0, 3.0, 0, evicted);
+    EXPECT_GT(evicted.data.size(), 0ul);
+    EXPECT_LT(evicted.data.size(), full->data.size());
+    for (const auto &d : evicted.data)
+        EXPECT_LE(Eigen::Vector3d(d.mean[0].data, d.mean[1].data, d.mean[2].data).norm(), 3.0);
+
+    /// ids of a level and its bundles differ
+    for (std::size_t l = 0 ; l < lod.getLevels() ; ++l)
+        for (const lod_t::Node &n : lod.getLevel(l))
+            EXPECT_EQ(ids.count(n.id) == 1ul, l == 0);
+}
+
+TEST(Test_cslibs_ndt_3d, testLevelOfDetailBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-30.0, -30.0, -2.0), cslibs_math_3d::Point3d(30.0, 30.0, 2.0), 500000));
+
+    array_t::Ptr full;
+    cslibs_ndt_3d::conversion::from(map, full);
+
+    /// merging only, from the distributions as received by a display
+    lod_t lod;
+    auto start = steady_clock_t::now();
+    lod.build(*full);
+    const duration_t t_merge = steady_clock_t::now() - start;
+
+    const std::size_t n = lod.getLevel(0).size();
+    std::size_t merged = 0;
+    for (std::size_t l = 1 ; l < lod.getLevels() ; ++l)
+        merged += lod.getLevel(l).size();
+
+    array_t view, limited;
+    start = steady_clock_t::now();
+    lod.select(Eigen::Vector3d(0.0, 0.0, 10.0), 10.0, 60.0, 0, view);
+    const duration_t t_view = steady_clock_t::now() - start;
+    start = steady_clock_t::now();
+    const std::size_t bias = lod.select(Eigen::Vector3d(0.0, 0.0, 10.0), 10.0, 0.0, 10000, limited);
+    const duration_t t_limited = steady_clock_t::now() - start;
+
+    std::cout << "[level of detail] " << n << " distributions, " << lod.getLevels() << " levels with "
+              << merged << " merged nodes, merge " << t_merge.count() << " ms" << std::endl;
+    std::cout << "[level of detail] view " << view.data.size() << " distributions, reduction "
+              << static_cast<double>(n) / view.data.size() << ", " << t_view.count() << " ms" << std::endl;
+    std::cout << "[level of detail] limited " << limited.data.size() << " distributions at offset " << bias << ", reduction "
+              << static_cast<double>(n) / limited.data.size() << ", " << t_limited.count() << " ms" << std::endl;
+    EXPECT_LE(limited.data.size(), 10000ul);
+    EXPECT_LT(view.data.size(), n);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/mesh.hpp>
+#include <cslibs_ndt_3d/serialization/meshes/mesh.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <map>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t           = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using block_grid_t    = cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>;
+using mesh_t          = cslibs_ndt_3d::meshes::Mesh;
+using index_t         = std::array<int, 3>;
+using steady_clock_t  = std::chrono::steady_clock;
+using duration_t      = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION          = 0.5;
+const double SAMPLING_RESOLUTION = 0.05;
+
+/// points on an axis aligned rectangle
+void generatePlane(const cslibs_math_3d::Point3d &min,
+                   const cslibs_math_3d::Point3d &max,
+                   const std::size_t size,
+                   cslibs_math_3d::Pointcloud3d::Ptr &cloud)
+{
+    rng_t<1> rng_x(min(0), max(0)), rng_y(min(1), max(1)), rng_z(min(2), max(2));
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(rng_x.get(), rng_y.get(), rng_z.get()));
+}
+
+/// every directed edge once and the opposite one once
+bool closed(const mesh_t &mesh)
+{
+    std::map<std::pair<uint32_t, uint32_t>, int> edges;
+    for (std::size_t i = 0 ; i < mesh.indices.size() ; i += 3)
+        for (std::size_t j = 0 ; j < 3 ; ++ j)
+            ++edges[std::make_pair(mesh.indices[i + j], mesh.indices[i + (j + 1) % 3])];
+    for (const auto &e : edges) {
+        const auto o = edges.find(std::make_pair(e.first.second, e.first.first));
+        if (e.second != 1 || o == edges.end() || o->second != 1)
+            return false;
+    }
+    return true;
+}
+
+/// signed volume of a closed mesh, positive if it is oriented outwards
+double volume(const mesh_t &mesh)
+{
+    double v = 0.0;
+    for (std::size_t i = 0 ; i < mesh.indices.size() ; i += 3) {
+        const mesh_t::vertex_t &a = mesh.vertices[mesh.indices[i]];
+        const mesh_t::vertex_t &b = mesh.vertices[mesh.indices[i + 1]];
+        const mesh_t::vertex_t &c = mesh.vertices[mesh.indices[i + 2]];
+        v += (a[0] * (b[1] * c[2] - b[2] * c[1]) -
+              a[1] * (b[0] * c[2] - b[2] * c[0]) +
+              a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0;
+    }
+    return v;
+}
+
+TEST(Test_cslibs_ndt_3d, testMarchingCubesTable)
+{
+    namespace impl = cslibs_ndt_3d::meshes::impl;
+    const std::array<impl::Edge, 12> &es = impl::edges();
+
+    EXPECT_TRUE(impl::triangles(0).empty());
+    EXPECT_TRUE(impl::triangles(255).empty());
+    for (int configuration = 0 ; configuration < 256 ; ++ configuration) {
+        /// exactly the edges between inside and outside corners carry vertices
+        std::array<int, 12> used;
+        used.fill(0);
+        for (const impl::triangle_t &t : impl::triangles(configuration))
+            for (const uint8_t e : t)
+                ++ used[e];
+        for (int e = 0 ; e < 12 ; ++ e) {
+            const int a = es[e].corner;
+            const int b = a | (1 << es[e].axis);
+            const bool crossed = ((configuration >> a) & 1) != ((configuration >> b) & 1);
+            EXPECT_EQ(used[e] > 0, crossed);
+        }
+        EXPECT_LE(impl::triangles(configuration).size(), 12ul);
+
+        /// diagonals, which belong to two triangles, do not lie on a face
+        std::map<std::pair<int, int>, int> pairs;
+        for (const impl::triangle_t &t : impl::triangles(configuration))
+            for (std::size_t j = 0 ; j < 3 ; ++ j)
+                ++ pairs[std::make_pair(std::min(t[j], t[(j + 1) % 3]), std::max(t[j], t[(j + 1) % 3]))];
+        for (const auto &p : pairs)
+            EXPECT_EQ(p.second == 2, !impl::coplanar(p.first.first, p.first.second));
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testMarchingCubesSphere)
+{
+    /// a Gaussian crosses 0.5 on a sphere
+    const double sigma  = 0.5;
+    const double radius = sigma * std::sqrt(2.0 * std::log(2.0));
+    const cslibs_math_3d::Point3d centre(0.37, 0.21, -0.13);
+
+    block_grid_t grid(block_grid_t::pose_t(), 0.1, 8, 0.0);
+    for (int z = -15 ; z < 15 ; ++ z) {
+        for (int y = -15 ; y < 15 ; ++ y) {
+            for (int x = -15 ; x < 15 ; ++ x) {
+                const index_t i = {{x, y, z}};
+                const double d = (grid.toPoint(i) - centre).length();
+                grid.get(i) = std::exp(-0.5 * d * d / (sigma * sigma));
+            }
+        }
+    }
+
+    mesh_t mesh;
+    cslibs_ndt_3d::meshes::extract(grid, 0.5, mesh);
+    ASSERT_GT(mesh.getTriangleCount(), 0ul);
+    EXPECT_TRUE(closed(mesh));
+    /// the vertices lie on the sphere, the volume in between is missing
+    const double sphere = 4.0 / 3.0 * M_PI * radius * radius * radius;
+    EXPECT_LT(volume(mesh), sphere);
+    EXPECT_GT(volume(mesh), 0.97 * sphere);
+    for (const mesh_t::vertex_t &v : mesh.vertices)
+        EXPECT_NEAR((cslibs_math_3d::Point3d(v[0], v[1], v[2]) - centre).length(), radius, 0.01);
+
+    /// the same with one thread
+    mesh_t sequential;
+    cslibs_ndt_3d::meshes::extract(grid, 0.5, sequential, 1);
+    EXPECT_TRUE(sequential.vertices == mesh.vertices);
+    EXPECT_TRUE(sequential.indices  == mesh.indices);
+}
+
+TEST(Test_cslibs_ndt_3d, testMarchingCubesMaps)
+{
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    generatePlane(cslibs_math_3d::Point3d(0.0, 0.0, -0.1), cslibs_math_3d::Point3d(4.0, 4.0, 0.1), 20000, cloud);
+    generatePlane(cslibs_math_3d::Point3d(0.0, 3.9, 0.0), cslibs_math_3d::Point3d(4.0, 4.1, 2.0), 10000, cloud);
+
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(cloud);
+    mesh_t::Ptr mesh;
+    cslibs_ndt_3d::conversion::from(map, mesh, SAMPLING_RESOLUTION, 0.2);
+    ASSERT_TRUE(mesh.get());
+    EXPECT_GT(mesh->getTriangleCount(), 0ul);
+    EXPECT_TRUE(closed(*mesh));
+    EXPECT_GT(volume(*mesh), 0.0);
+
+    const occupancy_map_t::Ptr occupancy_map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    occupancy_map->insert(cloud, occupancy_map_t::pose_t(2.0, 2.0, 1.0));
+    mesh_t::Ptr occupancy_mesh;
+    cslibs_ndt_3d::conversion::from(occupancy_map, occupancy_mesh, SAMPLING_RESOLUTION, 0.1, ivm, 0.169);
+    ASSERT_TRUE(occupancy_mesh.get());
+    EXPECT_GT(occupancy_mesh->getTriangleCount(), 0ul);
+    EXPECT_TRUE(closed(*occupancy_mesh));
+
+    /// header, 3 floats per vertex and a count with 3 ints per triangle
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%.ply");
+    ASSERT_TRUE(cslibs_ndt_3d::meshes::savePly(mesh, path.string()));
+    std::ifstream in(path.string(), std::ios::binary);
+    std::string line, header;
+    while (std::getline(in, line) && line != "end_header")
+        header += line + "\n";
+    header += "end_header\n";
+    EXPECT_EQ(boost::filesystem::file_size(path),
+              header.size() + 12 * mesh->vertices.size() + 13 * mesh->getTriangleCount());
+    boost::filesystem::remove(path);
+}
+
+TEST(Test_cslibs_ndt_3d, testMarchingCubesBenchmark)
+{
+    /// two floors of 40 m x 20 m with outer and inner walls
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (int f = 0 ; f < 2 ; ++ f) {
+        const double z = 3.0 * f;
+        generatePlane(cslibs_math_3d::Point3d(0.0, 0.0, z - 0.05), cslibs_math_3d::Point3d(40.0, 20.0, z + 0.05), 200000, cloud);
+        generatePlane(cslibs_math_3d::Point3d(0.0, -0.05, z), cslibs_math_3d::Point3d(40.0, 0.05, z + 3.0), 30000, cloud);
+        generatePlane(cslibs_math_3d::Point3d(0.0, 19.95, z), cslibs_math_3d::Point3d(40.0, 20.05, z + 3.0), 30000, cloud);
+        for (int w = 0 ; w <= 4 ; ++ w)
+            generatePlane(cslibs_math_3d::Point3d(10.0 * w - 0.05, 0.0, z), cslibs_math_3d::Point3d(10.0 * w + 0.05, 20.0, z + 3.0), 15000, cloud);
+    }
+
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(cloud);
+
+    auto start = steady_clock_t::now();
+    block_grid_t::Ptr grid;
+    cslibs_ndt_3d::conversion::from(map, grid, SAMPLING_RESOLUTION);
+    const duration_t t_sample = steady_clock_t::now() - start;
+
+    mesh_t mesh;
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::meshes::extract(*grid, 0.2, mesh);
+    const duration_t t_extract = steady_clock_t::now() - start;
+
+    const double voxels = static_cast<double>(grid->getBlockCount()) * std::pow(grid->getBlockSize(), 3);
+    std::cout << "[marching cubes] " << grid->getBlockCount() << " blocks, sampling " << t_sample.count() << " ms, "
+              << "extraction " << t_extract.count() << " ms, " << voxels / t_extract.count() * 1e-3 << " M voxels/s, "
+              << mesh.getTriangleCount() << " triangles, " << mesh.vertices.size() << " vertices, "
+              << mesh.getByteSize() / (1024 * 1024) << " MiB" << std::endl;
+    EXPECT_TRUE(closed(mesh));
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
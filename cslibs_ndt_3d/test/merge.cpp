@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t           = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION = 0.5;
+
+cslibs_math_3d::Pointcloud3d::Ptr generateCloud(const std::size_t size)
+{
+    rng_t<1> rng(-5.0, 5.0);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng.get()));
+    return cloud;
+}
+
+std::size_t numPoints(const map_t &map)
+{
+    std::size_t n = 0;
+    map.getStorages()[0]->traverse([&n](const map_t::index_t &, const map_t::distribution_t &d) {
+        n += d.data().getN();
+    });
+    return n;
+}
+
+void testEqual(const map_t &expected,
+               const map_t &map)
+{
+    expected.traverse([&map](const map_t::index_t &bi, const map_t::distribution_bundle_t &b) {
+        const map_t::distribution_bundle_t *bm = map.getDistributionBundle(bi);
+        ASSERT_NE(bm, nullptr);
+        for (std::size_t i = 0 ; i < 8 ; ++ i) {
+            EXPECT_EQ(b.at(i)->data().getN(), bm->at(i)->data().getN());
+            if (b.at(i)->data().getN() > 0)
+                EXPECT_NEAR((b.at(i)->data().getMean() - bm->at(i)->data().getMean()).norm(), 0.0, 1e-9);
+        }
+    });
+}
+
+TEST(Test_cslibs_ndt_3d, testMergeAligned)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr a = generateCloud(10000);
+    const cslibs_math_3d::Pointcloud3d::Ptr b = generateCloud(10000);
+    const map_t::pose_t origin(0.3, 0.1, -0.2, 0.0, 0.0, 0.4);
+
+    map_t expected(origin, RESOLUTION);
+    expected.insert(a);
+    expected.insert(b);
+
+    /// same grid
+    map_t map(origin, RESOLUTION);
+    map_t other(origin, RESOLUTION);
+    map.insert(a);
+    other.insert(b);
+    map.merge(other);
+    testEqual(expected, map);
+
+    /// grids offset by whole cells
+    map_t shifted_map(origin, RESOLUTION);
+    map_t shifted(origin * map_t::pose_t(1.0, -0.5, 1.5), RESOLUTION);
+    shifted_map.insert(a);
+    shifted.insert(b);
+    shifted_map.merge(shifted);
+    testEqual(expected, shifted_map);
+}
+
+TEST(Test_cslibs_ndt_3d, testMergeTransformed)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr a = generateCloud(10000);
+    const cslibs_math_3d::Pointcloud3d::Ptr b = generateCloud(10000);
+    const map_t::pose_t      origin(0.3, 0.1, -0.2, 0.0, 0.0, 0.4);
+    const map_t::transform_t transform(0.2, 0.1, 0.0, 0.0, 0.0, 0.3);
+
+    map_t expected(origin, RESOLUTION);
+    expected.insert(a);
+    expected.insert(b, transform);
+
+    /// re-binned, every point is kept but may end up in a neighbouring cell
+    map_t map(origin, RESOLUTION);
+    map_t other(map_t::pose_t(), RESOLUTION);
+    map.insert(a);
+    other.insert(b);
+    map.merge(other, transform);
+    EXPECT_EQ(numPoints(expected), numPoints(map));
+
+    std::size_t bundles = 0;
+    std::size_t found   = 0;
+    expected.traverse([&map, &bundles, &found](const map_t::index_t &bi, const map_t::distribution_bundle_t &) {
+        ++ bundles;
+        if (map.getDistributionBundle(bi))
+            ++ found;
+    });
+    EXPECT_GE(found, bundles * 9 / 10);
+}
+
+TEST(Test_cslibs_ndt_3d, testMergeOccupancy)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr a = generateCloud(2000);
+    const cslibs_math_3d::Pointcloud3d::Ptr b = generateCloud(2000);
+    const occupancy_map_t::pose_t origin(0.3, 0.1, -0.2, 0.0, 0.0, 0.4);
+    const occupancy_map_t::pose_t sensor(0.5, 0.5, 0.5, 0.0, 0.0, 0.0);
+
+    occupancy_map_t expected(origin, RESOLUTION);
+    expected.insert(a, sensor);
+    expected.insert(b, sensor);
+
+    occupancy_map_t map(origin, RESOLUTION);
+    occupancy_map_t other(origin * occupancy_map_t::pose_t(-2.0, 1.0, 0.5), RESOLUTION);
+    map.insert(a, sensor);
+    other.insert(b, sensor);
+    map.merge(other);
+
+    expected.traverse([&map](const occupancy_map_t::index_t &bi, const occupancy_map_t::distribution_bundle_t &b) {
+        const occupancy_map_t::distribution_bundle_t *bm = map.getDistributionBundle(bi);
+        ASSERT_NE(bm, nullptr);
+        for (std::size_t i = 0 ; i < 8 ; ++ i) {
+            EXPECT_EQ(b.at(i)->numFree(),     bm->at(i)->numFree());
+            EXPECT_EQ(b.at(i)->numOccupied(), bm->at(i)->numOccupied());
+        }
+    });
+}
+
+TEST(Test_cslibs_ndt_3d, testMergeCost)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateCloud(1000000);
+    const map_t::transform_t transform(0.2, 0.1, 0.0, 0.0, 0.0, 0.3);
+
+    map_t map(map_t::pose_t(), RESOLUTION);
+    map_t other(map_t::pose_t(), RESOLUTION);
+    map.insertParallel(cloud);
+    other.insertParallel(cloud);
+
+    auto start = steady_clock_t::now();
+    map.insertParallel(cloud);
+    const duration_t t_insert = steady_clock_t::now() - start;
+
+    start = steady_clock_t::now();
+    map.merge(other);
+    const duration_t t_aligned = steady_clock_t::now() - start;
+
+    start = steady_clock_t::now();
+    map.merge(other, transform);
+    const duration_t t_rebinned = steady_clock_t::now() - start;
+
+    std::cout << "[merge] " << other.getByteSize() << " bytes: re-insertion " << t_insert.count()
+              << " ms, aligned " << t_aligned.count() << " ms, re-binned " << t_rebinned.count() << " ms" << std::endl;
+    EXPECT_EQ(numPoints(map), 4 * cloud->size());
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
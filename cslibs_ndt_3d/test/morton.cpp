@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/common/morton.hpp>
+#include <cslibs_ndt/common/morton_storage.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <set>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using index_2d_t = std::array<int, 2>;
+using index_3d_t = std::array<int, 3>;
+using map_t      = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using ordered_t  = cslibs_ndt_3d::dynamic_maps::OrderedGridmap;
+using array_t    = cslibs_ndt_3d::DistributionArray;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+TEST(Test_cslibs_ndt_3d, testMortonSpread)
+{
+    using cslibs_ndt::morton::spread2;
+    using cslibs_ndt::morton::spread3;
+
+    EXPECT_EQ(spread2(0x0ull), 0x0ull);
+    EXPECT_EQ(spread2(0x1ull), 0x1ull);
+    EXPECT_EQ(spread2(0xbull), 0x45ull);                        /// 1011 -> 1000101
+    EXPECT_EQ(spread2(0xffffffffull), 0x5555555555555555ull);
+    EXPECT_EQ(spread2(0x80000000ull), 0x4000000000000000ull);
+    EXPECT_EQ(spread2(0x100000000ull), 0x0ull);                 /// only the lower 32 bits
+
+    EXPECT_EQ(spread3(0x0ull), 0x0ull);
+    EXPECT_EQ(spread3(0x1ull), 0x1ull);
+    EXPECT_EQ(spread3(0x5ull), 0x41ull);                        /// 101 -> 1000001
+    EXPECT_EQ(spread3(0x1fffffull), 0x1249249249249249ull);
+    EXPECT_EQ(spread3(0x100000ull), 0x1000000000000000ull);
+    EXPECT_EQ(spread3(0x200000ull), 0x0ull);                    /// only the lower 21 bits
+
+    /// bit i moves to Dim * i
+    for (uint64_t i = 0 ; i < 32 ; ++i)
+        EXPECT_EQ(spread2(1ull << i), 1ull << (2 * i));
+    for (uint64_t i = 0 ; i < 21 ; ++i)
+        EXPECT_EQ(spread3(1ull << i), 1ull << (3 * i));
+}
+
+TEST(Test_cslibs_ndt_3d, testMortonEncode)
+{
+    using cslibs_ndt::morton::encode;
+
+    const index_2d_t o2 = {{0, 0}};
+    EXPECT_EQ(encode(index_2d_t{{0, 0}}, o2), 0ull);
+    EXPECT_EQ(encode(index_2d_t{{1, 0}}, o2), 1ull);
+    EXPECT_EQ(encode(index_2d_t{{0, 1}}, o2), 2ull);
+    EXPECT_EQ(encode(index_2d_t{{1, 1}}, o2), 3ull);
+    EXPECT_EQ(encode(index_2d_t{{2, 0}}, o2), 4ull);
+    EXPECT_EQ(encode(index_2d_t{{3, 3}}, o2), 15ull);
+
+    const index_3d_t o3 = {{0, 0, 0}};
+    EXPECT_EQ(encode(index_3d_t{{1, 0, 0}}, o3), 1ull);
+    EXPECT_EQ(encode(index_3d_t{{0, 1, 0}}, o3), 2ull);
+    EXPECT_EQ(encode(index_3d_t{{0, 0, 1}}, o3), 4ull);
+    EXPECT_EQ(encode(index_3d_t{{1, 1, 1}}, o3), 7ull);
+    EXPECT_EQ(encode(index_3d_t{{2, 0, 0}}, o3), 8ull);
+    EXPECT_EQ(encode(index_3d_t{{3, 3, 3}}, o3), 63ull);
+
+    /// codes are relative to the offset
+    EXPECT_EQ(encode(index_2d_t{{-3, 5}}, index_2d_t{{-4, 4}}), 3ull);
+    EXPECT_EQ(encode(index_3d_t{{-7, 0, 12}}, index_3d_t{{-8, -1, 11}}), 7ull);
+
+    /// a cube of 2^k per axis maps onto the codes 0 .. 2^(3k) - 1
+    std::set<uint64_t> codes;
+    for (int i = 0 ; i < 8 ; ++i)
+        for (int j = 0 ; j < 8 ; ++j)
+            for (int k = 0 ; k < 8 ; ++k)
+                codes.insert(encode(index_3d_t{{i - 4, j + 2, k - 1}}, index_3d_t{{-4, 2, -1}}));
+    ASSERT_EQ(codes.size(), 512ul);
+    EXPECT_EQ(*codes.begin(),  0ull);
+    EXPECT_EQ(*codes.rbegin(), 511ull);
+}
+
+TEST(Test_cslibs_ndt_3d, testMortonOrder)
+{
+    std::vector<index_3d_t> indices;
+    for (int i = 0 ; i < 4 ; ++i)
+        for (int j = 0 ; j < 4 ; ++j)
+            for (int k = 0 ; k < 4 ; ++k)
+                indices.push_back({{i, j, k}});
+    std::reverse(indices.begin(), indices.end());
+    std::swap(indices[3], indices[40]);
+
+    std::vector<int> values(indices.size(), 0);
+    cslibs_ndt::morton::Order<index_3d_t, const int> order(index_3d_t{{0, 0, 0}}, indices.size());
+    for (std::size_t i = 0 ; i < indices.size() ; ++i)
+        order.add(indices[i], &values[i]);
+    EXPECT_EQ(order.size(), indices.size());
+
+    std::vector<index_3d_t> visited;
+    order.traverse([&visited](const index_3d_t &bi, const int &) {
+        visited.push_back(bi);
+    });
+    ASSERT_EQ(visited.size(), indices.size());
+
+    /// every aligned block of 2 x 2 x 2 is visited consecutively, x fastest
+    for (std::size_t b = 0 ; b < visited.size() ; b += 8) {
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            const index_3d_t &bi = visited[b + i];
+            EXPECT_EQ(bi[0] % 2, static_cast<int>(i & 1ul));
+            EXPECT_EQ(bi[1] % 2, static_cast<int>((i >> 1) & 1ul));
+            EXPECT_EQ(bi[2] % 2, static_cast<int>((i >> 2) & 1ul));
+            EXPECT_EQ(bi[0] / 2, visited[b][0] / 2);
+            EXPECT_EQ(bi[1] / 2, visited[b][1] / 2);
+            EXPECT_EQ(bi[2] / 2, visited[b][2] / 2);
+        }
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testTraverseOrdered)
+{
+    rng_t<1> rng(-5.0, 5.0);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < 5000 ; ++i)
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng.get()));
+
+    map_t map(map_t::pose_t(), 1.0);
+    map.insert(cloud);
+
+    /// bounds are the component-wise extremes, so they are valid Z-order offsets
+    const index_3d_t min_bi = map.getMinBundleIndex();
+    const index_3d_t max_bi = map.getMaxBundleIndex();
+    std::vector<index_3d_t> expected;
+    map.traverse([&expected, &min_bi, &max_bi](const index_3d_t &bi, const map_t::distribution_bundle_t &) {
+        expected.push_back(bi);
+        for (std::size_t d = 0 ; d < 3 ; ++d) {
+            EXPECT_GE(bi[d], min_bi[d]);
+            EXPECT_LE(bi[d], max_bi[d]);
+        }
+    });
+
+    std::vector<index_3d_t> visited;
+    uint64_t last = 0;
+    map.traverseOrdered([&visited, &last, &min_bi](const index_3d_t &bi, const map_t::distribution_bundle_t &) {
+        const uint64_t code = cslibs_ndt::morton::encode(bi, min_bi);
+        if (!visited.empty())
+            EXPECT_LT(last, code);
+        last = code;
+        visited.push_back(bi);
+    });
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(visited.begin(), visited.end());
+    EXPECT_TRUE(expected == visited);
+}
+
+TEST(Test_cslibs_ndt_3d, testMortonStorage)
+{
+    using storage_t = cslibs_ndt::MortonStorage<int, index_3d_t>;
+
+    /// negative indices and several blocks
+    storage_t storage;
+    rng_t<1> rng(-40.0, 40.0);
+    std::set<index_3d_t> inserted;
+    for (std::size_t n = 0 ; n < 2000 ; ++n) {
+        const index_3d_t i = {{static_cast<int>(std::floor(rng.get())),
+                               static_cast<int>(std::floor(rng.get())),
+                               static_cast<int>(std::floor(rng.get()))}};
+        inserted.insert(i);
+        storage.insert(i, i[0] + 100 * i[1] + 10000 * i[2]);
+    }
+    EXPECT_EQ(storage.size(), inserted.size());
+    for (const index_3d_t &i : inserted) {
+        const int *v = storage.get(i);
+        ASSERT_NE(v, nullptr);
+        EXPECT_EQ(*v, i[0] + 100 * i[1] + 10000 * i[2]);
+    }
+    EXPECT_EQ(storage.get(index_3d_t{{100, 100, 100}}), nullptr);
+
+    /// pointers stay valid while the storage grows
+    const int *first = storage.get(*inserted.begin());
+    storage.insert(index_3d_t{{1000, -1000, 1000}}, 0);
+    EXPECT_EQ(storage.get(*inserted.begin()), first);
+
+    /// copies are deep
+    storage_t copy(storage);
+    *copy.get(*inserted.begin()) = -1;
+    EXPECT_NE(*storage.get(*inserted.begin()), -1);
+
+    /// the elements of a box are visited in Z-order, across blocks
+    const index_3d_t lo = {{0, 0, 0}};
+    const index_3d_t hi = {{15, 15, 15}};
+    std::vector<index_3d_t> visited;
+    storage.traverse(lo, hi, [&visited](const index_3d_t &i, const int &) {
+        visited.push_back(i);
+    });
+    std::size_t expected = 0;
+    for (const index_3d_t &i : inserted)
+        expected += cslibs_ndt::box::contains(i, lo, hi) ? 1 : 0;
+    ASSERT_EQ(visited.size(), expected);
+    for (std::size_t i = 1 ; i < visited.size() ; ++i)
+        EXPECT_LT(cslibs_ndt::morton::encode(visited[i - 1], lo), cslibs_ndt::morton::encode(visited[i], lo));
+
+    std::size_t all = 0;
+    storage.traverse([&all](const index_3d_t &, const int &) {
+        ++ all;
+    });
+    EXPECT_EQ(all, storage.size());
+}
+
+TEST(Test_cslibs_ndt_3d, testTraverseOrderedStorage)
+{
+    rng_t<1> rng(-5.0, 5.0);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < 5000 ; ++i)
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng.get()));
+
+    map_t     map(map_t::pose_t(), 1.0);
+    ordered_t ordered(ordered_t::pose_t(), 1.0);
+    map.insert(cloud);
+    ordered.insert(cloud);
+
+    /// the Morton backend holds the same bundles and moments
+    std::vector<index_3d_t> expected, visited;
+    map.traverseOrdered([&expected](const index_3d_t &bi, const map_t::distribution_bundle_t &) {
+        expected.push_back(bi);
+    });
+    ordered.traverseOrdered([&visited, &map](const index_3d_t &bi, const ordered_t::distribution_bundle_t &b) {
+        visited.push_back(bi);
+        const map_t::distribution_bundle_t *other = map.getDistributionBundle(bi);
+        ASSERT_NE(other, nullptr);
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            EXPECT_EQ(b.at(i)->data().getN(), other->at(i)->data().getN());
+            EXPECT_NEAR((b.at(i)->data().getMean() - other->at(i)->data().getMean()).norm(), 0.0, 1e-9);
+        }
+    });
+    EXPECT_EQ(ordered.getMinBundleIndex(), map.getMinBundleIndex());
+    EXPECT_EQ(ordered.getMaxBundleIndex(), map.getMaxBundleIndex());
+
+    /// the storage orders relative to a fixed offset, with all bundle blocks
+    /// within 16 blocks of the origin an offset of -16 blocks gives the same order
+    const index_3d_t offset = {{-64, -64, -64}};
+    for (std::size_t i = 1 ; i < visited.size() ; ++i)
+        EXPECT_LT(cslibs_ndt::morton::encode(visited[i - 1], offset), cslibs_ndt::morton::encode(visited[i], offset));
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(visited.begin(), visited.end());
+    EXPECT_TRUE(expected == visited);
+
+    /// box traversals agree
+    const index_3d_t lo = {{-3, -2, -4}};
+    const index_3d_t hi = {{2, 4, 1}};
+    std::vector<index_3d_t> box_expected, box_visited;
+    map.traverse(lo, hi, [&box_expected](const index_3d_t &bi, const map_t::distribution_bundle_t &) {
+        box_expected.push_back(bi);
+    });
+    ordered.traverse(lo, hi, [&box_visited](const index_3d_t &bi, const ordered_t::distribution_bundle_t &) {
+        box_visited.push_back(bi);
+    });
+    std::sort(box_expected.begin(), box_expected.end());
+    std::sort(box_visited.begin(), box_visited.end());
+    EXPECT_TRUE(box_expected == box_visited);
+
+    /// and so do the conversions
+    const map_t::Ptr     map_ptr(new map_t(map));
+    const ordered_t::Ptr ordered_ptr(new ordered_t(ordered));
+    array_t::Ptr a, b;
+    cslibs_ndt_3d::conversion::from(map_ptr, a);
+    cslibs_ndt_3d::conversion::from(ordered_ptr, b);
+    ASSERT_EQ(a->data.size(), b->data.size());
+    std::set<uint64_t> ids_a, ids_b;
+    for (std::size_t i = 0 ; i < a->data.size() ; ++i) {
+        ids_a.insert(a->data[i].id.data);
+        ids_b.insert(b->data[i].id.data);
+    }
+    EXPECT_TRUE(ids_a == ids_b);
+}
+
+template <typename gridmap_t>
+void benchmark(const cslibs_math_3d::Pointcloud3d::Ptr &cloud,
+               const std::string                       &name,
+               std::size_t                             &samples,
+               std::size_t                             &converted)
+{
+    const typename gridmap_t::Ptr map(new gridmap_t(typename gridmap_t::pose_t(), 0.5));
+    map->insert(cloud);
+
+    samples = 0;
+    auto start = steady_clock_t::now();
+    map->traverse([&samples](const index_3d_t &, const typename gridmap_t::distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            samples += b.at(i)->data().getN();
+    });
+    const duration_t t_traverse = steady_clock_t::now() - start;
+
+    std::size_t ordered_samples = 0;
+    start = steady_clock_t::now();
+    map->traverseOrdered([&ordered_samples](const index_3d_t &, const typename gridmap_t::distribution_bundle_t &b) {
+        for (std::size_t i = 0 ; i < 8 ; ++i)
+            ordered_samples += b.at(i)->data().getN();
+    });
+    const duration_t t_ordered = steady_clock_t::now() - start;
+    EXPECT_EQ(ordered_samples, samples);
+
+    array_t::Ptr dst;
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, dst);
+    const duration_t t_convert = steady_clock_t::now() - start;
+    converted = dst->data.size();
+
+    std::cout << "[morton] " << name << ": traverse " << t_traverse.count() << " ms, "
+              << "ordered traverse " << t_ordered.count() << " ms, "
+              << "conversion of " << converted << " distributions " << t_convert.count() << " ms, "
+              << map->getByteSize() / 1024 << " KiB" << std::endl;
+}
+
+TEST(Test_cslibs_ndt_3d, testMortonBenchmark)
+{
+    rng_t<1> rng(0.0, 40.0);
+    rng_t<1> rng_noise(-0.05, 0.05);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < 1000000 ; ++i) {
+        /// floor and walls of a grid of rooms
+        const double a = rng.get();
+        const double b = rng.get();
+        switch (i % 3) {
+        case 0: cloud->insert(cslibs_math_3d::Point3d(a, b, rng_noise.get()));                                    break;
+        case 1: cloud->insert(cslibs_math_3d::Point3d(std::floor(a / 5.0) * 5.0 + rng_noise.get(), b, 0.1 * a)); break;
+        case 2: cloud->insert(cslibs_math_3d::Point3d(a, std::floor(b / 5.0) * 5.0 + rng_noise.get(), 0.1 * b)); break;
+        }
+    }
+
+    std::size_t samples_kd = 0, samples_morton = 0, converted_kd = 0, converted_morton = 0;
+    benchmark<map_t>(cloud, "kd-tree", samples_kd, converted_kd);
+    benchmark<ordered_t>(cloud, "morton ", samples_morton, converted_morton);
+    EXPECT_EQ(samples_kd, samples_morton);
+    EXPECT_EQ(converted_kd, converted_morton);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/packed_distributions.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include "generate_box.hpp"
+
+#include <ros/serialization.h>
+
+#include <iostream>
+#include <chrono>
+
+using map_t          = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using array_t        = cslibs_ndt_3d::DistributionArray;
+using packed_t       = cslibs_ndt_3d::PackedDistributionArray;
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION = 0.5;
+
+/// relative to the magnitude of the values, which are stored as float
+void expectNear(const double a, const double b)
+{
+    EXPECT_NEAR(a, b, 1e-5 * std::max(1.0, std::abs(b)));
+}
+
+/// milliseconds to serialise and deserialise a message
+template <typename msg_t>
+void roundTrip(const msg_t &msg,
+               double &t_serialize,
+               double &t_deserialize,
+               std::size_t &length)
+{
+    namespace ser = ros::serialization;
+    length = ser::serializationLength(msg);
+    std::vector<uint8_t> buffer(length);
+
+    auto start = steady_clock_t::now();
+    ser::OStream out(buffer.data(), static_cast<uint32_t>(length));
+    ser::serialize(out, msg);
+    t_serialize = duration_t(steady_clock_t::now() - start).count();
+
+    msg_t copy;
+    start = steady_clock_t::now();
+    ser::IStream in(buffer.data(), static_cast<uint32_t>(length));
+    ser::deserialize(in, copy);
+    t_deserialize = duration_t(steady_clock_t::now() - start).count();
+}
+
+TEST(Test_cslibs_ndt_3d, testPackedDistributions)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-3.0, -3.0, -1.0), cslibs_math_3d::Point3d(3.0, 3.0, 1.0), 20000));
+
+    array_t::Ptr  array;
+    packed_t::Ptr packed;
+    cslibs_ndt_3d::conversion::from(map, array);
+    cslibs_ndt_3d::conversion::from(map, packed);
+    ASSERT_TRUE(array.get() && packed.get());
+
+    /// same distributions in the same order
+    const std::size_t n = array->data.size();
+    ASSERT_GT(n, 0ul);
+    ASSERT_EQ(packed->ids.size(),         n);
+    ASSERT_EQ(packed->means.size(),       3 * n);
+    ASSERT_EQ(packed->covariances.size(), 6 * n);
+    ASSERT_EQ(packed->probs.size(),       n);
+
+    const std::array<int, 6> upper = {{0, 1, 2, 4, 5, 8}};
+    for (std::size_t i = 0 ; i < n ; ++ i) {
+        const cslibs_ndt_3d::Distribution &d = array->data[i];
+        EXPECT_EQ(packed->ids[i], d.id.data);
+        expectNear(packed->probs[i], d.prob.data);
+        for (std::size_t j = 0 ; j < 3 ; ++ j)
+            expectNear(packed->means[3 * i + j], d.mean[j].data);
+        for (std::size_t j = 0 ; j < 6 ; ++ j)
+            expectNear(packed->covariances[6 * i + j], d.covariance[upper[j]].data);
+    }
+
+    /// packing an array gives the same, unpacking recovers the decompositions
+    packed_t repacked;
+    cslibs_ndt_3d::conversion::from(*array, repacked);
+    EXPECT_TRUE(repacked.ids == packed->ids);
+    array_t unpacked;
+    cslibs_ndt_3d::conversion::from(repacked, unpacked);
+    ASSERT_EQ(unpacked.data.size(), n);
+    for (std::size_t i = 0 ; i < n ; ++ i) {
+        const cslibs_ndt_3d::Distribution &d = array->data[i];
+        const cslibs_ndt_3d::Distribution &u = unpacked.data[i];
+        EXPECT_EQ(u.id.data, d.id.data);
+        for (std::size_t j = 0 ; j < 3 ; ++ j)
+            EXPECT_NEAR(u.eigen_values[j].data, d.eigen_values[j].data, 1e-5);
+
+        /// eigen vectors are unique up to their sign, the covariance is not
+        Eigen::Matrix3d v, c;
+        for (int j = 0 ; j < 9 ; ++ j) {
+            v(j) = u.eigen_vectors[j].data;
+            c(j) = d.covariance[j].data;
+        }
+        const Eigen::Vector3d l(u.eigen_values[0].data, u.eigen_values[1].data, u.eigen_values[2].data);
+        EXPECT_LT((v * l.asDiagonal() * v.transpose() - c).norm(), 1e-5);
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testPackedDistributionsBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-20.0, -20.0, -2.0), cslibs_math_3d::Point3d(20.0, 20.0, 2.0), 500000));
+
+    array_t::Ptr  array;
+    packed_t::Ptr packed;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, array);
+    const duration_t t_array = steady_clock_t::now() - start;
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, packed);
+    const duration_t t_packed = steady_clock_t::now() - start;
+
+    double t_array_serialize, t_array_deserialize, t_packed_serialize, t_packed_deserialize;
+    std::size_t array_length, packed_length;
+    roundTrip(*array,  t_array_serialize,  t_array_deserialize,  array_length);
+    roundTrip(*packed, t_packed_serialize, t_packed_deserialize, packed_length);
+
+    const double n = static_cast<double>(array->data.size()) * 1e-3;
+    std::cout << "[distributions] " << array->data.size() << " distributions, "
+              << array_length / 1024 << " KiB, conversion " << t_array.count() << " ms, "
+              << "serialisation " << n / t_array_serialize << " M/s, deserialisation " << n / t_array_deserialize << " M/s" << std::endl;
+    std::cout << "[packed]        " << packed->ids.size() << " distributions, "
+              << packed_length / 1024 << " KiB, conversion " << t_packed.count() << " ms, "
+              << "serialisation " << n / t_packed_serialize << " M/s, deserialisation " << n / t_packed_deserialize << " M/s" << std::endl;
+    EXPECT_LT(3 * packed_length, array_length);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
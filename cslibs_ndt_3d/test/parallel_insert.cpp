@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/static_maps/gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using dynamic_map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using static_map_t  = cslibs_ndt_3d::static_maps::Gridmap;
+using index_t       = dynamic_map_t::index_t;
+using pose_t        = dynamic_map_t::pose_t;
+using point_t       = dynamic_map_t::point_t;
+using cloud_t       = cslibs_math_3d::Pointcloud3d;
+
+/// points partly outside of the static map and some invalid ones
+cloud_t::Ptr generateCloud(const std::size_t size)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    rng_t<1> rng(-12.0, 12.0);
+    cloud_t::Ptr cloud(new cloud_t);
+    for (std::size_t i = 0 ; i < size ; ++ i) {
+        cloud->insert(point_t(rng.get(), rng.get(), rng.get()));
+        if (i % 100 == 0) {
+            cloud->insert(point_t(nan, rng.get(), rng.get()));
+            cloud->insert(point_t(rng.get(), rng.get(), nan));
+        }
+    }
+    return cloud;
+}
+
+std::vector<std::size_t> threadCounts()
+{
+    return {1ul, 2ul, std::max<std::size_t>(3ul, std::thread::hardware_concurrency())};
+}
+
+template <typename map_t>
+std::size_t countBundles(const map_t &map)
+{
+    std::size_t n = 0;
+    map.traverse([&n](const index_t &, const typename map_t::distribution_bundle_t &) {
+        ++ n;
+    });
+    return n;
+}
+
+/// identical distributions in every storage, the means up to summation order
+template <typename map_t>
+void expectEqual(const map_t &a,
+                 const map_t &b)
+{
+    EXPECT_EQ(countBundles(a), countBundles(b));
+    for (std::size_t i = 0 ; i < 8 ; ++ i) {
+        std::size_t n_a = 0;
+        std::size_t n_b = 0;
+        a.getStorages()[i]->traverse([&n_a, &b, i](const index_t &si, const typename map_t::distribution_t &d) {
+            ++ n_a;
+            const typename map_t::distribution_t *d_b = b.getStorages()[i]->get(si);
+            ASSERT_TRUE(d_b);
+            EXPECT_EQ(d.data().getN(), d_b->data().getN());
+            if (d.data().getN() > 0)
+                EXPECT_LT((d.data().getMean() - d_b->data().getMean()).norm(), 1e-9);
+        });
+        b.getStorages()[i]->traverse([&n_b](const index_t &, const typename map_t::distribution_t &) {
+            ++ n_b;
+        });
+        EXPECT_EQ(n_a, n_b);
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testInsertParallelDynamic)
+{
+    const cloud_t::Ptr cloud = generateCloud(50000);
+    const pose_t origin(1.0, -0.5, 0.2, 0.1, -0.2, 0.3);
+
+    dynamic_map_t reference(pose_t(), 0.5);
+    reference.insert(cloud, origin);
+    for (const std::size_t threads : threadCounts()) {
+        dynamic_map_t map(pose_t(), 0.5);
+        map.insertParallel(cloud, origin, threads);
+        expectEqual(reference, map);
+        EXPECT_TRUE(reference.getMinBundleIndex() == map.getMinBundleIndex());
+        EXPECT_TRUE(reference.getMaxBundleIndex() == map.getMaxBundleIndex());
+        EXPECT_TRUE(reference.getDirtyBlocks().getBlocks() == map.getDirtyBlocks().getBlocks());
+    }
+
+    dynamic_map_t map(pose_t(), 0.5);
+    map.insertParallel(cloud->begin(), cloud->begin(), origin, 4);
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(0ul, countBundles(map));
+    EXPECT_TRUE(map.getDirtyBlocks().empty());
+}
+
+TEST(Test_cslibs_ndt_3d, testInsertParallelStatic)
+{
+    const cloud_t::Ptr cloud = generateCloud(50000);
+    const pose_t origin(1.0, -0.5, 0.2, 0.1, -0.2, 0.3);
+
+    static_map_t reference(pose_t(), 0.5, {{40, 40, 40}}, {{-40, -40, -40}});
+    reference.insert(cloud, origin);
+    for (const std::size_t threads : threadCounts()) {
+        static_map_t map(pose_t(), 0.5, {{40, 40, 40}}, {{-40, -40, -40}});
+        map.insertParallel(cloud, origin, threads);
+        expectEqual(reference, map);
+    }
+
+    static_map_t map(pose_t(), 0.5, {{40, 40, 40}}, {{-40, -40, -40}});
+    map.insertParallel(cloud->begin(), cloud->begin(), origin, 4);
+    EXPECT_EQ(0ul, countBundles(map));
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/sensor_msgs_pointcloud2_iterator.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <limits>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+const std::size_t NUM_POINTS = 1200;
+
+/// every seventh point carries a NaN and is expected to be skipped
+inline bool invalid(const std::size_t i)
+{
+    return i % 7 == 0;
+}
+
+cslibs_math_3d::Pointcloud3d::Ptr generateCloud()
+{
+    rng_t<1> rng(-5.0, 5.0);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < NUM_POINTS ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(static_cast<float>(rng.get()),
+                                              static_cast<float>(rng.get()),
+                                              static_cast<float>(rng.get())));
+    return cloud;
+}
+
+/// fields in z, x, y order behind a leading channel, rows padded by the row step
+template <typename scalar_t>
+sensor_msgs::PointCloud2 generateMessage(const cslibs_math_3d::Pointcloud3d::Ptr &cloud,
+                                         const std::size_t width,
+                                         const std::size_t padding)
+{
+    const uint8_t datatype = sizeof(scalar_t) == sizeof(float) ? sensor_msgs::PointField::FLOAT32
+                                                               : sensor_msgs::PointField::FLOAT64;
+    const std::array<std::string, 3> names   = {{"z", "x", "y"}};
+    const std::array<std::size_t, 3> offsets = {{4, 4 + sizeof(scalar_t), 4 + 2 * sizeof(scalar_t)}};
+
+    sensor_msgs::PointCloud2 msg;
+    msg.width      = width;
+    msg.height     = cloud->size() / width;
+    msg.point_step = 4 + 3 * sizeof(scalar_t) + 2;
+    msg.row_step   = msg.width * msg.point_step + padding;
+    msg.is_bigendian = cslibs_ndt_3d::conversion::impl::bigEndian();
+    msg.fields.resize(3);
+    for (std::size_t i = 0 ; i < 3 ; ++ i) {
+        msg.fields[i].name     = names[i];
+        msg.fields[i].offset   = offsets[i];
+        msg.fields[i].datatype = datatype;
+        msg.fields[i].count    = 1;
+    }
+    msg.data.resize(msg.height * msg.row_step);
+
+    for (std::size_t i = 0 ; i < cloud->size() ; ++ i) {
+        const cslibs_math_3d::Point3d &p = cloud->getPoints()[i];
+        uint8_t *data = &msg.data[(i / width) * msg.row_step + (i % width) * msg.point_step];
+        const std::array<scalar_t, 3> values = {{static_cast<scalar_t>(p(2)),
+                                                 static_cast<scalar_t>(p(0)),
+                                                 invalid(i) ? std::numeric_limits<scalar_t>::quiet_NaN()
+                                                            : static_cast<scalar_t>(p(1))}};
+        for (std::size_t j = 0 ; j < 3 ; ++ j)
+            std::memcpy(data + offsets[j], &values[j], sizeof(scalar_t));
+    }
+    return msg;
+}
+
+template <typename scalar_t>
+void testMessage(const std::size_t width,
+                 const std::size_t padding)
+{
+    using map_t           = cslibs_ndt_3d::dynamic_maps::Gridmap;
+    using occupancy_map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateCloud();
+    const sensor_msgs::PointCloud2          msg   = generateMessage<scalar_t>(cloud, width, padding);
+
+    cslibs_math_3d::Pointcloud3d::Ptr valid(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < cloud->size() ; ++ i)
+        if (!invalid(i))
+            valid->insert(cloud->getPoints()[i]);
+
+    std::array<std::size_t, 3> offsets;
+    cslibs_ndt_3d::conversion::impl::coordinateFields(msg, offsets);
+    const cslibs_ndt_3d::conversion::PointCloud2View<scalar_t> view(msg, offsets);
+    std::size_t i = 0;
+    for (const cslibs_math_3d::Point3d &p : view) {
+        ASSERT_LT(i, valid->size());
+        EXPECT_NEAR((p - valid->getPoints()[i]).length(), 0.0, 1e-6);
+        ++ i;
+    }
+    EXPECT_EQ(i, valid->size());
+
+    const map_t::pose_t origin(0.1, 0.2, 0.3, 0.0, 0.0, 0.4);
+
+    map_t expected(map_t::pose_t(), 1.0);
+    map_t map(map_t::pose_t(), 1.0);
+    expected.insert(valid, origin);
+    cslibs_ndt_3d::conversion::insert(map, msg, origin);
+    expected.traverse([&map](const map_t::index_t &bi, const map_t::distribution_bundle_t &b) {
+        const map_t::distribution_bundle_t *bb = map.getDistributionBundle(bi);
+        ASSERT_NE(bb, nullptr);
+        for (std::size_t j = 0 ; j < 8 ; ++ j)
+            EXPECT_EQ(b.at(j)->data().getN(), bb->at(j)->data().getN());
+    });
+
+    occupancy_map_t expected_occupancy(occupancy_map_t::pose_t(), 1.0);
+    occupancy_map_t occupancy(occupancy_map_t::pose_t(), 1.0);
+    expected_occupancy.insert(valid, origin);
+    cslibs_ndt_3d::conversion::insert(occupancy, msg, origin);
+    expected_occupancy.traverse([&occupancy](const occupancy_map_t::index_t &bi, const occupancy_map_t::distribution_bundle_t &b) {
+        const occupancy_map_t::distribution_bundle_t *bb = occupancy.getDistributionBundle(bi);
+        ASSERT_NE(bb, nullptr);
+        for (std::size_t j = 0 ; j < 8 ; ++ j) {
+            EXPECT_EQ(b.at(j)->numFree(),     bb->at(j)->numFree());
+            EXPECT_EQ(b.at(j)->numOccupied(), bb->at(j)->numOccupied());
+        }
+    });
+
+    const cslibs_ndt::matching::Parameter params;
+    const auto r_cloud   = cslibs_ndt::matching::match(valid->begin(), valid->end(), expected, params, map_t::transform_t());
+    const auto r_message = cslibs_ndt_3d::conversion::match(msg, expected, params, map_t::transform_t());
+    EXPECT_NEAR((r_cloud.transform().translation() - r_message.transform().translation()).length(), 0.0, 1e-6);
+}
+
+TEST(Test_cslibs_ndt_3d, testPointCloud2Float32)
+{
+    testMessage<float>(NUM_POINTS, 0);
+    testMessage<float>(40, 6);
+}
+
+TEST(Test_cslibs_ndt_3d, testPointCloud2Float64)
+{
+    testMessage<double>(NUM_POINTS, 0);
+    testMessage<double>(40, 6);
+}
+
+TEST(Test_cslibs_ndt_3d, testPointCloud2MissingField)
+{
+    sensor_msgs::PointCloud2 msg;
+    msg.fields.resize(2);
+    msg.fields[0].name     = "x";
+    msg.fields[0].datatype = sensor_msgs::PointField::FLOAT32;
+    msg.fields[1].name     = "y";
+    msg.fields[1].datatype = sensor_msgs::PointField::FLOAT32;
+
+    cslibs_ndt_3d::dynamic_maps::Gridmap map(cslibs_ndt_3d::dynamic_maps::Gridmap::pose_t(), 1.0);
+    EXPECT_THROW(cslibs_ndt_3d::conversion::insert(map, msg), std::runtime_error);
+}
+
+TEST(Test_cslibs_ndt_3d, testPointCloud2InvalidLayout)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateCloud();
+    const sensor_msgs::PointCloud2          valid = generateMessage<float>(cloud, 40, 0);
+    map_t map(map_t::pose_t(), 1.0);
+    EXPECT_NO_THROW(cslibs_ndt_3d::conversion::insert(map, valid));
+
+    /// the last coordinate would be read from the next point
+    sensor_msgs::PointCloud2 msg = valid;
+    msg.fields[2].offset = msg.point_step - sizeof(float) + 1;
+    EXPECT_THROW(cslibs_ndt_3d::conversion::insert(map, msg), std::runtime_error);
+
+    /// the field datatype does not fit into the point
+    msg = valid;
+    for (sensor_msgs::PointField &f : msg.fields)
+        f.datatype = sensor_msgs::PointField::FLOAT64;
+    EXPECT_THROW(cslibs_ndt_3d::conversion::insert(map, msg), std::runtime_error);
+
+    /// foreign byte order
+    msg = valid;
+    msg.is_bigendian = !valid.is_bigendian;
+    EXPECT_THROW(cslibs_ndt_3d::conversion::insert(map, msg), std::runtime_error);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/projection.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include "generate_box.hpp"
+
+#include <cmath>
+
+using map_t              = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using occupancy_map_t    = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using map_2d_t           = cslibs_ndt_2d::dynamic_maps::Gridmap;
+using occupancy_map_2d_t = cslibs_ndt_2d::dynamic_maps::OccupancyGridmap;
+using grid_t             = cslibs_gridmaps::static_maps::Gridmap<double>;
+
+const double RESOLUTION = 0.5;
+
+TEST(Test_cslibs_ndt_3d, testProjectionGridmap)
+{
+    const map_t::pose_t origin(0.3, -0.2, 0.0, 0.0, 0.0, 0.4);
+    const map_t::Ptr map(new map_t(origin, RESOLUTION));
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateBox(cslibs_math_3d::Point3d(-2.0, -2.0, -1.0),
+                                                                cslibs_math_3d::Point3d(3.0, 3.0, 2.0), 20000);
+    map->insert(cloud);
+
+    /// the band spans whole cells, [0, 1) in map coordinates
+    map_2d_t::Ptr projected;
+    cslibs_ndt_3d::conversion::from(map, projected, 0.1, 0.9);
+    ASSERT_TRUE(projected.get());
+
+    const map_2d_t::Ptr reference(new map_2d_t(map_2d_t::pose_t(origin.tx(), origin.ty(), origin.yaw()), RESOLUTION));
+    for (const cslibs_math_3d::Point3d &p : *cloud)
+        if (p(2) >= 0.0 && p(2) < 1.0)
+            reference->insert(map_2d_t::point_t(p(0), p(1)));
+
+    std::size_t compared = 0;
+    map_2d_t::distribution_const_bundle_t b;
+    reference->traverse([&](const map_2d_t::index_t &bi, const map_2d_t::distribution_bundle_t &r) {
+        ASSERT_TRUE(projected->lookupDistributionBundle(bi, b));
+        for (std::size_t i = 0 ; i < 4 ; ++ i) {
+            const auto &expected = r.at(i)->data();
+            ASSERT_TRUE(b.at(i));
+            const auto &actual = b.at(i)->data();
+            ASSERT_EQ(expected.getN(), actual.getN());
+            if (expected.getN() < 3)
+                continue;
+            EXPECT_LT((expected.getMean() - actual.getMean()).norm(), 1e-9);
+            EXPECT_LT((expected.getCovariance() - actual.getCovariance()).norm(), 1e-9);
+            ++ compared;
+        }
+    });
+    EXPECT_GT(compared, 0ul);
+
+    /// samples of the projection match, the band leaves out the rest
+    auto count = [](const map_2d_t &map) {
+        std::size_t n = 0;
+        map.getStorages()[0]->traverse([&n](const map_2d_t::index_t &, const map_2d_t::distribution_t &d) {
+            n += d.data().getN();
+        });
+        return n;
+    };
+    const std::size_t n = count(*projected);
+    const std::size_t m = count(*reference);
+    EXPECT_EQ(n, m);
+    EXPECT_LT(n, cloud->size());
+}
+
+TEST(Test_cslibs_ndt_3d, testProjectionOccupancy)
+{
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    for (std::size_t i = 0 ; i < 5 ; ++ i)
+        map->insert(generateBox(cslibs_math_3d::Point3d(4.0, -2.0, -0.5),
+                                cslibs_math_3d::Point3d(4.1, 2.0, 1.5), 2000),
+                    occupancy_map_t::pose_t(0.0, 0.0, 0.5));
+
+    occupancy_map_2d_t::Ptr projected;
+    cslibs_ndt_3d::conversion::from(map, projected, 0.0, 1.0);
+    ASSERT_TRUE(projected.get());
+
+    /// free and occupied counts of the band are kept
+    std::size_t free_3d = 0, occupied_3d = 0;
+    map->getStorages()[0]->traverse([&](const occupancy_map_t::index_t &si, const occupancy_map_t::distribution_t &d) {
+        const double z = (si[2] + 0.5) * RESOLUTION;
+        if (z < 0.0 || z > 1.0)
+            return;
+        free_3d     += d.numFree();
+        occupied_3d += d.numOccupied();
+    });
+    std::size_t free_2d = 0, occupied_2d = 0;
+    projected->getStorages()[0]->traverse([&](const occupancy_map_2d_t::index_t &, const occupancy_map_2d_t::distribution_t &d) {
+        free_2d     += d.numFree();
+        occupied_2d += d.numOccupied();
+    });
+    EXPECT_EQ(free_3d, free_2d);
+    EXPECT_EQ(occupied_3d, occupied_2d);
+    EXPECT_GT(occupied_2d, 0ul);
+
+    /// the wall is occupied, the space in front of it free
+    EXPECT_GT(projected->sampleNonNormalized(occupancy_map_2d_t::point_t(4.05, 0.0), ivm), 0.0);
+    EXPECT_EQ(projected->sampleNonNormalized(occupancy_map_2d_t::point_t(2.0, 0.0), ivm), 0.0);
+}
+
+TEST(Test_cslibs_ndt_3d, testProjectionHeightLayers)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(0.0, 0.0, 0.05), cslibs_math_3d::Point3d(4.0, 4.0, 0.15), 20000));
+    map->insert(generateBox(cslibs_math_3d::Point3d(1.0, 1.0, 1.1),  cslibs_math_3d::Point3d(2.0, 2.0, 1.2), 5000));
+    map->insert(generateBox(cslibs_math_3d::Point3d(0.0, 0.0, 3.0),  cslibs_math_3d::Point3d(4.0, 4.0, 3.1), 5000));
+
+    grid_t::Ptr elevation, min_height, max_height;
+    cslibs_ndt_3d::conversion::from(map, elevation, min_height, max_height, -1.0, 2.0);
+    ASSERT_TRUE(elevation.get() && min_height.get() && max_height.get());
+    EXPECT_EQ(elevation->getWidth(),  8ul);
+    EXPECT_EQ(elevation->getHeight(), 8ul);
+
+    auto at = [](const grid_t::Ptr &g, const double x, const double y) {
+        grid_t::index_t i;
+        EXPECT_TRUE(g->toIndex(cslibs_math_2d::Point2d(x, y), i));
+        return g->at(static_cast<std::size_t>(i[0]), static_cast<std::size_t>(i[1]));
+    };
+
+    /// the ceiling is outside of the band
+    EXPECT_NEAR(at(elevation, 0.2, 0.2), 0.1,  0.02);
+    EXPECT_NEAR(at(elevation, 1.7, 1.3), 1.15, 0.02);
+    EXPECT_LT(at(min_height, 1.7, 1.3), 0.1);
+    EXPECT_GT(at(max_height, 1.7, 1.3), 1.15);
+    EXPECT_LT(at(max_height, 3.2, 3.7), 0.2);
+    for (std::size_t y = 0 ; y < elevation->getHeight() ; ++ y)
+        for (std::size_t x = 0 ; x < elevation->getWidth() ; ++ x)
+            EXPECT_LE(min_height->at(x, y), max_height->at(x, y));
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
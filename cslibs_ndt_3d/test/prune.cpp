@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/common/box.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/occupancy_gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t           = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using occupancy_map_t = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using index_t         = map_t::index_t;
+using cloud_t         = cslibs_math_3d::Pointcloud3d;
+
+cloud_t::Ptr generateCloud(const std::size_t size)
+{
+    rng_t<1> rng(-10.0, 10.0);
+    cloud_t::Ptr cloud(new cloud_t);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(map_t::point_t(rng.get(), rng.get(), rng.get()));
+    return cloud;
+}
+
+/// index of the distribution of storage i a bundle refers to
+index_t storageIndex(const index_t &bi,
+                     const std::size_t i)
+{
+    const int s0 = static_cast<int>(i & 1ul);
+    const int s1 = static_cast<int>((i >> 1) & 1ul);
+    const int s2 = static_cast<int>((i >> 2) & 1ul);
+    return {{cslibs_math::common::div<int>(bi[0], 2) + s0 * cslibs_math::common::mod<int>(bi[0], 2),
+             cslibs_math::common::div<int>(bi[1], 2) + s1 * cslibs_math::common::mod<int>(bi[1], 2),
+             cslibs_math::common::div<int>(bi[2], 2) + s2 * cslibs_math::common::mod<int>(bi[2], 2)}};
+}
+
+std::size_t samples(const occupancy_map_t::distribution_t &d)
+{
+    return d.numFree() + d.numOccupied();
+}
+
+template <typename distribution_t>
+std::size_t samples(const distribution_t &d)
+{
+    return d.data().getN();
+}
+
+/// samples per storage and distribution index
+template <typename map_t>
+std::map<std::pair<std::size_t, index_t>, std::size_t> distributions(const map_t &map)
+{
+    std::map<std::pair<std::size_t, index_t>, std::size_t> n;
+    for (std::size_t i = 0 ; i < 8 ; ++ i)
+        map.getStorages()[i]->traverse([&n, i](const index_t &si, const typename map_t::distribution_t &d) {
+            n[{i, si}] = samples(d);
+        });
+    return n;
+}
+
+template <typename map_t>
+std::set<index_t> bundles(const map_t &map)
+{
+    std::set<index_t> indices;
+    map.traverse([&indices](const index_t &bi, const typename map_t::distribution_bundle_t &) {
+        indices.insert(bi);
+    });
+    return indices;
+}
+
+template <typename map_t>
+void testEvictOutside(map_t &map, const std::string &name)
+{
+    const index_t min_bi = map.getMinBundleIndex();
+    const index_t max_bi = map.getMaxBundleIndex();
+    const index_t lo = {{min_bi[0] + (max_bi[0] - min_bi[0]) / 4, min_bi[1] + (max_bi[1] - min_bi[1]) / 3, min_bi[2] + (max_bi[2] - min_bi[2]) / 5}};
+    const index_t hi = {{max_bi[0] - (max_bi[0] - min_bi[0]) / 3, max_bi[1] - (max_bi[1] - min_bi[1]) / 4, max_bi[2] - (max_bi[2] - min_bi[2]) / 5}};
+
+    const std::set<index_t> before = bundles(map);
+    const std::map<std::pair<std::size_t, index_t>, std::size_t> n_before = distributions(map);
+    const std::size_t byte_size = map.getByteSize();
+
+    std::set<index_t> expected;
+    index_t expected_min = {{std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}};
+    index_t expected_max = {{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()}};
+    for (const index_t &bi : before) {
+        if (cslibs_ndt::box::contains(bi, lo, hi)) {
+            expected.insert(bi);
+            expected_min = cslibs_ndt::box::minimum(expected_min, bi);
+            expected_max = cslibs_ndt::box::maximum(expected_max, bi);
+        }
+    }
+    ASSERT_FALSE(expected.empty());
+    ASSERT_LT(expected.size(), before.size());
+
+    map.fetchDirtyBlocks();
+    EXPECT_EQ(0ul, map.prune([](const index_t &, const typename map_t::distribution_bundle_t &) { return false; }));
+    EXPECT_TRUE(map.getDirtyBlocks().empty());
+    EXPECT_EQ(before.size() - expected.size(), map.evictOutside(lo, hi));
+    EXPECT_TRUE(expected == bundles(map));
+    EXPECT_TRUE(expected_min == map.getMinBundleIndex());
+    EXPECT_TRUE(expected_max == map.getMaxBundleIndex());
+    EXPECT_FALSE(map.getDirtyBlocks().empty());
+
+    /// exactly the distributions referenced by a surviving bundle are kept,
+    /// including the ones shared with evicted bundles, with all of their samples
+    std::map<std::pair<std::size_t, index_t>, std::size_t> n_expected;
+    for (const index_t &bi : expected)
+        for (std::size_t i = 0 ; i < 8 ; ++ i)
+            n_expected[{i, storageIndex(bi, i)}] = n_before.at({i, storageIndex(bi, i)});
+    EXPECT_TRUE(n_expected == distributions(map));
+
+    const std::size_t pruned_byte_size = map.getByteSize();
+    EXPECT_LT(pruned_byte_size, byte_size);
+    std::cout << "[" << name << "] evicted " << before.size() - expected.size() << " of " << before.size()
+              << " bundles, bytes: " << byte_size << " -> " << pruned_byte_size << std::endl;
+
+    EXPECT_EQ(expected.size(), map.prune([](const index_t &, const typename map_t::distribution_bundle_t &) { return true; }));
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(bundles(map).empty());
+    EXPECT_TRUE(distributions(map).empty());
+}
+
+TEST(Test_cslibs_ndt_3d, testPruneGridmap)
+{
+    map_t map(map_t::pose_t(), 0.5);
+    map.insert(generateCloud(200000));
+    testEvictOutside(map, "Gridmap");
+}
+
+TEST(Test_cslibs_ndt_3d, testPruneOccupancyGridmap)
+{
+    occupancy_map_t map(occupancy_map_t::pose_t(), 0.5);
+    map.insert(generateCloud(2000));
+    testEvictOutside(map, "OccupancyGridmap");
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/common/pyramid.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t     = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using pyramid_t = cslibs_ndt::Pyramid<map_t>;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+const std::size_t NUM_LEVELS = 4;
+const double      RESOLUTION = 0.25;
+
+cslibs_math_3d::Pointcloud3d::Ptr generateCloud(const std::size_t size)
+{
+    rng_t<1> rng(-8.0, 8.0);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < size ; ++ i)
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng.get()));
+    return cloud;
+}
+
+/// every level has to equal a map built directly at its resolution
+void testLevels(const pyramid_t &pyramid,
+                const std::vector<cslibs_math_3d::Pointcloud3d::Ptr> &clouds,
+                const map_t::pose_t &origin)
+{
+    double resolution = RESOLUTION;
+    for (std::size_t l = 0 ; l < NUM_LEVELS ; ++ l) {
+        map_t expected(origin, resolution);
+        for (const cslibs_math_3d::Pointcloud3d::Ptr &cloud : clouds)
+            expected.insert(cloud);
+
+        const map_t &level = pyramid.getLevel(l);
+        EXPECT_FALSE(pyramid.isDirty(l));
+
+        std::size_t expected_bundles = 0;
+        expected.traverse([&level, &expected_bundles](const map_t::index_t &bi, const map_t::distribution_bundle_t &b) {
+            const map_t::distribution_bundle_t *bl = level.getDistributionBundle(bi);
+            for (std::size_t i = 0 ; i < 8 ; ++ i) {
+                EXPECT_EQ(b.at(i)->data().getN(), bl->at(i)->data().getN());
+                if (b.at(i)->data().getN() > 0)
+                    EXPECT_NEAR((b.at(i)->data().getMean() - bl->at(i)->data().getMean()).norm(), 0.0, 1e-9);
+            }
+            ++ expected_bundles;
+        });
+
+        std::size_t bundles = 0;
+        level.traverse([&bundles](const map_t::index_t &, const map_t::distribution_bundle_t &) {
+            ++ bundles;
+        });
+        EXPECT_EQ(expected_bundles, bundles);
+
+        const cslibs_math_3d::Point3d p = clouds.front()->getPoints().front();
+        EXPECT_NEAR(expected.sampleNonNormalized(p), pyramid.sampleNonNormalized(p, l), 1e-9);
+
+        resolution *= 2.0;
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testPyramidLevels)
+{
+    const map_t::pose_t origin(0.5, -0.3, 0.1, 0.0, 0.0, 0.3);
+    pyramid_t pyramid(origin, RESOLUTION, NUM_LEVELS);
+    EXPECT_EQ(pyramid.getLevels(), NUM_LEVELS);
+
+    std::vector<cslibs_math_3d::Pointcloud3d::Ptr> clouds;
+    clouds.emplace_back(generateCloud(5000));
+    pyramid.insert(clouds.back());
+    EXPECT_TRUE(pyramid.isDirty(NUM_LEVELS - 1));
+    testLevels(pyramid, clouds, origin);
+
+    /// incremental updates only touch the dirty cells
+    for (std::size_t i = 0 ; i < 3 ; ++ i) {
+        clouds.emplace_back(generateCloud(500));
+        pyramid.insert(clouds.back());
+    }
+    testLevels(pyramid, clouds, origin);
+}
+
+TEST(Test_cslibs_ndt_3d, testPyramidInsertionCost)
+{
+    const std::size_t cycles = 20;
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateCloud(10000);
+
+    map_t     map(map_t::pose_t(), RESOLUTION);
+    pyramid_t pyramid(map_t::pose_t(), RESOLUTION, NUM_LEVELS);
+
+    duration_t t_map(0.0);
+    duration_t t_pyramid(0.0);
+    for (std::size_t c = 0 ; c < cycles ; ++ c) {
+        auto start = steady_clock_t::now();
+        map.insert(cloud);
+        t_map += steady_clock_t::now() - start;
+
+        start = steady_clock_t::now();
+        pyramid.insert(cloud);
+        t_pyramid += steady_clock_t::now() - start;
+    }
+
+    const auto start = steady_clock_t::now();
+    pyramid.getLevel(NUM_LEVELS - 1);
+    const duration_t t_update = steady_clock_t::now() - start;
+
+    std::cout << "[pyramid] insertion per cloud: map " << t_map.count() / cycles
+              << " ms, pyramid " << t_pyramid.count() / cycles
+              << " ms, lazy update of all levels " << t_update.count() << " ms" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
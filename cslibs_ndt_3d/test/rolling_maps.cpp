@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt/common/box.hpp>
+#include <cslibs_ndt_3d/rolling_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/rolling_maps/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <map>
+#include <vector>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t   = cslibs_ndt_3d::rolling_maps::Gridmap;
+using index_t = map_t::index_t;
+
+/// distribution indices of a bundle, in storage order
+std::array<index_t, 8> distributionIndices(const index_t &bi)
+{
+    std::array<index_t, 8> di;
+    for (std::size_t s = 0 ; s < 8 ; ++ s)
+        for (std::size_t d = 0 ; d < 3 ; ++ d)
+            di[s][d] = cslibs_math::common::div<int>(bi[d], 2) +
+                       static_cast<int>((s >> d) & 1ul) * cslibs_math::common::mod<int>(bi[d], 2);
+    return di;
+}
+
+bool inWindow(const map_t &map,
+              const map_t::point_t &p)
+{
+    return cslibs_ndt::box::contains(map.getBundleIndex(p), map.getMinBundleIndex(), map.getMaxBundleIndex());
+}
+
+TEST(Test_cslibs_ndt_3d, testRollingMapScrolling)
+{
+    rng_t<1> rng_step(-0.7, 0.7);
+    rng_t<1> rng_jump(-20.0, 20.0);
+    rng_t<1> rng_point(-2.0, 2.0);
+
+    map_t map(map_t::pose_t(), 0.5, {{6, 5, 4}});
+    const std::size_t byte_size = map.getByteSize();
+
+    /// reference sample counts per storage and distribution index, dropped
+    /// as soon as no bundle of the window references the distribution
+    std::map<std::pair<std::size_t, index_t>, std::size_t> reference;
+
+    map_t::point_t center;
+    for (int step = 0 ; step < 200 ; ++ step) {
+        center = center + map_t::point_t(rng_step.get(), rng_step.get(), rng_step.get());
+        if (step % 50 == 0)
+            center = center + map_t::point_t(rng_jump.get(), rng_jump.get(), rng_jump.get());
+        map.moveTo(center);
+
+        const index_t min_bi = map.getMinBundleIndex();
+        const index_t max_bi = map.getMaxBundleIndex();
+        EXPECT_EQ(max_bi[0] - min_bi[0] + 1, 12);
+        EXPECT_EQ(max_bi[1] - min_bi[1] + 1, 10);
+        EXPECT_EQ(max_bi[2] - min_bi[2] + 1, 8);
+
+        std::map<std::pair<std::size_t, index_t>, std::size_t> referenced;
+        for (int i = min_bi[0] ; i <= max_bi[0] ; ++ i) {
+            for (int j = min_bi[1] ; j <= max_bi[1] ; ++ j) {
+                for (int k = min_bi[2] ; k <= max_bi[2] ; ++ k) {
+                    const std::array<index_t, 8> di = distributionIndices({{i, j, k}});
+                    for (std::size_t s = 0 ; s < 8 ; ++ s) {
+                        auto it = reference.find({s, di[s]});
+                        referenced[{s, di[s]}] = it == reference.end() ? 0 : it->second;
+                    }
+                }
+            }
+        }
+        reference.swap(referenced);
+
+        for (int i = 0 ; i < 50 ; ++ i) {
+            const map_t::point_t p = center + map_t::point_t(rng_point.get(), rng_point.get(), rng_point.get());
+            if (!inWindow(map, p))
+                continue;
+
+            map.insert(p);
+            const std::array<index_t, 8> di = distributionIndices(map.getBundleIndex(p));
+            for (std::size_t s = 0 ; s < 8 ; ++ s)
+                ++ reference[{s, di[s]}];
+        }
+
+        /// slots entering the window are empty, distributions shared with
+        /// bundles that left the window keep their samples
+        map.traverse([&reference](const index_t &bi, const map_t::distribution_bundle_t &b) {
+            const std::array<index_t, 8> di = distributionIndices(bi);
+            for (std::size_t s = 0 ; s < 8 ; ++ s) {
+                const std::size_t n = reference[{s, di[s]}];
+                EXPECT_EQ(n, b.at(s)->data().getN());
+            }
+        });
+        EXPECT_EQ(byte_size, map.getByteSize());
+    }
+}
+
+TEST(Test_cslibs_ndt_3d, testRollingMapMatchesCroppedDynamicMap)
+{
+    using dynamic_map_t = cslibs_ndt_3d::dynamic_maps::Gridmap;
+
+    rng_t<1> rng_step(0.0, 0.7);
+    rng_t<1> rng_point(-2.5, 2.5);
+
+    map_t         map(map_t::pose_t(), 0.5, {{6, 5, 4}});
+    dynamic_map_t dynamic_map(dynamic_map_t::pose_t(), 0.5);
+
+    /// the window only moves forward, so no distribution re-enters it after
+    /// it has been dropped and both maps have seen the same samples
+    map_t::point_t center;
+    for (int step = 0 ; step < 100 ; ++ step) {
+        center = center + map_t::point_t(rng_step.get(), 0.5 * rng_step.get(), 0.25 * rng_step.get());
+        if (step == 50)
+            center = center + map_t::point_t(20.0, 0.0, 0.0);
+        map.moveTo(center);
+
+        for (int i = 0 ; i < 50 ; ++ i) {
+            const map_t::point_t p = center + map_t::point_t(rng_point.get(), rng_point.get(), rng_point.get());
+            if (!inWindow(map, p))
+                continue;
+
+            map.insert(p);
+            dynamic_map.insert(p);
+        }
+    }
+
+    const dynamic_map_t::Ptr cropped = dynamic_map.crop(map.getMinBundleIndex(), map.getMaxBundleIndex());
+    ASSERT_TRUE(cropped);
+
+    /// getDistributionBundle allocates, so the cropped bundles are collected
+    std::map<index_t, const dynamic_map_t::distribution_bundle_t*> cropped_bundles;
+    cropped->traverse([&cropped_bundles](const index_t &bi, const dynamic_map_t::distribution_bundle_t &b) {
+        cropped_bundles[bi] = &b;
+    });
+
+    std::size_t visited = 0;
+    map.traverse([&visited, &cropped_bundles](const index_t &bi, const map_t::distribution_bundle_t &b) {
+        ++ visited;
+        auto it = cropped_bundles.find(bi);
+        ASSERT_TRUE(it != cropped_bundles.end());
+        for (std::size_t s = 0 ; s < 8 ; ++ s) {
+            EXPECT_EQ(b.at(s)->data().getN(), it->second->at(s)->data().getN());
+            if (b.at(s)->data().getN() > 0)
+                EXPECT_LT((b.at(s)->data().getMean() - it->second->at(s)->data().getMean()).norm(), 1e-9);
+        }
+    });
+    EXPECT_GT(visited, 0ul);
+    EXPECT_EQ(visited, cropped_bundles.size());
+}
+
+TEST(Test_cslibs_ndt_3d, testRollingOccupancyMapClearing)
+{
+    using occupancy_map_t = cslibs_ndt_3d::rolling_maps::OccupancyGridmap;
+
+    occupancy_map_t map(occupancy_map_t::pose_t(), 1.0, {{4, 4, 4}});
+
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (int i = 0 ; i < 100 ; ++ i)
+        cloud->insert(occupancy_map_t::point_t(1.0 + 0.01 * i, 0.5, 0.5));
+    cloud->insert(occupancy_map_t::point_t(50.0, 0.0, 0.0));
+    map.insert(cloud);
+
+    cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+    EXPECT_GT(map.sampleNonNormalized(occupancy_map_t::point_t(1.5, 0.5, 0.5), ivm), 0.0);
+    EXPECT_EQ(map.sampleNonNormalized(occupancy_map_t::point_t(50.0, 0.0, 0.0), ivm), 0.0);
+
+    std::size_t allocated = 0;
+    map.traverse([&allocated](const occupancy_map_t::index_t &, const occupancy_map_t::distribution_bundle_t &) {
+        ++ allocated;
+    });
+    EXPECT_GT(allocated, 2ul);
+
+    map.moveTo(occupancy_map_t::point_t(100.0, 0.0, 0.0));
+    allocated = 0;
+    map.traverse([&allocated](const occupancy_map_t::index_t &, const occupancy_map_t::distribution_bundle_t &) {
+        ++ allocated;
+    });
+    EXPECT_EQ(allocated, 0ul);
+    EXPECT_EQ(map.sampleNonNormalized(occupancy_map_t::point_t(1.5, 0.5, 0.5), ivm), 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt_3d/serialization/dynamic_maps/gridmap.hpp>
+#include <cslibs_ndt/matching/match.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <cmath>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using steady_clock_t = std::chrono::steady_clock;
+using duration_t     = std::chrono::duration<double, std::milli>;
+
+cslibs_math_3d::Pointcloud3d::Ptr generateScene()
+{
+    /// three orthogonal, slightly noisy walls, so that all six degrees of freedom are constrained
+    rng_t<1> rng_coord(0.0, 10.0);
+    rng_t<1> rng_noise(-0.02, 0.02);
+
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (int i = 0 ; i < 3000 ; ++ i) {
+        cloud->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_noise.get()));
+        cloud->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_noise.get(), rng_coord.get()));
+        cloud->insert(cslibs_math_3d::Point3d(rng_noise.get(), rng_coord.get(), rng_coord.get()));
+    }
+    return cloud;
+}
+
+template <typename T>
+cslibs_ndt::matching::Result<cslibs_math_3d::Transform3d> matchScene(const cslibs_math_3d::Pointcloud3d::Ptr &src,
+                                                                     const cslibs_math_3d::Pointcloud3d::Ptr &dst,
+                                                                     const cslibs_math_3d::Transform3d       &initial_transform)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::GridmapT<T>;
+    map_t map(typename map_t::pose_t(), 1.0);
+    map.insert(dst);
+
+    cslibs_ndt::matching::Parameter params;
+    params.maxIterations() = 100;
+    return cslibs_ndt::matching::match(src->begin(), src->end(), map, params, initial_transform);
+}
+
+TEST(Test_cslibs_ndt_3d, testSinglePrecisionMatching)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr dst = generateScene();
+
+    const cslibs_math_3d::Transform3d offset(0.2, -0.1, 0.05, 0.02, -0.01, 0.03);
+    cslibs_math_3d::Pointcloud3d::Ptr src(new cslibs_math_3d::Pointcloud3d);
+    for (const cslibs_math_3d::Point3d &p : *dst)
+        src->insert(offset.inverse() * p);
+
+    const auto r_double = matchScene<double>(src, dst, cslibs_math_3d::Transform3d::identity());
+    const auto r_float  = matchScene<float>(src, dst, cslibs_math_3d::Transform3d::identity());
+
+    const cslibs_math_3d::Transform3d &t_double = r_double.transform();
+    const cslibs_math_3d::Transform3d &t_float  = r_float.transform();
+
+    std::cout << "[single precision] double: "
+              << t_double.tx() << " " << t_double.ty() << " " << t_double.tz() << " "
+              << t_double.roll() << " " << t_double.pitch() << " " << t_double.yaw()
+              << " (" << r_double.iterations() << " iterations, score " << r_double.score() << ")" << std::endl;
+    std::cout << "[single precision] float:  "
+              << t_float.tx() << " " << t_float.ty() << " " << t_float.tz() << " "
+              << t_float.roll() << " " << t_float.pitch() << " " << t_float.yaw()
+              << " (" << r_float.iterations() << " iterations, score " << r_float.score() << ")" << std::endl;
+    std::cout << "[single precision] |dt| = " << (t_double.translation() - t_float.translation()).length()
+              << ", |dyaw| = " << std::abs(std::remainder(t_double.yaw() - t_float.yaw(), 2.0 * M_PI)) << std::endl;
+
+    EXPECT_NEAR(t_double.tx(),    t_float.tx(),    1e-3);
+    EXPECT_NEAR(t_double.ty(),    t_float.ty(),    1e-3);
+    EXPECT_NEAR(t_double.tz(),    t_float.tz(),    1e-3);
+    EXPECT_NEAR(std::remainder(t_double.roll()  - t_float.roll(),  2.0 * M_PI), 0.0, 1e-3);
+    EXPECT_NEAR(std::remainder(t_double.pitch() - t_float.pitch(), 2.0 * M_PI), 0.0, 1e-3);
+    EXPECT_NEAR(std::remainder(t_double.yaw()   - t_float.yaw(),   2.0 * M_PI), 0.0, 1e-3);
+}
+
+TEST(Test_cslibs_ndt_3d, testSinglePrecisionFileBinarySerialization)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::GridmapT<float>;
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateScene();
+
+    typename map_t::Ptr map(new map_t(cslibs_math_3d::Transform3d(1.0, 2.0, 3.0), 1.0));
+    map->insert(cloud);
+
+    cslibs_ndt_3d::dynamic_maps::saveBinary(map, "/tmp/dynamic_map_binary_3d_float");
+
+    typename map_t::Ptr map_from_file;
+    const bool success = cslibs_ndt_3d::dynamic_maps::loadBinary("/tmp/dynamic_map_binary_3d_float", map_from_file);
+    EXPECT_TRUE(success);
+    EXPECT_NE(map_from_file, nullptr);
+
+    using index_t = std::array<int, 3>;
+    using db_t    = typename map_t::distribution_bundle_t;
+    map->traverse([&map_from_file](const index_t& bi, const db_t& b) {
+        const db_t* bb = map_from_file->getDistributionBundle(bi);
+        EXPECT_NE(bb, nullptr);
+
+        for (std::size_t i = 0 ; i < 8 ; ++ i) {
+            const auto &d  = b.at(i)->data();
+            const auto &dd = bb->at(i)->data();
+            EXPECT_EQ(d.getN(), dd.getN());
+
+            for (std::size_t j = 0 ; j < 3 ; ++ j) {
+                EXPECT_EQ(d.getMean()(j), dd.getMean()(j));
+                for (std::size_t k = 0 ; k < 3 ; ++ k)
+                    EXPECT_NEAR(d.getCovariance()(j, k), dd.getCovariance()(j, k), 1e-6);
+            }
+        }
+    });
+}
+
+template <typename T>
+void benchmark(const cslibs_math_3d::Pointcloud3d::Ptr &cloud,
+               const cslibs_math_3d::Pointcloud3d::Ptr &queries,
+               std::size_t &byte_size,
+               double      &sum)
+{
+    using map_t = cslibs_ndt_3d::dynamic_maps::GridmapT<T>;
+    map_t map(typename map_t::pose_t(), 1.0);
+
+    auto start = steady_clock_t::now();
+    map.insert(cloud);
+    const duration_t t_insert = steady_clock_t::now() - start;
+
+    sum = 0.0;
+    start = steady_clock_t::now();
+    for (const cslibs_math_3d::Point3d &p : *queries)
+        sum += map.sample(p);
+    const duration_t t_sample = steady_clock_t::now() - start;
+
+    byte_size = map.getByteSize();
+    std::cout << "[single precision] " << (sizeof(T) == sizeof(float) ? "float " : "double") << ": "
+              << "insert " << t_insert.count() << " ms, sample " << t_sample.count() << " ms, "
+              << byte_size / 1024 << " KiB" << std::endl;
+}
+
+TEST(Test_cslibs_ndt_3d, testSinglePrecisionBenchmark)
+{
+    const cslibs_math_3d::Pointcloud3d::Ptr cloud = generateScene();
+    for (int i = 0 ; i < 20 ; ++ i)
+        for (const cslibs_math_3d::Point3d &p : *generateScene())
+            cloud->insert(p);
+
+    rng_t<1> rng_coord(0.0, 10.0);
+    cslibs_math_3d::Pointcloud3d::Ptr queries(new cslibs_math_3d::Pointcloud3d);
+    for (int i = 0 ; i < 500000 ; ++ i)
+        queries->insert(cslibs_math_3d::Point3d(rng_coord.get(), rng_coord.get(), rng_coord.get()));
+
+    std::size_t bytes_double = 0, bytes_float = 0;
+    double      sum_double   = 0.0, sum_float = 0.0;
+    benchmark<double>(cloud, queries, bytes_double, sum_double);
+    benchmark<float>(cloud, queries, bytes_float, sum_float);
+
+    /// moments are stored in single precision, updates and samples are still computed in double
+    EXPECT_LT(bytes_float, bytes_double);
+    EXPECT_NEAR(sum_double, sum_float, 1e-3 * std::abs(sum_double));
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
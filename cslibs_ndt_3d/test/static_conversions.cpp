@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/gridmap.hpp>
+#include <cslibs_ndt_3d/conversion/occupancy_gridmap.hpp>
+#include <cslibs_ndt_3d/conversion/sensor_msgs_pointcloud2.hpp>
+#include <cslibs_ndt_3d/conversion/distributions.hpp>
+#include <cslibs_ndt_3d/conversion/voxel_grid.hpp>
+#include <cslibs_ndt_3d/conversion/level_of_detail.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include "generate_box.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <map>
+
+using map_t                  = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using static_map_t           = cslibs_ndt_3d::static_maps::Gridmap;
+using occupancy_map_t        = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using static_occupancy_map_t = cslibs_ndt_3d::static_maps::OccupancyGridmap;
+using array_t                = cslibs_ndt_3d::DistributionArray;
+using block_grid_t           = cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>;
+using cloud_point_t          = cslibs_ndt_3d::conversion::impl::cloud_point_t;
+using steady_clock_t         = std::chrono::steady_clock;
+using duration_t             = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION          = 0.5;
+const double SAMPLING_RESOLUTION = 0.1;
+
+/// the bundles of the maps are traversed in another order
+std::vector<cloud_point_t> sorted(const sensor_msgs::PointCloud2 &msg)
+{
+    std::vector<cloud_point_t> points(msg.width);
+    if (!points.empty())
+        memcpy(points.data(), msg.data.data(), msg.data.size());
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
+void expectSame(const array_t &a,
+                const array_t &b)
+{
+    std::map<uint64_t, cslibs_ndt_3d::Distribution> distributions;
+    for (const auto &d : b.data)
+        distributions[d.id.data] = d;
+
+    ASSERT_EQ(a.data.size(), b.data.size());
+    for (const auto &d : a.data) {
+        ASSERT_EQ(distributions.count(d.id.data), 1ul);
+        const cslibs_ndt_3d::Distribution &e = distributions[d.id.data];
+        EXPECT_EQ(d.prob.data, e.prob.data);
+        for (std::size_t j = 0 ; j < 3 ; ++ j)
+            EXPECT_EQ(d.mean[j].data, e.mean[j].data);
+    }
+}
+
+void expectSame(const block_grid_t &a,
+                const block_grid_t &b)
+{
+    ASSERT_EQ(a.getBlockCount(), b.getBlockCount());
+    std::size_t different = 0;
+    a.traverse([&b, &different](const block_grid_t::index_t &bi, const block_grid_t::block_t &block) {
+        const block_grid_t::block_t *other = b.getBlock(bi);
+        if (!other || *other != block)
+            ++ different;
+    });
+    EXPECT_EQ(different, 0ul);
+}
+
+TEST(Test_cslibs_ndt_3d, testStaticConversions)
+{
+    /// points well inside, so the bundles next to the populated ones lie within the static map
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-4.0, -4.0, -1.0), cslibs_math_3d::Point3d(4.0, 4.0, 1.0), 50000));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-6.0, -6.0, -2.0), cslibs_math_3d::Point3d(6.0, 6.0, 2.0), 20));
+    const static_map_t::Ptr static_map = cslibs_ndt_3d::conversion::from<double>(map);
+
+    sensor_msgs::PointCloud2 msg, static_msg;
+    cslibs_ndt_3d::conversion::from(map, msg);
+    cslibs_ndt_3d::conversion::from(static_map, static_msg);
+    EXPECT_GT(msg.width, 0ul);
+    EXPECT_EQ(msg.width, static_msg.width);
+    EXPECT_TRUE(sorted(msg) == sorted(static_msg));
+
+    array_t::Ptr array, static_array;
+    cslibs_ndt_3d::conversion::from(map, array);
+    cslibs_ndt_3d::conversion::from(static_map, static_array);
+    ASSERT_TRUE(array && static_array);
+    expectSame(*array, *static_array);
+
+    block_grid_t::Ptr grid, static_grid;
+    cslibs_ndt_3d::conversion::from(map, grid, SAMPLING_RESOLUTION);
+    cslibs_ndt_3d::conversion::from(static_map, static_grid, SAMPLING_RESOLUTION);
+    ASSERT_TRUE(grid && static_grid);
+    expectSame(*grid, *static_grid);
+
+    cslibs_ndt_3d::conversion::LevelOfDetail lod, static_lod;
+    lod.build(*map);
+    static_lod.build(*static_map);
+    EXPECT_EQ(lod.getLevels(), static_lod.getLevels());
+}
+
+TEST(Test_cslibs_ndt_3d, testStaticOccupancyConversions)
+{
+    /// the same scan in both maps, the static one covers all of it
+    const cslibs_math_3d::Pointcloud3d::Ptr points =
+            generateBox(cslibs_math_3d::Point3d(-4.0, -4.0, -1.0), cslibs_math_3d::Point3d(4.0, 4.0, 1.0), 50000);
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    const static_occupancy_map_t::Ptr static_map(new static_occupancy_map_t(static_occupancy_map_t::pose_t(), RESOLUTION,
+                                                                            static_occupancy_map_t::size_t{{40, 40, 40}},
+                                                                            static_occupancy_map_t::index_t{{-40, -40, -20}}));
+    map->insert(points, occupancy_map_t::pose_t(0.0, 0.0, 3.0));
+    static_map->insert(points, static_occupancy_map_t::pose_t(0.0, 0.0, 3.0));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+
+    sensor_msgs::PointCloud2 msg, static_msg;
+    cslibs_ndt_3d::conversion::from(map, msg, ivm);
+    cslibs_ndt_3d::conversion::from(static_map, static_msg, ivm);
+    EXPECT_GT(msg.width, 0ul);
+    EXPECT_TRUE(sorted(msg) == sorted(static_msg));
+
+    array_t::Ptr array, static_array;
+    cslibs_ndt_3d::conversion::from(map, array, ivm);
+    cslibs_ndt_3d::conversion::from(static_map, static_array, ivm);
+    ASSERT_TRUE(array && static_array);
+    expectSame(*array, *static_array);
+
+    block_grid_t::Ptr grid, static_grid;
+    cslibs_ndt_3d::conversion::from(map, grid, SAMPLING_RESOLUTION, ivm);
+    cslibs_ndt_3d::conversion::from(static_map, static_grid, SAMPLING_RESOLUTION, ivm);
+    ASSERT_TRUE(grid && static_grid);
+    expectSame(*grid, *static_grid);
+}
+
+TEST(Test_cslibs_ndt_3d, testStaticConversionsBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateBox(cslibs_math_3d::Point3d(-20.0, -20.0, -1.0), cslibs_math_3d::Point3d(20.0, 20.0, 1.0), 500000));
+    const static_map_t::Ptr static_map = cslibs_ndt_3d::conversion::from<double>(map);
+
+    array_t::Ptr array;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, array);
+    const duration_t t_dynamic = steady_clock_t::now() - start;
+
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(static_map, array);
+    const duration_t t_static = steady_clock_t::now() - start;
+
+    std::cout << "[static conversions] " << array->data.size() << " distributions, dynamic map "
+              << t_dynamic.count() << " ms, static map " << t_static.count() << " ms" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <cslibs_ndt_3d/conversion/voxel_grid.hpp>
+
+#include <cslibs_math_3d/linear/pointcloud.hpp>
+
+#include <cslibs_math/random/random.hpp>
+#include <iostream>
+#include <chrono>
+
+template <std::size_t Dim>
+using rng_t = typename cslibs_math::random::Uniform<Dim>;
+
+using map_t            = cslibs_ndt_3d::dynamic_maps::Gridmap;
+using occupancy_map_t  = cslibs_ndt_3d::dynamic_maps::OccupancyGridmap;
+using voxel_grid_t     = cslibs_ndt_3d::voxel_grids::VoxelGrid<double>;
+using block_grid_t     = cslibs_ndt_3d::voxel_grids::BlockVoxelGrid<double>;
+using index_t          = std::array<int, 3>;
+using steady_clock_t   = std::chrono::steady_clock;
+using duration_t       = std::chrono::duration<double, std::milli>;
+
+const double RESOLUTION          = 0.5;
+const double SAMPLING_RESOLUTION = 0.05;
+
+/// a floor with a wall
+cslibs_math_3d::Pointcloud3d::Ptr generateRoom(const double size,
+                                               const std::size_t count)
+{
+    rng_t<1> rng(0.0, size);
+    rng_t<1> rng_z(-0.1, 0.1);
+    cslibs_math_3d::Pointcloud3d::Ptr cloud(new cslibs_math_3d::Pointcloud3d);
+    for (std::size_t i = 0 ; i < count ; ++ i) {
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), rng.get(), rng_z.get()));
+        cloud->insert(cslibs_math_3d::Point3d(rng.get(), size + rng_z.get(), 0.2 * rng.get()));
+    }
+    return cloud;
+}
+
+/// voxel by voxel sampling of the bundle which contains the voxel
+template <typename map_t, typename Sample>
+double sampleVoxel(const map_t &map,
+                   const index_t &bi,
+                   const cslibs_math_3d::Point3d &p,
+                   const Sample &sample)
+{
+    typename map_t::distribution_const_bundle_t b;
+    map.lookupDistributionBundle(bi, b);
+    double v = 0.0;
+    for (std::size_t i = 0 ; i < 8 ; ++ i)
+        if (b.at(i))
+            v += 0.125 * sample(*b.at(i), p);
+    return v;
+}
+
+cslibs_math_3d::Point3d centre(const voxel_grid_t &grid,
+                               const index_t &i)
+{
+    const double r = grid.getResolution();
+    return grid.getOrigin() * cslibs_math_3d::Point3d((i[0] + 0.5) * r, (i[1] + 0.5) * r, (i[2] + 0.5) * r);
+}
+
+TEST(Test_cslibs_ndt_3d, testVoxelGridDense)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(1.0, -2.0, 0.5, 0.1, -0.2, 0.3), RESOLUTION));
+    map->insert(generateRoom(3.0, 5000), map->getInitialOrigin());
+
+    voxel_grid_t::Ptr grid;
+    cslibs_ndt_3d::conversion::from(map, grid, SAMPLING_RESOLUTION);
+    ASSERT_TRUE(grid.get());
+    ASSERT_FALSE(grid->getData().empty());
+
+    auto sample = [](const map_t::distribution_t &d, const cslibs_math_3d::Point3d &p) {
+        return d.data().sampleNonNormalized(p);
+    };
+
+    std::size_t different = 0;
+    const voxel_grid_t::size_t &size = grid->getSize();
+    for (std::size_t z = 0 ; z < size[2] ; ++ z) {
+        for (std::size_t y = 0 ; y < size[1] ; ++ y) {
+            for (std::size_t x = 0 ; x < size[0] ; ++ x) {
+                const index_t i  = {{static_cast<int>(x), static_cast<int>(y), static_cast<int>(z)}};
+                const index_t bi = map->getBundleIndex(centre(*grid, i));
+                if (std::abs(sampleVoxel(*map, bi, grid->toPoint(i), sample) - grid->at(i)) > 1e-9)
+                    ++ different;
+            }
+        }
+    }
+    EXPECT_EQ(different, 0ul);
+}
+
+TEST(Test_cslibs_ndt_3d, testVoxelGridBlocks)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(1.0, -2.0, 0.5, 0.1, -0.2, 0.3), RESOLUTION));
+    map->insert(generateRoom(3.0, 5000), map->getInitialOrigin());
+    std::size_t bundles = 0;
+    map->traverse([&bundles](const index_t &, const map_t::distribution_bundle_t &) { ++ bundles; });
+
+    voxel_grid_t::Ptr dense;
+    block_grid_t::Ptr blocks;
+    cslibs_ndt_3d::conversion::from(map, dense, SAMPLING_RESOLUTION);
+    cslibs_ndt_3d::conversion::from(map, blocks, SAMPLING_RESOLUTION);
+
+    /// the conversions do not allocate bundles
+    std::size_t bundles_after = 0;
+    map->traverse([&bundles_after](const index_t &, const map_t::distribution_bundle_t &) { ++ bundles_after; });
+    EXPECT_EQ(bundles, bundles_after);
+
+    /// both grids agree at every voxel of the dense one
+    std::size_t different = 0;
+    const voxel_grid_t::size_t &size = dense->getSize();
+    for (std::size_t z = 0 ; z < size[2] ; ++ z) {
+        for (std::size_t y = 0 ; y < size[1] ; ++ y) {
+            for (std::size_t x = 0 ; x < size[0] ; ++ x) {
+                const index_t i  = {{static_cast<int>(x), static_cast<int>(y), static_cast<int>(z)}};
+                const index_t bi = blocks->toIndex(centre(*dense, i));
+                if (std::abs(blocks->at(bi) - dense->at(i)) > 1e-9)
+                    ++ different;
+            }
+        }
+    }
+    EXPECT_EQ(different, 0ul);
+    EXPECT_LT(blocks->getByteSize(), dense->getByteSize());
+}
+
+TEST(Test_cslibs_ndt_3d, testVoxelGridOccupancy)
+{
+    const occupancy_map_t::Ptr map(new occupancy_map_t(occupancy_map_t::pose_t(), RESOLUTION));
+    map->insert(generateRoom(3.0, 5000), cslibs_math_3d::Transform3d(1.5, 1.5, 1.0));
+    const cslibs_gridmaps::utility::InverseModel::Ptr ivm(new cslibs_gridmaps::utility::InverseModel(0.5, 0.45, 0.65));
+
+    auto sample = [&ivm](const occupancy_map_t::distribution_t &d, const cslibs_math_3d::Point3d &p) {
+        return d.getDistribution() ? d.getDistribution()->sampleNonNormalized(p) * d.getOccupancy(ivm) : 0.0;
+    };
+
+    block_grid_t::Ptr blocks;
+    cslibs_ndt_3d::conversion::from(map, blocks, SAMPLING_RESOLUTION, ivm);
+    ASSERT_GT(blocks->getBlockCount(), 0ul);
+
+    const int chunk_step = blocks->getBlockSize();
+    std::size_t different = 0;
+    blocks->traverse([&](const index_t &bi, const block_grid_t::block_t &b) {
+        for (int m = 0 ; m < chunk_step ; ++ m)
+            for (int l = 0 ; l < chunk_step ; ++ l)
+                for (int k = 0 ; k < chunk_step ; ++ k) {
+                    const index_t i = {{bi[0] * chunk_step + k, bi[1] * chunk_step + l, bi[2] * chunk_step + m}};
+                    if (std::abs(sampleVoxel(*map, bi, blocks->toPoint(i), sample) - b[(m * chunk_step + l) * chunk_step + k]) > 1e-9)
+                        ++ different;
+                }
+    });
+    EXPECT_EQ(different, 0ul);
+
+    /// bundles below the threshold are left out
+    block_grid_t::Ptr occupied;
+    cslibs_ndt_3d::conversion::from(map, occupied, SAMPLING_RESOLUTION, ivm, 0.6);
+    EXPECT_LT(occupied->getBlockCount(), blocks->getBlockCount());
+    occupied->traverse([&blocks](const index_t &bi, const block_grid_t::block_t &b) {
+        EXPECT_TRUE(blocks->getBlock(bi) && *blocks->getBlock(bi) == b);
+    });
+}
+
+TEST(Test_cslibs_ndt_3d, testVoxelGridBenchmark)
+{
+    const map_t::Ptr map(new map_t(map_t::pose_t(), RESOLUTION));
+    map->insert(generateRoom(10.0, 50000));
+
+    voxel_grid_t::Ptr dense;
+    auto start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, dense, SAMPLING_RESOLUTION);
+    const duration_t t_dense = steady_clock_t::now() - start;
+
+    block_grid_t::Ptr blocks;
+    start = steady_clock_t::now();
+    cslibs_ndt_3d::conversion::from(map, blocks, SAMPLING_RESOLUTION);
+    const duration_t t_blocks = steady_clock_t::now() - start;
+
+    /// the same voxels sampled one by one
+    start = steady_clock_t::now();
+    double sum = 0.0;
+    const int chunk_step = blocks->getBlockSize();
+    blocks->traverse([&](const index_t &bi, const block_grid_t::block_t &) {
+        for (int m = 0 ; m < chunk_step ; ++ m)
+            for (int l = 0 ; l < chunk_step ; ++ l)
+                for (int k = 0 ; k < chunk_step ; ++ k)
+                    sum += map->sampleNonNormalized(blocks->toPoint({{bi[0] * chunk_step + k, bi[1] * chunk_step + l, bi[2] * chunk_step + m}}));
+    });
+    const duration_t t_voxels = steady_clock_t::now() - start;
+
+    std::cout << "[voxel grid] dense " << dense->getByteSize() / 1024 << " KiB " << t_dense.count() << " ms, "
+              << blocks->getBlockCount() << " blocks " << blocks->getByteSize() / 1024 << " KiB " << t_blocks.count() << " ms, "
+              << "per voxel " << t_voxels.count() << " ms" << std::endl;
+    EXPECT_GT(sum, 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}